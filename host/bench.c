@@ -0,0 +1,911 @@
+/**
+ * Copyright (C) 2017 m2enu
+ *
+ * @file host/bench.c
+ * @brief throughput and latency benchmark of the ingest pipeline (Linux)
+ *
+ * Replays an app_tag stream, synthetic (twelite_build_packet() of N end
+ * devices) or captured (-f), through the stages of the ESP32 build:
+ *   frame     twelite_framer_push()/next() of one UART read (burst)
+ *   parse     twelite_parse_packet() of one frame
+ *   serialize m2x_batch_add() and m2x_batch_json() of one batch
+ *   cbor_packet  cbor_packet() of each packet of one batch (MQTT_CBOR)
+ *   cbor_delta   cbor_delta() of one batch (MQTT_CBOR_DELTA)
+ *   timestamp timemap_wall() and json_timestamp() of each packet of one batch
+ *   values_sprintf  BME280 values of each packet of one batch by sprintf()
+ *             "%6.2f"/"%9.2f", as the values were formatted before json_fixed()
+ *   values_fixed    the same values by json_fixed() of the integer readings
+ *   journal_append  journal_append() of each packet of one batch (RAM image
+ *             of BENCH_JOURNAL_SECTORS flash sectors, erase included)
+ *   journal_replay  journal_peek() and journal_consume() of the same batch
+ *   rule_check  rule_check() of each packet of one batch (BENCH_RULES)
+ *   sink_x1/x2/x4  sink_push() of one batch to 1, 2 or 4 sink tasks (influx
+ *             format, null transport) until every task has sent it
+ *   upload    m2x_client_post() of one batch to a (mock) M2X server
+ *   upload_per_request  the same on a new connection after DNS lookup, as
+ *             every request did before the client kept its connection
+ *   e2e       from UART read of a packet to its batch serialized/posted
+ * Each stage reports items/s, p50/p99/p999 latency of one operation and
+ * heap use per operation as one JSON line on stdout (logs go to stderr), and
+ * for the serializers the output bytes per reading, e.g.
+ *   make -C host bench BENCH_ARGS="-n 1000 -b 1:16 -c 10 -l $(git rev-parse --short HEAD)"
+ * @author m2enu
+ * @date 2026/10/17
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sched.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "port.h"
+#include "twelite.h"
+#include "framer.h"
+#include "batch.h"
+#include "cbor.h"
+#include "json.h"
+#include "m2x.h"
+#include "influx.h"
+#include "sink.h"
+#include "timemap.h"
+#include "journal.h"
+#include "rule.h"
+
+#define BENCH_DEVICE_MAX    1000 //!< max. number of end devices
+#define BENCH_LINE_MAX      (TWELITE_PACKET_LENGTH_MAX + 5) //!< max. length of line
+#define BENCH_BURST_MAX     128 //!< max. number of lines per UART read
+#define BENCH_SID_DEVICE    0x81000000u //!< SID of the first end device
+#define BENCH_SID_ROUTER    0x82000000u //!< SID of router
+#define BENCH_SINK_MAX      4 //!< number of sink tasks
+#define BENCH_SINK_SLOTS    64 //!< packet queue slots of sink
+#define BENCH_JOURNAL_SECTORS 16 //!< flash sectors of journal (4 KiB each)
+#define BENCH_RULES         "vdd<2.4,temperature<-10,temperature>40,temperature~5,humidity~10" //!< alert rules
+
+/** <!-- bench_stage_t {{{1 -->
+ * @brief stages of pipeline
+ */
+typedef enum bench_stage_t_tag {
+    BENCH_FRAME = 0, //!< framing of one UART read
+    BENCH_PARSE, //!< parse of one frame
+    BENCH_SERIALIZE, //!< batch and json of one batch
+    BENCH_CBOR_PACKET, //!< cbor map of each packet of one batch
+    BENCH_CBOR_DELTA, //!< cbor delta of one batch
+    BENCH_TIMESTAMP, //!< wall clock timestamps of one batch
+    BENCH_VALUES_SPRINTF, //!< values of one batch by sprintf()
+    BENCH_VALUES_FIXED, //!< values of one batch by json_fixed()
+    BENCH_JOURNAL_APPEND, //!< journal append of one batch
+    BENCH_JOURNAL_REPLAY, //!< journal peek and consume of one batch
+    BENCH_RULE_CHECK, //!< alert rules of one batch
+    BENCH_SINK_X1, //!< one batch through 1 sink task
+    BENCH_SINK_X2, //!< one batch through 2 sink tasks
+    BENCH_SINK_X4, //!< one batch through 4 sink tasks
+    BENCH_UPLOAD, //!< POST of one batch
+    BENCH_UPLOAD_ONCE, //!< POST of one batch on a new connection
+    BENCH_E2E, //!< one packet from UART read to end of pipeline
+    BENCH_STAGE_NUM,
+} bench_stage_t;
+
+static const char *bench_stage_name[BENCH_STAGE_NUM] = {
+    "frame", "parse", "serialize", "cbor_packet", "cbor_delta", "timestamp",
+    "values_sprintf", "values_fixed", "journal_append", "journal_replay",
+    "rule_check", "sink_x1", "sink_x2", "sink_x4", "upload", "upload_per_request", "e2e",
+};
+
+/** <!-- bench_stat_t {{{1 -->
+ * @brief measurement of one stage
+ */
+typedef struct bench_stat_t_tag {
+    int64_t *ns; //!< latency of each operation [ns]
+    uint32_t num; //!< number of operations
+    uint32_t max_num; //!< size of ns
+    uint64_t items; //!< number of items processed (frames, packets)
+    int64_t busy; //!< sum of latency [ns]
+    uint32_t n_alloc; //!< number of heap allocations
+    uint64_t b_alloc; //!< bytes of heap allocations
+    uint64_t out_bytes; //!< bytes of serialized output
+    uint32_t n_error; //!< number of failed operations
+} bench_stat_t;
+
+/** <!-- bench_t {{{1 -->
+ * @brief benchmark options and state
+ */
+typedef struct bench_t_tag {
+    const char *path; //!< captured stream (NULL: synthetic)
+    const char *label; //!< label of results (e.g. commit)
+    uint32_t device_num; //!< number of end devices
+    uint32_t packet_num; //!< number of synthetic packets
+    uint32_t burst_min; //!< min. number of lines per UART read
+    uint32_t burst_max; //!< max. number of lines per UART read
+    uint32_t corrupt; //!< corrupted lines [1/1000]
+    uint32_t repeat; //!< number of measured passes
+    uint32_t batch_num; //!< packets per batch
+    uint32_t seed; //!< seed of random numbers
+    char host[64]; //!< M2X server (empty: no upload)
+    uint16_t port; //!< M2X port
+    char *stream; //!< lines of stream
+    uint32_t *line; //!< offset of each line in stream (line_num + 1)
+    uint32_t line_num; //!< number of lines
+    int64_t *arrive; //!< UART read time of packets in batch [ns]
+    twelite_framer_t framer; //!< framer
+    timemap_t clock; //!< clock mapping of timestamps
+    m2x_batch_t batch; //!< batch
+    m2x_client_t m2x; //!< M2X client
+    m2x_client_t m2x_once; //!< M2X client closed after each request
+    char body[16384]; //!< json of batch
+    char cbor[16384]; //!< cbor of batch
+    influx_t influx; //!< format of sinks
+    sink_ops_t sink_ops; //!< influx format, null transport
+    sink_t sink[BENCH_SINK_MAX]; //!< sink tasks
+    pktq_slot_t sink_slot[BENCH_SINK_MAX][BENCH_SINK_SLOTS]; //!< slots of sink queues
+    char sink_body[BENCH_SINK_MAX][4096]; //!< serialize buffers of sinks
+    journal_ops_t journal_ops; //!< storage backend on journal_image
+    journal_t journal; //!< journal
+    uint8_t journal_image[BENCH_JOURNAL_SECTORS * 4096]; //!< flash image
+    twelite_packet_t replay[M2X_BATCH_MAX]; //!< packets replayed from journal
+    rule_table_t rule; //!< alert rules
+    bench_stat_t stat[BENCH_STAGE_NUM]; //!< measurement by stage
+    int64_t side; //!< time of stages outside of e2e pipeline [ns]
+} bench_t;
+
+static bench_t bench; //!< benchmark
+
+/** <!-- bench_ns {{{1 -->
+ * @brief current time
+ * @param nothing
+ * @return monotonic time [ns]
+ */
+static inline int64_t bench_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/** <!-- bench_rand {{{1 -->
+ * @brief deterministic random number (xorshift32)
+ * @param nothing
+ * @return random number
+ */
+static uint32_t bench_rand(void)
+{
+    uint32_t x = bench.seed;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    bench.seed = x;
+    return x;
+}
+
+/** <!-- bench_record {{{1 -->
+ * @brief record one operation of stage
+ * @param[in] stage stage
+ * @param[in] start start time [ns]
+ * @param[in] end end time [ns]
+ * @param[in] items number of items processed
+ * @param[in] n_alloc heap allocations before operation
+ * @param[in] b_alloc heap bytes before operation
+ * @return nothing
+ */
+static void bench_record(bench_stage_t stage, int64_t start, int64_t end,
+                         uint32_t items, uint32_t n_alloc, uint64_t b_alloc)
+{
+    bench_stat_t *s = &bench.stat[stage];
+    if (s->num < s->max_num) {
+        s->ns[s->num++] = end - start;
+    }
+    s->items   += items;
+    s->busy    += end - start;
+    s->n_alloc += port_heap_count() - n_alloc;
+    s->b_alloc += port_heap_bytes() - b_alloc;
+}
+
+/** <!-- bench_line_add {{{1 -->
+ * @brief append line to stream
+ * @param[in] str line
+ * @param[in] len length of line
+ * @return nothing
+ */
+static void bench_line_add(const char *str, uint32_t len)
+{
+    uint32_t pos = bench.line[bench.line_num];
+    memcpy(&bench.stream[pos], str, len);
+    bench.line[++bench.line_num] = pos + len;
+}
+
+/** <!-- bench_synth {{{1 -->
+ * @brief generate stream of end devices with every sensor type
+ * @param nothing
+ * @return nothing
+ */
+static void bench_synth(void)
+{
+    static const uint8_t ids[] = {
+        TWELITE_ID_BME280, TWELITE_ID_SHT21, TWELITE_ID_ADXL34X, TWELITE_ID_LM61,
+    };
+    static uint16_t next_number[BENCH_DEVICE_MAX];
+    char str[BENCH_LINE_MAX];
+    uint32_t n;
+    for (n = 0; n < bench.packet_num; n++) {
+        uint32_t dev = bench_rand() % bench.device_num;
+        twelite_packet_t pkt;
+        memset(&pkt, 0, sizeof(pkt));
+        pkt.sid_router      = BENCH_SID_ROUTER;
+        pkt.lqi             = 60 + bench_rand() % 120;
+        pkt.next_number     = next_number[dev]++;
+        pkt.sid_enddevice   = BENCH_SID_DEVICE + dev;
+        pkt.id_sensor       = ids[dev % sizeof(ids)];
+        pkt.mvolt_vdd       = 2400 + bench_rand() % 1200;
+        pkt.mvolt_adc1      = 300 + bench_rand() % 1000;
+        pkt.pkt_raw.w16[0]  = bench_rand();
+        pkt.pkt_raw.w16[1]  = bench_rand();
+        pkt.pkt_raw.w16[2]  = bench_rand();
+        pkt.pkt_raw.w32     = 90000 + bench_rand() % 20000;
+        bench_line_add(str, twelite_build_packet(str, sizeof(str), &pkt));
+    }
+}
+
+/** <!-- bench_load {{{1 -->
+ * @brief load captured stream, split into lines at LF
+ * @param nothing
+ * @return result of load
+ * @retval Zero: Success
+ * @retval -ve_value: Error
+ */
+static int8_t bench_load(void)
+{
+    FILE *fp = fopen(bench.path, "rb");
+    char str[BENCH_LINE_MAX];
+    if (fp == NULL) {
+        perror(bench.path);
+        return -1;
+    }
+    while (fgets(str, sizeof(str), fp) != NULL) {
+        if (bench.line_num < bench.packet_num) {
+            bench_line_add(str, strlen(str));
+        }
+    }
+    fclose(fp);
+    return (bench.line_num > 0) ? 0 : -1;
+}
+
+/** <!-- bench_corrupt {{{1 -->
+ * @brief corrupt lines (wrong digit, lost byte or lost CR/LF)
+ * @param nothing
+ * @return nothing
+ */
+static void bench_corrupt(void)
+{
+    uint32_t n;
+    for (n = 0; n < bench.line_num; n++) {
+        char *str = &bench.stream[bench.line[n]];
+        uint32_t len = bench.line[n + 1] - bench.line[n];
+        uint32_t pos = 1 + bench_rand() % ((len > 3) ? len - 3 : 1);
+        if ((len < 4) || ((bench_rand() % 1000) >= bench.corrupt)) {
+            continue;
+        }
+        switch (bench_rand() % 3) {
+        case 0: str[pos] = (str[pos] == '0') ? '1' : '0'; break;
+        case 1: str[pos] = 'G'; break;
+        default: str[len - 1] = str[len - 2] = '0'; break;
+        }
+    }
+}
+
+/** <!-- bench_cbor {{{1 -->
+ * @brief serialize batch into cbor, one map per packet and as delta batch
+ * @param nothing
+ * @return nothing
+ */
+static void bench_cbor(void)
+{
+    bench_stat_t *s;
+    json_writer_t w;
+    uint32_t num = bench.batch.num;
+    uint32_t n;
+    uint32_t n_alloc = port_heap_count();
+    uint64_t b_alloc = port_heap_bytes();
+    int64_t t0 = bench_ns();
+    json_init(&w, bench.cbor, sizeof(bench.cbor));
+    for (n = 0; (n < num) && !w.err; n++) {
+        cbor_packet(&w, &bench.batch.pkt[n], &bench.clock);
+    }
+    int32_t len = json_finish(&w);
+    int64_t t1 = bench_ns();
+    bench_record(BENCH_CBOR_PACKET, t0, t1, num, n_alloc, b_alloc);
+    s = &bench.stat[BENCH_CBOR_PACKET];
+    s->out_bytes += (len > 0) ? len : 0;
+    s->n_error   += (len < 0);
+    n_alloc = port_heap_count();
+    b_alloc = port_heap_bytes();
+    t0 = bench_ns();
+    json_init(&w, bench.cbor, sizeof(bench.cbor));
+    cbor_delta(&w, bench.batch.pkt, num, &bench.clock);
+    len = json_finish(&w);
+    t1 = bench_ns();
+    bench_record(BENCH_CBOR_DELTA, t0, t1, num, n_alloc, b_alloc);
+    s = &bench.stat[BENCH_CBOR_DELTA];
+    s->out_bytes += (len > 0) ? len : 0;
+    s->n_error   += (len < 0);
+}
+
+/** <!-- bench_timestamp {{{1 -->
+ * @brief map receive time of each packet of batch to ISO 8601
+ * @param nothing
+ * @return nothing
+ */
+static void bench_timestamp(void)
+{
+    json_writer_t w;
+    uint32_t num = bench.batch.num;
+    uint32_t n;
+    uint32_t n_alloc = port_heap_count();
+    uint64_t b_alloc = port_heap_bytes();
+    int64_t t0 = bench_ns();
+    json_init(&w, bench.cbor, sizeof(bench.cbor));
+    for (n = 0; n < num; n++) {
+        json_timestamp(&w, timemap_wall(&bench.clock, bench.batch.pkt[n].timestamp));
+    }
+    int32_t len = json_finish(&w);
+    int64_t t1 = bench_ns();
+    bench_record(BENCH_TIMESTAMP, t0, t1, num, n_alloc, b_alloc);
+    bench.stat[BENCH_TIMESTAMP].out_bytes += (len > 0) ? len : 0;
+    bench.stat[BENCH_TIMESTAMP].n_error   += (len < 0);
+}
+
+/** <!-- bench_values_sprintf {{{1 -->
+ * @brief format BME280 values of each packet of batch by sprintf()
+ * @param nothing
+ * @return nothing
+ */
+static void bench_values_sprintf(void)
+{
+    uint32_t num = bench.batch.num;
+    uint32_t n;
+    int32_t len = 0;
+    uint32_t n_alloc = port_heap_count();
+    uint64_t b_alloc = port_heap_bytes();
+    int64_t t0 = bench_ns();
+    for (n = 0; n < num; n++) {
+        const twelite_packet_t *pkt = &bench.batch.pkt[n];
+        int ret = snprintf(&bench.cbor[len], sizeof(bench.cbor) - len,
+            "{ \"values\": {\"temperature\": %6.2f, \"pressure\": %9.2f, "
+            "\"humidity\": %6.2f, \"vdd\": %6.3f} }",
+            pkt->pkt_bme280.temperature, pkt->pkt_bme280.pressure,
+            pkt->pkt_bme280.humidity, pkt->mvolt_vdd / 1000.0);
+        if ((ret < 0) || (ret >= (int)sizeof(bench.cbor) - len)) {
+            len = -1;
+            break;
+        }
+        len += ret;
+    }
+    int64_t t1 = bench_ns();
+    bench_record(BENCH_VALUES_SPRINTF, t0, t1, num, n_alloc, b_alloc);
+    bench.stat[BENCH_VALUES_SPRINTF].out_bytes += (len > 0) ? len : 0;
+    bench.stat[BENCH_VALUES_SPRINTF].n_error   += (len < 0);
+}
+
+/** <!-- bench_values_fixed {{{1 -->
+ * @brief format BME280 values of each packet of batch by json_fixed()
+ * @param nothing
+ * @return nothing
+ */
+static void bench_values_fixed(void)
+{
+    json_writer_t w;
+    uint32_t num = bench.batch.num;
+    uint32_t n;
+    uint32_t n_alloc = port_heap_count();
+    uint64_t b_alloc = port_heap_bytes();
+    int64_t t0 = bench_ns();
+    json_init(&w, bench.cbor, sizeof(bench.cbor));
+    for (n = 0; n < num; n++) {
+        const twelite_packet_t *pkt = &bench.batch.pkt[n];
+        json_puts(&w, "{\"values\":{");
+        json_key(&w, "temperature");
+        json_fixed(&w, (int16_t)pkt->pkt_bme280.i_temperature, 2);
+        json_puts(&w, ",");
+        json_key(&w, "pressure");
+        json_fixed(&w, (int32_t)pkt->pkt_bme280.i_pressure, 0);
+        json_puts(&w, ",");
+        json_key(&w, "humidity");
+        json_fixed(&w, pkt->pkt_bme280.i_humidity, 2);
+        json_puts(&w, ",");
+        json_key(&w, "vdd");
+        json_fixed(&w, pkt->mvolt_vdd, 3);
+        json_puts(&w, "}}");
+    }
+    int32_t len = json_finish(&w);
+    int64_t t1 = bench_ns();
+    bench_record(BENCH_VALUES_FIXED, t0, t1, num, n_alloc, b_alloc);
+    bench.stat[BENCH_VALUES_FIXED].out_bytes += (len > 0) ? len : 0;
+    bench.stat[BENCH_VALUES_FIXED].n_error   += (len < 0);
+}
+
+/** <!-- bench_journal {{{1 -->
+ * @brief append packets of batch to journal, then replay them
+ * @param nothing
+ * @return nothing
+ */
+static void bench_journal(void)
+{
+    journal_t *j = &bench.journal;
+    uint32_t num = bench.batch.num;
+    uint32_t n;
+    uint32_t span;
+    int32_t got = 0;
+    uint32_t n_alloc = port_heap_count();
+    uint64_t b_alloc = port_heap_bytes();
+    int64_t t0 = bench_ns();
+    for (n = 0; n < num; n++) {
+        bench.stat[BENCH_JOURNAL_APPEND].n_error +=
+            (journal_append(j, &bench.batch.pkt[n]) < 0);
+    }
+    int64_t t1 = bench_ns();
+    bench_record(BENCH_JOURNAL_APPEND, t0, t1, num, n_alloc, b_alloc);
+    n_alloc = port_heap_count();
+    b_alloc = port_heap_bytes();
+    t0 = bench_ns();
+    while (j->count > 0) {
+        int32_t ret = journal_peek(j, bench.replay, M2X_BATCH_MAX, &span);
+        if ((ret < 0) || journal_consume(j, span)) {
+            bench.stat[BENCH_JOURNAL_REPLAY].n_error++;
+            break;
+        }
+        got += ret;
+    }
+    t1 = bench_ns();
+    bench_record(BENCH_JOURNAL_REPLAY, t0, t1, num, n_alloc, b_alloc);
+    bench.stat[BENCH_JOURNAL_REPLAY].n_error += (got != (int32_t)num);
+}
+
+/** <!-- bench_rule {{{1 -->
+ * @brief classify each packet of batch by alert rules
+ * @param nothing
+ * @return nothing
+ */
+static void bench_rule(void)
+{
+    uint32_t num = bench.batch.num;
+    uint32_t n;
+    uint32_t n_alloc = port_heap_count();
+    uint64_t b_alloc = port_heap_bytes();
+    int64_t t0 = bench_ns();
+    for (n = 0; n < num; n++) {
+        rule_check(&bench.rule, &bench.batch.pkt[n]);
+    }
+    int64_t t1 = bench_ns();
+    bench_record(BENCH_RULE_CHECK, t0, t1, num, n_alloc, b_alloc);
+}
+
+/** <!-- bench_sink_send {{{1 -->
+ * @brief discard serialized packets (sink_ops_t)
+ * @param[in] ctx not used
+ * @param[in] data serialized packets
+ * @param[in] len length of data
+ * @return result of send
+ * @retval Zero: Success
+ */
+static int8_t bench_sink_send(void *ctx, const char *data, int32_t len)
+{
+    (void)ctx;
+    (void)data;
+    (void)len;
+    return 0;
+}
+
+/** <!-- bench_sink_close {{{1 -->
+ * @brief nothing to close (sink_ops_t)
+ * @param[in] ctx not used
+ * @return nothing
+ */
+static void bench_sink_close(void *ctx)
+{
+    (void)ctx;
+}
+
+/** <!-- bench_sink_start {{{1 -->
+ * @brief create sink tasks (before heap is armed)
+ * @param nothing
+ * @return result of start
+ * @retval Zero: Success
+ * @retval -ve_value: Error
+ */
+static int8_t bench_sink_start(void)
+{
+    uint32_t n;
+    if (influx_init(&bench.influx, "localhost", 8089, &bench.clock)) {
+        return -1;
+    }
+    bench.sink_ops          = bench.influx.ops;
+    bench.sink_ops.send     = bench_sink_send;
+    bench.sink_ops.close    = bench_sink_close;
+    for (n = 0; n < BENCH_SINK_MAX; n++) {
+        if (sink_init(&bench.sink[n], "bench", &bench.sink_ops,
+                      bench.sink_slot[n], BENCH_SINK_SLOTS, bench.sink_body[n],
+                      sizeof(bench.sink_body[n]), SINK_BATCH_MAX, 0) ||
+            sink_spawn(&bench.sink[n], 4096, 5, PORT_CORE_ANY)) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/** <!-- bench_sinks {{{1 -->
+ * @brief hand batch over to sink tasks, and wait until all are sent
+ * @param[in] stage stage (BENCH_SINK_X1, X2 or X4)
+ * @param[in] num_sink number of sink tasks
+ * @return nothing
+ */
+static void bench_sinks(bench_stage_t stage, uint32_t num_sink)
+{
+    uint32_t target[BENCH_SINK_MAX];
+    uint32_t drop = 0;
+    uint32_t num = bench.batch.num;
+    uint32_t n;
+    uint32_t k;
+    uint32_t n_alloc = port_heap_count();
+    uint64_t b_alloc = port_heap_bytes();
+    for (k = 0; k < num_sink; k++) {
+        sink_t *s = &bench.sink[k];
+        target[k] = __atomic_load_n(&s->n_packet, __ATOMIC_ACQUIRE) +
+                    s->q.n_drop_oldest + num;
+    }
+    int64_t t0 = bench_ns();
+    for (n = 0; n < num; n++) {
+        for (k = 0; k < num_sink; k++) {
+            sink_push(&bench.sink[k], &bench.batch.pkt[n]);
+        }
+    }
+    for (k = 0; k < num_sink; k++) {
+        sink_t *s = &bench.sink[k];
+        while (__atomic_load_n(&s->n_packet, __ATOMIC_ACQUIRE) +
+               s->q.n_drop_oldest < target[k]) {
+            sched_yield();
+        }
+    }
+    int64_t t1 = bench_ns();
+    bench_record(stage, t0, t1, num * num_sink, n_alloc, b_alloc);
+    for (k = 0; k < num_sink; k++) {
+        drop += bench.sink[k].q.n_drop_oldest;
+    }
+    bench.stat[stage].n_error = drop;
+}
+
+/** <!-- bench_upload_once {{{1 -->
+ * @brief post batch by DNS lookup, connect, POST and close
+ * @param[in] len length of json of batch
+ * @return nothing
+ */
+static void bench_upload_once(int32_t len)
+{
+    uint32_t n_alloc = port_heap_count();
+    uint64_t b_alloc = port_heap_bytes();
+    int64_t t0 = bench_ns();
+    int32_t status = m2x_client_post(&bench.m2x_once, M2X_PATH_UPDATES,
+                                     bench.body, len, 1);
+    m2x_client_close(&bench.m2x_once);
+    bench.m2x_once.addr_expire = 0; // resolve again
+    bench_record(BENCH_UPLOAD_ONCE, t0, bench_ns(), bench.batch.num,
+                 n_alloc, b_alloc);
+    bench.stat[BENCH_UPLOAD_ONCE].n_error += (status != STATUS_OK);
+}
+
+/** <!-- bench_flush {{{1 -->
+ * @brief serialize batch, and post it
+ * @param nothing
+ * @return nothing
+ */
+static void bench_flush(void)
+{
+    uint32_t n_alloc = port_heap_count();
+    uint64_t b_alloc = port_heap_bytes();
+    uint32_t num = bench.batch.num;
+    uint32_t n;
+    int64_t t0 = bench_ns();
+    int32_t len = m2x_batch_json(bench.body, sizeof(bench.body), &bench.batch);
+    int64_t t1 = bench_ns();
+    bench_record(BENCH_SERIALIZE, t0, t1, num, n_alloc, b_alloc);
+    bench.stat[BENCH_SERIALIZE].out_bytes += (len > 0) ? len : 0;
+    if (len < 0) {
+        bench.stat[BENCH_SERIALIZE].n_error++;
+    } else if (bench.host[0] != '\0') {
+        n_alloc = port_heap_count();
+        b_alloc = port_heap_bytes();
+        t0 = t1;
+        int32_t status = m2x_client_post(&bench.m2x, M2X_PATH_UPDATES,
+                                         bench.body, len, 1);
+        t1 = bench_ns();
+        bench_record(BENCH_UPLOAD, t0, t1, num, n_alloc, b_alloc);
+        bench.stat[BENCH_UPLOAD].n_error += (status != STATUS_OK);
+    }
+    // heap use is counted by the stages
+    n_alloc = port_heap_count();
+    b_alloc = port_heap_bytes();
+    for (n = 0; n < num; n++) {
+        bench_record(BENCH_E2E, bench.arrive[n], t1, 1, n_alloc, b_alloc);
+    }
+    // the other encodings and consumers of the same batch, not part of e2e
+    t0 = bench_ns();
+    bench_cbor();
+    bench_timestamp();
+    bench_values_sprintf();
+    bench_values_fixed();
+    bench_journal();
+    bench_rule();
+    bench_sinks(BENCH_SINK_X1, 1);
+    bench_sinks(BENCH_SINK_X2, 2);
+    bench_sinks(BENCH_SINK_X4, 4);
+    if ((len >= 0) && (bench.host[0] != '\0')) {
+        bench_upload_once(len);
+    }
+    bench.side += bench_ns() - t0;
+    m2x_batch_clear(&bench.batch);
+}
+
+/** <!-- bench_pass {{{1 -->
+ * @brief run stream through pipeline once
+ * @param nothing
+ * @return nothing
+ */
+static void bench_pass(void)
+{
+    uint32_t n = 0;
+    twelite_framer_init(&bench.framer);
+    m2x_batch_init(&bench.batch, bench.batch_num, INT32_MAX, UINT32_MAX,
+                   &bench.clock);
+    while (n < bench.line_num) {
+        uint32_t burst = bench.burst_min +
+                         bench_rand() % (bench.burst_max - bench.burst_min + 1);
+        uint32_t end = (n + burst < bench.line_num) ? n + burst : bench.line_num;
+        uint32_t size = bench.line[end] - bench.line[n];
+        uint32_t n_alloc = port_heap_count();
+        uint64_t b_alloc = port_heap_bytes();
+        uint32_t frames = bench.framer.n_frame;
+        char *frame[BENCH_BURST_MAX];
+        int32_t flen[BENCH_BURST_MAX];
+        uint32_t num = 0;
+        uint32_t i;
+        // UART read of one burst
+        int64_t arrive = bench_ns();
+        twelite_framer_push(&bench.framer, &bench.stream[bench.line[n]], size);
+        while ((num < BENCH_BURST_MAX) &&
+               ((flen[num] = twelite_framer_next(&bench.framer, &frame[num])) > 0)) {
+            num++;
+        }
+        bench_record(BENCH_FRAME, arrive, bench_ns(), bench.framer.n_frame - frames,
+                     n_alloc, b_alloc);
+        for (i = 0; i < num; i++) {
+            twelite_packet_t pkt;
+            n_alloc = port_heap_count();
+            b_alloc = port_heap_bytes();
+            int64_t t0 = bench_ns();
+            int8_t ret = twelite_parse_packet(&pkt, frame[i], flen[i]);
+            bench_record(BENCH_PARSE, t0, bench_ns(), 1, n_alloc, b_alloc);
+            if (ret != TWELITE_OK) {
+                bench.stat[BENCH_PARSE].n_error++;
+                continue;
+            }
+            pkt.timestamp = port_msec();
+            bench.arrive[bench.batch.num] = arrive;
+            m2x_batch_add(&bench.batch, &pkt);
+            if (bench.batch.num >= bench.batch_num) {
+                bench_flush();
+            }
+        }
+        n = end;
+    }
+    if (bench.batch.num > 0) {
+        bench_flush();
+    }
+    bench.stat[BENCH_FRAME].n_error += bench.framer.n_resync +
+                                       bench.framer.n_oversize;
+}
+
+/** <!-- bench_cmp {{{1 -->
+ * @brief compare latencies for qsort()
+ * @param[in] a latency
+ * @param[in] b latency
+ * @return order
+ */
+static int bench_cmp(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a;
+    int64_t y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/** <!-- bench_pct {{{1 -->
+ * @brief percentile of sorted latencies
+ * @param[in] s measurement
+ * @param[in] permille percentile [1/1000]
+ * @return latency [ns]
+ */
+static int64_t bench_pct(const bench_stat_t *s, uint32_t permille)
+{
+    uint64_t i = ((uint64_t)s->num * permille + 999) / 1000;
+    return (s->num == 0) ? 0 : s->ns[(i > 0) ? i - 1 : 0];
+}
+
+/** <!-- bench_report {{{1 -->
+ * @brief print one JSON line per stage
+ * @param[in] elapsed wall time of measured passes, but side stages [ns]
+ * @return nothing
+ */
+static void bench_report(int64_t elapsed)
+{
+    uint32_t n;
+    for (n = 0; n < BENCH_STAGE_NUM; n++) {
+        bench_stat_t *s = &bench.stat[n];
+        if (s->num == 0) {
+            continue;
+        }
+        qsort(s->ns, s->num, sizeof(s->ns[0]), bench_cmp);
+        // throughput of stage alone, and of whole pipeline for e2e
+        int64_t busy = (n == BENCH_E2E) ? elapsed : s->busy;
+        printf("{\"label\":\"%s\",\"stage\":\"%s\",\"source\":\"%s\","
+               "\"devices\":%u,\"lines\":%u,\"burst\":[%u,%u],\"corrupt\":%u,"
+               "\"batch\":%u,\"repeat\":%u,\"ops\":%u,\"items\":%llu,"
+               "\"items_per_s\":%.1f,\"p50_ns\":%lld,\"p99_ns\":%lld,"
+               "\"p999_ns\":%lld,\"max_ns\":%lld,\"allocs_per_op\":%.3f,"
+               "\"bytes_per_op\":%.1f,\"ns_per_item\":%.1f,"
+               "\"out_bytes_per_item\":%.1f,\"errors\":%u}\n",
+               bench.label, bench_stage_name[n],
+               (bench.path != NULL) ? "file" : "synthetic",
+               bench.device_num, bench.line_num, bench.burst_min,
+               bench.burst_max, bench.corrupt, bench.batch_num, bench.repeat,
+               s->num, (unsigned long long)s->items,
+               (busy > 0) ? s->items * 1e9 / busy : 0.0,
+               (long long)bench_pct(s, 500), (long long)bench_pct(s, 990),
+               (long long)bench_pct(s, 999), (long long)s->ns[s->num - 1],
+               (double)s->n_alloc / s->num, (double)s->b_alloc / s->num,
+               (s->items > 0) ? (double)busy / s->items : 0.0,
+               (s->items > 0) ? (double)s->out_bytes / s->items : 0.0,
+               s->n_error);
+    }
+}
+
+/** <!-- bench_usage {{{1 -->
+ * @brief print usage
+ * @param nothing
+ * @return nothing
+ */
+static void bench_usage(void)
+{
+    fprintf(stderr,
+        "usage: bench [options]\n"
+        "  -f path  captured app_tag stream (synthetic)\n"
+        "  -n num   synthetic end devices, 1-%u (%u)\n"
+        "  -p num   synthetic packets, or max. lines of -f (%u)\n"
+        "  -b min:max  lines per UART read, max. %u (%u:%u)\n"
+        "  -c num   corrupted lines [1/1000] (%u)\n"
+        "  -s num   packets per batch (%u)\n"
+        "  -r num   measured passes, after one warm-up pass (%u)\n"
+        "  -m host:port  post batches to M2X server, e.g. tools/mock_m2x.py\n"
+        "  -l label label of results, e.g. commit\n"
+        "one JSON line is printed per stage\n",
+        BENCH_DEVICE_MAX, bench.device_num, bench.packet_num, BENCH_BURST_MAX,
+        bench.burst_min, bench.burst_max, bench.corrupt, bench.batch_num,
+        bench.repeat);
+}
+
+/** <!-- main {{{1 -->
+ * @brief main function
+ * @param[in] argc number of arguments
+ * @param[in] argv arguments
+ * @return exit status
+ */
+int main(int argc, char **argv)
+{
+    char *colon;
+    uint32_t n;
+    int opt;
+    bench.label         = "";
+    bench.device_num    = 100;
+    bench.packet_num    = 100000;
+    bench.burst_min     = 1;
+    bench.burst_max     = 1;
+    bench.batch_num     = 16;
+    bench.repeat        = 5;
+    bench.seed          = 2463534242u;
+    while ((opt = getopt(argc, argv, "f:n:p:b:c:s:r:m:l:h")) != -1) {
+        switch (opt) {
+        case 'f': bench.path        = optarg; break;
+        case 'n': bench.device_num  = strtoul(optarg, NULL, 0); break;
+        case 'p': bench.packet_num  = strtoul(optarg, NULL, 0); break;
+        case 'c': bench.corrupt     = strtoul(optarg, NULL, 0); break;
+        case 's': bench.batch_num   = strtoul(optarg, NULL, 0); break;
+        case 'r': bench.repeat      = strtoul(optarg, NULL, 0); break;
+        case 'l': bench.label       = optarg; break;
+        case 'b':
+            bench.burst_min = strtoul(optarg, &colon, 0);
+            bench.burst_max = (*colon == ':') ? strtoul(colon + 1, NULL, 0)
+                                              : bench.burst_min;
+            break;
+        case 'm':
+            colon = strrchr(optarg, ':');
+            if ((colon == NULL) || (colon - optarg >= (int)sizeof(bench.host))) {
+                bench_usage();
+                return 2;
+            }
+            memcpy(bench.host, optarg, colon - optarg);
+            bench.host[colon - optarg] = '\0';
+            bench.port = (uint16_t)strtoul(colon + 1, NULL, 0);
+            break;
+        default:
+            bench_usage();
+            return 2;
+        }
+    }
+    if ((bench.device_num < 1) || (bench.device_num > BENCH_DEVICE_MAX) ||
+        (bench.packet_num < 1) || (bench.burst_min < 1) ||
+        (bench.burst_max < bench.burst_min) ||
+        (bench.burst_max > BENCH_BURST_MAX) || (bench.corrupt > 1000) ||
+        (bench.batch_num < 1) || (bench.batch_num > M2X_BATCH_MAX) ||
+        (bench.repeat < 1)) {
+        bench_usage();
+        return 2;
+    }
+    // every buffer is allocated before heap is armed
+    bench.stream = malloc((size_t)bench.packet_num * BENCH_LINE_MAX);
+    bench.line   = calloc(bench.packet_num + 1, sizeof(bench.line[0]));
+    bench.arrive = calloc(M2X_BATCH_MAX, sizeof(bench.arrive[0]));
+    for (n = 0; n < BENCH_STAGE_NUM; n++) {
+        bench_stat_t *s = &bench.stat[n];
+        s->max_num = bench.packet_num * bench.repeat;
+        s->ns      = malloc(s->max_num * sizeof(s->ns[0]));
+        if (s->ns == NULL) {
+            return 1;
+        }
+    }
+    if ((bench.stream == NULL) || (bench.line == NULL) || (bench.arrive == NULL)) {
+        return 1;
+    }
+    if (bench.path != NULL) {
+        if (bench_load()) {
+            return 1;
+        }
+    } else {
+        bench_synth();
+    }
+    bench_corrupt();
+    timemap_init(&bench.clock);
+    timemap_sync(&bench.clock, port_msec(), (int64_t)time(NULL) * 1000);
+    if (bench_sink_start()) {
+        return 1;
+    }
+    memset(bench.journal_image, 0xff, sizeof(bench.journal_image));
+    journal_mem_ops(&bench.journal_ops, bench.journal_image, 4096,
+                    BENCH_JOURNAL_SECTORS);
+    if (journal_mount(&bench.journal, &bench.journal_ops, &bench.clock) ||
+        rule_init(&bench.rule, BENCH_RULES)) {
+        return 1;
+    }
+    if ((bench.host[0] != '\0') &&
+        (m2x_client_init(&bench.m2x, bench.host, bench.port, "bench", "bench") ||
+         m2x_client_init(&bench.m2x_once, bench.host, bench.port, "bench", "bench"))) {
+        return 1;
+    }
+    bench_pass(); // warm-up, also connects to M2X server
+    for (n = 0; n < BENCH_STAGE_NUM; n++) {
+        bench_stat_t *s = &bench.stat[n];
+        int64_t *ns = s->ns;
+        uint32_t max_num = s->max_num;
+        memset(s, 0, sizeof(*s));
+        s->ns       = ns;
+        s->max_num  = max_num;
+    }
+    bench.side = 0;
+    port_heap_arm();
+    int64_t start = bench_ns();
+    for (n = 0; n < bench.repeat; n++) {
+        bench_pass();
+    }
+    bench_report(bench_ns() - start - bench.side);
+    m2x_client_close(&bench.m2x);
+    return 0;
+}
+
+// end of file {{{1
+// vim:ft=c:et:nowrap:fdm=marker
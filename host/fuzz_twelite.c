@@ -0,0 +1,119 @@
+/**
+ * Copyright (C) 2017 m2enu
+ *
+ * @file host/fuzz_twelite.c
+ * @brief fuzz entry point of TWE-LITE framer and parsers
+ *
+ * Input bytes are fed to the framer in both formats, and every frame is
+ * passed to its parser, as uart_task does. Built with FUZZ_LIBFUZZER, it
+ * is a libFuzzer target. Otherwise it runs each file given as argument
+ * (or stdin) once, which serves AFL (afl-gcc, @@) and corpus replay.
+ * @author m2enu
+ * @date 2026/10/17
+ */
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "twelite.h"
+#include "framer.h"
+
+static twelite_framer_t fr; //!< framer under test
+
+/** <!-- fuzz_frames {{{1 -->
+ * @brief push data to framer in chunks, and parse every frame
+ * @param[in] data input data
+ * @param[in] size size of data
+ * @param[in] format frame format
+ * @return nothing
+ */
+static void fuzz_frames(const uint8_t *data, size_t size,
+                        twelite_format_t format)
+{
+    twelite_packet_t pkt;
+    size_t pos = 0;
+    char *frame;
+    int32_t len;
+    twelite_framer_init(&fr);
+    twelite_framer_format(&fr, format);
+    while (pos < size) {
+        // chunk length is taken from data, to split frames anywhere
+        size_t chunk = 1 + (data[pos] & 0x3f);
+        chunk = (chunk > size - pos) ? size - pos : chunk;
+        pos += twelite_framer_push(&fr, (const char *)&data[pos], chunk);
+        while ((len = twelite_framer_next(&fr, &frame)) > 0) {
+            if (format == TWELITE_FORMAT_BINARY) {
+                twelite_parse_binary(&pkt, frame, len);
+            } else {
+                twelite_parse_packet(&pkt, frame, len);
+            }
+        }
+    }
+}
+
+/** <!-- LLVMFuzzerTestOneInput {{{1 -->
+ * @brief run one input
+ * @param[in] data input data
+ * @param[in] size size of data
+ * @return always zero
+ */
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    twelite_packet_t pkt;
+    char str[TWELITE_PACKET_LENGTH_MAX + 5];
+    // whole input as one frame
+    if (twelite_parse_packet(&pkt, (const char *)data, size) == TWELITE_OK) {
+        // accepted packet must be rebuilt and parsed again
+        int32_t len = twelite_build_packet(str, sizeof(str), &pkt);
+        if ((len < 2) || (twelite_parse_packet(&pkt, str, len - 2) != TWELITE_OK)) {
+            __builtin_trap();
+        }
+    }
+    twelite_parse_binary(&pkt, (const char *)data, size);
+    fuzz_frames(data, size, TWELITE_FORMAT_ASCII);
+    fuzz_frames(data, size, TWELITE_FORMAT_BINARY);
+    return 0;
+}
+
+#ifndef FUZZ_LIBFUZZER
+/** <!-- fuzz_file {{{1 -->
+ * @brief run contents of file
+ * @param[in] fp file
+ * @return nothing
+ */
+static void fuzz_file(FILE *fp)
+{
+    static uint8_t buf[1 << 16];
+    size_t size = fread(buf, 1, sizeof(buf), fp);
+    LLVMFuzzerTestOneInput(buf, size);
+}
+
+/** <!-- main {{{1 -->
+ * @brief run each file of arguments, or stdin
+ * @param[in] argc number of arguments
+ * @param[in] argv files of input
+ * @return exit status
+ */
+int main(int argc, char *argv[])
+{
+    int i;
+    if (argc < 2) {
+        fuzz_file(stdin);
+        return 0;
+    }
+    for (i = 1; i < argc; i++) {
+        FILE *fp = fopen(argv[i], "rb");
+        if (fp == NULL) {
+            perror(argv[i]);
+            return 1;
+        }
+        fuzz_file(fp);
+        fclose(fp);
+    }
+    return 0;
+}
+#endif // FUZZ_LIBFUZZER
+
+// end of file {{{1
+// vim:ft=c:et:nowrap:fdm=marker
@@ -0,0 +1,60 @@
+/**
+ * Copyright (C) 2017 m2enu
+ *
+ * @file host/test.h
+ * @brief minimal check macros of host unit tests
+ *
+ * Every test program counts its checks, prints failed ones with their
+ * location, and exits non-zero if any of them failed.
+ * @author m2enu
+ * @date 2026/10/17
+ */
+#ifndef TEST_H
+#define TEST_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+static uint32_t test_num; //!< number of checks
+static uint32_t test_fail; //!< number of failed checks
+
+/** <!-- TEST_CHECK {{{1 -->
+ * @brief check condition, print it when it does not hold
+ * @param cond condition
+ */
+#define TEST_CHECK(cond) do { \
+    test_num++; \
+    if (!(cond)) { \
+        test_fail++; \
+        fprintf(stderr, "%s:%d: failed: %s\n", __FILE__, __LINE__, #cond); \
+    } \
+} while (0)
+
+/** <!-- TEST_EQ {{{1 -->
+ * @brief check integers are equal, print both when they are not
+ * @param a actual value
+ * @param b expected value
+ */
+#define TEST_EQ(a, b) do { \
+    long long test_a = (long long)(a); \
+    long long test_b = (long long)(b); \
+    test_num++; \
+    if (test_a != test_b) { \
+        test_fail++; \
+        fprintf(stderr, "%s:%d: failed: %s == %s (%lld != %lld)\n", \
+                __FILE__, __LINE__, #a, #b, test_a, test_b); \
+    } \
+} while (0)
+
+/** <!-- TEST_END {{{1 -->
+ * @brief print summary of checks
+ * @return exit status of test program
+ */
+#define TEST_END() ( \
+    printf("%s: %u checks, %u failed\n", __FILE__, test_num, test_fail), \
+    (test_fail == 0) ? 0 : 1)
+
+#endif // TEST_H
+
+// end of file {{{1
+// vim:ft=c:et:nowrap:fdm=marker
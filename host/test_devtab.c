@@ -0,0 +1,179 @@
+/**
+ * Copyright (C) 2017 m2enu
+ *
+ * @file host/test_devtab.c
+ * @brief unit tests of end device state table
+ * @author m2enu
+ * @date 2026/10/17
+ */
+#include <stdint.h>
+#include <string.h>
+
+#include "devtab.h"
+#include "test.h"
+
+#define TEST_DEVTAB_SIZE    16 //!< number of table entries (14 devices)
+#define TEST_INTERVAL       10000 //!< packet interval of devices [ms]
+#define TEST_ALERT_NUM      32 //!< size of silent device list
+
+static devtab_t tab; //!< table under test
+static devtab_alert_t alert[TEST_ALERT_NUM]; //!< devices gone silent
+
+/** <!-- pkt_make {{{1 -->
+ * @brief make packet
+ * @param[in] sid SID of end device
+ * @return packet
+ */
+static twelite_packet_t pkt_make(uint32_t sid)
+{
+    twelite_packet_t pkt;
+    memset(&pkt, 0, sizeof(pkt));
+    pkt.sid_enddevice = sid;
+    pkt.mvolt_vdd     = 3000;
+    pkt.lqi           = 100;
+    return pkt;
+}
+
+/** <!-- test_init {{{1 -->
+ * @brief size must be power of 2 in range, nothing is tracked otherwise
+ * @return nothing
+ */
+static void test_init(void)
+{
+    twelite_packet_t pkt = pkt_make(0x81000001);
+    TEST_EQ(devtab_init(&tab, 0, 0, 2400), -1);
+    TEST_EQ(devtab_init(&tab, 24, 0, 2400), -1);
+    TEST_EQ(devtab_init(&tab, DEVTAB_SIZE_MAX * 2, 0, 2400), -1);
+    TEST_EQ(devtab_update(&tab, &pkt, 0), DEVTAB_EV_FULL);
+    TEST_CHECK(devtab_find(&tab, pkt.sid_enddevice) == NULL);
+    TEST_EQ(devtab_expire(&tab, 10000, alert, TEST_ALERT_NUM), 0);
+    TEST_EQ(devtab_init(&tab, TEST_DEVTAB_SIZE, 0, 2400), 0);
+    TEST_EQ(tab.size, TEST_DEVTAB_SIZE);
+    TEST_EQ(tab.load_max, TEST_DEVTAB_SIZE / 8 * 7);
+}
+
+/** <!-- test_full {{{1 -->
+ * @brief devices beyond 7/8 of table are not tracked
+ * @return nothing
+ */
+static void test_full(void)
+{
+    twelite_packet_t pkt;
+    uint32_t n;
+    devtab_free(&tab);
+    devtab_init(&tab, TEST_DEVTAB_SIZE, 0, 2400);
+    for (n = 0; n < tab.load_max; n++) {
+        pkt = pkt_make(0x81000000 + n);
+        TEST_EQ(devtab_update(&tab, &pkt, 0), DEVTAB_EV_NEW);
+    }
+    pkt = pkt_make(0x82000000);
+    TEST_EQ(devtab_update(&tab, &pkt, 0), DEVTAB_EV_FULL);
+    TEST_EQ(tab.n_full, 1);
+    // tracked devices still update, SID 0 is a device too
+    pkt = pkt_make(0x81000000);
+    TEST_EQ(devtab_update(&tab, &pkt, 1000), DEVTAB_EV_NONE);
+    TEST_EQ(devtab_find(&tab, 0x81000000)->n_packet, 2);
+    devtab_free(&tab);
+    devtab_init(&tab, TEST_DEVTAB_SIZE, 0, 2400);
+    pkt = pkt_make(0);
+    TEST_EQ(devtab_update(&tab, &pkt, 0), DEVTAB_EV_NEW);
+    TEST_CHECK(devtab_find(&tab, 0) != NULL);
+}
+
+/** <!-- test_silent {{{1 -->
+ * @brief silent device is reported once, and alive again by its packet
+ * @return nothing
+ */
+static void test_silent(void)
+{
+    twelite_packet_t pkt = pkt_make(0x81000001);
+    int64_t now;
+    uint32_t silent = 0;
+    devtab_free(&tab);
+    devtab_init(&tab, TEST_DEVTAB_SIZE, 0, 2400);
+    for (now = 0; now <= 10 * TEST_INTERVAL; now += TEST_INTERVAL) {
+        devtab_update(&tab, &pkt, now);
+        TEST_EQ(devtab_expire(&tab, now, alert, TEST_ALERT_NUM), 0);
+    }
+    TEST_EQ(devtab_find(&tab, pkt.sid_enddevice)->interval, TEST_INTERVAL);
+    // silent after DEVTAB_SILENT_MISS intervals, checked when its slot expires
+    for (; now < 2 * DEVTAB_WHEEL * DEVTAB_TICK; now += DEVTAB_TICK) {
+        uint32_t num = devtab_expire(&tab, now, alert, TEST_ALERT_NUM);
+        if (num > 0) {
+            TEST_EQ(num, 1);
+            TEST_EQ(alert[0].sid, pkt.sid_enddevice);
+            TEST_CHECK(alert[0].age >= DEVTAB_SILENT_MISS * TEST_INTERVAL);
+        }
+        silent += num;
+    }
+    TEST_EQ(silent, 1);
+    TEST_EQ(tab.n_silent, 1);
+    TEST_EQ(devtab_update(&tab, &pkt, now), DEVTAB_EV_ALIVE);
+    TEST_EQ(tab.n_silent, 0);
+}
+
+/** <!-- test_evict {{{1 -->
+ * @brief devices silent for DEVTAB_EVICT are evicted, entries reused
+ * @return nothing
+ */
+static void test_evict(void)
+{
+    twelite_packet_t pkt;
+    int64_t now;
+    uint32_t n;
+    devtab_free(&tab);
+    devtab_init(&tab, TEST_DEVTAB_SIZE, 0, 2400);
+    for (n = 0; n < tab.load_max; n++) {
+        pkt = pkt_make(0x81000000 + n);
+        devtab_update(&tab, &pkt, 0);
+    }
+    // one device keeps sending, the others go silent
+    pkt = pkt_make(0x81000000);
+    for (now = 0; now <= DEVTAB_EVICT + DEVTAB_SILENT_MAX; now += 60000) {
+        devtab_update(&tab, &pkt, now);
+        devtab_expire(&tab, now, alert, TEST_ALERT_NUM);
+    }
+    TEST_EQ(tab.num, 1);
+    TEST_EQ(tab.n_evict, tab.load_max - 1);
+    TEST_EQ(tab.n_silent, 0);
+    TEST_CHECK(devtab_find(&tab, 0x81000000) != NULL);
+    TEST_CHECK(devtab_find(&tab, 0x81000001) == NULL);
+    // evicted entries are taken by new devices, table stays usable
+    for (n = 0; n < tab.load_max - 1; n++) {
+        pkt = pkt_make(0x83000000 + n);
+        TEST_EQ(devtab_update(&tab, &pkt, now), DEVTAB_EV_NEW);
+    }
+    TEST_EQ(tab.num, tab.load_max);
+    for (n = 0; n < tab.load_max - 1; n++) {
+        TEST_CHECK(devtab_find(&tab, 0x83000000 + n) != NULL);
+    }
+    TEST_CHECK(devtab_find(&tab, 0x81000000) != NULL);
+    // evicted device returns as new
+    devtab_free(&tab);
+    devtab_init(&tab, TEST_DEVTAB_SIZE, 0, 2400);
+    pkt = pkt_make(0x81000001);
+    devtab_update(&tab, &pkt, 0);
+    for (now = 0; now <= DEVTAB_EVICT + DEVTAB_SILENT_MAX; now += 60000) {
+        devtab_expire(&tab, now, alert, TEST_ALERT_NUM);
+    }
+    TEST_EQ(tab.num, 0);
+    TEST_EQ(tab.n_dead, 0);
+    TEST_EQ(devtab_update(&tab, &pkt, now), DEVTAB_EV_NEW);
+    devtab_free(&tab);
+}
+
+/** <!-- main {{{1 -->
+ * @brief run tests
+ * @return exit status
+ */
+int main(void)
+{
+    test_init();
+    test_full();
+    test_silent();
+    test_evict();
+    return TEST_END();
+}
+
+// end of file {{{1
+// vim:ft=c:et:nowrap:fdm=marker
@@ -0,0 +1,231 @@
+/**
+ * Copyright (C) 2017 m2enu
+ *
+ * @file host/test_framer.c
+ * @brief unit tests of TWE-LITE app_tag stream framer
+ * @author m2enu
+ * @date 2026/10/17
+ */
+#include <stdint.h>
+#include <string.h>
+
+#include "twelite.h"
+#include "framer.h"
+#include "test.h"
+
+static twelite_framer_t fr; //!< framer under test
+
+static char frame_bme280[TWELITE_PACKET_LENGTH_MAX + 5]; //!< BME280 frame
+static int32_t frame_len; //!< length of frame_bme280 (without CR/LF)
+
+/** <!-- frame_next {{{1 -->
+ * @brief extract next frame and compare it with expected one
+ * @param[in] expect expected frame (NULL: no more frame)
+ * @param[in] len length of expected frame
+ * @return result of compare
+ * @retval Zero: frame is as expected
+ * @retval -ve_value: frame is not as expected
+ */
+static int8_t frame_next(const char *expect, int32_t len)
+{
+    char *frame;
+    int32_t n = twelite_framer_next(&fr, &frame);
+    if (expect == NULL) {
+        return (n == 0) ? 0 : -1;
+    }
+    return ((n == len) && (memcmp(frame, expect, len) == 0)) ? 0 : -1;
+}
+
+/** <!-- frame_build {{{1 -->
+ * @brief build BME280 frame used by tests
+ * @return nothing
+ */
+static void frame_build(void)
+{
+    twelite_packet_t pkt;
+    memset(&pkt, 0, sizeof(pkt));
+    pkt.sid_router      = 0x81234567;
+    pkt.lqi             = 0xa5;
+    pkt.sid_enddevice   = 0x8abcdef0;
+    pkt.id_sensor       = TWELITE_ID_BME280;
+    pkt.mvolt_vdd       = 3000;
+    pkt.pkt_bme280.i_temperature = 2512;
+    pkt.pkt_bme280.i_humidity    = 4800;
+    pkt.pkt_bme280.i_pressure    = 101325;
+    frame_len = twelite_build_packet(frame_bme280, sizeof(frame_bme280), &pkt) - 2;
+    TEST_EQ(frame_len, 59);
+}
+
+/** <!-- test_ascii {{{1 -->
+ * @brief ascii frames in one push, split pushes and garbage
+ * @return nothing
+ */
+static void test_ascii(void)
+{
+    static const char data[] = "junk:0102\r\n:0304\n\r\n:05";
+    int32_t i;
+    twelite_framer_init(&fr);
+    TEST_EQ(twelite_framer_push(&fr, data, sizeof(data) - 1), sizeof(data) - 1);
+    TEST_EQ(frame_next(":0102", 5), 0);
+    TEST_EQ(frame_next(":0304", 5), 0);
+    TEST_EQ(frame_next(NULL, 0), 0);
+    // partial frame is kept over pushes
+    TEST_EQ(fr.tail, 3);
+    twelite_framer_push(&fr, "06\r", 3);
+    TEST_EQ(frame_next(":0506", 5), 0);
+    TEST_EQ(frame_next(NULL, 0), 0);
+    TEST_EQ(fr.n_frame, 3);
+    // one byte per push
+    for (i = 0; i < frame_len; i++) {
+        twelite_framer_push(&fr, &frame_bme280[i], 1);
+        TEST_EQ(frame_next(NULL, 0), 0);
+    }
+    twelite_framer_push(&fr, "\r\n", 2);
+    TEST_EQ(frame_next(frame_bme280, frame_len), 0);
+    TEST_EQ(frame_next(NULL, 0), 0);
+    TEST_EQ(fr.tail, 0);
+    TEST_EQ(fr.n_resync, 0);
+    TEST_EQ(fr.n_oversize, 0);
+}
+
+/** <!-- test_broken {{{1 -->
+ * @brief frames broken by start character or exceeding max. length
+ * @return nothing
+ */
+static void test_broken(void)
+{
+    char data[TWELITE_FRAME_LENGTH_MAX + 16];
+    twelite_framer_init(&fr);
+    twelite_framer_push(&fr, ":0102:0304\r\n", 12);
+    TEST_EQ(frame_next(":0304", 5), 0);
+    TEST_EQ(fr.n_resync, 1);
+    memset(data, '0', sizeof(data));
+    data[0] = ':';
+    twelite_framer_push(&fr, data, sizeof(data));
+    twelite_framer_push(&fr, "\r\n:0506\r\n", 9);
+    TEST_EQ(frame_next(":0506", 5), 0);
+    TEST_EQ(frame_next(NULL, 0), 0);
+    TEST_EQ(fr.n_oversize, 1);
+    TEST_EQ(fr.n_frame, 2);
+    // data without frame is not accumulated
+    memset(data, '0', sizeof(data));
+    twelite_framer_push(&fr, data, sizeof(data));
+    TEST_EQ(frame_next(NULL, 0), 0);
+    TEST_EQ(fr.tail, 0);
+}
+
+/** <!-- test_full {{{1 -->
+ * @brief push stops at the end of buffer
+ * @return nothing
+ */
+static void test_full(void)
+{
+    static char data[TWELITE_FRAMER_BUF_SIZE + 1];
+    int32_t room;
+    twelite_framer_init(&fr);
+    TEST_EQ(twelite_framer_push(&fr, data, sizeof(data)), TWELITE_FRAMER_BUF_SIZE);
+    twelite_framer_wptr(&fr, &room);
+    TEST_EQ(room, 0);
+    TEST_EQ(twelite_framer_commit(&fr, 1), -1);
+    twelite_framer_reset(&fr);
+    twelite_framer_wptr(&fr, &room);
+    TEST_EQ(room, TWELITE_FRAMER_BUF_SIZE);
+}
+
+/** <!-- test_binary {{{1 -->
+ * @brief binary frames, split pushes, false headers, bad trailer and checksum
+ * @return nothing
+ */
+static void test_binary(void)
+{
+    char bin[TWELITE_FRAME_LENGTH_MAX];
+    char data[2 * TWELITE_FRAME_LENGTH_MAX + 8];
+    twelite_packet_t pkt;
+    twelite_packet_t out;
+    int32_t pos = 0;
+    int32_t len;
+    int32_t i;
+    TEST_EQ(twelite_parse_packet(&pkt, frame_bme280, frame_len),
+            TWELITE_OK);
+    len = twelite_build_binary(bin, sizeof(bin), &pkt);
+    TEST_CHECK(len > TWELITE_BINARY_OVERHEAD);
+    // garbage with false header, two frames back to back
+    data[pos++] = (char)TWELITE_BINARY_HEAD0;
+    data[pos++] = 0x00;
+    data[pos++] = (char)TWELITE_BINARY_HEAD0;
+    memcpy(&data[pos], bin, len);
+    pos += len;
+    memcpy(&data[pos], bin, len);
+    pos += len;
+    twelite_framer_init(&fr);
+    twelite_framer_format(&fr, TWELITE_FORMAT_BINARY);
+    // split at every byte of the first frame
+    for (i = 0; i < len + 2; i++) {
+        twelite_framer_push(&fr, &data[i], 1);
+        TEST_EQ(frame_next(NULL, 0), 0);
+    }
+    twelite_framer_push(&fr, &data[i], pos - i);
+    TEST_EQ(frame_next(bin, len), 0);
+    TEST_EQ(frame_next(bin, len), 0);
+    TEST_EQ(frame_next(NULL, 0), 0);
+    TEST_EQ(fr.n_frame, 2);
+    TEST_EQ(fr.n_resync, 0);
+    // frame itself parses back to the packet
+    memset(&out, 0, sizeof(out));
+    TEST_EQ(twelite_parse_binary(&out, bin, len), TWELITE_OK);
+    TEST_EQ(out.sid_enddevice, pkt.sid_enddevice);
+    TEST_EQ(out.pkt_bme280.i_pressure, pkt.pkt_bme280.i_pressure);
+    // broken trailer is skipped, the next frame is found
+    memcpy(data, bin, len);
+    data[len - 1] = 0;
+    memcpy(&data[len], bin, len);
+    twelite_framer_push(&fr, data, 2 * len);
+    TEST_EQ(frame_next(bin, len), 0);
+    TEST_EQ(frame_next(NULL, 0), 0);
+    TEST_EQ(fr.n_resync, 1);
+    // trailer in place but checksum wrong, e.g. payload byte lost and EOT
+    // value in payload; rescanned from next byte, the next frame is found
+    memcpy(data, bin, len);
+    data[len - 2] ^= 0x01;
+    memcpy(&data[len], bin, len);
+    twelite_framer_push(&fr, data, 2 * len);
+    TEST_EQ(frame_next(bin, len), 0);
+    TEST_EQ(frame_next(NULL, 0), 0);
+    TEST_EQ(fr.n_resync, 2);
+    memcpy(data, bin, len);
+    data[len / 2] ^= 0x10;
+    memcpy(&data[len], bin, len);
+    twelite_framer_push(&fr, data, 2 * len);
+    TEST_EQ(frame_next(bin, len), 0);
+    TEST_EQ(frame_next(NULL, 0), 0);
+    TEST_EQ(fr.n_resync, 3);
+    // stray header with out of range length is a false header
+    data[0] = (char)TWELITE_BINARY_HEAD0;
+    data[1] = (char)TWELITE_BINARY_HEAD1;
+    data[2] = (char)0xff;
+    data[3] = (char)0xff;
+    twelite_framer_push(&fr, data, 4);
+    twelite_framer_push(&fr, bin, len);
+    TEST_EQ(frame_next(bin, len), 0);
+    TEST_EQ(frame_next(NULL, 0), 0);
+    TEST_EQ(fr.n_resync, 4);
+    TEST_EQ(fr.n_oversize, 0);
+    TEST_EQ(fr.n_frame, 6);
+}
+
+/** <!-- main {{{1 -->
+ * @brief run tests
+ * @return exit status
+ */
+int main(void)
+{
+    frame_build();
+    test_ascii();
+    test_broken();
+    test_full();
+    test_binary();
+    return TEST_END();
+}
+
+// end of file {{{1
+// vim:ft=c:et:nowrap:fdm=marker
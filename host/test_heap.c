@@ -0,0 +1,342 @@
+/**
+ * Copyright (C) 2017 m2enu
+ *
+ * @file host/test_heap.c
+ * @brief no heap allocation after initialisation (PORT_HEAP_GUARD=2)
+ *
+ * Replays app_tag frames of twelite_build_packet() through every stage of
+ * the ESP32 build, as uart_task(), m2x_task() and the sink tasks wire them:
+ * ingest, dedup, devtab, rules, pktq, batch, the influx/mqtt(JSON, CBOR,
+ * CBOR delta) sinks, and the journal on journal_mem_ops(). port.c is built
+ * with PORT_HEAP_GUARD=2, so any allocation after port_heap_arm() aborts.
+ * @author m2enu
+ * @date 2026/10/17
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "port.h"
+#include "twelite.h"
+#include "ingest.h"
+#include "dedup.h"
+#include "devtab.h"
+#include "rule.h"
+#include "pktq.h"
+#include "batch.h"
+#include "journal.h"
+#include "influx.h"
+#include "mqtt.h"
+#include "sink.h"
+#include "timemap.h"
+#include "test.h"
+
+#define TEST_DEVICE_NUM     50 //!< number of end devices
+#define TEST_READING_NUM    4000 //!< number of readings
+#define TEST_LINE_MAX       (TWELITE_PACKET_LENGTH_MAX + 5) //!< max. length of line
+#define TEST_READ_MAX       200 //!< max. length of one UART read
+#define TEST_DEVTAB_SIZE    256 //!< number of device table entries
+#define TEST_PKTQ_SIZE      64 //!< number of packet queue slots
+#define TEST_SINK_NUM       4 //!< number of sinks
+#define TEST_SECTOR_SIZE    4096 //!< journal sector size
+#define TEST_SECTOR_NUM     4 //!< journal sectors
+#define TEST_RULES          "vdd<2.6,temperature>40,temperature~5" //!< alert rules
+#define TEST_SID_ROUTER     0x82000000u //!< SID of the first router
+
+static char stream[TEST_READING_NUM * 2 * TEST_LINE_MAX]; //!< app_tag stream
+static int32_t stream_len; //!< length of stream
+static int32_t stream_pos; //!< next position to read
+static uint32_t seed = 2463534242u; //!< seed of random numbers
+
+static timemap_t clock_map; //!< clock mapping of timestamps
+static ingest_t ingest; //!< ingestion
+static dedup_t dedup; //!< duplicate filter
+static devtab_t devtab; //!< device table
+static devtab_alert_t silent[8]; //!< devices gone silent
+static rule_table_t rules; //!< alert rules
+static pktq_slot_t pktq_slot[TEST_PKTQ_SIZE]; //!< slots of packet queue
+static pktq_t pktq; //!< packet queue to m2x_task
+static m2x_batch_t batch; //!< batch of M2X
+static m2x_batch_t replay; //!< batch replayed from journal
+static char body[16384]; //!< json of batch
+static uint8_t image[TEST_SECTOR_SIZE * TEST_SECTOR_NUM]; //!< journal storage
+static journal_ops_t journal_ops; //!< storage backend of journal
+static journal_t journal; //!< journal of failed uploads
+static influx_t influx; //!< influx sink
+static mqtt_t mqtt[3]; //!< mqtt sinks (JSON, CBOR, CBOR delta)
+static sink_ops_t sink_ops[TEST_SINK_NUM]; //!< sink formats, sent to nowhere
+static sink_t sink[TEST_SINK_NUM]; //!< sinks
+static pktq_slot_t sink_slot[TEST_SINK_NUM][TEST_PKTQ_SIZE]; //!< slots of sink queues
+static char sink_body[TEST_SINK_NUM][4096]; //!< sink serialize buffers
+static uint64_t sink_bytes; //!< bytes sent by sinks
+static uint32_t n_parse_err; //!< number of frames failed to parse
+static char stdout_buf[BUFSIZ]; //!< buffer of stdout, not allocated by stdio
+
+/** <!-- rand_next {{{1 -->
+ * @brief deterministic random number (xorshift32)
+ * @param nothing
+ * @return random number
+ */
+static uint32_t rand_next(void)
+{
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+/** <!-- stream_build {{{1 -->
+ * @brief build stream of readings, a quarter of them relayed twice
+ * @param nothing
+ * @return nothing
+ */
+static void stream_build(void)
+{
+    static const uint8_t ids[] = {
+        TWELITE_ID_BME280, TWELITE_ID_SHT21, TWELITE_ID_ADXL34X, TWELITE_ID_LM61,
+    };
+    static uint16_t next_number[TEST_DEVICE_NUM];
+    uint32_t n;
+    for (n = 0; n < TEST_READING_NUM; n++) {
+        uint32_t dev = rand_next() % TEST_DEVICE_NUM;
+        uint32_t relay = ((rand_next() % 4) == 0) ? 2 : 1;
+        twelite_packet_t pkt;
+        uint32_t r;
+        memset(&pkt, 0, sizeof(pkt));
+        pkt.next_number     = next_number[dev]++;
+        pkt.sid_enddevice   = 0x81000000u + dev;
+        pkt.id_sensor       = ids[dev % sizeof(ids)];
+        pkt.mvolt_vdd       = 2400 + rand_next() % 1200;
+        pkt.mvolt_adc1      = 300 + rand_next() % 1000;
+        pkt.pkt_raw.w16[0]  = rand_next();
+        pkt.pkt_raw.w16[1]  = rand_next();
+        pkt.pkt_raw.w16[2]  = rand_next();
+        pkt.pkt_raw.w32     = 90000 + rand_next() % 20000;
+        for (r = 0; r < relay; r++) {
+            pkt.sid_router  = TEST_SID_ROUTER + r;
+            pkt.lqi         = 60 + rand_next() % 120;
+            stream_len += twelite_build_packet(&stream[stream_len],
+                                               sizeof(stream) - stream_len,
+                                               &pkt);
+        }
+    }
+}
+
+/** <!-- test_read {{{1 -->
+ * @brief read stream like UART (ingest_ops_t)
+ * @param[in] ctx not used
+ * @param[out] dst read data
+ * @param[in] len max. length to read
+ * @return length of read data
+ */
+static int32_t test_read(void *ctx, char *dst, int32_t len)
+{
+    (void)ctx;
+    len = (len < stream_len - stream_pos) ? len : stream_len - stream_pos;
+    memcpy(dst, &stream[stream_pos], len);
+    stream_pos += len;
+    return len;
+}
+
+/** <!-- test_flush {{{1 -->
+ * @brief nothing to discard (ingest_ops_t)
+ * @param[in] ctx not used
+ * @return nothing
+ */
+static void test_flush(void *ctx)
+{
+    (void)ctx;
+}
+
+/** <!-- test_dispatch {{{1 -->
+ * @brief parse frame and hand over like uart_dispatch() (ingest_ops_t)
+ * @param[in] ctx not used
+ * @param[in] frame app_tag frame
+ * @param[in] len length of frame
+ * @return nothing
+ */
+static void test_dispatch(void *ctx, const char *frame, int32_t len)
+{
+    twelite_packet_t pkt;
+    uint32_t n;
+    (void)ctx;
+    if (twelite_parse_packet(&pkt, frame, len) != TWELITE_OK) {
+        n_parse_err++;
+        return;
+    }
+    pkt.timestamp = ingest.stamp;
+    int8_t dup = dedup_check(&dedup, &pkt, pkt.timestamp);
+    if (dup == DEDUP_DUP) {
+        return;
+    }
+    pkt.better = (dup == DEDUP_BETTER);
+    if (!pkt.better) {
+        devtab_update(&devtab, &pkt, pkt.timestamp);
+        rule_check(&rules, &pkt);
+        for (n = 0; n < TEST_SINK_NUM; n++) {
+            sink_push(&sink[n], &pkt);
+        }
+    }
+    pktq_push(&pktq, &pkt);
+}
+
+static const ingest_ops_t test_ops = {
+    .read = test_read,
+    .flush = test_flush,
+    .dispatch = test_dispatch,
+    .ctx = NULL,
+};
+
+/** <!-- test_send {{{1 -->
+ * @brief count serialized packets instead of sending (sink_ops_t)
+ * @param[in] ctx not used
+ * @param[in] data serialized packets
+ * @param[in] len length of data
+ * @return result of send
+ * @retval Zero: Success
+ */
+static int8_t test_send(void *ctx, const char *data, int32_t len)
+{
+    (void)ctx;
+    (void)data;
+    sink_bytes += len;
+    return 0;
+}
+
+/** <!-- test_close {{{1 -->
+ * @brief nothing to close (sink_ops_t)
+ * @param[in] ctx not used
+ * @return nothing
+ */
+static void test_close(void *ctx)
+{
+    (void)ctx;
+}
+
+/** <!-- m2x_flush {{{1 -->
+ * @brief serialize batch, store every other one into journal and replay it
+ * @param nothing
+ * @return nothing
+ */
+static void m2x_flush(void)
+{
+    static uint32_t n_flush;
+    uint32_t span;
+    uint32_t n;
+    TEST_CHECK(m2x_batch_json(body, sizeof(body), &batch) > 0);
+    if ((n_flush++ % 2) == 1) {
+        // upload failed, stored (m2x_store())
+        for (n = 0; n < batch.num; n++) {
+            journal_append(&journal, &batch.pkt[n]);
+        }
+        // and replayed later (m2x_replay())
+        int32_t num = journal_peek(&journal, replay.pkt, replay.max_num, &span);
+        TEST_CHECK(num > 0);
+        replay.num = (num > 0) ? num : 0;
+        TEST_CHECK(m2x_batch_json(body, sizeof(body), &replay) > 0);
+        journal_consume(&journal, span);
+        m2x_batch_clear(&replay);
+    }
+    m2x_batch_clear(&batch);
+}
+
+/** <!-- setup {{{1 -->
+ * @brief initialise every stage, everything allocated is allocated here
+ * @param nothing
+ * @return nothing
+ */
+static void setup(void)
+{
+    static const mqtt_encoding_t enc[] = { MQTT_JSON, MQTT_CBOR, MQTT_CBOR_DELTA };
+    uint32_t n;
+    setvbuf(stdout, stdout_buf, _IOLBF, sizeof(stdout_buf));
+    stream_build();
+    timemap_init(&clock_map);
+    timemap_sync(&clock_map, port_msec(), 1800000000000LL);
+    ingest_init(&ingest, &test_ops, 0);
+    dedup_init(&dedup, 5000, 1);
+    TEST_EQ(devtab_init(&devtab, TEST_DEVTAB_SIZE, port_msec(), 2600), 0);
+    TEST_EQ(rule_init(&rules, TEST_RULES), 0);
+    TEST_EQ(pktq_init(&pktq, pktq_slot, TEST_PKTQ_SIZE, PKTQ_DROP_NEWEST), 0);
+    m2x_batch_init(&batch, 16, INT32_MAX, UINT32_MAX, &clock_map);
+    m2x_batch_init(&replay, 16, INT32_MAX, UINT32_MAX, &clock_map);
+    memset(image, 0xff, sizeof(image));
+    journal_mem_ops(&journal_ops, image, TEST_SECTOR_SIZE, TEST_SECTOR_NUM);
+    TEST_EQ(journal_mount(&journal, &journal_ops, &clock_map), 0);
+    TEST_EQ(influx_init(&influx, "localhost", 8089, &clock_map), 0);
+    sink_ops[0] = influx.ops;
+    for (n = 0; n < 3; n++) {
+        TEST_EQ(mqtt_init(&mqtt[n], "localhost", 1883, "test", "twelite",
+                          enc[n], &clock_map), 0);
+        sink_ops[1 + n] = mqtt[n].ops;
+    }
+    for (n = 0; n < TEST_SINK_NUM; n++) {
+        sink_ops[n].send  = test_send;
+        sink_ops[n].close = test_close;
+        TEST_EQ(sink_init(&sink[n], "test", &sink_ops[n], sink_slot[n],
+                          TEST_PKTQ_SIZE, sink_body[n], sizeof(sink_body[n]),
+                          SINK_BATCH_MAX, 0), 0);
+    }
+}
+
+/** <!-- test_replay {{{1 -->
+ * @brief replay stream in UART reads of random length, nothing is allocated
+ * @return nothing
+ */
+static void test_replay(void)
+{
+    twelite_packet_t pkt;
+    uint32_t n;
+    port_heap_arm();
+    while (stream_pos < stream_len) {
+        int64_t now = port_msec();
+        ingest_event(&ingest, INGEST_DATA, 1 + rand_next() % TEST_READ_MAX);
+        // m2x_task
+        while (pktq_pop(&pktq, &pkt) == 0) {
+            if (m2x_batch_add(&batch, &pkt) < 0) {
+                m2x_flush();
+                m2x_batch_add(&batch, &pkt);
+            }
+        }
+        if (m2x_batch_due(&batch, now, 0) != M2X_BATCH_NONE) {
+            m2x_flush();
+        }
+        // sink tasks
+        for (n = 0; n < TEST_SINK_NUM; n++) {
+            while (sink_poll(&sink[n], now) == 0) {
+            }
+        }
+        devtab_expire(&devtab, now, silent, sizeof(silent) / sizeof(silent[0]));
+    }
+    m2x_flush();
+    TEST_EQ(port_heap_count(), 0);
+    TEST_EQ(port_heap_bytes(), 0);
+    // every stage has seen the stream
+    TEST_EQ(n_parse_err, 0);
+    TEST_CHECK(ingest.n_dispatch > TEST_READING_NUM);
+    TEST_EQ(dedup.n_new, TEST_READING_NUM);
+    TEST_CHECK(dedup.n_dup + dedup.n_better > 0);
+    TEST_EQ(devtab.num, TEST_DEVICE_NUM);
+    TEST_CHECK(rules.n_alert > 0);
+    TEST_CHECK(journal.n_append > 0);
+    TEST_CHECK(journal.n_consume > 0);
+    TEST_CHECK(sink_bytes > 0);
+    for (n = 0; n < TEST_SINK_NUM; n++) {
+        TEST_EQ(sink[n].n_packet + pktq_count(&sink[n].q), TEST_READING_NUM);
+        TEST_EQ(sink[n].n_overflow, 0);
+    }
+}
+
+/** <!-- main {{{1 -->
+ * @brief run tests
+ * @return exit status
+ */
+int main(void)
+{
+    setup();
+    test_replay();
+    return TEST_END();
+}
+
+// end of file {{{1
+// vim:ft=c:et:nowrap:fdm=marker
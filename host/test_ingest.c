@@ -0,0 +1,233 @@
+/**
+ * Copyright (C) 2017 m2enu
+ *
+ * @file host/test_ingest.c
+ * @brief unit tests of event-driven ingestion, driven by simulated UART events
+ * @author m2enu
+ * @date 2026/10/17
+ */
+#include <stdint.h>
+#include <string.h>
+
+#include "ingest.h"
+#include "port.h"
+#include "test.h"
+
+#define TEST_THRESH         32 //!< data_thresh of tests
+#define TEST_FRAME_NUM      16 //!< max. number of dispatched frames kept
+#define TEST_FRAME_SIZE     64 //!< max. length of dispatched frame kept
+
+static ingest_t in; //!< ingestion under test
+static char uart_buf[1024]; //!< data received by UART driver
+static int32_t uart_len; //!< length of uart_buf
+static int32_t uart_pos; //!< position read from uart_buf
+static uint32_t n_flush; //!< number of flushes of driver
+static char frame[TEST_FRAME_NUM][TEST_FRAME_SIZE]; //!< dispatched frames
+static uint32_t frame_num; //!< number of dispatched frames
+
+/** <!-- uart_read {{{1 -->
+ * @brief read buffered data of driver (ingest_ops_t)
+ */
+static int32_t uart_read(void *ctx, char *dst, int32_t len)
+{
+    (void)ctx;
+    if (len > uart_len - uart_pos) {
+        len = uart_len - uart_pos;
+    }
+    memcpy(dst, &uart_buf[uart_pos], len);
+    uart_pos += len;
+    return len;
+}
+
+/** <!-- uart_flush {{{1 -->
+ * @brief discard buffered data of driver (ingest_ops_t)
+ */
+static void uart_flush(void *ctx)
+{
+    (void)ctx;
+    uart_pos = uart_len;
+    n_flush++;
+}
+
+/** <!-- uart_dispatch {{{1 -->
+ * @brief keep dispatched frame (ingest_ops_t)
+ */
+static void uart_dispatch(void *ctx, const char *data, int32_t len)
+{
+    (void)ctx;
+    if ((frame_num < TEST_FRAME_NUM) && (len < TEST_FRAME_SIZE)) {
+        memcpy(frame[frame_num], data, len);
+        frame[frame_num][len] = '\0';
+    }
+    frame_num++;
+}
+
+static const ingest_ops_t test_ops = {
+    .read       = uart_read,
+    .flush      = uart_flush,
+    .dispatch   = uart_dispatch,
+    .ctx        = NULL,
+};
+
+/** <!-- uart_rx {{{1 -->
+ * @brief receive data into driver
+ * @param[in] str data
+ * @return length of data buffered in driver
+ */
+static int32_t uart_rx(const char *str)
+{
+    int32_t len = strlen(str);
+    memcpy(&uart_buf[uart_len], str, len);
+    uart_len += len;
+    return uart_len - uart_pos;
+}
+
+/** <!-- setup {{{1 -->
+ * @brief empty driver and start ingestion
+ * @param[in] data_thresh INGEST_DATA is read only from this length
+ * @return nothing
+ */
+static void setup(int32_t data_thresh)
+{
+    uart_len    = 0;
+    uart_pos    = 0;
+    n_flush     = 0;
+    frame_num   = 0;
+    memset(frame, 0, sizeof(frame));
+    ingest_init(&in, &test_ops, data_thresh);
+}
+
+/** <!-- test_data {{{1 -->
+ * @brief data below threshold is left in driver, above it is read
+ * @return nothing
+ */
+static void test_data(void)
+{
+    int32_t len;
+    setup(TEST_THRESH);
+    len = uart_rx(":0102\r\n");
+    TEST_EQ(ingest_event(&in, INGEST_DATA, len), 0);
+    TEST_EQ(in.n_byte, 0);
+    TEST_EQ(uart_pos, 0);
+    TEST_EQ(ingest_event(&in, INGEST_PATTERN, len), 1);
+    TEST_EQ(frame_num, 1);
+    TEST_CHECK(!strcmp(frame[0], ":0102"));
+    TEST_EQ(in.n_byte, 7);
+    // just below and at threshold without line end
+    len = uart_rx(":0123456789abcdef0123456789abcd");
+    TEST_EQ(len, TEST_THRESH - 1);
+    TEST_EQ(ingest_event(&in, INGEST_DATA, len), 0);
+    TEST_EQ(in.n_byte, 7);
+    len = uart_rx("e");
+    TEST_EQ(ingest_event(&in, INGEST_DATA, len), 0);
+    TEST_EQ(in.n_byte, 7 + TEST_THRESH);
+    TEST_EQ(uart_pos, uart_len);
+    // rest of the frame completes it in framer
+    len = uart_rx("f\r\n");
+    TEST_EQ(ingest_event(&in, INGEST_PATTERN, len), 1);
+    TEST_CHECK(!strcmp(frame[1], ":0123456789abcdef0123456789abcdef"));
+    TEST_EQ(in.n_event[INGEST_DATA], 3);
+    TEST_EQ(in.n_event[INGEST_PATTERN], 2);
+    TEST_EQ(in.n_dispatch, 2);
+    // polling reads every event, frames of several lines at once
+    setup(0);
+    len = uart_rx(":01\r\n:02\r\n:0");
+    TEST_EQ(ingest_event(&in, INGEST_DATA, len), 2);
+    TEST_EQ(ingest_event(&in, INGEST_DATA, uart_rx("3\r\n")), 1);
+    TEST_CHECK(!strcmp(frame[2], ":03"));
+    TEST_EQ(in.n_byte, uart_len);
+    // event larger than buffered data (e.g. driver read by others)
+    TEST_EQ(ingest_event(&in, INGEST_DATA, 100), 0);
+    TEST_EQ(in.n_byte, uart_len);
+}
+
+/** <!-- test_pattern {{{1 -->
+ * @brief line end event reads up to it, next partial frame stays in driver
+ * @return nothing
+ */
+static void test_pattern(void)
+{
+    setup(TEST_THRESH);
+    uart_rx("xx:0102\r\n:03");
+    TEST_EQ(ingest_event(&in, INGEST_PATTERN, 9), 1);
+    TEST_CHECK(!strcmp(frame[0], ":0102"));
+    TEST_EQ(uart_pos, 9);
+    TEST_EQ(in.framer.tail, 0);
+    uart_rx("04\r");
+    TEST_EQ(ingest_event(&in, INGEST_PATTERN, 6), 1);
+    TEST_CHECK(!strcmp(frame[1], ":0304"));
+    // LF of CR LF is the next line end, nothing but an empty line
+    uart_rx("\n:05");
+    TEST_EQ(ingest_event(&in, INGEST_PATTERN, 1), 0);
+    // partial frame read by DATA, completed by line end
+    uart_rx("0607080910111213141516171819202122232425");
+    TEST_EQ(ingest_event(&in, INGEST_DATA, uart_len - uart_pos), 0);
+    TEST_CHECK(in.framer.start >= 0);
+    uart_rx("26\r\n");
+    TEST_EQ(ingest_event(&in, INGEST_PATTERN, 4), 1);
+    TEST_CHECK(!strcmp(frame[2], ":05060708091011121314151617181920212223242526"));
+    TEST_EQ(frame_num, 3);
+    TEST_EQ(in.n_dispatch, 3);
+    TEST_EQ(in.framer.n_resync, 0);
+}
+
+/** <!-- test_overflow {{{1 -->
+ * @brief overflow and full buffer flush driver and framer, counts kept
+ * @return nothing
+ */
+static void test_overflow(void)
+{
+    uint32_t n;
+    setup(0);
+    TEST_EQ(ingest_event(&in, INGEST_DATA, uart_rx(":0102\r\n:03")), 1);
+    TEST_EQ(in.framer.tail, 3);
+    // rest of the partial frame was lost by FIFO overflow
+    uart_rx("04");
+    TEST_EQ(ingest_event(&in, INGEST_FIFO_OVF, 0), -1);
+    TEST_EQ(n_flush, 1);
+    TEST_EQ(uart_pos, uart_len);
+    TEST_EQ(in.framer.tail, 0);
+    TEST_EQ(in.framer.start, -1);
+    // tail of broken frame is no frame, the next one is
+    TEST_EQ(ingest_event(&in, INGEST_DATA, uart_rx("05\r\n:0607\r\n")), 1);
+    TEST_CHECK(!strcmp(frame[1], ":0607"));
+    TEST_EQ(frame_num, 2);
+    // driver buffer full, buffered frames are discarded
+    uart_rx(":0809\r\n:10");
+    TEST_EQ(ingest_event(&in, INGEST_BUFFER_FULL, 0), -1);
+    TEST_EQ(n_flush, 2);
+    TEST_EQ(ingest_event(&in, INGEST_DATA, uart_rx("11\r\n")), 0);
+    TEST_EQ(frame_num, 2);
+    for (n = 0; n < 3; n++) {
+        TEST_EQ(ingest_event(&in, INGEST_FIFO_OVF, 0), -1);
+        TEST_EQ(ingest_event(&in, INGEST_BUFFER_FULL, 0), -1);
+    }
+    TEST_EQ(in.n_event[INGEST_FIFO_OVF], 4);
+    TEST_EQ(in.n_event[INGEST_BUFFER_FULL], 4);
+    TEST_EQ(in.n_event[INGEST_DATA], 3);
+    TEST_EQ(n_flush, 8);
+    // statistics of framer survive the resets
+    TEST_EQ(in.framer.n_frame, 2);
+    TEST_EQ(in.n_dispatch, 2);
+    // unknown event is ignored
+    TEST_EQ(ingest_event(&in, INGEST_EVENT_NUM, 0), 0);
+    TEST_EQ(n_flush, 8);
+    int64_t now = port_msec();
+    TEST_EQ(ingest_event(&in, INGEST_DATA, uart_rx(":12\r\n")), 1);
+    TEST_CHECK(in.stamp >= now);
+}
+
+/** <!-- main {{{1 -->
+ * @brief run tests
+ * @return exit status
+ */
+int main(void)
+{
+    test_data();
+    test_pattern();
+    test_overflow();
+    return TEST_END();
+}
+
+// end of file {{{1
+// vim:ft=c:et:nowrap:fdm=marker
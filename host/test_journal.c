@@ -0,0 +1,288 @@
+/**
+ * Copyright (C) 2017 m2enu
+ *
+ * @file host/test_journal.c
+ * @brief unit tests of store-and-forward journal on memory image
+ * @author m2enu
+ * @date 2026/10/17
+ */
+#include <stdint.h>
+#include <string.h>
+
+#include "journal.h"
+#include "test.h"
+
+#define TEST_SLOTS          4 //!< number of records per sector
+#define TEST_SECTOR_SIZE    (JOURNAL_HEAD_SIZE + TEST_SLOTS * JOURNAL_REC_SIZE) //!< size of sector
+#define TEST_SECTOR_NUM     4 //!< number of sectors
+#define TEST_TOTAL          (TEST_SLOTS * TEST_SECTOR_NUM) //!< number of records
+#define TEST_WALL           1800000000000LL //!< wall clock of tests [ms]
+#define TEST_SID            0x81000000u //!< SID of end device of record 0
+
+static uint8_t image[TEST_SECTOR_SIZE * TEST_SECTOR_NUM]; //!< flash image
+static journal_ops_t ops; //!< storage backend on image
+static timemap_t clock_map; //!< clock mapping of timestamps
+static journal_t j; //!< journal under test
+static twelite_packet_t pkt[TEST_TOTAL]; //!< packets read
+
+/** <!-- rec_addr {{{1 -->
+ * @brief address of record in image
+ * @param[in] pos position of record
+ * @return address
+ */
+static uint32_t rec_addr(uint32_t pos)
+{
+    return (pos / TEST_SLOTS) * TEST_SECTOR_SIZE + JOURNAL_HEAD_SIZE
+         + (pos % TEST_SLOTS) * JOURNAL_REC_SIZE;
+}
+
+/** <!-- append {{{1 -->
+ * @brief append packets of consecutive SIDs
+ * @param[in] first number of the first packet
+ * @param[in] num number of packets
+ * @return nothing
+ */
+static void append(uint32_t first, uint32_t num)
+{
+    twelite_packet_t p;
+    uint32_t n;
+    for (n = first; n < first + num; n++) {
+        memset(&p, 0, sizeof(p));
+        p.sid_enddevice = TEST_SID + n;
+        p.id_sensor     = TWELITE_ID_LM61;
+        p.mvolt_vdd     = 3000;
+        p.mvolt_adc1    = 850;
+        p.timestamp     = 1000 * n;
+        TEST_CHECK(journal_append(&j, &p) >= 0);
+    }
+}
+
+/** <!-- remount {{{1 -->
+ * @brief mount image again (as after reboot)
+ * @return nothing
+ */
+static void remount(void)
+{
+    TEST_EQ(journal_mount(&j, &ops, &clock_map), 0);
+}
+
+/** <!-- format {{{1 -->
+ * @brief erase image and mount it
+ * @return nothing
+ */
+static void format(void)
+{
+    memset(image, 0xff, sizeof(image));
+    remount();
+}
+
+/** <!-- test_mount {{{1 -->
+ * @brief positions are recovered from records and consumed marks
+ * @return nothing
+ */
+static void test_mount(void)
+{
+    uint32_t span;
+    journal_mem_ops(&ops, image, TEST_SECTOR_SIZE, 1);
+    TEST_EQ(journal_mount(&j, &ops, &clock_map), -1);
+    journal_mem_ops(&ops, image, JOURNAL_HEAD_SIZE + JOURNAL_REC_SIZE, 4);
+    TEST_EQ(journal_mount(&j, &ops, &clock_map), -1);
+    journal_mem_ops(&ops, image, TEST_SECTOR_SIZE, TEST_SECTOR_NUM);
+    format();
+    TEST_EQ(j.slots, TEST_SLOTS);
+    TEST_EQ(j.total, TEST_TOTAL);
+    TEST_EQ(j.count + j.seq + j.wr, 0);
+    append(0, 6);
+    remount();
+    TEST_EQ(j.count, 6);
+    TEST_EQ(j.seq, 6);
+    TEST_EQ(j.wr, 6);
+    TEST_EQ(j.rd, 0);
+    TEST_EQ(journal_peek(&j, pkt, 4, &span), 4);
+    TEST_EQ(span, 4);
+    TEST_EQ(pkt[3].sid_enddevice, TEST_SID + 3);
+    TEST_EQ(pkt[3].timestamp, 3000);
+    TEST_EQ(journal_consume(&j, span), 0);
+    TEST_EQ(journal_consume(&j, 3), -1);
+    remount();
+    TEST_EQ(j.count, 2);
+    TEST_EQ(j.rd, 4);
+    TEST_EQ(journal_peek(&j, pkt, TEST_TOTAL, &span), 2);
+    TEST_EQ(pkt[0].sid_enddevice, TEST_SID + 4);
+    TEST_EQ(pkt[1].sid_enddevice, TEST_SID + 5);
+}
+
+/** <!-- test_corrupt {{{1 -->
+ * @brief records with CRC error are skipped, and never hold consumed mark
+ * @return nothing
+ */
+static void test_corrupt(void)
+{
+    uint32_t span;
+    format();
+    append(0, 8);
+    image[rec_addr(2) + 16] ^= 0x01; // sid_enddevice
+    image[rec_addr(3) + 42] ^= 0x80; // crc16
+    TEST_EQ(journal_peek(&j, pkt, 4, &span), 4);
+    TEST_EQ(span, 6);
+    TEST_EQ(j.n_corrupt, 2);
+    TEST_EQ(pkt[1].sid_enddevice, TEST_SID + 1);
+    TEST_EQ(pkt[2].sid_enddevice, TEST_SID + 4);
+    // batch of the first two: span ends on the corrupt records
+    TEST_EQ(journal_peek(&j, pkt, 2, &span), 2);
+    TEST_EQ(span, 2);
+    TEST_EQ(journal_consume(&j, 4), 0);
+    TEST_EQ(j.count, 4);
+    // mark is on record 1, corrupt records after it are not taken
+    remount();
+    TEST_EQ(j.count, 4);
+    TEST_EQ(j.rd, 4);
+    TEST_EQ(journal_peek(&j, pkt, TEST_TOTAL, &span), 4);
+    TEST_EQ(pkt[0].sid_enddevice, TEST_SID + 4);
+    // corrupt records only, consumed without mark
+    image[rec_addr(4) + 20] ^= 0x10;
+    image[rec_addr(5) + 0] ^= 0x01; // seq
+    remount();
+    TEST_EQ(j.count, 2);
+    TEST_EQ(j.rd, 6);
+    format();
+    append(0, 4);
+    image[rec_addr(2) + 30] ^= 0x04;
+    image[rec_addr(3) + 30] ^= 0x04;
+    TEST_EQ(journal_peek(&j, pkt, 2, &span), 2);
+    TEST_EQ(journal_consume(&j, span), 0);
+    TEST_EQ(journal_peek(&j, pkt, TEST_TOTAL, &span), 0);
+    TEST_EQ(span, 2);
+    TEST_EQ(journal_consume(&j, span), 0);
+    TEST_EQ(j.count, 0);
+    remount();
+    TEST_EQ(j.count, 0);
+    TEST_EQ(j.seq, 2);
+}
+
+/** <!-- test_torn {{{1 -->
+ * @brief reset while writing a record or a consumed mark
+ * @return nothing
+ */
+static void test_torn(void)
+{
+    uint32_t span;
+    format();
+    append(0, 7);
+    // reset in the middle of record 6, the rest of it stays erased
+    memset(&image[rec_addr(6) + 24], 0xff, JOURNAL_REC_SIZE - 24);
+    remount();
+    TEST_EQ(j.count, 6);
+    TEST_EQ(j.seq, 6);
+    TEST_EQ(j.wr, 7);
+    // torn slot is skipped, not written over
+    append(100, 1);
+    remount();
+    TEST_EQ(j.count, 8);
+    TEST_EQ(journal_peek(&j, pkt, TEST_TOTAL, &span), 7);
+    TEST_EQ(span, 8);
+    TEST_EQ(j.n_corrupt, 1);
+    TEST_EQ(pkt[5].sid_enddevice, TEST_SID + 5);
+    TEST_EQ(pkt[6].sid_enddevice, TEST_SID + 100);
+    // torn in the last slot of sector, next sector is erased anyway
+    format();
+    append(0, 4);
+    memset(&image[rec_addr(3) + 8], 0xff, JOURNAL_REC_SIZE - 8);
+    remount();
+    TEST_EQ(j.wr, 4);
+    TEST_EQ(j.count, 3);
+    append(4, 1);
+    TEST_EQ(j.n_erase, 1);
+    remount();
+    TEST_EQ(j.count, 5);
+    TEST_EQ(j.seq, 4);
+    // reset while writing consumed mark, records were delivered
+    TEST_EQ(journal_peek(&j, pkt, 2, &span), 2);
+    TEST_EQ(journal_consume(&j, span), 0);
+    memset(&image[rec_addr(1) + 45], 0xff, 3);
+    remount();
+    TEST_EQ(j.count, 3);
+    TEST_EQ(j.rd, 2);
+}
+
+/** <!-- test_wrap {{{1 -->
+ * @brief sequence number wraps around, marks are lost by sector erase
+ * @return nothing
+ */
+static void test_wrap(void)
+{
+    journal_t live;
+    uint32_t span;
+    uint32_t step;
+    uint32_t rnd = 1;
+    uint32_t n = 0;
+    format();
+    j.seq = 0xfffffffa;
+    append(0, 10);
+    remount();
+    TEST_EQ(j.seq, 4);
+    TEST_EQ(j.wr, 10);
+    TEST_EQ(j.rd, 0);
+    TEST_EQ(j.count, 10);
+    TEST_EQ(journal_peek(&j, pkt, 7, &span), 7);
+    TEST_EQ(pkt[6].sid_enddevice, TEST_SID + 6);
+    TEST_EQ(journal_consume(&j, span), 0);
+    remount();
+    TEST_EQ(j.count, 3);
+    TEST_EQ(j.rd, 7);
+    // wraps around the image, erasing sector of the mark and record 7
+    append(10, 11);
+    TEST_EQ(j.n_overwrite, 1);
+    TEST_EQ(j.count, 13);
+    TEST_EQ(j.rd, 8);
+    remount();
+    TEST_EQ(j.count, 13);
+    TEST_EQ(j.rd, 8);
+    TEST_EQ(j.wr, 5);
+    TEST_EQ(journal_peek(&j, pkt, 1, &span), 1);
+    TEST_EQ(pkt[0].sid_enddevice, TEST_SID + 8);
+    // random appends and consumes around the wrap, remount agrees with them
+    format();
+    j.seq = 0xffffff00;
+    for (step = 0; step < 2000; step++) {
+        rnd = rnd * 1103515245 + 12345;
+        append(n, (rnd >> 16) % 4);
+        n += (rnd >> 16) % 4;
+        if ((rnd >> 20) % 3 == 0) {
+            int32_t num = journal_peek(&j, pkt, (rnd >> 24) % 8, &span);
+            TEST_CHECK(num >= 0);
+            TEST_EQ(journal_consume(&j, span), 0);
+        }
+        live = j;
+        remount();
+        if ((j.seq != live.seq) || (j.wr != live.wr) ||
+            (j.rd != live.rd) || (j.count != live.count)) {
+            TEST_EQ(j.seq, live.seq);
+            TEST_EQ(j.wr, live.wr);
+            TEST_EQ(j.rd, live.rd);
+            TEST_EQ(j.count, live.count);
+            break;
+        }
+        j = live;
+    }
+    TEST_CHECK(j.seq < 0xffffff00);
+    TEST_CHECK(j.n_overwrite > 0);
+}
+
+/** <!-- main {{{1 -->
+ * @brief run tests
+ * @return exit status
+ */
+int main(void)
+{
+    timemap_init(&clock_map);
+    timemap_sync(&clock_map, 0, TEST_WALL);
+    test_mount();
+    test_corrupt();
+    test_torn();
+    test_wrap();
+    return TEST_END();
+}
+
+// end of file {{{1
+// vim:ft=c:et:nowrap:fdm=marker
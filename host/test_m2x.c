@@ -0,0 +1,207 @@
+/**
+ * Copyright (C) 2017 m2enu
+ *
+ * @file host/test_m2x.c
+ * @brief tests of M2X client pipelining against tools/mock_m2x.py
+ *
+ * The mock server is started on a free port for the test, and closes
+ * keep-alive connections idle for TEST_IDLE. Skipped without python3.
+ * @author m2enu
+ * @date 2026/10/17
+ */
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "m2x.h"
+#include "batch.h"
+#include "timemap.h"
+#include "test.h"
+
+#define TEST_MOCK           "../tools/mock_m2x.py" //!< mock server (run from host/)
+#define TEST_IDLE           "1" //!< idle timeout of mock server [s]
+#define TEST_BODY_MAX       4096 //!< max. length of one body
+
+static m2x_client_t c; //!< client under test
+static timemap_t clock_map; //!< clock mapping of timestamps
+static m2x_batch_t batch; //!< batch of bodies
+static char body_buf[M2X_PIPELINE_MAX][TEST_BODY_MAX]; //!< bodies
+static const char *body[M2X_PIPELINE_MAX]; //!< bodies to pipeline
+static int32_t len[M2X_PIPELINE_MAX]; //!< lengths of bodies
+static int32_t status[M2X_PIPELINE_MAX]; //!< statuses of requests
+
+/** <!-- mock_start {{{1 -->
+ * @brief start mock server, and wait until it accepts connections
+ * @param[in] port port number
+ * @return process id of mock server
+ * @retval -ve_value: not started
+ */
+static pid_t mock_start(uint16_t port)
+{
+    char arg[8];
+    struct sockaddr_in addr;
+    uint32_t n;
+    snprintf(arg, sizeof(arg), "%u", port);
+    pid_t pid = fork();
+    if (pid == 0) {
+        int fd = open("/dev/null", O_WRONLY);
+        dup2(fd, 1);
+        execlp("python3", "python3", TEST_MOCK, "--port", arg,
+               "--idle-timeout", TEST_IDLE, "--stats", "0", (char *)NULL);
+        _exit(127);
+    }
+    if (pid < 0) {
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_port        = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    for (n = 0; n < 100; n++) {
+        int sock = socket(AF_INET, SOCK_STREAM, 0);
+        int ret = connect(sock, (struct sockaddr *)&addr, sizeof(addr));
+        close(sock);
+        if (ret == 0) {
+            return pid;
+        }
+        if (waitpid(pid, NULL, WNOHANG) == pid) {
+            return -1; // exited
+        }
+        usleep(100000);
+    }
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+    return -1;
+}
+
+/** <!-- body_make {{{1 -->
+ * @brief make bodies of one packet each
+ * @param[in] num number of bodies
+ * @return nothing
+ */
+static void body_make(int32_t num)
+{
+    twelite_packet_t pkt;
+    int32_t n;
+    for (n = 0; n < num; n++) {
+        memset(&pkt, 0, sizeof(pkt));
+        pkt.sid_enddevice   = 0x81000000u + n;
+        pkt.id_sensor       = TWELITE_ID_LM61;
+        pkt.mvolt_vdd       = 3000;
+        pkt.mvolt_adc1      = 850;
+        pkt.timestamp       = 1000 * n;
+        m2x_batch_clear(&batch);
+        m2x_batch_add(&batch, &pkt);
+        len[n]  = m2x_batch_json(body_buf[n], TEST_BODY_MAX, &batch);
+        body[n] = body_buf[n];
+        TEST_CHECK(len[n] > 0);
+    }
+}
+
+/** <!-- test_pipeline {{{1 -->
+ * @brief requests are answered in order over one connection
+ * @return nothing
+ */
+static void test_pipeline(void)
+{
+    int32_t n;
+    body_make(M2X_PIPELINE_MAX);
+    TEST_EQ(m2x_client_pipeline(&c, M2X_PATH_UPDATES, body, len, status, 0), -1);
+    TEST_EQ(m2x_client_pipeline(&c, M2X_PATH_UPDATES, body, len, status,
+                                M2X_PIPELINE_MAX + 1), -1);
+    TEST_EQ(m2x_client_pipeline(&c, M2X_PATH_UPDATES, body, len, status, 4), 4);
+    for (n = 0; n < 4; n++) {
+        TEST_EQ(status[n], STATUS_OK);
+    }
+    TEST_EQ(c.n_connect, 1);
+    TEST_EQ(c.n_request, 4);
+    // kept alive, the whole pipeline on the same connection
+    TEST_EQ(m2x_client_pipeline(&c, M2X_PATH_UPDATES, body, len, status,
+                                M2X_PIPELINE_MAX), M2X_PIPELINE_MAX);
+    for (n = 0; n < M2X_PIPELINE_MAX; n++) {
+        TEST_EQ(status[n], STATUS_OK);
+    }
+    TEST_EQ(c.n_connect, 1);
+    TEST_EQ(c.n_request, 4 + M2X_PIPELINE_MAX);
+    // refused request in the middle does not affect the others
+    len[1] = 2;
+    body[1] = "{}";
+    TEST_EQ(m2x_client_pipeline(&c, M2X_PATH_UPDATES, body, len, status, 3), 3);
+    TEST_EQ(status[0], STATUS_OK);
+    TEST_EQ(status[1], 422);
+    TEST_EQ(status[2], STATUS_OK);
+    TEST_EQ(c.n_connect, 1);
+    TEST_EQ(m2x_client_post(&c, M2X_PATH_UPDATES, body[0], len[0], 1), STATUS_OK);
+    TEST_EQ(c.n_connect, 1);
+    TEST_EQ(c.n_stale, 0);
+}
+
+/** <!-- test_idle {{{1 -->
+ * @brief connection closed by server while idle is replaced, requests resent
+ * @return nothing
+ */
+static void test_idle(void)
+{
+    int32_t n;
+    body_make(3);
+    sleep(2);
+    TEST_EQ(m2x_client_pipeline(&c, M2X_PATH_UPDATES, body, len, status, 3), 3);
+    for (n = 0; n < 3; n++) {
+        TEST_EQ(status[n], STATUS_OK);
+    }
+    TEST_EQ(c.n_stale, 1);
+    TEST_EQ(c.n_connect, 2);
+}
+
+/** <!-- test_gone {{{1 -->
+ * @brief server gone, kept connection is found closed and new one refused
+ * @return nothing
+ */
+static void test_gone(void)
+{
+    int32_t n;
+    body_make(3);
+    TEST_EQ(m2x_client_pipeline(&c, M2X_PATH_UPDATES, body, len, status, 3), -1);
+    for (n = 0; n < 3; n++) {
+        TEST_EQ(status[n], -1);
+    }
+    TEST_EQ(c.n_stale, 2);
+    TEST_EQ(c.n_connect, 2);
+    // not connected, so nothing to resend
+    TEST_EQ(m2x_client_pipeline(&c, M2X_PATH_UPDATES, body, len, status, 3), -1);
+    TEST_EQ(c.n_stale, 2);
+    m2x_client_close(&c);
+}
+
+/** <!-- main {{{1 -->
+ * @brief run tests
+ * @return exit status
+ */
+int main(void)
+{
+    uint16_t port = 20000 + getpid() % 20000;
+    pid_t pid = mock_start(port);
+    if (pid < 0) {
+        printf("%s: skipped, %s not started\n", __FILE__, TEST_MOCK);
+        return 0;
+    }
+    timemap_init(&clock_map);
+    timemap_sync(&clock_map, 0, 1800000000000LL);
+    m2x_batch_init(&batch, 1, INT32_MAX, UINT32_MAX, &clock_map);
+    TEST_EQ(m2x_client_init(&c, "127.0.0.1", port, "test", "key"), 0);
+    test_pipeline();
+    test_idle();
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+    test_gone();
+    return TEST_END();
+}
+
+// end of file {{{1
+// vim:ft=c:et:nowrap:fdm=marker
@@ -0,0 +1,205 @@
+/**
+ * Copyright (C) 2017 m2enu
+ *
+ * @file host/test_pktq.c
+ * @brief unit tests of packet queue
+ * @author m2enu
+ * @date 2026/10/17
+ */
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "pktq.h"
+#include "test.h"
+
+#define TEST_PKTQ_SIZE      8 //!< number of slots
+#define TEST_THREAD_NUM     200000 //!< number of packets of threaded test
+
+static pktq_t q; //!< packet queue under test
+static pktq_slot_t slot[TEST_PKTQ_SIZE]; //!< slots of queue
+static uint32_t done; //!< 1: producer thread pushed every packet
+
+/** <!-- pkt_make {{{1 -->
+ * @brief make packet
+ * @param[in] sid SID of end device
+ * @param[in] number next number
+ * @return packet
+ */
+static twelite_packet_t pkt_make(uint32_t sid, uint16_t number)
+{
+    twelite_packet_t pkt;
+    memset(&pkt, 0, sizeof(pkt));
+    pkt.sid_enddevice = sid;
+    pkt.next_number   = number;
+    return pkt;
+}
+
+/** <!-- test_init {{{1 -->
+ * @brief number of slots must be power of 2
+ * @return nothing
+ */
+static void test_init(void)
+{
+    TEST_EQ(pktq_init(&q, slot, 0, PKTQ_DROP_NEWEST), -1);
+    TEST_EQ(pktq_init(&q, slot, 1, PKTQ_DROP_NEWEST), -1);
+    TEST_EQ(pktq_init(&q, slot, 6, PKTQ_DROP_NEWEST), -1);
+    TEST_EQ(pktq_init(&q, slot, TEST_PKTQ_SIZE, PKTQ_DROP_NEWEST), 0);
+    TEST_EQ(pktq_count(&q), 0);
+}
+
+/** <!-- test_drop_newest {{{1 -->
+ * @brief FIFO order, and pushed packet is dropped when full
+ * @return nothing
+ */
+static void test_drop_newest(void)
+{
+    twelite_packet_t pkt = pkt_make(1, 0);
+    uint16_t n;
+    pktq_init(&q, slot, TEST_PKTQ_SIZE, PKTQ_DROP_NEWEST);
+    TEST_EQ(pktq_pop(&q, &pkt), 1);
+    // wrap around several times
+    for (n = 0; n < 3 * TEST_PKTQ_SIZE; n++) {
+        pkt = pkt_make(1, n);
+        TEST_EQ(pktq_push(&q, &pkt), 0);
+        pkt = pkt_make(1, 0xffff);
+        TEST_EQ(pktq_pop(&q, &pkt), 0);
+        TEST_EQ(pkt.next_number, n);
+    }
+    for (n = 0; n < TEST_PKTQ_SIZE; n++) {
+        pkt = pkt_make(1, n);
+        TEST_EQ(pktq_push(&q, &pkt), 0);
+    }
+    TEST_EQ(pktq_count(&q), TEST_PKTQ_SIZE);
+    pkt = pkt_make(1, 100);
+    TEST_EQ(pktq_push(&q, &pkt), -1);
+    TEST_EQ(q.n_drop_newest, 1);
+    for (n = 0; n < TEST_PKTQ_SIZE; n++) {
+        TEST_EQ(pktq_pop(&q, &pkt), 0);
+        TEST_EQ(pkt.next_number, n);
+    }
+    TEST_EQ(pktq_pop(&q, &pkt), 1);
+    TEST_EQ(q.n_push, 4 * TEST_PKTQ_SIZE);
+    TEST_EQ(q.n_pop, 4 * TEST_PKTQ_SIZE);
+}
+
+/** <!-- test_drop_oldest {{{1 -->
+ * @brief the oldest packet is dropped when full
+ * @return nothing
+ */
+static void test_drop_oldest(void)
+{
+    twelite_packet_t pkt;
+    uint16_t n;
+    pktq_init(&q, slot, TEST_PKTQ_SIZE, PKTQ_DROP_OLDEST);
+    for (n = 0; n < TEST_PKTQ_SIZE; n++) {
+        pkt = pkt_make(1, n);
+        TEST_EQ(pktq_push(&q, &pkt), 0);
+    }
+    pkt = pkt_make(1, TEST_PKTQ_SIZE);
+    TEST_EQ(pktq_push(&q, &pkt), 1);
+    TEST_EQ(q.n_drop_oldest, 1);
+    TEST_EQ(pktq_count(&q), TEST_PKTQ_SIZE);
+    for (n = 1; n <= TEST_PKTQ_SIZE; n++) {
+        TEST_EQ(pktq_pop(&q, &pkt), 0);
+        TEST_EQ(pkt.next_number, n);
+    }
+    TEST_EQ(pktq_pop(&q, &pkt), 1);
+}
+
+/** <!-- test_coalesce {{{1 -->
+ * @brief queued packet of the same end device is overwritten when full
+ * @return nothing
+ */
+static void test_coalesce(void)
+{
+    twelite_packet_t pkt;
+    uint16_t n;
+    pktq_init(&q, slot, TEST_PKTQ_SIZE, PKTQ_COALESCE);
+    for (n = 0; n < TEST_PKTQ_SIZE; n++) {
+        pkt = pkt_make(n, n);
+        TEST_EQ(pktq_push(&q, &pkt), 0);
+    }
+    pkt = pkt_make(3, 100);
+    TEST_EQ(pktq_push(&q, &pkt), 1);
+    TEST_EQ(q.n_coalesce, 1);
+    pkt = pkt_make(TEST_PKTQ_SIZE, 101);
+    TEST_EQ(pktq_push(&q, &pkt), -1);
+    TEST_EQ(q.n_drop_newest, 1);
+    for (n = 0; n < TEST_PKTQ_SIZE; n++) {
+        TEST_EQ(pktq_pop(&q, &pkt), 0);
+        TEST_EQ(pkt.sid_enddevice, n);
+        TEST_EQ(pkt.next_number, (n == 3) ? 100 : n);
+    }
+    TEST_EQ(pktq_pop(&q, &pkt), 1);
+}
+
+/** <!-- test_producer {{{1 -->
+ * @brief producer thread of threaded test
+ * @param[in] arg unused
+ * @return NULL
+ */
+static void *test_producer(void *arg)
+{
+    uint32_t n;
+    (void)arg;
+    for (n = 0; n < TEST_THREAD_NUM; n++) {
+        twelite_packet_t pkt = pkt_make(n, 0);
+        pktq_push(&q, &pkt);
+    }
+    __atomic_store_n(&done, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+/** <!-- test_thread {{{1 -->
+ * @brief packets are popped once and in order against concurrent producer
+ * @param[in] policy overflow policy
+ * @return nothing
+ */
+static void test_thread(pktq_policy_t policy)
+{
+    pthread_t th;
+    twelite_packet_t pkt;
+    uint32_t num = 0;
+    uint32_t bad = 0;
+    int64_t prev = -1;
+    pktq_init(&q, slot, TEST_PKTQ_SIZE, policy);
+    done = 0;
+    pthread_create(&th, NULL, test_producer, NULL);
+    while (1) {
+        // done is loaded before pop, so empty queue after it is the end
+        uint32_t last = __atomic_load_n(&done, __ATOMIC_ACQUIRE);
+        if (pktq_pop(&q, &pkt) != 0) {
+            if (last) {
+                break;
+            }
+            continue;
+        }
+        bad += ((int64_t)pkt.sid_enddevice <= prev);
+        prev = pkt.sid_enddevice;
+        num++;
+    }
+    pthread_join(th, NULL);
+    TEST_EQ(bad, 0);
+    TEST_EQ(num, q.n_pop);
+    TEST_EQ(q.n_push, q.n_pop + q.n_drop_oldest);
+    TEST_EQ(q.n_push + q.n_drop_newest, TEST_THREAD_NUM);
+}
+
+/** <!-- main {{{1 -->
+ * @brief run tests
+ * @return exit status
+ */
+int main(void)
+{
+    test_init();
+    test_drop_newest();
+    test_drop_oldest();
+    test_coalesce();
+    test_thread(PKTQ_DROP_NEWEST);
+    test_thread(PKTQ_DROP_OLDEST);
+    return TEST_END();
+}
+
+// end of file {{{1
+// vim:ft=c:et:nowrap:fdm=marker
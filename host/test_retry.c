@@ -0,0 +1,214 @@
+/**
+ * Copyright (C) 2017 m2enu
+ *
+ * @file host/test_retry.c
+ * @brief unit tests of retry scheduler, driven by a virtual clock
+ * @author m2enu
+ * @date 2026/10/17
+ */
+#include <stdint.h>
+
+#include "retry.h"
+#include "test.h"
+
+#define TEST_BASE           500 //!< backoff after the first failure [ms]
+#define TEST_CAP            30000 //!< max. backoff [ms]
+#define TEST_THRESHOLD      5 //!< consecutive failures to open breaker
+#define TEST_COOLDOWN       60000 //!< time to stay open [ms]
+#define TEST_ATTEMPT        3 //!< max. attempts of one request
+
+static retry_t r; //!< retry scheduler under test
+static int64_t now; //!< virtual clock [ms]
+
+/** <!-- request_fail {{{1 -->
+ * @brief wait until request is allowed, then fail it without response
+ * @return verdict of failure
+ */
+static retry_verdict_t request_fail(void)
+{
+    now += retry_wait(&r, now);
+    return retry_result(&r, now, -1);
+}
+
+/** <!-- test_classify {{{1 -->
+ * @brief 2xx done, 408/429/5xx/no response again, other 4xx dropped
+ * @return nothing
+ */
+static void test_classify(void)
+{
+    TEST_EQ(retry_classify(200), RETRY_DONE);
+    TEST_EQ(retry_classify(202), RETRY_DONE);
+    TEST_EQ(retry_classify(204), RETRY_DONE);
+    TEST_EQ(retry_classify(408), RETRY_AGAIN);
+    TEST_EQ(retry_classify(429), RETRY_AGAIN);
+    TEST_EQ(retry_classify(500), RETRY_AGAIN);
+    TEST_EQ(retry_classify(503), RETRY_AGAIN);
+    TEST_EQ(retry_classify(-1), RETRY_AGAIN);
+    TEST_EQ(retry_classify(400), RETRY_DROP);
+    TEST_EQ(retry_classify(401), RETRY_DROP);
+    TEST_EQ(retry_classify(404), RETRY_DROP);
+    TEST_EQ(retry_classify(301), RETRY_DROP);
+}
+
+/** <!-- test_backoff {{{1 -->
+ * @brief backoff doubles up to cap, half of it is jitter
+ * @return nothing
+ */
+static void test_backoff(void)
+{
+    int64_t lo = TEST_CAP;
+    int64_t hi = 0;
+    uint32_t seed;
+    uint32_t n;
+    for (seed = 1; seed <= 1000; seed++) {
+        // threshold and attempts never reached, so backoff grows to cap
+        retry_init(&r, TEST_BASE, TEST_CAP, 100, TEST_COOLDOWN, 100, seed);
+        now = 0;
+        for (n = 0; n < 10; n++) {
+            int64_t delay = TEST_BASE << n;
+            delay = (delay > TEST_CAP) ? TEST_CAP : delay;
+            TEST_EQ(retry_result(&r, now, 503), RETRY_AGAIN);
+            int64_t wait = retry_wait(&r, now);
+            if ((wait < delay / 2) || (wait > delay)) {
+                TEST_CHECK((wait >= delay / 2) && (wait <= delay));
+            }
+            if (n == 0) {
+                lo = (wait < lo) ? wait : lo;
+                hi = (wait > hi) ? wait : hi;
+            }
+            now += wait;
+        }
+    }
+    // jitter spreads gateways over the whole random half
+    TEST_CHECK(lo < TEST_BASE / 2 + TEST_BASE / 20);
+    TEST_CHECK(hi > TEST_BASE - TEST_BASE / 20);
+    // the same seed gives the same backoff
+    retry_init(&r, TEST_BASE, TEST_CAP, 100, TEST_COOLDOWN, 100, 7);
+    retry_result(&r, 0, -1);
+    int64_t wait = retry_wait(&r, 0);
+    retry_init(&r, TEST_BASE, TEST_CAP, 100, TEST_COOLDOWN, 100, 7);
+    retry_result(&r, 0, -1);
+    TEST_EQ(retry_wait(&r, 0), wait);
+    // not allowed before the backoff, allowed from then on
+    TEST_CHECK(retry_wait(&r, wait - 1) == 1);
+    TEST_EQ(retry_wait(&r, wait), 0);
+    TEST_EQ(r.state, RETRY_CLOSED);
+}
+
+/** <!-- test_attempts {{{1 -->
+ * @brief request is given up after max. attempts, success resets
+ * @return nothing
+ */
+static void test_attempts(void)
+{
+    retry_init(&r, TEST_BASE, TEST_CAP, TEST_THRESHOLD, TEST_COOLDOWN,
+               TEST_ATTEMPT, 1);
+    now = 0;
+    TEST_EQ(request_fail(), RETRY_AGAIN);
+    TEST_EQ(request_fail(), RETRY_AGAIN);
+    TEST_EQ(request_fail(), RETRY_GIVEUP);
+    TEST_EQ(r.n_again, 2);
+    TEST_EQ(r.n_giveup, 1);
+    TEST_EQ(r.state, RETRY_CLOSED);
+    // next request starts its own attempts, failures keep counting
+    TEST_EQ(request_fail(), RETRY_AGAIN);
+    TEST_EQ(r.fails, 4);
+    now += retry_wait(&r, now);
+    TEST_EQ(retry_result(&r, now, 202), RETRY_DONE);
+    TEST_EQ(r.fails, 0);
+    TEST_EQ(r.attempt, 0);
+    TEST_EQ(retry_wait(&r, now), 0);
+    // refused request is dropped, and the server is healthy
+    TEST_EQ(request_fail(), RETRY_AGAIN);
+    TEST_EQ(retry_result(&r, now, 400), RETRY_DROP);
+    TEST_EQ(r.fails, 0);
+    TEST_EQ(r.n_drop, 1);
+    TEST_EQ(retry_wait(&r, now), 0);
+}
+
+/** <!-- test_breaker {{{1 -->
+ * @brief breaker opens, cools down, and probes once half-open
+ * @return nothing
+ */
+static void test_breaker(void)
+{
+    uint32_t n;
+    retry_init(&r, TEST_BASE, TEST_CAP, TEST_THRESHOLD, TEST_COOLDOWN,
+               100, 1);
+    now = 0;
+    for (n = 1; n < TEST_THRESHOLD; n++) {
+        TEST_EQ(request_fail(), RETRY_AGAIN);
+    }
+    TEST_EQ(request_fail(), RETRY_GIVEUP);
+    TEST_EQ(r.state, RETRY_OPEN);
+    TEST_EQ(r.n_open, 1);
+    // nothing allowed during cool down
+    int64_t opened = now;
+    TEST_EQ(retry_wait(&r, now), TEST_COOLDOWN);
+    TEST_EQ(retry_wait(&r, now + TEST_COOLDOWN - 1), 1);
+    TEST_EQ(r.state, RETRY_OPEN);
+    // half-open after cool down, failed probe opens it again
+    now = opened + TEST_COOLDOWN;
+    TEST_EQ(retry_wait(&r, now), 0);
+    TEST_EQ(r.state, RETRY_HALF_OPEN);
+    TEST_EQ(retry_result(&r, now, 503), RETRY_GIVEUP);
+    TEST_EQ(r.state, RETRY_OPEN);
+    TEST_EQ(r.n_open, 2);
+    TEST_EQ(retry_wait(&r, now), TEST_COOLDOWN);
+    // successful probe closes it
+    now += TEST_COOLDOWN;
+    TEST_EQ(retry_wait(&r, now), 0);
+    TEST_EQ(r.state, RETRY_HALF_OPEN);
+    TEST_EQ(retry_result(&r, now, 202), RETRY_DONE);
+    TEST_EQ(r.state, RETRY_CLOSED);
+    TEST_EQ(r.fails, 0);
+    TEST_EQ(retry_wait(&r, now), 0);
+    // refused probe also shows the server is up
+    for (n = 0; n < TEST_THRESHOLD; n++) {
+        request_fail();
+    }
+    TEST_EQ(r.state, RETRY_OPEN);
+    now += retry_wait(&r, now);
+    TEST_EQ(retry_wait(&r, now), 0);
+    TEST_EQ(r.state, RETRY_HALF_OPEN);
+    TEST_EQ(retry_result(&r, now, 404), RETRY_DROP);
+    TEST_EQ(r.state, RETRY_CLOSED);
+}
+
+/** <!-- test_outage {{{1 -->
+ * @brief requests during a 10 min outage, every 1 s while allowed
+ * @return nothing
+ */
+static void test_outage(void)
+{
+    uint32_t sent = 0;
+    retry_init(&r, TEST_BASE, TEST_CAP, TEST_THRESHOLD, TEST_COOLDOWN,
+               TEST_ATTEMPT, 1);
+    for (now = 0; now < 10 * 60 * 1000; now += 1000) {
+        if (retry_wait(&r, now) == 0) {
+            retry_result(&r, now, -1);
+            sent++;
+        }
+    }
+    // breaker opens after threshold, then one probe per cool down
+    TEST_EQ(r.n_open, 1 + 9);
+    TEST_EQ(sent, TEST_THRESHOLD + 9);
+    TEST_EQ(r.state, RETRY_OPEN);
+}
+
+/** <!-- main {{{1 -->
+ * @brief run tests
+ * @return exit status
+ */
+int main(void)
+{
+    test_classify();
+    test_backoff();
+    test_attempts();
+    test_breaker();
+    test_outage();
+    return TEST_END();
+}
+
+// end of file {{{1
+// vim:ft=c:et:nowrap:fdm=marker
@@ -0,0 +1,216 @@
+/**
+ * Copyright (C) 2017 m2enu
+ *
+ * @file host/test_rule.c
+ * @brief unit tests of alert rules
+ * @author m2enu
+ * @date 2026/10/17
+ */
+#include <stdint.h>
+#include <string.h>
+
+#include "rule.h"
+#include "test.h"
+
+#define TEST_SID            0x81000001u //!< SID of end device
+
+static rule_table_t t; //!< alert rules under test
+static char spec[512]; //!< rules built by tests
+
+/** <!-- pkt_make {{{1 -->
+ * @brief make BME280 packet
+ * @param[in] sid SID of end device
+ * @param[in] msec receive time [ms]
+ * @param[in] temperature temperature [x100 degC]
+ * @param[in] vdd power supply voltage [mV]
+ * @return packet
+ */
+static twelite_packet_t pkt_make(uint32_t sid, int64_t msec,
+                                 int16_t temperature, uint16_t vdd)
+{
+    twelite_packet_t pkt;
+    memset(&pkt, 0, sizeof(pkt));
+    pkt.sid_enddevice            = sid;
+    pkt.timestamp                = msec;
+    pkt.id_sensor                = TWELITE_ID_BME280;
+    pkt.mvolt_vdd                = vdd;
+    pkt.pkt_bme280.i_temperature = (uint16_t)temperature;
+    pkt.pkt_bme280.i_humidity    = 4800;
+    pkt.pkt_bme280.i_pressure    = 101325;
+    twelite_sensor_resolve(&pkt);
+    return pkt;
+}
+
+/** <!-- lane {{{1 -->
+ * @brief classify packet
+ * @param[in] sid SID of end device
+ * @param[in] msec receive time [ms]
+ * @param[in] temperature temperature [x100 degC]
+ * @param[in] vdd power supply voltage [mV]
+ * @return lane of packet
+ */
+static int8_t lane(uint32_t sid, int64_t msec, int16_t temperature, uint16_t vdd)
+{
+    twelite_packet_t pkt = pkt_make(sid, msec, temperature, vdd);
+    return rule_check(&t, &pkt);
+}
+
+/** <!-- test_malformed {{{1 -->
+ * @brief malformed spec compiles no rule at all
+ * @return nothing
+ */
+static void test_malformed(void)
+{
+    static const char *bad[] = {
+        "vdd", "vdd<", "vdd<x", "vdd<1x", "vdd=1", "foo>1", "vddd<1",
+        ",vdd<1", "vdd<1,,", "vdd<-", "vdd<.", "vdd<-.", "vdd<1.2.3",
+        "vdd<1 ", " vdd<1", "vdd<<1", "vdd<2.4;temperature>40",
+        "pressure>2147483648", "vdd<2147484", "temperature>40,vdd",
+    };
+    uint32_t n;
+    for (n = 0; n < sizeof(bad) / sizeof(bad[0]); n++) {
+        int8_t ret = rule_init(&t, "vdd<2.4");
+        ret |= rule_init(&t, bad[n]);
+        if ((ret != -1) || (t.num != 0)) {
+            fprintf(stderr, "spec: \"%s\"\n", bad[n]);
+        }
+        TEST_EQ(ret, -1);
+        TEST_EQ(t.num, 0);
+        TEST_EQ(lane(TEST_SID, 0, 9000, 1900), RULE_LANE_BULK);
+    }
+    // no rule, and empty rule list after the last one
+    TEST_EQ(rule_init(&t, NULL), 0);
+    TEST_EQ(t.num, 0);
+    TEST_EQ(rule_init(&t, ""), 0);
+    TEST_EQ(t.num, 0);
+    TEST_EQ(rule_init(&t, "vdd<2.4,"), 0);
+    TEST_EQ(t.num, 1);
+    TEST_EQ(rule_init(&t, "pressure>2147483647"), 0);
+    TEST_EQ(t.entry[0].hi, INT32_MAX);
+}
+
+/** <!-- test_limit {{{1 -->
+ * @brief negative and fractional limits, extra decimals truncated
+ * @return nothing
+ */
+static void test_limit(void)
+{
+    uint32_t n;
+    TEST_EQ(rule_init(&t, "temperature<-5.5,vdd<2.4,temperature>40"), 0);
+    TEST_EQ(t.num, 2);
+    TEST_EQ(t.num_rate, 0);
+    TEST_EQ(t.entry[0].stream, TWELITE_STREAM_TEMPERATURE);
+    TEST_EQ(t.entry[0].lo, -550);
+    TEST_EQ(t.entry[0].hi, 4000);
+    TEST_EQ(t.entry[1].lo, 2400);
+    TEST_EQ(t.entry[1].hi, INT32_MAX);
+    TEST_EQ(lane(TEST_SID, 0, -549, 3000), RULE_LANE_BULK);
+    TEST_EQ(lane(TEST_SID, 0, -550, 3000), RULE_LANE_BULK);
+    TEST_EQ(lane(TEST_SID, 0, -551, 3000), RULE_LANE_ALERT);
+    TEST_EQ(lane(TEST_SID, 0, 4000, 3000), RULE_LANE_BULK);
+    TEST_EQ(lane(TEST_SID, 0, 4001, 3000), RULE_LANE_ALERT);
+    TEST_EQ(lane(TEST_SID, 0, 2500, 2399), RULE_LANE_ALERT);
+    TEST_EQ(lane(TEST_SID, 0, 2500, 2400), RULE_LANE_BULK);
+    TEST_EQ(t.n_alert, 3);
+    // leading point, negative fraction, integer of fractional stream
+    TEST_EQ(rule_init(&t, "adc1>.5,temperature>-.25,humidity<1"), 0);
+    TEST_EQ(t.entry[0].hi, 500);
+    TEST_EQ(t.entry[1].hi, -25);
+    TEST_EQ(t.entry[2].lo, 100);
+    // decimals beyond frac of stream are truncated, not rounded
+    TEST_EQ(rule_init(&t, "vdd<2.4009,pressure>1000.99,temperature>25.129"), 0);
+    TEST_EQ(t.entry[0].lo, 2400);
+    TEST_EQ(t.entry[1].hi, 1000);
+    TEST_EQ(t.entry[2].hi, 2512);
+    TEST_EQ(rule_init(&t, "temperature<-0.019"), 0);
+    TEST_EQ(t.entry[0].lo, -1);
+    // however many of them
+    strcpy(spec, "vdd<1.");
+    for (n = 0; n < 255; n++) {
+        strcat(spec, "0");
+    }
+    strcat(spec, "9");
+    TEST_EQ(rule_init(&t, spec), 0);
+    TEST_EQ(t.entry[0].lo, 1000);
+    spec[strlen(spec) - 1] = '\0';
+    TEST_EQ(rule_init(&t, spec), 0);
+    TEST_EQ(t.entry[0].lo, 1000);
+}
+
+/** <!-- test_rate {{{1 -->
+ * @brief change per minute, at most RULE_RATE_MAX streams
+ * @return nothing
+ */
+static void test_rate(void)
+{
+    TEST_EQ(rule_init(&t, "temperature~5"), 0);
+    TEST_EQ(t.entry[0].rate, 500);
+    TEST_EQ(t.entry[0].slot, 0);
+    TEST_EQ(lane(TEST_SID, 0, 2000, 3000), RULE_LANE_BULK);
+    TEST_EQ(lane(TEST_SID, 60000, 2500, 3000), RULE_LANE_BULK);
+    TEST_EQ(lane(TEST_SID, 120000, 3001, 3000), RULE_LANE_ALERT);
+    TEST_EQ(lane(TEST_SID, 150000, 2800, 3000), RULE_LANE_BULK);
+    TEST_EQ(lane(TEST_SID, 180000, 2549, 3000), RULE_LANE_ALERT);
+    // the other device has its own previous value
+    TEST_EQ(lane(TEST_SID + 1, 180000, -2000, 3000), RULE_LANE_BULK);
+    // fractional rate, zero rate alerts on any change
+    TEST_EQ(rule_init(&t, "vdd~0.0105,temperature~0"), 0);
+    TEST_EQ(t.entry[0].rate, 10);
+    TEST_EQ(lane(TEST_SID, 0, 2000, 3000), RULE_LANE_BULK);
+    TEST_EQ(lane(TEST_SID, 60000, 2000, 3010), RULE_LANE_BULK);
+    TEST_EQ(lane(TEST_SID, 120000, 2000, 3021), RULE_LANE_ALERT);
+    TEST_EQ(lane(TEST_SID, 180000, 2001, 3021), RULE_LANE_ALERT);
+    // negative rate is malformed
+    TEST_EQ(rule_init(&t, "temperature~-5"), -1);
+    TEST_EQ(t.num, 0);
+    // RULE_RATE_MAX streams, same stream twice takes one slot
+    TEST_EQ(rule_init(&t, "temperature~1,pressure~1,humidity~1,vdd~1,vdd~2"), 0);
+    TEST_EQ(t.num_rate, RULE_RATE_MAX);
+    TEST_EQ(t.entry[3].slot, 3);
+    TEST_EQ(t.entry[3].rate, 2000);
+    TEST_EQ(rule_init(&t, "temperature~1,pressure~1,humidity~1,vdd~1,adc1~1"), -1);
+    TEST_EQ(t.num + t.num_rate, 0);
+    TEST_EQ(rule_init(&t, "temperature~1,pressure~1,humidity~1,vdd~1,adc1>1"), 0);
+    TEST_EQ(t.num, 5);
+    TEST_EQ(t.entry[4].slot, -1);
+}
+
+/** <!-- test_sid0 {{{1 -->
+ * @brief SID 0 is a device, its entry is not taken as unused
+ * @return nothing
+ */
+static void test_sid0(void)
+{
+    uint32_t sid;
+    uint32_t n;
+    TEST_EQ(rule_init(&t, "temperature~5"), 0);
+    TEST_EQ(lane(0, 0, 2000, 3000), RULE_LANE_BULK);
+    TEST_EQ(lane(0, 60000, 3000, 3000), RULE_LANE_ALERT);
+    TEST_EQ(lane(0, 120000, 3100, 3000), RULE_LANE_BULK);
+    for (n = 0; n < RULE_DEVICE_SIZE; n++) {
+        TEST_CHECK(t.prev[n].sid != 0 || t.prev[n].valid == 0);
+    }
+    // many devices evict the least recently seen, SID 0 is kept while seen
+    for (sid = 1; sid <= 4 * RULE_DEVICE_SIZE; sid++) {
+        lane(sid, 120000 + 2 * sid, 2000, 3000);
+        TEST_EQ(lane(0, 120000 + 2 * sid + 1, 3100, 3000), RULE_LANE_BULK);
+    }
+    TEST_CHECK(t.n_evict > 0);
+    TEST_EQ(lane(0, 240000, 4200, 3000), RULE_LANE_ALERT);
+}
+
+/** <!-- main {{{1 -->
+ * @brief run tests
+ * @return exit status
+ */
+int main(void)
+{
+    test_malformed();
+    test_limit();
+    test_rate();
+    test_sid0();
+    return TEST_END();
+}
+
+// end of file {{{1
+// vim:ft=c:et:nowrap:fdm=marker
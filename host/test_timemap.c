@@ -0,0 +1,194 @@
+/**
+ * Copyright (C) 2017 m2enu
+ *
+ * @file host/test_timemap.c
+ * @brief unit tests of clock mapping and ISO 8601 timestamps
+ * @author m2enu
+ * @date 2026/10/17
+ */
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "timemap.h"
+#include "json.h"
+#include "test.h"
+
+#define TEST_WALL           1800000000000LL //!< wall clock of tests (2027-01-15) [ms]
+#define TEST_SYNC           60000 //!< interval of sync [ms]
+
+static timemap_t m; //!< clock mapping under test
+
+/** <!-- timestamp {{{1 -->
+ * @brief write timestamp without quotes
+ * @param[out] dst timestamp (25 bytes at least)
+ * @param[in] msec time [ms since epoch]
+ * @return dst
+ */
+static const char *timestamp(char *dst, int64_t msec)
+{
+    char buf[32];
+    json_writer_t w;
+    json_init(&w, buf, sizeof(buf));
+    json_timestamp(&w, msec);
+    json_finish(&w);
+    memcpy(dst, &buf[1], 24);
+    dst[24] = '\0';
+    return dst;
+}
+
+/** <!-- test_unsynced {{{1 -->
+ * @brief wall clock before TIMEMAP_VALID is ignored, mapping stays unsynced
+ * @return nothing
+ */
+static void test_unsynced(void)
+{
+    timemap_init(&m);
+    TEST_EQ(m.synced, 0);
+    TEST_EQ(timemap_wall(&m, 12345), 12345);
+    // SNTP not done yet, wall clock counts from epoch
+    TEST_EQ(timemap_sync(&m, 5000, 5000), -1);
+    TEST_EQ(timemap_sync(&m, 5000, TIMEMAP_VALID - 1), -1);
+    TEST_EQ(m.synced, 0);
+    TEST_EQ(m.n_step + m.n_slew, 0);
+    // packet stamped before the first sync gets its time afterwards
+    int64_t stamp = 7000;
+    TEST_EQ(timemap_sync(&m, 10000, TEST_WALL), 1);
+    TEST_EQ(m.synced, 1);
+    TEST_EQ(timemap_wall(&m, stamp), TEST_WALL - 3000);
+    TEST_EQ(timemap_mono(&m, TEST_WALL - 3000), stamp);
+    TEST_EQ(timemap_mono(&m, TEST_WALL - 20000), -10000);
+}
+
+/** <!-- test_step {{{1 -->
+ * @brief errors beyond TIMEMAP_STEP are stepped, up to it slewed
+ * @return nothing
+ */
+static void test_step(void)
+{
+    timemap_init(&m);
+    TEST_EQ(timemap_sync(&m, 0, TEST_WALL), 1);
+    TEST_EQ(m.n_step, 1);
+    // just TIMEMAP_STEP fast, slewed
+    TEST_EQ(timemap_sync(&m, TEST_SYNC, TEST_WALL + TEST_SYNC + TIMEMAP_STEP), 0);
+    TEST_EQ(m.error, TIMEMAP_STEP);
+    TEST_EQ(m.n_slew, 1);
+    TEST_EQ(timemap_wall(&m, TEST_SYNC),
+            TEST_WALL + TEST_SYNC + TIMEMAP_STEP / TIMEMAP_SLEW);
+    // 1 h back (e.g. server corrected), stepped at once
+    timemap_init(&m);
+    timemap_sync(&m, 0, TEST_WALL);
+    TEST_EQ(timemap_sync(&m, TEST_SYNC, TEST_WALL + TEST_SYNC - 3600000), 1);
+    TEST_EQ(m.error, -3600000);
+    TEST_EQ(m.n_step, 2);
+    TEST_EQ(timemap_wall(&m, TEST_SYNC), TEST_WALL + TEST_SYNC - 3600000);
+    // just over TIMEMAP_STEP slow, stepped
+    TEST_EQ(timemap_sync(&m, 2 * TEST_SYNC,
+                         TEST_WALL + 2 * TEST_SYNC - 3600000 - TIMEMAP_STEP - 1), 1);
+    TEST_EQ(timemap_wall(&m, 2 * TEST_SYNC),
+            TEST_WALL + 2 * TEST_SYNC - 3600000 - TIMEMAP_STEP - 1);
+    TEST_EQ(m.last, 2 * TEST_SYNC);
+}
+
+/** <!-- test_slew {{{1 -->
+ * @brief small error converges by syncs, never stepped
+ * @return nothing
+ */
+static void test_slew(void)
+{
+    int64_t mono = 0;
+    int64_t err = 800;
+    uint32_t n;
+    timemap_init(&m);
+    timemap_sync(&m, 0, TEST_WALL);
+    // wall clock found 800 ms behind, e.g. first SNTP reply was late
+    for (n = 1; n <= 30; n++) {
+        mono = n * TEST_SYNC;
+        TEST_EQ(timemap_sync(&m, mono, TEST_WALL + mono - 800), 0);
+        // error shrinks by 1/TIMEMAP_SLEW each sync
+        TEST_CHECK(-m.error <= err);
+        err = -m.error;
+        if (n == 1) {
+            TEST_EQ(m.error, -800);
+            TEST_EQ(timemap_wall(&m, mono), TEST_WALL + mono - 200);
+        }
+    }
+    TEST_EQ(m.n_step, 1);
+    TEST_EQ(m.n_slew, 30);
+    // converged, rest is below TIMEMAP_SLEW by integer division
+    TEST_CHECK(m.error > -TIMEMAP_SLEW);
+    TEST_CHECK(timemap_wall(&m, mono) - (TEST_WALL + mono - 800) < TIMEMAP_SLEW);
+    // jitter around the true time keeps offset within jitter
+    for (n = 31; n <= 100; n++) {
+        mono = n * TEST_SYNC;
+        timemap_sync(&m, mono, TEST_WALL + mono - 800 + ((n % 2) ? 40 : -40));
+        err = timemap_wall(&m, mono) - (TEST_WALL + mono - 800);
+        TEST_CHECK((err >= -40) && (err <= 40));
+    }
+    TEST_EQ(m.n_step, 1);
+}
+
+/** <!-- test_timestamp {{{1 -->
+ * @brief dates of leap years and centuries, milliseconds truncated
+ * @return nothing
+ */
+static void test_timestamp(void)
+{
+    char str[32];
+    char buf[32];
+    json_writer_t w;
+    int64_t msec;
+    TEST_CHECK(!strcmp(timestamp(str, 0), "1970-01-01T00:00:00.000Z"));
+    TEST_CHECK(!strcmp(timestamp(str, 951782400000LL), "2000-02-29T00:00:00.000Z"));
+    TEST_CHECK(!strcmp(timestamp(str, 951868799999LL), "2000-02-29T23:59:59.999Z"));
+    TEST_CHECK(!strcmp(timestamp(str, 951868800000LL), "2000-03-01T00:00:00.000Z"));
+    // 2100 is not a leap year
+    TEST_CHECK(!strcmp(timestamp(str, 4107456000000LL), "2100-02-28T00:00:00.000Z"));
+    TEST_CHECK(!strcmp(timestamp(str, 4107542400000LL), "2100-03-01T00:00:00.000Z"));
+    TEST_CHECK(!strcmp(timestamp(str, TIMEMAP_VALID), "2017-01-01T00:00:00.000Z"));
+    // milliseconds are truncated, never rounded into the next second
+    TEST_CHECK(!strcmp(timestamp(str, 999), "1970-01-01T00:00:00.999Z"));
+    TEST_CHECK(!strcmp(timestamp(str, 1000), "1970-01-01T00:00:01.000Z"));
+    TEST_CHECK(!strcmp(timestamp(str, 1800000059999LL), "2027-01-15T08:00:59.999Z"));
+    TEST_CHECK(!strcmp(timestamp(str, 1800000000001LL), "2027-01-15T08:00:00.001Z"));
+    // before epoch (e.g. stamp before sync mapped back) counts down
+    TEST_CHECK(!strcmp(timestamp(str, -1), "1969-12-31T23:59:59.999Z"));
+    TEST_CHECK(!strcmp(timestamp(str, -86400000), "1969-12-31T00:00:00.000Z"));
+    // quoted for JSON, overflow is reported by writer
+    json_init(&w, buf, sizeof(buf));
+    json_timestamp(&w, 0);
+    TEST_EQ(json_finish(&w), 26);
+    TEST_CHECK(!strcmp(buf, "\"1970-01-01T00:00:00.000Z\""));
+    json_init(&w, buf, 26);
+    json_timestamp(&w, 0);
+    TEST_EQ(json_finish(&w), -1);
+    // same as gmtime() every 7 h 13 min 17.345 s over 200 years
+    for (msec = 0; msec < 6311433600000LL; msec += 25997345) {
+        time_t sec = (time_t)(msec / 1000);
+        struct tm tm;
+        char ref[32];
+        gmtime_r(&sec, &tm);
+        strftime(ref, sizeof(ref), "%Y-%m-%dT%H:%M:%S", &tm);
+        snprintf(&ref[19], sizeof(ref) - 19, ".%03dZ", (int)(msec % 1000));
+        if (strcmp(timestamp(str, msec), ref)) {
+            TEST_CHECK(!strcmp(str, ref));
+            break;
+        }
+    }
+}
+
+/** <!-- main {{{1 -->
+ * @brief run tests
+ * @return exit status
+ */
+int main(void)
+{
+    test_unsynced();
+    test_step();
+    test_slew();
+    test_timestamp();
+    return TEST_END();
+}
+
+// end of file {{{1
+// vim:ft=c:et:nowrap:fdm=marker
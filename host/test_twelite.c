@@ -0,0 +1,374 @@
+/**
+ * Copyright (C) 2017 m2enu
+ *
+ * @file host/test_twelite.c
+ * @brief unit tests of TWE-LITE app_tag and binary parsers
+ *
+ * Frames are composed here from field positions of the app_tag format,
+ * independently of the descriptor tables of twelite.c, so that a wrong
+ * position, length or destination of any field is detected.
+ * @author m2enu
+ * @date 2026/10/17
+ */
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "twelite.h"
+#include "framer.h"
+#include "test.h"
+
+#define FRAME_LEN_BME280    59 //!< ':' + 28 bytes + checksum
+#define FRAME_LEN_SHT21     47 //!< ':' + 22 bytes + checksum
+#define FRAME_LEN_ADXL34X   51 //!< ':' + 24 bytes + checksum
+#define FRAME_LEN_ANALOG    39 //!< ':' + 18 bytes + checksum
+
+/** <!-- test_field_t {{{1 -->
+ * @brief expected position and destination of one field
+ */
+typedef struct test_field_t_tag {
+    const char *name; //!< name of member
+    uint8_t pos; //!< position in app_tag string
+    uint8_t len; //!< number of hex characters
+    uint8_t offset; //!< offset of member in twelite_packet_t
+    uint8_t size; //!< size of member [byte]
+    uint32_t raw; //!< value written to frame
+    uint32_t expect; //!< value expected in member
+} test_field_t;
+
+#define TEST_FIELD(member, pos, len, raw, expect) { \
+    #member, (pos), (len), offsetof(twelite_packet_t, member), \
+    sizeof(((twelite_packet_t *)0)->member), (raw), (expect) \
+}
+
+/** <!-- test_header {{{1 -->
+ * @brief header fields of every sensor
+ */
+static const test_field_t test_header[] = {
+    TEST_FIELD(sid_router,    1, 8, 0x81234567, 0x81234567),
+    TEST_FIELD(lqi,           9, 2, 0xa5, 0xa5),
+    TEST_FIELD(next_number,  11, 4, 0xbeef, 0xbeef),
+    TEST_FIELD(sid_enddevice, 15, 8, 0x8abcdef0, 0x8abcdef0),
+    TEST_FIELD(id_enddevice, 23, 2, 0x7e, 0x7e),
+    TEST_FIELD(mvolt_vdd,    27, 2, 0xa0, 1950 + 0xa0 * 5),
+    TEST_FIELD(mvolt_adc1,   29, 4, 0x0c80, 0x0c80),
+    TEST_FIELD(mvolt_adc2,   33, 4, 0x0123, 0x0123),
+};
+
+/** <!-- test_bme280 {{{1 -->
+ * @brief payload fields of BME280
+ */
+static const test_field_t test_bme280[] = {
+    TEST_FIELD(pkt_bme280.id_sensor,     37, 4, 0x1234, 0x1234),
+    TEST_FIELD(pkt_bme280.i_temperature, 41, 4, 0x0a8c, 0x0a8c),
+    TEST_FIELD(pkt_bme280.i_humidity,    45, 4, 0x1388, 0x1388),
+    TEST_FIELD(pkt_bme280.i_pressure,    49, 8, 0x00018a92, 0x00018a92),
+};
+
+/** <!-- test_sht21 {{{1 -->
+ * @brief payload fields of SHT21
+ */
+static const test_field_t test_sht21[] = {
+    TEST_FIELD(pkt_sht21.i_temperature, 37, 4, 0xfc18, 0xfc18),
+    TEST_FIELD(pkt_sht21.i_humidity,    41, 4, 0x2710, 0x2710),
+};
+
+/** <!-- test_adxl34x {{{1 -->
+ * @brief payload fields of ADXL34x
+ */
+static const test_field_t test_adxl34x[] = {
+    TEST_FIELD(pkt_adxl34x.accel_x, 37, 4, 0x03e8, 0x03e8),
+    TEST_FIELD(pkt_adxl34x.accel_y, 41, 4, 0xfc18, 0xfc18),
+    TEST_FIELD(pkt_adxl34x.accel_z, 45, 4, 0x0064, 0x0064),
+};
+
+static char frame[TWELITE_PACKET_LENGTH_MAX + 8]; //!< frame under test
+
+/** <!-- frame_set {{{1 -->
+ * @brief write hexadecimal field into frame
+ * @param[in] pos position of field
+ * @param[in] len number of hex characters
+ * @param[in] val value
+ * @return nothing
+ */
+static void frame_set(int32_t pos, int32_t len, uint32_t val)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    int32_t i;
+    for (i = 0; i < len; i++) {
+        frame[pos + len - 1 - i] = hex[(val >> (i * 4)) & 0x0f];
+    }
+}
+
+/** <!-- frame_init {{{1 -->
+ * @brief start frame of sensor with every other field zero
+ * @param[in] len length of frame
+ * @param[in] id_sensor id_sensor
+ * @return nothing
+ */
+static void frame_init(int32_t len, uint8_t id_sensor)
+{
+    frame[0] = ':';
+    memset(&frame[1], '0', len - 1);
+    frame[len] = '\0';
+    frame_set(25, 2, id_sensor);
+}
+
+/** <!-- frame_seal {{{1 -->
+ * @brief write checksum (two's complement of the sum of bytes)
+ * @param[in] len length of frame
+ * @return nothing
+ */
+static void frame_seal(int32_t len)
+{
+    uint8_t sum = 0;
+    int32_t i;
+    for (i = 1; i < len - 2; i += 2) {
+        sum += (uint8_t)strtoul((char[3]){frame[i], frame[i + 1], '\0'}, NULL, 16);
+    }
+    frame_set(len - 2, 2, (uint8_t)(0 - sum));
+}
+
+/** <!-- field_get {{{1 -->
+ * @brief read member of packet
+ * @param[in] pkt TWE-LITE packet
+ * @param[in] f field
+ * @return value of member
+ */
+static uint32_t field_get(const twelite_packet_t *pkt, const test_field_t *f)
+{
+    const uint8_t *src = (const uint8_t *)pkt + f->offset;
+    switch (f->size) {
+    case 1: return *(const uint8_t *)src;
+    case 2: return *(const uint16_t *)src;
+    default: return *(const uint32_t *)src;
+    }
+}
+
+/** <!-- test_fields {{{1 -->
+ * @brief set each field alone, and check it lands in its member only
+ * @param[in] len length of frame
+ * @param[in] id_sensor id_sensor
+ * @param[in] type expected payload type
+ * @param[in] fld fields
+ * @param[in] num number of fields
+ * @return nothing
+ */
+static void test_fields(int32_t len, uint8_t id_sensor, uint8_t type,
+                        const test_field_t *fld, uint32_t num)
+{
+    twelite_packet_t ref;
+    twelite_packet_t pkt;
+    uint32_t i;
+    uint32_t k;
+    frame_init(len, id_sensor);
+    frame_seal(len);
+    TEST_EQ(twelite_parse_packet(&ref, frame, len), TWELITE_OK);
+    TEST_EQ(ref.type, type);
+    TEST_EQ(ref.id_sensor, id_sensor);
+    for (i = 0; i < num; i++) {
+        frame_init(len, id_sensor);
+        frame_set(fld[i].pos, fld[i].len, fld[i].raw);
+        frame_seal(len);
+        memset(&pkt, 0x5a, sizeof(pkt));
+        if (twelite_parse_packet(&pkt, frame, len) != TWELITE_OK) {
+            fprintf(stderr, "%s: parse failed\n", fld[i].name);
+            TEST_CHECK(0);
+            continue;
+        }
+        TEST_EQ(pkt.ok, 1);
+        TEST_EQ(field_get(&pkt, &fld[i]), fld[i].expect);
+        for (k = 0; k < num; k++) {
+            if ((k != i) && (field_get(&pkt, &fld[k]) != field_get(&ref, &fld[k]))) {
+                fprintf(stderr, "%s leaks into %s\n", fld[i].name, fld[k].name);
+                TEST_CHECK(0);
+            }
+        }
+    }
+}
+
+/** <!-- test_header_fields {{{1 -->
+ * @brief header fields of every sensor
+ * @return nothing
+ */
+static void test_header_fields(void)
+{
+    test_fields(FRAME_LEN_BME280, TWELITE_ID_BME280, TWELITE_SENSOR_BME280,
+                test_header, sizeof(test_header) / sizeof(test_header[0]));
+    test_fields(FRAME_LEN_ANALOG, TWELITE_ID_ANALOG, TWELITE_SENSOR_ANALOG,
+                test_header, sizeof(test_header) / sizeof(test_header[0]));
+}
+
+/** <!-- test_payload_fields {{{1 -->
+ * @brief payload fields and derived values of each sensor
+ * @return nothing
+ */
+static void test_payload_fields(void)
+{
+    twelite_packet_t pkt;
+    test_fields(FRAME_LEN_BME280, TWELITE_ID_BME280, TWELITE_SENSOR_BME280,
+                test_bme280, sizeof(test_bme280) / sizeof(test_bme280[0]));
+    test_fields(FRAME_LEN_SHT21, TWELITE_ID_SHT21, TWELITE_SENSOR_SHT21,
+                test_sht21, sizeof(test_sht21) / sizeof(test_sht21[0]));
+    test_fields(FRAME_LEN_ADXL34X, TWELITE_ID_ADXL34X, TWELITE_SENSOR_ADXL34X,
+                test_adxl34x, sizeof(test_adxl34x) / sizeof(test_adxl34x[0]));
+
+    // BME280 float values, also for id_sensor not registered
+    frame_init(FRAME_LEN_BME280, 0x77);
+    frame_set(41, 4, 0xfc18); // -10.00 degC
+    frame_set(45, 4, 5025); // 50.25 %
+    frame_set(49, 8, 101325);
+    frame_seal(FRAME_LEN_BME280);
+    TEST_EQ(twelite_parse_packet(&pkt, frame, FRAME_LEN_BME280), TWELITE_OK);
+    TEST_EQ(pkt.type, TWELITE_SENSOR_BME280);
+    TEST_CHECK(pkt.pkt_bme280.temperature == (float)-10.0);
+    TEST_CHECK(pkt.pkt_bme280.humidity == (float)50.25);
+    TEST_CHECK(pkt.pkt_bme280.pressure == (float)101325.0);
+
+    // LM61 temperature from ADC1 (10 mV/degC, 600 mV at 0 degC)
+    frame_init(FRAME_LEN_ANALOG, TWELITE_ID_LM61);
+    frame_set(29, 4, 850);
+    frame_seal(FRAME_LEN_ANALOG);
+    TEST_EQ(twelite_parse_packet(&pkt, frame, FRAME_LEN_ANALOG), TWELITE_OK);
+    TEST_EQ(pkt.type, TWELITE_SENSOR_LM61);
+    TEST_EQ(pkt.pkt_lm61.i_temperature, 2500);
+
+    // supply voltage on both slopes
+    frame_init(FRAME_LEN_ANALOG, TWELITE_ID_ANALOG);
+    frame_set(27, 2, 170);
+    frame_seal(FRAME_LEN_ANALOG);
+    twelite_parse_packet(&pkt, frame, FRAME_LEN_ANALOG);
+    TEST_EQ(pkt.mvolt_vdd, 2800);
+    frame_set(27, 2, 255);
+    frame_seal(FRAME_LEN_ANALOG);
+    twelite_parse_packet(&pkt, frame, FRAME_LEN_ANALOG);
+    TEST_EQ(pkt.mvolt_vdd, 3650);
+}
+
+/** <!-- test_errors {{{1 -->
+ * @brief rejected frames and statistics by cause
+ * @return nothing
+ */
+static void test_errors(void)
+{
+    twelite_stats_t st;
+    twelite_packet_t pkt;
+    int32_t len = FRAME_LEN_BME280;
+    memset(&st, 0, sizeof(st));
+
+    frame_init(len, TWELITE_ID_BME280);
+    frame_seal(len);
+    twelite_stats_count(&st, twelite_parse_packet(&pkt, frame, len));
+    TEST_EQ(pkt.ok, 1);
+
+    // length: too short, too long and even
+    TEST_EQ(twelite_parse_packet(&pkt, frame, TWELITE_PACKET_LENGTH_MIN - 2),
+            TWELITE_ERR_LENGTH);
+    TEST_EQ(twelite_parse_packet(&pkt, frame, TWELITE_PACKET_LENGTH_MAX + 2),
+            TWELITE_ERR_LENGTH);
+    twelite_stats_count(&st, twelite_parse_packet(&pkt, frame, len - 1));
+    TEST_EQ(pkt.ok, 0);
+
+    // non-hexadecimal character in field, in trailing byte and in checksum
+    frame[12] = 'G';
+    twelite_stats_count(&st, twelite_parse_packet(&pkt, frame, len));
+    frame_init(len, TWELITE_ID_BME280);
+    frame_seal(len);
+    frame[len - 1] = 'x';
+    TEST_EQ(twelite_parse_packet(&pkt, frame, len), TWELITE_ERR_HEX);
+
+    // lower case is hexadecimal
+    frame_init(len, TWELITE_ID_BME280);
+    frame_set(1, 8, 0x8abcdef0);
+    frame_seal(len);
+    frame[2] = 'a';
+    frame[3] = 'b';
+    TEST_EQ(twelite_parse_packet(&pkt, frame, len), TWELITE_OK);
+
+    // checksum
+    frame[len - 1] = (frame[len - 1] == '0') ? '1' : '0';
+    twelite_stats_count(&st, twelite_parse_packet(&pkt, frame, len));
+    TEST_CHECK(pkt.checksum != pkt.checksum_calc);
+    TEST_EQ(pkt.ok, 0);
+
+    TEST_EQ(st.n_ok, 1);
+    TEST_EQ(st.n_length, 1);
+    TEST_EQ(st.n_hex, 1);
+    TEST_EQ(st.n_checksum, 1);
+}
+
+/** <!-- test_roundtrip {{{1 -->
+ * @brief random frames re-encoded by builders parse to the same packet
+ * @return nothing
+ */
+static void test_roundtrip(void)
+{
+    static const uint8_t ids[] = {
+        TWELITE_ID_BME280, TWELITE_ID_SHT21, TWELITE_ID_ADXL34X,
+        TWELITE_ID_ANALOG, TWELITE_ID_LM61, 0x00,
+    };
+    static const int32_t lens[] = {
+        FRAME_LEN_BME280, FRAME_LEN_SHT21, FRAME_LEN_ADXL34X,
+        FRAME_LEN_ANALOG, FRAME_LEN_ANALOG, FRAME_LEN_BME280,
+    };
+    char str[TWELITE_PACKET_LENGTH_MAX + 5];
+    char bin[TWELITE_FRAME_LENGTH_MAX];
+    twelite_packet_t a;
+    twelite_packet_t b;
+    uint32_t n;
+    uint32_t bad = 0;
+    srand(1);
+    for (n = 0; n < 10000; n++) {
+        uint32_t k = n % (sizeof(ids) / sizeof(ids[0]));
+        int32_t i;
+        frame_init(lens[k], ids[k]);
+        for (i = 1; i < lens[k] - 2; i++) {
+            if ((i < 25) || (i > 26)) {
+                frame_set(i, 1, rand());
+            }
+        }
+        frame_seal(lens[k]);
+        memset(&a, 0, sizeof(a));
+        if (twelite_parse_packet(&a, frame, lens[k]) != TWELITE_OK) {
+            bad++;
+            continue;
+        }
+        int32_t len = twelite_build_packet(str, sizeof(str), &a);
+        memset(&b, 0, sizeof(b));
+        if ((len < 2) || (twelite_parse_packet(&b, str, len - 2) != TWELITE_OK) ||
+            (b.sid_router != a.sid_router) || (b.lqi != a.lqi) ||
+            (b.next_number != a.next_number) ||
+            (b.sid_enddevice != a.sid_enddevice) ||
+            (b.mvolt_vdd != a.mvolt_vdd) || (b.mvolt_adc1 != a.mvolt_adc1) ||
+            (b.mvolt_adc2 != a.mvolt_adc2) || (b.type != a.type) ||
+            (memcmp(&b.pkt_raw, &a.pkt_raw, sizeof(a.pkt_raw)) != 0)) {
+            bad++;
+            continue;
+        }
+        len = twelite_build_binary(bin, sizeof(bin), &a);
+        memset(&b, 0, sizeof(b));
+        if ((len < 0) || (twelite_parse_binary(&b, bin, len) != TWELITE_OK) ||
+            (b.sid_enddevice != a.sid_enddevice) || (b.mvolt_vdd != a.mvolt_vdd) ||
+            (memcmp(&b.pkt_raw, &a.pkt_raw, sizeof(a.pkt_raw)) != 0)) {
+            bad++;
+        }
+    }
+    TEST_EQ(bad, 0);
+}
+
+/** <!-- main {{{1 -->
+ * @brief run tests
+ * @return exit status
+ */
+int main(void)
+{
+    test_header_fields();
+    test_payload_fields();
+    test_errors();
+    test_roundtrip();
+    return TEST_END();
+}
+
+// end of file {{{1
+// vim:ft=c:et:nowrap:fdm=marker
@@ -0,0 +1,255 @@
+/**
+ * Copyright (C) 2017 m2enu
+ *
+ * @file main/aggr.c
+ * @brief windowed aggregation of sensor streams per end device
+ * @author m2enu
+ * @date 2026/10/16
+ */
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "aggr.h"
+#include "json.h"
+
+/** <!-- aggr_init {{{1 -->
+ * @brief initialise aggregation table
+ * @param[out] a aggregation table
+ * @param[in] window length of window [ms] (0: pass-through)
+ * @return nothing
+ */
+void aggr_init(aggr_t *a, int64_t window)
+{
+    memset(a, 0, sizeof(aggr_t));
+    a->window = window;
+}
+
+/** <!-- aggr_add {{{1 -->
+ * @brief add packet to the window of its end device
+ * @param[in,out] a aggregation table
+ * @param[in] pkt TWE-LITE packet (timestamp must be set)
+ * @return result of add
+ * @retval Zero: Success
+ * @retval +ve_value: pass-through, packet is not aggregated
+ * @retval -ve_value: table full, packet is not aggregated
+ */
+int8_t aggr_add(aggr_t *a, const twelite_packet_t *pkt)
+{
+    int32_t val[AGGR_STREAM_NUM];
+    uint32_t d, s;
+    if (a->window <= 0) {
+        return 1;
+    }
+    for (s = 0; s < AGGR_STREAM_NUM; s++) {
+        if (twelite_stream_value(pkt, s, &val[s]) < 0) {
+            return 1; // not all of streams provided by sensor
+        }
+    }
+    for (d = 0; d < a->num; d++) {
+        if (a->sid[d] == pkt->sid_enddevice) {
+            break;
+        }
+    }
+    if (d == a->num) {
+        // open new window
+        if (a->num >= AGGR_DEVICE_MAX) {
+            a->n_full++;
+            return -1;
+        }
+        a->num++;
+        a->sid[d] = pkt->sid_enddevice;
+        a->start[d] = pkt->timestamp;
+        a->count[d] = 0;
+        for (s = 0; s < AGGR_STREAM_NUM; s++) {
+            a->min[s][d] = val[s];
+            a->max[s][d] = val[s];
+            a->sum[s][d] = 0;
+        }
+    }
+    a->count[d]++;
+    for (s = 0; s < AGGR_STREAM_NUM; s++) {
+        if (val[s] < a->min[s][d]) {
+            a->min[s][d] = val[s];
+        }
+        if (val[s] > a->max[s][d]) {
+            a->max[s][d] = val[s];
+        }
+        a->last[s][d] = val[s];
+        a->sum[s][d] += val[s];
+    }
+    a->n_sample++;
+    return 0;
+}
+
+/** <!-- aggr_mean {{{1 -->
+ * @brief rounded mean
+ * @param[in] sum sum of values
+ * @param[in] count number of values
+ * @return mean value
+ */
+static int32_t aggr_mean(int64_t sum, uint32_t count)
+{
+    int64_t half = count / 2;
+    return (int32_t)((sum < 0) ? (sum - half) / count : (sum + half) / count);
+}
+
+/** <!-- aggr_flush {{{1 -->
+ * @brief emit and remove windows which are closed
+ * @param[in,out] a aggregation table
+ * @param[in] now current time [ms, monotonic] (INT64_MAX: all windows)
+ * @param[out] dst summaries
+ * @param[in] max_num max. number of summaries
+ * @return number of summaries
+ */
+uint32_t aggr_flush(aggr_t *a, int64_t now, aggr_summary_t *dst,
+                    uint32_t max_num)
+{
+    uint32_t num = 0;
+    uint32_t d = 0;
+    uint32_t s;
+    while ((d < a->num) && (num < max_num)) {
+        if ((now != INT64_MAX) && (now - a->start[d] < a->window)) {
+            d++;
+            continue;
+        }
+        aggr_summary_t *sum = &dst[num++];
+        sum->sid = a->sid[d];
+        sum->timestamp = a->start[d];
+        sum->count = a->count[d];
+        for (s = 0; s < AGGR_STREAM_NUM; s++) {
+            sum->min[s] = a->min[s][d];
+            sum->max[s] = a->max[s][d];
+            sum->mean[s] = aggr_mean(a->sum[s][d], a->count[d]);
+            sum->last[s] = a->last[s][d];
+        }
+        // keep table dense: move the last entry into this one
+        uint32_t l = --a->num;
+        a->sid[d] = a->sid[l];
+        a->start[d] = a->start[l];
+        a->count[d] = a->count[l];
+        for (s = 0; s < AGGR_STREAM_NUM; s++) {
+            a->min[s][d] = a->min[s][l];
+            a->max[s][d] = a->max[s][l];
+            a->last[s][d] = a->last[s][l];
+            a->sum[s][d] = a->sum[s][l];
+        }
+    }
+    a->n_summary += num;
+    return num;
+}
+
+/** <!-- aggr_wait {{{1 -->
+ * @brief time until the next window closes
+ * @param[in] a aggregation table
+ * @param[in] now current time [ms, monotonic]
+ * @return time to wait [ms] (-1: table is empty)
+ */
+int64_t aggr_wait(const aggr_t *a, int64_t now)
+{
+    int64_t wait = -1;
+    uint32_t d;
+    for (d = 0; d < a->num; d++) {
+        int64_t w = a->start[d] + a->window - now;
+        if (w < 0) {
+            w = 0;
+        }
+        if ((wait < 0) || (w < wait)) {
+            wait = w;
+        }
+    }
+    return wait;
+}
+
+/** <!-- aggr_packet {{{1 -->
+ * @brief convert summary to packet of mean values (e.g. to journal)
+ * @param[out] pkt TWE-LITE packet
+ * @param[in] s summary
+ * @return nothing
+ */
+void aggr_packet(twelite_packet_t *pkt, const aggr_summary_t *s)
+{
+    memset(pkt, 0, sizeof(twelite_packet_t));
+    pkt->ok = 1;
+    pkt->type = TWELITE_SENSOR_BME280;
+    pkt->id_sensor = TWELITE_ID_BME280;
+    pkt->sid_enddevice = s->sid;
+    pkt->timestamp = s->timestamp;
+    pkt->pkt_bme280.i_temperature = s->mean[AGGR_TEMPERATURE];
+    pkt->pkt_bme280.i_pressure = s->mean[AGGR_PRESSURE];
+    pkt->pkt_bme280.i_humidity = s->mean[AGGR_HUMIDITY];
+    pkt->mvolt_vdd = s->mean[AGGR_VDD];
+}
+
+/** <!-- aggr_json_stream {{{1 -->
+ * @brief write one M2X stream of summaries
+ * @param[in,out] w JSON writer
+ * @param[in] s summaries
+ * @param[in] num number of summaries
+ * @param[in] stream aggregated stream
+ * @param[in] suffix suffix of M2X stream
+ * @param[in] field offset of statistic in aggr_summary_t
+ * @param[in] clock clock mapping of timestamps
+ * @return nothing
+ */
+static void aggr_json_stream(json_writer_t *w, const aggr_summary_t *s,
+                             uint32_t num, uint32_t stream,
+                             const char *suffix, size_t field,
+                             const timemap_t *clock)
+{
+    uint32_t n;
+    json_raw(w, "\"", 1);
+    json_puts(w, twelite_streams[stream].name);
+    json_puts(w, suffix);
+    json_raw(w, "\":[", 3);
+    for (n = 0; n < num; n++) {
+        const int32_t *val = (const int32_t *)((const uint8_t *)&s[n] + field);
+        json_raw(w, (n > 0) ? ",{\"timestamp\":" : "{\"timestamp\":",
+                 (n > 0) ? 14 : 13);
+        json_timestamp(w, timemap_wall(clock, s[n].timestamp));
+        json_raw(w, ",\"value\":", 9);
+        json_fixed(w, val[stream], twelite_streams[stream].frac);
+        json_raw(w, "}", 1);
+    }
+    json_raw(w, "]", 1);
+}
+
+/** <!-- aggr_json {{{1 -->
+ * @brief create M2X /updates json message from summaries
+ *
+ * The mean goes to the raw stream name (e.g. "temperature"), min. and
+ * max. to streams with "_min" and "_max" suffix.
+ * @param[out] dst json string
+ * @param[in] size size of dst
+ * @param[in] s summaries
+ * @param[in] num number of summaries
+ * @param[in] clock clock mapping of timestamps
+ * @return length of json string
+ * @retval -ve_value: dst is too small
+ */
+int32_t aggr_json(char *dst, int32_t size, const aggr_summary_t *s,
+                  uint32_t num, const timemap_t *clock)
+{
+    json_writer_t w;
+    uint32_t i;
+    json_init(&w, dst, size);
+    json_raw(&w, "{\"values\":{", 11);
+    for (i = 0; i < AGGR_STREAM_NUM; i++) {
+        if (i > 0) {
+            json_raw(&w, ",", 1);
+        }
+        aggr_json_stream(&w, s, num, i, "",
+                         offsetof(aggr_summary_t, mean), clock);
+        json_raw(&w, ",", 1);
+        aggr_json_stream(&w, s, num, i, "_min",
+                         offsetof(aggr_summary_t, min), clock);
+        json_raw(&w, ",", 1);
+        aggr_json_stream(&w, s, num, i, "_max",
+                         offsetof(aggr_summary_t, max), clock);
+    }
+    json_raw(&w, "}}", 2);
+    return json_finish(&w);
+}
+
+// end of file {{{1
+// vim:ft=c:et:nowrap:fdm=marker
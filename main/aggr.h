@@ -0,0 +1,129 @@
+/**
+ * Copyright (C) 2017 m2enu
+ *
+ * @file main/aggr.h
+ * @brief windowed aggregation of sensor streams per end device
+ * @author m2enu
+ * @date 2026/10/16
+ */
+#ifndef AGGR_H
+#define AGGR_H
+
+#include <stdint.h>
+
+#include "timemap.h"
+#include "twelite.h"
+
+#define AGGR_DEVICE_MAX 16 //!< max. number of end devices in one window
+
+/** <!-- aggr_stream_t {{{1 -->
+ * @brief aggregated sensor streams (the first of twelite_stream_t)
+ */
+typedef enum aggr_stream_t_tag {
+    AGGR_TEMPERATURE = TWELITE_STREAM_TEMPERATURE, //!< temperature [x100 degC]
+    AGGR_PRESSURE = TWELITE_STREAM_PRESSURE, //!< pressure [Pa]
+    AGGR_HUMIDITY = TWELITE_STREAM_HUMIDITY, //!< humidity [x100 %]
+    AGGR_VDD = TWELITE_STREAM_VDD, //!< power supply voltage [mV]
+    AGGR_STREAM_NUM,
+} aggr_stream_t;
+
+/** <!-- aggr_t {{{1 -->
+ * @brief incremental statistics of the current window (struct of arrays)
+ *
+ * Statistics are indexed by [stream][device], so the lookup of sid and
+ * the update of one stream touch contiguous memory only.
+ */
+typedef struct aggr_t_tag {
+    uint32_t sid[AGGR_DEVICE_MAX]; //!< SID of end device
+    int64_t start[AGGR_DEVICE_MAX]; //!< receive time of the first sample [ms]
+    uint32_t count[AGGR_DEVICE_MAX]; //!< number of samples
+    int32_t min[AGGR_STREAM_NUM][AGGR_DEVICE_MAX]; //!< min. value
+    int32_t max[AGGR_STREAM_NUM][AGGR_DEVICE_MAX]; //!< max. value
+    int32_t last[AGGR_STREAM_NUM][AGGR_DEVICE_MAX]; //!< the latest value
+    int64_t sum[AGGR_STREAM_NUM][AGGR_DEVICE_MAX]; //!< sum of values
+    uint32_t num; //!< number of end devices in table
+    int64_t window; //!< length of window [ms] (0: pass-through)
+    uint32_t n_sample; //!< number of aggregated samples
+    uint32_t n_summary; //!< number of emitted summaries
+    uint32_t n_full; //!< number of samples rejected by full table
+} aggr_t;
+
+/** <!-- aggr_summary_t {{{1 -->
+ * @brief summary of one end device over one window
+ */
+typedef struct aggr_summary_t_tag {
+    uint32_t sid; //!< SID of end device
+    int64_t timestamp; //!< receive time of the first sample [ms]
+    uint32_t count; //!< number of samples
+    int32_t min[AGGR_STREAM_NUM]; //!< min. value
+    int32_t max[AGGR_STREAM_NUM]; //!< max. value
+    int32_t mean[AGGR_STREAM_NUM]; //!< mean value (rounded)
+    int32_t last[AGGR_STREAM_NUM]; //!< the latest value
+} aggr_summary_t;
+
+/** <!-- aggr_init {{{1 -->
+ * @brief initialise aggregation table
+ * @param[out] a aggregation table
+ * @param[in] window length of window [ms] (0: pass-through)
+ * @return nothing
+ */
+void aggr_init(aggr_t *a, int64_t window);
+
+/** <!-- aggr_add {{{1 -->
+ * @brief add packet to the window of its end device
+ * @param[in,out] a aggregation table
+ * @param[in] pkt TWE-LITE packet (timestamp must be set)
+ * @return result of add
+ * @retval Zero: Success
+ * @retval +ve_value: pass-through (or sensor without all of aggr_stream_t)
+ * @retval -ve_value: table full, packet is not aggregated
+ */
+int8_t aggr_add(aggr_t *a, const twelite_packet_t *pkt);
+
+/** <!-- aggr_flush {{{1 -->
+ * @brief emit and remove windows which are closed
+ * @param[in,out] a aggregation table
+ * @param[in] now current time [ms, monotonic] (INT64_MAX: all windows)
+ * @param[out] dst summaries
+ * @param[in] max_num max. number of summaries
+ * @return number of summaries
+ */
+uint32_t aggr_flush(aggr_t *a, int64_t now, aggr_summary_t *dst,
+                    uint32_t max_num);
+
+/** <!-- aggr_wait {{{1 -->
+ * @brief time until the next window closes
+ * @param[in] a aggregation table
+ * @param[in] now current time [ms, monotonic]
+ * @return time to wait [ms] (-1: table is empty)
+ */
+int64_t aggr_wait(const aggr_t *a, int64_t now);
+
+/** <!-- aggr_packet {{{1 -->
+ * @brief convert summary to packet of mean values (e.g. to journal)
+ * @param[out] pkt TWE-LITE packet
+ * @param[in] s summary
+ * @return nothing
+ */
+void aggr_packet(twelite_packet_t *pkt, const aggr_summary_t *s);
+
+/** <!-- aggr_json {{{1 -->
+ * @brief create M2X /updates json message from summaries
+ *
+ * The mean goes to the raw stream name (e.g. "temperature"), min. and
+ * max. to streams with "_min" and "_max" suffix.
+ * @param[out] dst json string
+ * @param[in] size size of dst
+ * @param[in] s summaries
+ * @param[in] num number of summaries
+ * @param[in] clock clock mapping of timestamps
+ * @return length of json string
+ * @retval -ve_value: dst is too small
+ */
+int32_t aggr_json(char *dst, int32_t size, const aggr_summary_t *s,
+                  uint32_t num, const timemap_t *clock);
+
+#endif // AGGR_H
+
+// end of file {{{1
+// vim:ft=c:et:nowrap:fdm=marker
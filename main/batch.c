@@ -0,0 +1,176 @@
+/**
+ * Copyright (C) 2017 m2enu
+ *
+ * @file main/batch.c
+ * @brief AT&T M2X batched multi-timestamp uploader
+ * @author m2enu
+ * @date 2026/10/16
+ */
+#include <stdint.h>
+#include <string.h>
+
+#include "batch.h"
+#include "json.h"
+
+/** <!-- m2x_batch_init {{{1 -->
+ * @brief initialise batch
+ * @param[out] b batch
+ * @param[in] max_num flush when number of packets reaches this
+ * @param[in] max_age flush when the oldest packet is older than this [ms]
+ * @param[in] pressure flush when queued packets reach this
+ * @param[in] clock clock mapping of timestamps
+ * @return nothing
+ */
+void m2x_batch_init(m2x_batch_t *b, uint32_t max_num, int64_t max_age,
+                    uint32_t pressure, const timemap_t *clock)
+{
+    if ((max_num == 0) || (max_num > M2X_BATCH_MAX)) {
+        max_num = M2X_BATCH_MAX;
+    }
+    b->num      = 0;
+    b->max_num  = max_num;
+    b->max_age  = max_age;
+    b->pressure = pressure;
+    b->clock    = clock;
+    memset(b->n_flush, 0, sizeof(b->n_flush));
+}
+
+/** <!-- m2x_batch_add {{{1 -->
+ * @brief add packet to batch
+ *
+ * A relayed copy of a batched reading (same end device and next_number)
+ * replaces it when its LQI is higher, and is discarded otherwise. A
+ * higher-LQI copy (better) of a reading no longer batched is discarded,
+ * as the reading itself is already posted.
+ * @param[in,out] b batch
+ * @param[in] pkt TWE-LITE packet (timestamp must be set)
+ * @return result of add
+ * @retval Zero: Success
+ * @retval +ve_value: merged with a batched copy of the same reading
+ * @retval -ve_value: batch full
+ */
+int8_t m2x_batch_add(m2x_batch_t *b, const twelite_packet_t *pkt)
+{
+    uint32_t n;
+    for (n = 0; n < b->num; n++) {
+        twelite_packet_t *p = &b->pkt[n];
+        if ((p->sid_enddevice == pkt->sid_enddevice) &&
+            (p->next_number == pkt->next_number)) {
+            if (pkt->lqi > p->lqi) {
+                *p = *pkt;
+            }
+            return 1;
+        }
+    }
+    if (pkt->better) {
+        return 1;
+    }
+    if (b->num >= b->max_num) {
+        return -1;
+    }
+    b->pkt[b->num++] = *pkt;
+    return 0;
+}
+
+/** <!-- m2x_batch_due {{{1 -->
+ * @brief check whether batch should be flushed
+ * @param[in,out] b batch
+ * @param[in] now current time [ms, monotonic]
+ * @param[in] queued number of packets waiting in packet queue
+ * @return reason of flush (M2X_BATCH_NONE: not due)
+ */
+m2x_batch_reason_t m2x_batch_due(m2x_batch_t *b, int64_t now,
+                                 uint32_t queued)
+{
+    m2x_batch_reason_t ret = M2X_BATCH_NONE;
+    if (b->num == 0) {
+        return ret;
+    }
+    if (b->num >= b->max_num) {
+        ret = M2X_BATCH_SIZE;
+    } else if (m2x_batch_wait(b, now) == 0) {
+        ret = M2X_BATCH_AGE;
+    } else if ((b->pressure > 0) && (queued >= b->pressure)) {
+        ret = M2X_BATCH_PRESSURE;
+    }
+    if (ret != M2X_BATCH_NONE) {
+        b->n_flush[ret]++;
+    }
+    return ret;
+}
+
+/** <!-- m2x_batch_wait {{{1 -->
+ * @brief time until batch becomes due by age
+ * @param[in] b batch
+ * @param[in] now current time [ms, monotonic]
+ * @return time to wait [ms] (-1: batch is empty)
+ */
+int64_t m2x_batch_wait(const m2x_batch_t *b, int64_t now)
+{
+    if (b->num == 0) {
+        return -1;
+    }
+    int64_t wait = b->pkt[0].timestamp + b->max_age - now;
+    return (wait < 0) ? 0 : wait;
+}
+
+/** <!-- m2x_batch_json {{{1 -->
+ * @brief create M2X /updates json message from batch
+ *
+ * Each packet contributes to the streams its payload type provides,
+ * streams without any value are omitted.
+ * @param[out] dst json string
+ * @param[in] size size of dst
+ * @param[in] b batch
+ * @return length of json string
+ * @retval -ve_value: dst is too small
+ */
+int32_t m2x_batch_json(char *dst, int32_t size, const m2x_batch_t *b)
+{
+    json_writer_t w;
+    uint32_t i, n, num;
+    uint32_t streams = 0;
+    int32_t val;
+    json_init(&w, dst, size);
+    json_raw(&w, "{\"values\":{", 11);
+    for (i = 0; i < TWELITE_STREAM_NUM; i++) {
+        num = 0;
+        for (n = 0; n < b->num; n++) {
+            if (twelite_stream_value(&b->pkt[n], i, &val) < 0) {
+                continue;
+            }
+            if (num == 0) {
+                if (streams++ > 0) {
+                    json_raw(&w, ",", 1);
+                }
+                json_key(&w, twelite_streams[i].name);
+                json_raw(&w, "[", 1);
+            }
+            json_raw(&w, (num > 0) ? ",{\"timestamp\":" : "{\"timestamp\":",
+                     (num > 0) ? 14 : 13);
+            json_timestamp(&w, timemap_wall(b->clock, b->pkt[n].timestamp));
+            json_raw(&w, ",\"value\":", 9);
+            json_fixed(&w, val, twelite_streams[i].frac);
+            json_raw(&w, "}", 1);
+            num++;
+        }
+        if (num > 0) {
+            json_raw(&w, "]", 1);
+        }
+    }
+    json_raw(&w, "}}", 2);
+    return json_finish(&w);
+}
+
+/** <!-- m2x_batch_clear {{{1 -->
+ * @brief remove all packets from batch
+ * @param[in,out] b batch
+ * @return nothing
+ */
+void m2x_batch_clear(m2x_batch_t *b)
+{
+    b->num = 0;
+}
+
+// end of file {{{1
+// vim:ft=c:et:nowrap:fdm=marker
@@ -0,0 +1,108 @@
+/**
+ * Copyright (C) 2017 m2enu
+ *
+ * @file main/batch.h
+ * @brief AT&T M2X batched multi-timestamp uploader
+ * @author m2enu
+ * @date 2026/10/16
+ */
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdint.h>
+
+#include "timemap.h"
+#include "twelite.h"
+
+#define M2X_BATCH_MAX   32 //!< max. number of packets in one batch
+
+/** <!-- m2x_batch_reason_t {{{1 -->
+ * @brief reason of batch flush
+ */
+typedef enum m2x_batch_reason_t_tag {
+    M2X_BATCH_NONE = 0, //!< not due
+    M2X_BATCH_SIZE, //!< number of packets reached
+    M2X_BATCH_AGE, //!< the oldest packet is too old
+    M2X_BATCH_PRESSURE, //!< packet queue is filling up
+} m2x_batch_reason_t;
+
+/** <!-- m2x_batch_t {{{1 -->
+ * @brief batch of TWE-LITE packets for M2X /updates
+ */
+typedef struct m2x_batch_t_tag {
+    twelite_packet_t pkt[M2X_BATCH_MAX]; //!< batched packets
+    uint32_t num; //!< number of batched packets
+    uint32_t max_num; //!< flush when num reaches this
+    int64_t max_age; //!< flush when the oldest packet is older than this [ms]
+    uint32_t pressure; //!< flush when queued packets reach this
+    const timemap_t *clock; //!< clock mapping of timestamps
+    uint32_t n_flush[M2X_BATCH_PRESSURE + 1]; //!< number of flushes by reason
+} m2x_batch_t;
+
+/** <!-- m2x_batch_init {{{1 -->
+ * @brief initialise batch
+ * @param[out] b batch
+ * @param[in] max_num flush when number of packets reaches this
+ * @param[in] max_age flush when the oldest packet is older than this [ms]
+ * @param[in] pressure flush when queued packets reach this
+ * @param[in] clock clock mapping of timestamps
+ * @return nothing
+ */
+void m2x_batch_init(m2x_batch_t *b, uint32_t max_num, int64_t max_age,
+                    uint32_t pressure, const timemap_t *clock);
+
+/** <!-- m2x_batch_add {{{1 -->
+ * @brief add packet to batch
+ *
+ * A relayed copy of a batched reading (same end device and next_number)
+ * replaces it when its LQI is higher, and is discarded otherwise. A
+ * higher-LQI copy (better) of a reading no longer batched is discarded,
+ * as the reading itself is already posted.
+ * @param[in,out] b batch
+ * @param[in] pkt TWE-LITE packet (timestamp must be set)
+ * @return result of add
+ * @retval Zero: Success
+ * @retval +ve_value: merged with a batched copy of the same reading
+ * @retval -ve_value: batch full
+ */
+int8_t m2x_batch_add(m2x_batch_t *b, const twelite_packet_t *pkt);
+
+/** <!-- m2x_batch_due {{{1 -->
+ * @brief check whether batch should be flushed
+ * @param[in,out] b batch
+ * @param[in] now current time [ms, monotonic]
+ * @param[in] queued number of packets waiting in packet queue
+ * @return reason of flush (M2X_BATCH_NONE: not due)
+ */
+m2x_batch_reason_t m2x_batch_due(m2x_batch_t *b, int64_t now,
+                                 uint32_t queued);
+
+/** <!-- m2x_batch_wait {{{1 -->
+ * @brief time until batch becomes due by age
+ * @param[in] b batch
+ * @param[in] now current time [ms, monotonic]
+ * @return time to wait [ms] (-1: batch is empty)
+ */
+int64_t m2x_batch_wait(const m2x_batch_t *b, int64_t now);
+
+/** <!-- m2x_batch_json {{{1 -->
+ * @brief create M2X /updates json message from batch
+ * @param[out] dst json string
+ * @param[in] size size of dst
+ * @param[in] b batch
+ * @return length of json string
+ * @retval -ve_value: dst is too small
+ */
+int32_t m2x_batch_json(char *dst, int32_t size, const m2x_batch_t *b);
+
+/** <!-- m2x_batch_clear {{{1 -->
+ * @brief remove all packets from batch
+ * @param[in,out] b batch
+ * @return nothing
+ */
+void m2x_batch_clear(m2x_batch_t *b);
+
+#endif // BATCH_H
+
+// end of file {{{1
+// vim:ft=c:et:nowrap:fdm=marker
@@ -0,0 +1,233 @@
+/**
+ * Copyright (C) 2017 m2enu
+ *
+ * @file main/cbor.c
+ * @brief CBOR (RFC 7049) encoding of TWE-LITE packets
+ * @author m2enu
+ * @date 2026/10/16
+ */
+#include <stdint.h>
+#include <string.h>
+
+#include "cbor.h"
+
+/** <!-- cbor_head {{{1 -->
+ * @brief write initial byte and argument of data item
+ * @param[in,out] w writer
+ * @param[in] major major type (CBOR_xxx)
+ * @param[in] val argument (value, length or number of items)
+ * @return nothing
+ */
+void cbor_head(json_writer_t *w, uint8_t major, uint64_t val)
+{
+    char buf[9];
+    int32_t n, len;
+    if (val < 24) {
+        buf[0] = (char)(major | (uint8_t)val);
+        json_raw(w, buf, 1);
+        return;
+    }
+    if (val <= 0xff) {
+        buf[0] = (char)(major | 24);
+        len = 1;
+    } else if (val <= 0xffff) {
+        buf[0] = (char)(major | 25);
+        len = 2;
+    } else if (val <= 0xffffffffu) {
+        buf[0] = (char)(major | 26);
+        len = 4;
+    } else {
+        buf[0] = (char)(major | 27);
+        len = 8;
+    }
+    for (n = 0; n < len; n++) {
+        buf[len - n] = (char)(val >> (n * 8));
+    }
+    json_raw(w, buf, len + 1);
+}
+
+/** <!-- cbor_int {{{1 -->
+ * @brief write signed integer
+ * @param[in,out] w writer
+ * @param[in] val value
+ * @return nothing
+ */
+void cbor_int(json_writer_t *w, int64_t val)
+{
+    if (val < 0) {
+        cbor_head(w, CBOR_NEGINT, (uint64_t)(-1 - val));
+    } else {
+        cbor_head(w, CBOR_UINT, (uint64_t)val);
+    }
+}
+
+/** <!-- cbor_text {{{1 -->
+ * @brief write text string
+ * @param[in,out] w writer
+ * @param[in] str string
+ * @return nothing
+ */
+void cbor_text(json_writer_t *w, const char *str)
+{
+    int32_t len = strlen(str);
+    cbor_head(w, CBOR_TEXT, len);
+    json_raw(w, str, len);
+}
+
+/** <!-- cbor_fixed {{{1 -->
+ * @brief write fixed-point value as decimal fraction
+ * @param[in,out] w writer
+ * @param[in] val value in units of 10^-frac
+ * @param[in] frac number of fractional digits
+ * @return nothing
+ */
+void cbor_fixed(json_writer_t *w, int32_t val, uint8_t frac)
+{
+    if (frac == 0) {
+        cbor_int(w, val);
+        return;
+    }
+    cbor_head(w, CBOR_TAG, CBOR_TAG_DECIMAL);
+    cbor_head(w, CBOR_ARRAY, 2);
+    cbor_int(w, -(int32_t)frac);
+    cbor_int(w, val);
+}
+
+/** <!-- cbor_packet {{{1 -->
+ * @brief write one packet as map
+ *
+ * {"sid": uint, "timestamp": uint [ms], "lqi": uint, <stream>: decimal, ...}
+ * @param[in,out] w writer
+ * @param[in] pkt TWE-LITE packet
+ * @param[in] clock clock mapping of timestamps
+ * @return nothing
+ */
+void cbor_packet(json_writer_t *w, const twelite_packet_t *pkt,
+                 const timemap_t *clock)
+{
+    int32_t val[TWELITE_STREAM_NUM];
+    uint32_t mask = 0;
+    uint32_t num = 3;
+    uint32_t i;
+    for (i = 0; i < TWELITE_STREAM_NUM; i++) {
+        if (twelite_stream_value(pkt, i, &val[i]) == 0) {
+            mask |= 1u << i;
+            num++;
+        }
+    }
+    cbor_head(w, CBOR_MAP, num);
+    cbor_text(w, "sid");
+    cbor_head(w, CBOR_UINT, pkt->sid_enddevice);
+    cbor_text(w, "timestamp");
+    cbor_int(w, timemap_wall(clock, pkt->timestamp));
+    cbor_text(w, "lqi");
+    cbor_head(w, CBOR_UINT, pkt->lqi);
+    for (i = 0; i < TWELITE_STREAM_NUM; i++) {
+        if (mask & (1u << i)) {
+            cbor_text(w, twelite_streams[i].name);
+            cbor_fixed(w, val[i], twelite_streams[i].frac);
+        }
+    }
+}
+
+/** <!-- cbor_delta_device {{{1 -->
+ * @brief write samples of one end device
+ * @param[in,out] w writer
+ * @param[in] pkt TWE-LITE packets
+ * @param[in] idx indices of samples in pkt
+ * @param[in] num number of samples
+ * @param[in] clock clock mapping of timestamps
+ * @return nothing
+ */
+static void cbor_delta_device(json_writer_t *w, const twelite_packet_t *pkt,
+                              const uint8_t *idx, uint32_t num,
+                              const timemap_t *clock)
+{
+    const twelite_packet_t *first = &pkt[idx[0]];
+    const char null = (char)CBOR_NULL;
+    int32_t val, prev;
+    uint32_t mask = 0;
+    uint32_t i, n;
+    for (i = 0; i < TWELITE_STREAM_NUM; i++) {
+        if (twelite_stream_value(first, i, &val) == 0) {
+            mask |= 1u << i;
+        }
+    }
+    cbor_head(w, CBOR_ARRAY, 4);
+    cbor_head(w, CBOR_UINT, first->sid_enddevice);
+    cbor_head(w, CBOR_ARRAY, num);
+    cbor_int(w, timemap_wall(clock, first->timestamp));
+    for (n = 1; n < num; n++) {
+        cbor_int(w, pkt[idx[n]].timestamp - pkt[idx[n - 1]].timestamp);
+    }
+    cbor_head(w, CBOR_ARRAY, num);
+    for (n = 0; n < num; n++) {
+        cbor_head(w, CBOR_UINT, pkt[idx[n]].lqi);
+    }
+    cbor_head(w, CBOR_MAP, __builtin_popcount(mask));
+    for (i = 0; i < TWELITE_STREAM_NUM; i++) {
+        if (!(mask & (1u << i))) {
+            continue;
+        }
+        cbor_text(w, twelite_streams[i].name);
+        cbor_head(w, CBOR_ARRAY, num + 1);
+        cbor_head(w, CBOR_UINT, twelite_streams[i].frac);
+        prev = 0;
+        for (n = 0; n < num; n++) {
+            if (twelite_stream_value(&pkt[idx[n]], i, &val) < 0) {
+                json_raw(w, &null, 1);
+                continue;
+            }
+            cbor_int(w, (int64_t)val - prev);
+            prev = val;
+        }
+    }
+}
+
+/** <!-- cbor_delta {{{1 -->
+ * @brief write packets as delta-encoded batch grouped by end device
+ *
+ * [[sid, [t0, dt1, ...], [lqi, ...], {<stream>: [frac, v0, dv1, ...]}], ...]
+ *
+ * Timestamps and values are differences from the previous sample of the
+ * same end device, so most of them fit into one byte. A value missing in
+ * a sample is null.
+ * @param[in,out] w writer
+ * @param[in] pkt TWE-LITE packets
+ * @param[in] num number of packets (max. CBOR_DELTA_MAX)
+ * @param[in] clock clock mapping of timestamps
+ * @return nothing
+ */
+void cbor_delta(json_writer_t *w, const twelite_packet_t *pkt, uint32_t num,
+                const timemap_t *clock)
+{
+    uint8_t dev[CBOR_DELTA_MAX]; // packet index -> device index
+    uint8_t idx[CBOR_DELTA_MAX];
+    uint32_t dev_num = 0;
+    uint32_t i, j, n;
+    if (num > CBOR_DELTA_MAX) {
+        w->err = -1;
+        return;
+    }
+    // assign device index in order of first appearance
+    for (i = 0; i < num; i++) {
+        for (j = 0; j < i; j++) {
+            if (pkt[j].sid_enddevice == pkt[i].sid_enddevice) {
+                break;
+            }
+        }
+        dev[i] = (j < i) ? dev[j] : dev_num++;
+    }
+    cbor_head(w, CBOR_ARRAY, dev_num);
+    for (j = 0; j < dev_num; j++) {
+        for (i = 0, n = 0; i < num; i++) {
+            if (dev[i] == j) {
+                idx[n++] = i;
+            }
+        }
+        cbor_delta_device(w, pkt, idx, n, clock);
+    }
+}
+
+// end of file {{{1
+// vim:ft=c:et:nowrap:fdm=marker
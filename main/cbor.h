@@ -0,0 +1,97 @@
+/**
+ * Copyright (C) 2017 m2enu
+ *
+ * @file main/cbor.h
+ * @brief CBOR (RFC 7049) encoding of TWE-LITE packets
+ *
+ * Output goes through json_writer_t, which is a bounds-checked byte
+ * writer as well.
+ * @author m2enu
+ * @date 2026/10/16
+ */
+#ifndef CBOR_H
+#define CBOR_H
+
+#include <stdint.h>
+
+#include "json.h"
+#include "timemap.h"
+#include "twelite.h"
+
+#define CBOR_UINT       0x00 //!< major type 0: unsigned integer
+#define CBOR_NEGINT     0x20 //!< major type 1: negative integer
+#define CBOR_TEXT       0x60 //!< major type 3: text string
+#define CBOR_ARRAY      0x80 //!< major type 4: array
+#define CBOR_MAP        0xa0 //!< major type 5: map
+#define CBOR_TAG        0xc0 //!< major type 6: tag
+#define CBOR_NULL       0xf6 //!< simple value null
+#define CBOR_TAG_DECIMAL 4 //!< tag of decimal fraction [exponent, mantissa]
+#define CBOR_DELTA_MAX  64 //!< max. number of packets in one delta batch
+
+/** <!-- cbor_head {{{1 -->
+ * @brief write initial byte and argument of data item
+ * @param[in,out] w writer
+ * @param[in] major major type (CBOR_xxx)
+ * @param[in] val argument (value, length or number of items)
+ * @return nothing
+ */
+void cbor_head(json_writer_t *w, uint8_t major, uint64_t val);
+
+/** <!-- cbor_int {{{1 -->
+ * @brief write signed integer
+ * @param[in,out] w writer
+ * @param[in] val value
+ * @return nothing
+ */
+void cbor_int(json_writer_t *w, int64_t val);
+
+/** <!-- cbor_text {{{1 -->
+ * @brief write text string
+ * @param[in,out] w writer
+ * @param[in] str string
+ * @return nothing
+ */
+void cbor_text(json_writer_t *w, const char *str);
+
+/** <!-- cbor_fixed {{{1 -->
+ * @brief write fixed-point value as decimal fraction
+ * @param[in,out] w writer
+ * @param[in] val value in units of 10^-frac
+ * @param[in] frac number of fractional digits
+ * @return nothing
+ */
+void cbor_fixed(json_writer_t *w, int32_t val, uint8_t frac);
+
+/** <!-- cbor_packet {{{1 -->
+ * @brief write one packet as map
+ *
+ * {"sid": uint, "timestamp": uint [ms], "lqi": uint, <stream>: decimal, ...}
+ * @param[in,out] w writer
+ * @param[in] pkt TWE-LITE packet
+ * @param[in] clock clock mapping of timestamps
+ * @return nothing
+ */
+void cbor_packet(json_writer_t *w, const twelite_packet_t *pkt,
+                 const timemap_t *clock);
+
+/** <!-- cbor_delta {{{1 -->
+ * @brief write packets as delta-encoded batch grouped by end device
+ *
+ * [[sid, [t0, dt1, ...], [lqi, ...], {<stream>: [frac, v0, dv1, ...]}], ...]
+ *
+ * Timestamps and values are differences from the previous sample of the
+ * same end device, so most of them fit into one byte. A value missing in
+ * a sample is null.
+ * @param[in,out] w writer
+ * @param[in] pkt TWE-LITE packets
+ * @param[in] num number of packets (max. CBOR_DELTA_MAX)
+ * @param[in] clock clock mapping of timestamps
+ * @return nothing
+ */
+void cbor_delta(json_writer_t *w, const twelite_packet_t *pkt, uint32_t num,
+                const timemap_t *clock);
+
+#endif // CBOR_H
+
+// end of file {{{1
+// vim:ft=c:et:nowrap:fdm=marker
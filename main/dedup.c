@@ -0,0 +1,99 @@
+/**
+ * Copyright (C) 2017 m2enu
+ *
+ * @file main/dedup.c
+ * @brief duplicate suppression of relayed TWE-LITE packets
+ * @author m2enu
+ * @date 2026/10/16
+ */
+#include <stdint.h>
+#include <string.h>
+
+#include "dedup.h"
+
+/** <!-- dedup_hash {{{1 -->
+ * @brief hash of end device SID
+ * @param[in] sid SID of end device
+ * @return hash value
+ */
+static inline uint32_t dedup_hash(uint32_t sid)
+{
+    return (sid * 2654435761u) >> 16;
+}
+
+/** <!-- dedup_init {{{1 -->
+ * @brief initialise duplicate filter
+ * @param[out] d duplicate filter
+ * @param[in] window duplicates are detected within this [ms]
+ * @param[in] best_lqi 1: forward duplicate with higher LQI
+ * @return nothing
+ */
+void dedup_init(dedup_t *d, int64_t window, int8_t best_lqi)
+{
+    memset(d, 0, sizeof(*d));
+    d->window   = window;
+    d->best_lqi = best_lqi;
+}
+
+/** <!-- dedup_lookup {{{1 -->
+ * @brief find entry of end device, or entry to (re)use for it
+ * @param[in,out] d duplicate filter
+ * @param[in] sid SID of end device
+ * @return entry (sid is 0 when newly assigned)
+ */
+static dedup_entry_t *dedup_lookup(dedup_t *d, uint32_t sid)
+{
+    dedup_entry_t *oldest = NULL;
+    uint32_t h = dedup_hash(sid);
+    uint32_t i;
+    for (i = 0; i < DEDUP_PROBE; i++) {
+        dedup_entry_t *e = &d->entry[(h + i) & (DEDUP_SIZE - 1)];
+        if ((e->sid == sid) || (e->sid == 0)) {
+            return e;
+        }
+        if ((oldest == NULL) || (e->seen < oldest->seen)) {
+            oldest = e;
+        }
+    }
+    // probe sequence is full, evict the least recently seen device
+    d->n_evict++;
+    oldest->sid = 0;
+    return oldest;
+}
+
+/** <!-- dedup_check {{{1 -->
+ * @brief check whether packet is a duplicate of a relayed reading
+ * @param[in,out] d duplicate filter
+ * @param[in] pkt TWE-LITE packet
+ * @param[in] now receive time [ms]
+ * @return result of check (dedup_result_t)
+ */
+int8_t dedup_check(dedup_t *d, const twelite_packet_t *pkt, int64_t now)
+{
+    // SID 0 marks unused entry
+    uint32_t sid = pkt->sid_enddevice ? pkt->sid_enddevice : 0xffffffff;
+    dedup_entry_t *e = dedup_lookup(d, sid);
+    if ((e->sid == sid) && (now - e->seen <= d->window)) {
+        // serial number difference, modulo 2^16
+        int16_t diff = (int16_t)(pkt->next_number - e->next_number);
+        if ((diff == 0) && d->best_lqi && (pkt->lqi > e->lqi)) {
+            e->lqi = pkt->lqi;
+            d->n_better++;
+            return DEDUP_BETTER;
+        }
+        if ((diff <= 0) && (diff > -DEDUP_SEQ_WINDOW)) {
+            d->n_dup++;
+            return DEDUP_DUP;
+        }
+    }
+    // new reading, or device restarted / silent for longer than window
+    e->sid          = sid;
+    e->next_number  = pkt->next_number;
+    e->lqi          = pkt->lqi;
+    e->seen         = now;
+    d->n_new++;
+    return DEDUP_NEW;
+}
+
+// end of file {{{1
+// vim:ft=c:et:nowrap:fdm=marker
@@ -0,0 +1,73 @@
+/**
+ * Copyright (C) 2017 m2enu
+ *
+ * @file main/dedup.h
+ * @brief duplicate suppression of relayed TWE-LITE packets
+ * @author m2enu
+ * @date 2026/10/16
+ */
+#ifndef DEDUP_H
+#define DEDUP_H
+
+#include <stdint.h>
+
+#include "twelite.h"
+
+#define DEDUP_SIZE          64 //!< number of table entries (power of 2)
+#define DEDUP_PROBE         8 //!< max. probe length of table
+#define DEDUP_SEQ_WINDOW    16 //!< older next_number within this is a duplicate
+
+/** <!-- dedup_result_t {{{1 -->
+ * @brief result of dedup_check()
+ */
+typedef enum dedup_result_t_tag {
+    DEDUP_NEW = 0, //!< new reading, forward
+    DEDUP_BETTER = 1, //!< duplicate with higher LQI, forward to replace
+    DEDUP_DUP = -1, //!< duplicate, drop
+} dedup_result_t;
+
+/** <!-- dedup_entry_t {{{1 -->
+ * @brief last reading of one end device
+ */
+typedef struct dedup_entry_t_tag {
+    uint32_t sid; //!< SID of end device (0: unused)
+    uint16_t next_number; //!< the newest next_number
+    uint8_t lqi; //!< the best LQI of the newest reading
+    int64_t seen; //!< receive time of the newest reading [ms]
+} dedup_entry_t;
+
+/** <!-- dedup_t {{{1 -->
+ * @brief duplicate filter keyed by sid_enddevice (open addressing)
+ */
+typedef struct dedup_t_tag {
+    dedup_entry_t entry[DEDUP_SIZE]; //!< table entries
+    int64_t window; //!< duplicates are detected within this [ms]
+    int8_t best_lqi; //!< 1: forward duplicate with higher LQI
+    uint32_t n_new; //!< number of new readings
+    uint32_t n_dup; //!< number of dropped duplicates
+    uint32_t n_better; //!< number of forwarded duplicates with higher LQI
+    uint32_t n_evict; //!< number of evicted entries
+} dedup_t;
+
+/** <!-- dedup_init {{{1 -->
+ * @brief initialise duplicate filter
+ * @param[out] d duplicate filter
+ * @param[in] window duplicates are detected within this [ms]
+ * @param[in] best_lqi 1: forward duplicate with higher LQI
+ * @return nothing
+ */
+void dedup_init(dedup_t *d, int64_t window, int8_t best_lqi);
+
+/** <!-- dedup_check {{{1 -->
+ * @brief check whether packet is a duplicate of a relayed reading
+ * @param[in,out] d duplicate filter
+ * @param[in] pkt TWE-LITE packet
+ * @param[in] now receive time [ms]
+ * @return result of check (dedup_result_t)
+ */
+int8_t dedup_check(dedup_t *d, const twelite_packet_t *pkt, int64_t now);
+
+#endif // DEDUP_H
+
+// end of file {{{1
+// vim:ft=c:et:nowrap:fdm=marker
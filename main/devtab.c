@@ -0,0 +1,329 @@
+/**
+ * Copyright (C) 2017 m2enu
+ *
+ * @file main/devtab.c
+ * @brief per end device state table with liveness and battery events
+ * @author m2enu
+ * @date 2026/10/16
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "devtab.h"
+
+/** <!-- devtab_hash {{{1 -->
+ * @brief hash of end device SID
+ * @param[in] sid SID of end device
+ * @return hash value
+ */
+static inline uint32_t devtab_hash(uint32_t sid)
+{
+    return (sid * 2654435761u) >> 16;
+}
+
+/** <!-- devtab_key {{{1 -->
+ * @brief key of end device SID
+ * @param[in] sid SID of end device
+ * @return key (SIDs 0 and DEVTAB_SID_DEAD share one with 0xffffffff)
+ */
+static inline uint32_t devtab_key(uint32_t sid)
+{
+    // 0 marks unused entry, DEVTAB_SID_DEAD evicted one
+    return ((sid == 0) || (sid == DEVTAB_SID_DEAD)) ? 0xffffffff : sid;
+}
+
+/** <!-- devtab_lookup {{{1 -->
+ * @brief find index of end device, or free index for it
+ *
+ * Evicted entries do not end probing, but the first of them on the way is
+ * reused for a new device.
+ * @param[in] t end device table
+ * @param[in] key key of end device
+ * @return index (t->sid[] is not key when not found)
+ */
+static uint32_t devtab_lookup(const devtab_t *t, uint32_t key)
+{
+    uint32_t mask = t->size - 1;
+    uint32_t i = devtab_hash(key) & mask;
+    uint32_t dead = t->size;
+    // load is limited, so an unused entry is always found
+    while ((t->sid[i] != key) && (t->sid[i] != 0)) {
+        if ((t->sid[i] == DEVTAB_SID_DEAD) && (dead == t->size)) {
+            dead = i;
+        }
+        i = (i + 1) & mask;
+    }
+    return ((t->sid[i] == 0) && (dead != t->size)) ? dead : i;
+}
+
+/** <!-- devtab_evict {{{1 -->
+ * @brief remove device from table
+ *
+ * Evicted entries just before an unused one end no probe, so they are
+ * marked unused again.
+ * @param[in,out] t end device table
+ * @param[in] i index of device (not in timer wheel)
+ * @return nothing
+ */
+static void devtab_evict(devtab_t *t, uint32_t i)
+{
+    uint32_t mask = t->size - 1;
+    t->sid[i] = DEVTAB_SID_DEAD;
+    t->num--;
+    t->n_dead++;
+    t->n_evict++;
+    if (t->sid[(i + 1) & mask] != 0) {
+        return;
+    }
+    while (t->sid[i] == DEVTAB_SID_DEAD) {
+        t->sid[i] = 0;
+        t->n_dead--;
+        i = (i - 1) & mask;
+    }
+}
+
+/** <!-- devtab_timeout {{{1 -->
+ * @brief time without packet for device to be silent
+ * @param[in] e state of end device
+ * @return timeout [ms]
+ */
+static uint32_t devtab_timeout(const devtab_entry_t *e)
+{
+    if ((e->interval == 0) ||
+        (e->interval > DEVTAB_SILENT_MAX / DEVTAB_SILENT_MISS)) {
+        return DEVTAB_SILENT_MAX; // rate not known yet
+    }
+    uint32_t timeout = e->interval * DEVTAB_SILENT_MISS;
+    return (timeout < DEVTAB_SILENT_MIN) ? DEVTAB_SILENT_MIN : timeout;
+}
+
+/** <!-- devtab_schedule {{{1 -->
+ * @brief put device into timer wheel
+ *
+ * Waits beyond the wheel are put into the farthest slot and rescheduled
+ * when it expires.
+ * @param[in,out] t end device table
+ * @param[in] i index of device
+ * @param[in] wait time until deadline [ms]
+ * @return nothing
+ */
+static void devtab_schedule(devtab_t *t, uint32_t i, uint32_t wait)
+{
+    uint32_t ticks = (wait + DEVTAB_TICK - 1) / DEVTAB_TICK;
+    if (ticks == 0) {
+        ticks = 1;
+    } else if (ticks >= DEVTAB_WHEEL) {
+        ticks = DEVTAB_WHEEL - 1;
+    }
+    uint16_t *slot = &t->wheel[(t->tick + ticks) & (DEVTAB_WHEEL - 1)];
+    t->entry[i].next = *slot;
+    t->entry[i].flags |= DEVTAB_IN_WHEEL;
+    *slot = (uint16_t)(i + 1);
+}
+
+/** <!-- devtab_init {{{1 -->
+ * @brief initialise end device table and allocate its entries
+ *
+ * Up to 7/8 of size are tracked, each entry takes 32 bytes of heap.
+ * @param[out] t end device table
+ * @param[in] size number of table entries (power of 2)
+ * @param[in] now monotonic time [ms]
+ * @param[in] vdd_low battery low threshold [mV]
+ * @return result of initialisation
+ * @retval Zero: Success
+ * @retval -ve_value: Error (bad size or out of memory, nothing is tracked)
+ */
+int8_t devtab_init(devtab_t *t, uint32_t size, int64_t now, uint16_t vdd_low)
+{
+    memset(t, 0, sizeof(devtab_t));
+    t->base     = now;
+    t->vdd_low  = vdd_low;
+    if ((size < DEVTAB_SIZE_MIN) || (size > DEVTAB_SIZE_MAX) ||
+        (size & (size - 1))) {
+        return -1;
+    }
+    t->sid   = calloc(size, sizeof(uint32_t));
+    t->entry = calloc(size, sizeof(devtab_entry_t));
+    if ((t->sid == NULL) || (t->entry == NULL)) {
+        free(t->sid);
+        free(t->entry);
+        t->sid   = NULL;
+        t->entry = NULL;
+        return -1;
+    }
+    t->size     = size;
+    t->load_max = size / 8 * 7;
+    return 0;
+}
+
+/** <!-- devtab_free {{{1 -->
+ * @brief release entries of end device table
+ * @param[in,out] t end device table (not tracking anything afterwards)
+ * @return nothing
+ */
+void devtab_free(devtab_t *t)
+{
+    free(t->sid);
+    free(t->entry);
+    t->sid   = NULL;
+    t->entry = NULL;
+    t->size  = 0;
+    t->num   = 0;
+}
+
+/** <!-- devtab_update {{{1 -->
+ * @brief update state of end device by packet, O(1)
+ * @param[in,out] t end device table
+ * @param[in] pkt TWE-LITE packet
+ * @param[in] now monotonic time [ms]
+ * @return event of end device (devtab_event_t)
+ */
+int8_t devtab_update(devtab_t *t, const twelite_packet_t *pkt, int64_t now)
+{
+    uint32_t key = devtab_key(pkt->sid_enddevice);
+    uint32_t ms = (uint32_t)(now - t->base);
+    if (t->size == 0) {
+        t->n_full++;
+        return DEVTAB_EV_FULL;
+    }
+    uint32_t i = devtab_lookup(t, key);
+    devtab_entry_t *e = &t->entry[i];
+    int8_t ev = DEVTAB_EV_NONE;
+    if (t->sid[i] != key) {
+        // an unused entry is taken only while enough stay for probing to end
+        if ((t->sid[i] == 0) ? (t->num + t->n_dead >= t->load_max)
+                             : (t->num >= t->load_max)) {
+            t->n_full++;
+            return DEVTAB_EV_FULL;
+        }
+        if (t->sid[i] == DEVTAB_SID_DEAD) {
+            t->n_dead--;
+        }
+        t->sid[i] = key;
+        t->num++;
+        memset(e, 0, sizeof(devtab_entry_t));
+        e->vdd_avg      = pkt->mvolt_vdd * 16;
+        e->vdd_ref      = e->vdd_avg;
+        e->trend_time   = ms;
+        e->lqi_avg      = pkt->lqi * 16;
+        e->lqi_min      = pkt->lqi;
+        ev = DEVTAB_EV_NEW;
+    } else {
+        int32_t diff = (int32_t)(ms - e->last) - (int32_t)e->interval;
+        e->interval += (e->n_packet == 1) ? diff : diff / 8;
+        e->vdd_avg += pkt->mvolt_vdd - e->vdd_avg / 16;
+        e->lqi_avg += pkt->lqi - e->lqi_avg / 16;
+        if (pkt->lqi < e->lqi_min) {
+            e->lqi_min = pkt->lqi;
+        }
+        uint32_t span = ms - e->trend_time;
+        if (span >= DEVTAB_TREND_PERIOD) {
+            int32_t delta = (int32_t)e->vdd_avg - (int32_t)e->vdd_ref;
+            e->vdd_trend  = (int16_t)((int64_t)delta * 3600000 / 16 / span);
+            e->vdd_ref    = e->vdd_avg;
+            e->trend_time = ms;
+        }
+        if (e->flags & DEVTAB_SILENT) {
+            e->flags &= ~DEVTAB_SILENT;
+            t->n_silent--;
+            ev = DEVTAB_EV_ALIVE;
+        }
+    }
+    e->last = ms;
+    e->n_packet++;
+    // battery, reported with the next packet if something else happened
+    uint32_t vdd = e->vdd_avg / 16;
+    uint8_t low = (e->flags & DEVTAB_BATTERY_LOW) ? 1 : 0;
+    if ((ev == DEVTAB_EV_NONE) && !low && (vdd < t->vdd_low)) {
+        e->flags |= DEVTAB_BATTERY_LOW;
+        ev = DEVTAB_EV_BATTERY_LOW;
+    } else if ((ev == DEVTAB_EV_NONE) && low &&
+               (vdd >= (uint32_t)t->vdd_low + DEVTAB_VDD_HYST)) {
+        e->flags &= ~DEVTAB_BATTERY_LOW;
+        ev = DEVTAB_EV_BATTERY_OK;
+    }
+    // deadline is checked lazily, devices stay in their slot meanwhile
+    if (!(e->flags & DEVTAB_IN_WHEEL)) {
+        devtab_schedule(t, i, devtab_timeout(e));
+    }
+    return ev;
+}
+
+/** <!-- devtab_expire {{{1 -->
+ * @brief advance timer wheel and report devices gone silent
+ *
+ * Only the slots elapsed since the last call are checked. Devices silent
+ * for DEVTAB_EVICT are removed from the table.
+ * @param[in,out] t end device table
+ * @param[in] now monotonic time [ms]
+ * @param[out] dst devices gone silent
+ * @param[in] max size of dst
+ * @return number of devices gone silent (may exceed max)
+ */
+uint32_t devtab_expire(devtab_t *t, int64_t now,
+                       devtab_alert_t *dst, uint32_t max)
+{
+    uint32_t ms = (uint32_t)(now - t->base);
+    uint32_t tick = (uint32_t)((now - t->base) / DEVTAB_TICK);
+    uint32_t n = 0;
+    if (tick - t->tick > DEVTAB_WHEEL) {
+        t->tick = tick - DEVTAB_WHEEL; // visit every slot once
+    }
+    while (t->tick != tick) {
+        t->tick++;
+        uint16_t *slot = &t->wheel[t->tick & (DEVTAB_WHEEL - 1)];
+        uint16_t idx = *slot;
+        *slot = 0;
+        while (idx != 0) {
+            uint32_t i = idx - 1;
+            devtab_entry_t *e = &t->entry[i];
+            uint32_t age = ms - e->last;
+            uint32_t timeout = devtab_timeout(e);
+            idx = e->next;
+            e->flags &= ~DEVTAB_IN_WHEEL;
+            if (e->flags & DEVTAB_SILENT) {
+                if (age < DEVTAB_EVICT) {
+                    devtab_schedule(t, i, DEVTAB_EVICT - age);
+                } else {
+                    t->n_silent--;
+                    devtab_evict(t, i);
+                }
+                continue;
+            }
+            if (age < timeout) {
+                devtab_schedule(t, i, timeout - age); // heard meanwhile
+                continue;
+            }
+            e->flags |= DEVTAB_SILENT;
+            t->n_silent++;
+            if (n < max) {
+                dst[n].sid = t->sid[i];
+                dst[n].age = age;
+            }
+            n++;
+            // silent devices wait for eviction in the wheel
+            devtab_schedule(t, i, DEVTAB_EVICT - age);
+        }
+    }
+    return n;
+}
+
+/** <!-- devtab_find {{{1 -->
+ * @brief find state of end device
+ * @param[in] t end device table
+ * @param[in] sid SID of end device
+ * @return state of end device (NULL: not found)
+ */
+const devtab_entry_t *devtab_find(const devtab_t *t, uint32_t sid)
+{
+    uint32_t key = devtab_key(sid);
+    if (t->size == 0) {
+        return NULL;
+    }
+    uint32_t i = devtab_lookup(t, key);
+    return (t->sid[i] == key) ? &t->entry[i] : NULL;
+}
+
+// end of file {{{1
+// vim:ft=c:et:nowrap:fdm=marker
@@ -0,0 +1,155 @@
+/**
+ * Copyright (C) 2017 m2enu
+ *
+ * @file main/devtab.h
+ * @brief per end device state table with liveness and battery events
+ * @author m2enu
+ * @date 2026/10/16
+ */
+#ifndef DEVTAB_H
+#define DEVTAB_H
+
+#include <stdint.h>
+
+#include "port.h"
+#include "twelite.h"
+
+#define DEVTAB_SIZE_MIN     8 //!< min. number of table entries
+#define DEVTAB_SIZE_MAX     32768 //!< max. number of table entries (uint16_t links)
+#define DEVTAB_WHEEL        256 //!< number of timer wheel slots (power of 2)
+#define DEVTAB_TICK         1000 //!< timer wheel resolution [ms]
+#define DEVTAB_SILENT_MISS  4 //!< missed intervals to be silent
+#define DEVTAB_SILENT_MIN   (30 * 1000) //!< min. time to be silent [ms]
+#define DEVTAB_SILENT_MAX   (60 * 60 * 1000) //!< max. time to be silent [ms]
+#define DEVTAB_EVICT        (24 * 60 * 60 * 1000) //!< time without packet to be evicted [ms]
+#define DEVTAB_TREND_PERIOD (60 * 60 * 1000) //!< period of battery trend [ms]
+#define DEVTAB_VDD_HYST     100 //!< hysteresis of battery low [mV]
+#define DEVTAB_SID_DEAD     0xfffffffe //!< key of evicted entry
+
+/** <!-- devtab_event_t {{{1 -->
+ * @brief events of end device
+ */
+typedef enum devtab_event_t_tag {
+    DEVTAB_EV_NONE = 0, //!< nothing happened
+    DEVTAB_EV_NEW, //!< first packet of device
+    DEVTAB_EV_ALIVE, //!< packet of silent device
+    DEVTAB_EV_SILENT, //!< no packet for DEVTAB_SILENT_MISS intervals
+    DEVTAB_EV_BATTERY_LOW, //!< supply voltage fell below threshold
+    DEVTAB_EV_BATTERY_OK, //!< supply voltage recovered
+    DEVTAB_EV_FULL = -1, //!< table full, device not tracked
+} devtab_event_t;
+
+#define DEVTAB_SILENT       0x01 //!< flag: device is silent
+#define DEVTAB_BATTERY_LOW  0x02 //!< flag: battery is low
+#define DEVTAB_IN_WHEEL     0x04 //!< flag: device is in timer wheel
+
+/** <!-- devtab_entry_t {{{1 -->
+ * @brief state of one end device
+ *
+ * Times are ms since devtab_init() modulo 2^32, so only differences of
+ * them are meaningful.
+ */
+typedef struct devtab_entry_t_tag {
+    uint32_t last; //!< time of last packet [ms]
+    uint32_t interval; //!< EWMA of packet interval [ms]
+    uint32_t n_packet; //!< number of packets
+    uint32_t trend_time; //!< start of battery trend period [ms]
+    int16_t vdd_trend; //!< battery trend of last period [mV/h]
+    uint16_t vdd_avg; //!< EWMA of supply voltage [mV x16]
+    uint16_t vdd_ref; //!< vdd_avg at start of trend period [mV x16]
+    uint16_t lqi_avg; //!< EWMA of LQI [x16]
+    uint16_t next; //!< next device in timer wheel slot (index + 1, 0: end)
+    uint8_t lqi_min; //!< min. LQI
+    uint8_t flags; //!< DEVTAB_SILENT, DEVTAB_BATTERY_LOW, DEVTAB_IN_WHEEL
+} devtab_entry_t;
+
+/** <!-- devtab_alert_t {{{1 -->
+ * @brief event of end device reported by devtab_expire()
+ */
+typedef struct devtab_alert_t_tag {
+    uint32_t sid; //!< SID of end device
+    uint32_t age; //!< time since last packet [ms]
+} devtab_alert_t;
+
+/** <!-- devtab_t {{{1 -->
+ * @brief end device table keyed by sid_enddevice (open addressing)
+ *
+ * Keys are kept apart from states so that probing touches keys only.
+ * Both arrays are allocated once by devtab_init().
+ * Every device is in one timer wheel slot at its silent deadline; a slot
+ * is checked once when it expires, and devices heard meanwhile are moved
+ * to their new deadline then. Silent devices stay in the wheel until
+ * DEVTAB_EVICT, when their entry is reclaimed.
+ */
+typedef struct devtab_t_tag {
+    uint32_t *sid; //!< SID of end device (0: unused, DEVTAB_SID_DEAD: evicted)
+    devtab_entry_t *entry; //!< state of end device
+    uint32_t size; //!< number of table entries (power of 2, 0: not allocated)
+    uint32_t load_max; //!< max. number of devices and evicted entries
+    uint16_t wheel[DEVTAB_WHEEL]; //!< first device in slot (index + 1, 0: empty)
+    int64_t base; //!< time of devtab_init() [ms]
+    uint32_t tick; //!< last expired tick
+    uint16_t vdd_low; //!< battery low threshold [mV]
+    uint32_t num; //!< number of devices
+    uint32_t n_dead; //!< number of evicted entries not reused yet
+    uint32_t n_evict; //!< number of evicted devices
+    uint32_t n_silent; //!< number of silent devices
+    uint32_t n_full; //!< number of packets of untracked devices
+} devtab_t;
+
+/** <!-- devtab_init {{{1 -->
+ * @brief initialise end device table and allocate its entries
+ *
+ * Up to 7/8 of size are tracked, each entry takes 32 bytes of heap.
+ * @param[out] t end device table
+ * @param[in] size number of table entries (power of 2)
+ * @param[in] now monotonic time [ms]
+ * @param[in] vdd_low battery low threshold [mV]
+ * @return result of initialisation
+ * @retval Zero: Success
+ * @retval -ve_value: Error (bad size or out of memory, nothing is tracked)
+ */
+int8_t devtab_init(devtab_t *t, uint32_t size, int64_t now, uint16_t vdd_low);
+
+/** <!-- devtab_free {{{1 -->
+ * @brief release entries of end device table
+ * @param[in,out] t end device table (not tracking anything afterwards)
+ * @return nothing
+ */
+void devtab_free(devtab_t *t);
+
+/** <!-- devtab_update {{{1 -->
+ * @brief update state of end device by packet, O(1)
+ * @param[in,out] t end device table
+ * @param[in] pkt TWE-LITE packet
+ * @param[in] now monotonic time [ms]
+ * @return event of end device (devtab_event_t)
+ */
+int8_t devtab_update(devtab_t *t, const twelite_packet_t *pkt, int64_t now);
+
+/** <!-- devtab_expire {{{1 -->
+ * @brief advance timer wheel and report devices gone silent
+ *
+ * Only the slots elapsed since the last call are checked. Devices silent
+ * for DEVTAB_EVICT are removed from the table.
+ * @param[in,out] t end device table
+ * @param[in] now monotonic time [ms]
+ * @param[out] dst devices gone silent
+ * @param[in] max size of dst
+ * @return number of devices gone silent (may exceed max)
+ */
+uint32_t devtab_expire(devtab_t *t, int64_t now,
+                       devtab_alert_t *dst, uint32_t max);
+
+/** <!-- devtab_find {{{1 -->
+ * @brief find state of end device
+ * @param[in] t end device table
+ * @param[in] sid SID of end device
+ * @return state of end device (NULL: not found)
+ */
+const devtab_entry_t *devtab_find(const devtab_t *t, uint32_t sid);
+
+#endif // DEVTAB_H
+
+// end of file {{{1
+// vim:ft=c:et:nowrap:fdm=marker
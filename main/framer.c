@@ -0,0 +1,222 @@
+/**
+ * Copyright (C) 2017 m2enu
+ *
+ * @file main/framer.c
+ * @brief MONO WIRELESS TWE-LITE app_tag stream framer
+ * @author m2enu
+ * @date 2026/10/16
+ */
+#include <stdint.h>
+#include <string.h>
+
+#include "framer.h"
+
+/** <!-- twelite_framer_reset {{{1 -->
+ * @brief discard received data (statistics are kept)
+ * @param[in,out] fr framer
+ * @return nothing
+ */
+void twelite_framer_reset(twelite_framer_t *fr)
+{
+    fr->tail        = 0;
+    fr->scan        = 0;
+    fr->start       = -1;
+}
+
+/** <!-- twelite_framer_init {{{1 -->
+ * @brief initialise framer
+ * @param[out] fr framer
+ * @return nothing
+ */
+void twelite_framer_init(twelite_framer_t *fr)
+{
+    twelite_framer_reset(fr);
+    fr->n_frame     = 0;
+    fr->n_resync    = 0;
+    fr->n_oversize  = 0;
+    fr->format      = TWELITE_FORMAT_ASCII;
+}
+
+/** <!-- twelite_framer_format {{{1 -->
+ * @brief select frame format (ascii after twelite_framer_init())
+ * @param[in,out] fr framer
+ * @param[in] format frame format
+ * @return nothing
+ */
+void twelite_framer_format(twelite_framer_t *fr, twelite_format_t format)
+{
+    twelite_framer_reset(fr);
+    fr->format = format;
+}
+
+/** <!-- twelite_framer_wptr {{{1 -->
+ * @brief get write pointer of framer to receive data in place
+ * @param[in] fr framer
+ * @param[out] room writable length
+ * @return write pointer
+ */
+char *twelite_framer_wptr(twelite_framer_t *fr, int32_t *room)
+{
+    *room = TWELITE_FRAMER_BUF_SIZE - fr->tail;
+    return &fr->buf[fr->tail];
+}
+
+/** <!-- twelite_framer_commit {{{1 -->
+ * @brief commit data written to twelite_framer_wptr()
+ * @param[in,out] fr framer
+ * @param[in] len length of written data
+ * @return result of commit
+ * @retval Zero: Success
+ * @retval -ve_value: Error
+ */
+int8_t twelite_framer_commit(twelite_framer_t *fr, int32_t len)
+{
+    if ((len < 0) || (len > TWELITE_FRAMER_BUF_SIZE - fr->tail)) {
+        return -1;
+    }
+    fr->tail += len;
+    return 0;
+}
+
+/** <!-- twelite_framer_push {{{1 -->
+ * @brief copy received data into framer
+ * @param[in,out] fr framer
+ * @param[in] data received data
+ * @param[in] len length of data
+ * @return length of copied data
+ */
+int32_t twelite_framer_push(twelite_framer_t *fr, const char *data, int32_t len)
+{
+    int32_t room;
+    char *dst = twelite_framer_wptr(fr, &room);
+    if (len > room) {
+        len = room;
+    }
+    memcpy(dst, data, len);
+    fr->tail += len;
+    return len;
+}
+
+/** <!-- twelite_framer_compact {{{1 -->
+ * @brief move partial frame to the head of buffer
+ * @param[in,out] fr framer
+ * @return nothing
+ */
+static void twelite_framer_compact(twelite_framer_t *fr)
+{
+    if (fr->start < 0) {
+        fr->tail = 0;
+        fr->scan = 0;
+        return;
+    }
+    int32_t len = fr->tail - fr->start;
+    if (fr->start > 0) {
+        memmove(fr->buf, &fr->buf[fr->start], len);
+    }
+    fr->tail  = len;
+    fr->scan  = len;
+    fr->start = 0;
+}
+
+/** <!-- twelite_framer_next_binary {{{1 -->
+ * @brief extract next complete binary frame
+ *
+ * A frame is accepted when the trailer is found where its length says
+ * and the XOR checksum of payload matches. Otherwise, or when the length
+ * is out of range, the header was a payload byte (counted as resync), and
+ * scan restarts next to it.
+ * @param[in,out] fr framer
+ * @param[out] frame start of frame
+ * @return length of frame
+ * @retval Zero: no more complete frame
+ */
+static int32_t twelite_framer_next_binary(twelite_framer_t *fr, char **frame)
+{
+    const uint8_t *buf = (const uint8_t *)fr->buf;
+    int32_t i = fr->scan;
+    int32_t n;
+    while (fr->tail - i >= 4) {
+        if ((buf[i] != TWELITE_BINARY_HEAD0) ||
+            (buf[i + 1] != TWELITE_BINARY_HEAD1) || !(buf[i + 2] & 0x80)) {
+            i++;
+            continue;
+        }
+        int32_t len = (((buf[i + 2] & 0x7f) << 8) | buf[i + 3]) +
+                      TWELITE_BINARY_OVERHEAD;
+        if (len > TWELITE_BINARY_PAYLOAD_MAX + TWELITE_BINARY_OVERHEAD) {
+            fr->n_resync++;
+            i++;
+            continue;
+        }
+        if (fr->tail - i < len) {
+            break; // partial frame
+        }
+        uint8_t sum = 0;
+        for (n = i + 4; n < i + len - 2; n++) {
+            sum ^= buf[n];
+        }
+        if ((buf[i + len - 1] != TWELITE_BINARY_EOT) ||
+            (buf[i + len - 2] != sum)) {
+            fr->n_resync++;
+            i++;
+            continue;
+        }
+        *frame   = &fr->buf[i];
+        fr->scan = i + len;
+        fr->n_frame++;
+        return len;
+    }
+    // move partial frame to the head of buffer
+    if (i > 0) {
+        memmove(fr->buf, &fr->buf[i], fr->tail - i);
+        fr->tail -= i;
+    }
+    fr->scan = 0;
+    return 0;
+}
+
+/** <!-- twelite_framer_next {{{1 -->
+ * @brief extract next complete frame
+ *
+ * An ascii frame starts with TWELITE_FRAME_START and excludes CR/LF. A
+ * binary frame is returned as a whole, from header to trailer. It points
+ * into framer buffer and is valid until this function returns zero.
+ * @param[in,out] fr framer
+ * @param[out] frame start of frame
+ * @return length of frame
+ * @retval Zero: no more complete frame
+ */
+int32_t twelite_framer_next(twelite_framer_t *fr, char **frame)
+{
+    int32_t i;
+    int32_t start = fr->start;
+    if (fr->format == TWELITE_FORMAT_BINARY) {
+        return twelite_framer_next_binary(fr, frame);
+    }
+    for (i = fr->scan; i < fr->tail; i++) {
+        char c = fr->buf[i];
+        if (c == TWELITE_FRAME_START) {
+            if (start >= 0) {
+                fr->n_resync++;
+            }
+            start = i;
+        } else if ((c == '\r') || (c == '\n')) {
+            if (start >= 0) {
+                *frame    = &fr->buf[start];
+                fr->scan  = i + 1;
+                fr->start = -1;
+                fr->n_frame++;
+                return i - start;
+            }
+        } else if ((start >= 0) && (i - start >= TWELITE_FRAME_LENGTH_MAX)) {
+            fr->n_oversize++;
+            start = -1;
+        }
+    }
+    fr->start = start;
+    twelite_framer_compact(fr);
+    return 0;
+}
+
+// end of file {{{1
+// vim:ft=c:et:nowrap:fdm=marker
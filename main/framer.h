@@ -0,0 +1,119 @@
+/**
+ * Copyright (C) 2017 m2enu
+ *
+ * @file main/framer.h
+ * @brief MONO WIRELESS TWE-LITE app_tag stream framer
+ *
+ * Frames are either ascii (':' ... CR/LF) or binary transfer mode
+ * (0xA5 0x5A, length, payload, XOR checksum, EOT).
+ * @author m2enu
+ * @date 2026/10/16
+ */
+#ifndef FRAMER_H
+#define FRAMER_H
+
+#include <stdint.h>
+
+#define TWELITE_FRAME_START     ':' //!< TWE-LITE app_tag frame start character
+#define TWELITE_FRAME_LENGTH_MAX 128 //!< TWE-LITE app_tag frame length max.
+#define TWELITE_BINARY_HEAD0    0xa5 //!< TWE-LITE binary frame header (1st byte)
+#define TWELITE_BINARY_HEAD1    0x5a //!< TWE-LITE binary frame header (2nd byte)
+#define TWELITE_BINARY_EOT      0x04 //!< TWE-LITE binary frame trailer
+#define TWELITE_BINARY_OVERHEAD 6 //!< header, length(2), checksum and trailer
+#define TWELITE_BINARY_PAYLOAD_MAX ((TWELITE_FRAME_LENGTH_MAX - 3) / 2) //!< TWE-LITE binary payload length max.
+#ifndef TWELITE_FRAMER_BUF_SIZE
+#define TWELITE_FRAMER_BUF_SIZE (1024 + TWELITE_FRAME_LENGTH_MAX) //!< framer buffer size
+#endif
+
+/** <!-- twelite_format_t {{{1 -->
+ * @brief frame format of TWE-LITE UART
+ */
+typedef enum twelite_format_t_tag {
+    TWELITE_FORMAT_ASCII = 0, //!< ascii hexadecimal, CR/LF terminated
+    TWELITE_FORMAT_BINARY, //!< binary transfer mode, length prefixed
+} twelite_format_t;
+
+/** <!-- twelite_framer_t {{{1 -->
+ * @brief TWE-LITE app_tag stream framer
+ *
+ * Received bytes are written in place (see twelite_framer_wptr()), and
+ * only the trailing partial frame is moved to the head of buffer when
+ * all complete frames are consumed.
+ */
+typedef struct twelite_framer_t_tag {
+    char buf[TWELITE_FRAMER_BUF_SIZE]; //!< receive buffer
+    int32_t tail; //!< end of received data
+    int32_t scan; //!< scanning position
+    int32_t start; //!< start of current frame (-1: out of frame)
+    uint8_t format; //!< frame format (twelite_format_t)
+    uint32_t n_frame; //!< number of complete frames
+    uint32_t n_resync; //!< number of frames broken by next start character, or false binary headers
+    uint32_t n_oversize; //!< number of ascii frames exceeding max. length
+} twelite_framer_t;
+
+/** <!-- twelite_framer_init {{{1 -->
+ * @brief initialise framer
+ * @param[out] fr framer
+ * @return nothing
+ */
+void twelite_framer_init(twelite_framer_t *fr);
+
+/** <!-- twelite_framer_format {{{1 -->
+ * @brief select frame format (ascii after twelite_framer_init())
+ * @param[in,out] fr framer
+ * @param[in] format frame format
+ * @return nothing
+ */
+void twelite_framer_format(twelite_framer_t *fr, twelite_format_t format);
+
+/** <!-- twelite_framer_reset {{{1 -->
+ * @brief discard received data (statistics are kept)
+ * @param[in,out] fr framer
+ * @return nothing
+ */
+void twelite_framer_reset(twelite_framer_t *fr);
+
+/** <!-- twelite_framer_wptr {{{1 -->
+ * @brief get write pointer of framer to receive data in place
+ * @param[in] fr framer
+ * @param[out] room writable length
+ * @return write pointer
+ */
+char *twelite_framer_wptr(twelite_framer_t *fr, int32_t *room);
+
+/** <!-- twelite_framer_commit {{{1 -->
+ * @brief commit data written to twelite_framer_wptr()
+ * @param[in,out] fr framer
+ * @param[in] len length of written data
+ * @return result of commit
+ * @retval Zero: Success
+ * @retval -ve_value: Error
+ */
+int8_t twelite_framer_commit(twelite_framer_t *fr, int32_t len);
+
+/** <!-- twelite_framer_push {{{1 -->
+ * @brief copy received data into framer
+ * @param[in,out] fr framer
+ * @param[in] data received data
+ * @param[in] len length of data
+ * @return length of copied data
+ */
+int32_t twelite_framer_push(twelite_framer_t *fr, const char *data, int32_t len);
+
+/** <!-- twelite_framer_next {{{1 -->
+ * @brief extract next complete frame
+ *
+ * An ascii frame starts with TWELITE_FRAME_START and excludes CR/LF. A
+ * binary frame is returned as a whole, from header to trailer. It points
+ * into framer buffer and is valid until this function returns zero.
+ * @param[in,out] fr framer
+ * @param[out] frame start of frame
+ * @return length of frame
+ * @retval Zero: no more complete frame
+ */
+int32_t twelite_framer_next(twelite_framer_t *fr, char **frame);
+
+#endif // FRAMER_H
+
+// end of file {{{1
+// vim:ft=c:et:nowrap:fdm=marker
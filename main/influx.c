@@ -0,0 +1,154 @@
+/**
+ * Copyright (C) 2017 m2enu
+ *
+ * @file main/influx.c
+ * @brief InfluxDB line protocol over UDP sink
+ * @author m2enu
+ * @date 2026/10/16
+ */
+#include <stdint.h>
+#include <string.h>
+
+#include "influx.h"
+#include "json.h"
+
+/** <!-- influx_timestamp {{{1 -->
+ * @brief write timestamp in nanoseconds
+ * @param[in,out] w writer
+ * @param[in] msec time [ms since epoch]
+ * @return nothing
+ */
+static void influx_timestamp(json_writer_t *w, int64_t msec)
+{
+    uint64_t ms = (msec < 0) ? 0 : (uint64_t)msec;
+    if (ms >= 1000000000u) {
+        json_uint(w, (uint32_t)(ms / 1000000000u), 1);
+        json_uint(w, (uint32_t)(ms % 1000000000u), 9);
+    } else {
+        json_uint(w, (uint32_t)ms, 1);
+    }
+    json_raw(w, "000000", 6);
+}
+
+/** <!-- influx_format {{{1 -->
+ * @brief serialize packets into line protocol
+ *
+ * e.g. twelite,sid=810015cc lqi=100i,temperature=20.05,vdd=3.000 <ns>
+ * @param[in] ctx InfluxDB UDP sink
+ * @param[out] dst line protocol
+ * @param[in] size size of dst
+ * @param[in] pkt TWE-LITE packets
+ * @param[in] num number of packets
+ * @return length of line protocol
+ * @retval -ve_value: dst is too small
+ */
+int32_t influx_format(void *ctx, char *dst, int32_t size,
+                      const twelite_packet_t *pkt, uint32_t num)
+{
+    const influx_t *c = (const influx_t *)ctx;
+    json_writer_t w;
+    uint32_t n, i;
+    int32_t val;
+    json_init(&w, dst, size);
+    for (n = 0; n < num; n++) {
+        json_puts(&w, INFLUX_MEASUREMENT ",sid=");
+        json_hex(&w, pkt[n].sid_enddevice, 8);
+        json_raw(&w, " lqi=", 5);
+        json_uint(&w, pkt[n].lqi, 1);
+        json_raw(&w, "i", 1);
+        for (i = 0; i < TWELITE_STREAM_NUM; i++) {
+            if (twelite_stream_value(&pkt[n], i, &val) < 0) {
+                continue;
+            }
+            json_raw(&w, ",", 1);
+            json_puts(&w, twelite_streams[i].name);
+            json_raw(&w, "=", 1);
+            json_fixed(&w, val, twelite_streams[i].frac);
+        }
+        json_raw(&w, " ", 1);
+        influx_timestamp(&w, timemap_wall(c->ops.clock, pkt[n].timestamp));
+        json_raw(&w, "\n", 1);
+    }
+    return json_finish(&w);
+}
+
+/** <!-- influx_send {{{1 -->
+ * @brief send line protocol in datagrams split at line ends
+ * @param[in,out] ctx InfluxDB UDP sink
+ * @param[in] data line protocol
+ * @param[in] len length of data
+ * @return result of send
+ * @retval Zero: Success
+ * @retval -ve_value: Error
+ */
+static int8_t influx_send(void *ctx, const char *data, int32_t len)
+{
+    influx_t *c = (influx_t *)ctx;
+    if (c->sock < 0) {
+        c->sock = sink_connect(c->host, c->port, SOCK_DGRAM);
+        if (c->sock < 0) {
+            return -1;
+        }
+    }
+    while (len > 0) {
+        int32_t n = len;
+        if (n > INFLUX_DGRAM_MAX) {
+            // the last line end which fits into a datagram
+            for (n = INFLUX_DGRAM_MAX; (n > 0) && (data[n - 1] != '\n'); n--);
+            if (n == 0) {
+                return -1;
+            }
+        }
+        if (send(c->sock, data, n, 0) != n) {
+            return -1;
+        }
+        data += n;
+        len  -= n;
+    }
+    return 0;
+}
+
+/** <!-- influx_close {{{1 -->
+ * @brief close UDP socket
+ * @param[in,out] ctx InfluxDB UDP sink
+ * @return nothing
+ */
+static void influx_close(void *ctx)
+{
+    influx_t *c = (influx_t *)ctx;
+    if (c->sock >= 0) {
+        close(c->sock);
+    }
+    c->sock = -1;
+}
+
+/** <!-- influx_init {{{1 -->
+ * @brief initialise InfluxDB UDP sink
+ * @param[out] c InfluxDB UDP sink
+ * @param[in] host host name
+ * @param[in] port UDP port number
+ * @param[in] clock clock mapping of timestamps
+ * @return result of initialisation
+ * @retval Zero: Success
+ * @retval -ve_value: Error
+ */
+int8_t influx_init(influx_t *c, const char *host, uint16_t port,
+                   const timemap_t *clock)
+{
+    memset(c, 0, sizeof(influx_t));
+    c->sock = -1;
+    c->port = port;
+    if (strlen(host) >= sizeof(c->host)) {
+        return -1;
+    }
+    strcpy(c->host, host);
+    c->ops.format   = influx_format;
+    c->ops.send     = influx_send;
+    c->ops.close    = influx_close;
+    c->ops.ctx      = c;
+    c->ops.clock    = clock;
+    return 0;
+}
+
+// end of file {{{1
+// vim:ft=c:et:nowrap:fdm=marker
@@ -0,0 +1,60 @@
+/**
+ * Copyright (C) 2017 m2enu
+ *
+ * @file main/influx.h
+ * @brief InfluxDB line protocol over UDP sink
+ * @author m2enu
+ * @date 2026/10/16
+ */
+#ifndef INFLUX_H
+#define INFLUX_H
+
+#include <stdint.h>
+
+#include "sink.h"
+
+#define INFLUX_MEASUREMENT  "twelite" //!< measurement of line protocol
+#define INFLUX_DGRAM_MAX    1400 //!< max. size of one datagram [byte]
+
+/** <!-- influx_t {{{1 -->
+ * @brief InfluxDB UDP sink
+ */
+typedef struct influx_t_tag {
+    char host[64]; //!< host name
+    uint16_t port; //!< UDP port number
+    int sock; //!< connected UDP socket (-1: not connected)
+    sink_ops_t ops; //!< sink operations
+} influx_t;
+
+/** <!-- influx_init {{{1 -->
+ * @brief initialise InfluxDB UDP sink
+ * @param[out] c InfluxDB UDP sink
+ * @param[in] host host name
+ * @param[in] port UDP port number
+ * @param[in] clock clock mapping of timestamps
+ * @return result of initialisation
+ * @retval Zero: Success
+ * @retval -ve_value: Error
+ */
+int8_t influx_init(influx_t *c, const char *host, uint16_t port,
+                   const timemap_t *clock);
+
+/** <!-- influx_format {{{1 -->
+ * @brief serialize packets into line protocol
+ *
+ * e.g. twelite,sid=810015cc lqi=100i,temperature=20.05,vdd=3.000 <ns>
+ * @param[in] ctx InfluxDB UDP sink
+ * @param[out] dst line protocol
+ * @param[in] size size of dst
+ * @param[in] pkt TWE-LITE packets
+ * @param[in] num number of packets
+ * @return length of line protocol
+ * @retval -ve_value: dst is too small
+ */
+int32_t influx_format(void *ctx, char *dst, int32_t size,
+                      const twelite_packet_t *pkt, uint32_t num);
+
+#endif // INFLUX_H
+
+// end of file {{{1
+// vim:ft=c:et:nowrap:fdm=marker
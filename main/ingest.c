@@ -0,0 +1,98 @@
+/**
+ * Copyright (C) 2017 m2enu
+ *
+ * @file main/ingest.c
+ * @brief event-driven ingestion of TWE-LITE app_tag stream
+ * @author m2enu
+ * @date 2026/10/16
+ */
+#include <stdint.h>
+#include <string.h>
+
+#include "ingest.h"
+#include "port.h"
+
+/** <!-- ingest_init {{{1 -->
+ * @brief initialise ingestion
+ *
+ * With data_thresh of zero every INGEST_DATA is read (polling). Otherwise
+ * data is left in the driver until a line end is signalled, unless it
+ * exceeds data_thresh without one.
+ * @param[out] in ingestion state
+ * @param[in] ops input device and frame consumer
+ * @param[in] data_thresh INGEST_DATA is read only from this length
+ * @return nothing
+ */
+void ingest_init(ingest_t *in, const ingest_ops_t *ops, int32_t data_thresh)
+{
+    memset(in, 0, sizeof(ingest_t));
+    twelite_framer_init(&in->framer);
+    in->ops = ops;
+    in->data_thresh = data_thresh;
+}
+
+/** <!-- ingest_read {{{1 -->
+ * @brief read data into framer and dispatch complete frames
+ * @param[in,out] in ingestion state
+ * @param[in] size length of data to read
+ * @return number of dispatched frames
+ */
+static int32_t ingest_read(ingest_t *in, int32_t size)
+{
+    int32_t num = 0;
+    int32_t room, len;
+    char *frame;
+    while (size > 0) {
+        char *wptr = twelite_framer_wptr(&in->framer, &room);
+        len = in->ops->read(in->ops->ctx, wptr, (size < room) ? size : room);
+        if (len <= 0) {
+            break;
+        }
+        twelite_framer_commit(&in->framer, len);
+        in->n_byte += len;
+        size -= len;
+        while ((len = twelite_framer_next(&in->framer, &frame)) > 0) {
+            in->ops->dispatch(in->ops->ctx, frame, len);
+            num++;
+        }
+    }
+    in->n_dispatch += num;
+    return num;
+}
+
+/** <!-- ingest_event {{{1 -->
+ * @brief handle one ingestion event
+ *
+ * Frames dispatched by the event are stamped by stamp, taken when the
+ * event is handled.
+ * @param[in,out] in ingestion state
+ * @param[in] ev event
+ * @param[in] size length of data concerned [byte]
+ * @return number of dispatched frames
+ * @retval -ve_value: input lost (overflow)
+ */
+int32_t ingest_event(ingest_t *in, ingest_event_t ev, int32_t size)
+{
+    if ((uint32_t)ev >= INGEST_EVENT_NUM) {
+        return 0;
+    }
+    in->n_event[ev]++;
+    in->stamp = port_msec();
+    switch (ev) {
+    case INGEST_DATA:
+        if (size < in->data_thresh) {
+            return 0; // wait for line end
+        }
+        return ingest_read(in, size);
+    case INGEST_PATTERN:
+        return ingest_read(in, size);
+    default:
+        // the partial frame is broken anyway, restart from next frame
+        in->ops->flush(in->ops->ctx);
+        twelite_framer_reset(&in->framer);
+        return -1;
+    }
+}
+
+// end of file {{{1
+// vim:ft=c:et:nowrap:fdm=marker
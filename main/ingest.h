@@ -0,0 +1,83 @@
+/**
+ * Copyright (C) 2017 m2enu
+ *
+ * @file main/ingest.h
+ * @brief event-driven ingestion of TWE-LITE app_tag stream
+ *
+ * UART driver events are translated into ingest_event() calls, so the
+ * framing and dispatch logic can be driven by simulated event sequences
+ * on the host as well.
+ * @author m2enu
+ * @date 2026/10/16
+ */
+#ifndef INGEST_H
+#define INGEST_H
+
+#include <stdint.h>
+
+#include "framer.h"
+
+/** <!-- ingest_event_t {{{1 -->
+ * @brief ingestion events
+ */
+typedef enum ingest_event_t_tag {
+    INGEST_DATA = 0, //!< data received (size: buffered length)
+    INGEST_PATTERN, //!< end of line detected (size: length up to it)
+    INGEST_FIFO_OVF, //!< hardware FIFO overflow
+    INGEST_BUFFER_FULL, //!< driver ring buffer full
+    INGEST_EVENT_NUM,
+} ingest_event_t;
+
+/** <!-- ingest_ops_t {{{1 -->
+ * @brief input device and frame consumer of ingestion
+ */
+typedef struct ingest_ops_t_tag {
+    int32_t (*read)(void *ctx, char *dst, int32_t len); //!< read buffered data without blocking
+    void (*flush)(void *ctx); //!< discard buffered data and pending events
+    void (*dispatch)(void *ctx, const char *frame, int32_t len); //!< consume one frame
+    void *ctx; //!< context of callbacks
+} ingest_ops_t;
+
+/** <!-- ingest_t {{{1 -->
+ * @brief ingestion state
+ */
+typedef struct ingest_t_tag {
+    twelite_framer_t framer; //!< app_tag stream framer
+    const ingest_ops_t *ops; //!< input device and frame consumer
+    int32_t data_thresh; //!< INGEST_DATA is read only from this length
+    uint32_t n_event[INGEST_EVENT_NUM]; //!< number of events by type
+    uint32_t n_byte; //!< number of bytes read
+    uint32_t n_dispatch; //!< number of dispatched frames
+    int64_t stamp; //!< monotonic time of the event being handled [ms]
+} ingest_t;
+
+/** <!-- ingest_init {{{1 -->
+ * @brief initialise ingestion
+ *
+ * With data_thresh of zero every INGEST_DATA is read (polling). Otherwise
+ * data is left in the driver until a line end is signalled, unless it
+ * exceeds data_thresh without one.
+ * @param[out] in ingestion state
+ * @param[in] ops input device and frame consumer
+ * @param[in] data_thresh INGEST_DATA is read only from this length
+ * @return nothing
+ */
+void ingest_init(ingest_t *in, const ingest_ops_t *ops, int32_t data_thresh);
+
+/** <!-- ingest_event {{{1 -->
+ * @brief handle one ingestion event
+ *
+ * Frames dispatched by the event are stamped by stamp, taken when the
+ * event is handled.
+ * @param[in,out] in ingestion state
+ * @param[in] ev event
+ * @param[in] size length of data concerned [byte]
+ * @return number of dispatched frames
+ * @retval -ve_value: input lost (overflow)
+ */
+int32_t ingest_event(ingest_t *in, ingest_event_t ev, int32_t size);
+
+#endif // INGEST_H
+
+// end of file {{{1
+// vim:ft=c:et:nowrap:fdm=marker
@@ -0,0 +1,496 @@
+/**
+ * Copyright (C) 2017 m2enu
+ *
+ * @file main/journal.c
+ * @brief append-only store-and-forward journal of TWE-LITE packets on flash
+ * @author m2enu
+ * @date 2026/10/16
+ */
+#include <stdint.h>
+#include <string.h>
+
+#include "journal.h"
+
+#ifdef ESP_PLATFORM
+#include "esp_partition.h"
+#endif
+
+/* Record layout (little endian, JOURNAL_REC_SIZE bytes):
+ *    0: seq            4: timestamp (8)   12: sid_router     16: sid_enddevice
+ *   20: payload w32   24: next_number    26: mvolt_vdd      28: mvolt_adc1
+ *   30: mvolt_adc2    32: payload w16[0] 34: payload w16[1] 36: payload w16[2]
+ *   38: lqi           39: id_enddevice   40: id_sensor      41: checksum
+ *   42: crc16 of 0..41                   44: state (0xffffffff: unconsumed)
+ * timestamp is wall clock [ms since epoch], as monotonic time restarts at
+ * reboot. seq wraps around, and is compared by its difference (records in
+ * journal are far less than 2^31 apart).
+ */
+#define JOURNAL_REC_CRC     42 //!< offset of CRC in record
+#define JOURNAL_REC_STATE   44 //!< offset of state in record
+#define JOURNAL_UNCONSUMED  0xffffffff //!< state of unconsumed record
+
+/** <!-- journal_crc16 {{{1 -->
+ * @brief CRC-16/CCITT-FALSE
+ * @param[in] data data
+ * @param[in] len length of data
+ * @return CRC
+ */
+static uint16_t journal_crc16(const uint8_t *data, uint32_t len)
+{
+    uint16_t crc = 0xffff;
+    uint32_t i;
+    int32_t b;
+    for (i = 0; i < len; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (b = 0; b < 8; b++) {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+/** <!-- journal_put {{{1 -->
+ * @brief store little endian value
+ * @param[out] dst destination
+ * @param[in] val value
+ * @param[in] len length of value [byte]
+ * @return nothing
+ */
+static void journal_put(uint8_t *dst, uint64_t val, int32_t len)
+{
+    int32_t i;
+    for (i = 0; i < len; i++) {
+        dst[i] = (uint8_t)(val >> (i * 8));
+    }
+}
+
+/** <!-- journal_get {{{1 -->
+ * @brief load little endian value
+ * @param[in] src source
+ * @param[in] len length of value [byte]
+ * @return value
+ */
+static uint64_t journal_get(const uint8_t *src, int32_t len)
+{
+    uint64_t val = 0;
+    int32_t i;
+    for (i = len - 1; i >= 0; i--) {
+        val = (val << 8) | src[i];
+    }
+    return val;
+}
+
+/** <!-- journal_encode {{{1 -->
+ * @brief encode packet into record
+ * @param[out] rec record
+ * @param[in] pkt TWE-LITE packet
+ * @param[in] seq sequence number
+ * @param[in] clock clock mapping of timestamps
+ * @return nothing
+ */
+static void journal_encode(uint8_t *rec, const twelite_packet_t *pkt,
+                           uint32_t seq, const timemap_t *clock)
+{
+    journal_put(&rec[ 0], seq, 4);
+    journal_put(&rec[ 4], (uint64_t)timemap_wall(clock, pkt->timestamp), 8);
+    journal_put(&rec[12], pkt->sid_router, 4);
+    journal_put(&rec[16], pkt->sid_enddevice, 4);
+    journal_put(&rec[20], pkt->pkt_raw.w32, 4);
+    journal_put(&rec[24], pkt->next_number, 2);
+    journal_put(&rec[26], pkt->mvolt_vdd, 2);
+    journal_put(&rec[28], pkt->mvolt_adc1, 2);
+    journal_put(&rec[30], pkt->mvolt_adc2, 2);
+    journal_put(&rec[32], pkt->pkt_raw.w16[0], 2);
+    journal_put(&rec[34], pkt->pkt_raw.w16[1], 2);
+    journal_put(&rec[36], pkt->pkt_raw.w16[2], 2);
+    rec[38] = pkt->lqi;
+    rec[39] = pkt->id_enddevice;
+    rec[40] = pkt->id_sensor;
+    rec[41] = pkt->checksum;
+    journal_put(&rec[JOURNAL_REC_CRC], journal_crc16(rec, JOURNAL_REC_CRC), 2);
+    memset(&rec[JOURNAL_REC_STATE], 0xff, JOURNAL_REC_SIZE - JOURNAL_REC_STATE);
+}
+
+/** <!-- journal_decode {{{1 -->
+ * @brief decode record into packet
+ * @param[out] pkt TWE-LITE packet
+ * @param[in] rec record
+ * @param[in] clock clock mapping of timestamps
+ * @return nothing
+ */
+static void journal_decode(twelite_packet_t *pkt, const uint8_t *rec,
+                           const timemap_t *clock)
+{
+    memset(pkt, 0, sizeof(*pkt));
+    pkt->ok                         = 1;
+    pkt->timestamp                  = timemap_mono(clock, (int64_t)journal_get(&rec[ 4], 8));
+    pkt->sid_router                 = journal_get(&rec[12], 4);
+    pkt->sid_enddevice              = journal_get(&rec[16], 4);
+    pkt->pkt_raw.w32                = journal_get(&rec[20], 4);
+    pkt->next_number                = journal_get(&rec[24], 2);
+    pkt->mvolt_vdd                  = journal_get(&rec[26], 2);
+    pkt->mvolt_adc1                 = journal_get(&rec[28], 2);
+    pkt->mvolt_adc2                 = journal_get(&rec[30], 2);
+    pkt->pkt_raw.w16[0]             = journal_get(&rec[32], 2);
+    pkt->pkt_raw.w16[1]             = journal_get(&rec[34], 2);
+    pkt->pkt_raw.w16[2]             = journal_get(&rec[36], 2);
+    pkt->lqi                        = rec[38];
+    pkt->id_enddevice               = rec[39];
+    pkt->id_sensor                  = rec[40];
+    pkt->checksum                   = rec[41];
+    pkt->checksum_calc              = rec[41];
+    twelite_sensor_resolve(pkt);
+}
+
+/** <!-- journal_addr {{{1 -->
+ * @brief storage address of record
+ * @param[in] j journal
+ * @param[in] pos position of record
+ * @return address
+ */
+static uint32_t journal_addr(const journal_t *j, uint32_t pos)
+{
+    return (pos / j->slots) * j->ops->sector_size
+         + JOURNAL_HEAD_SIZE + (pos % j->slots) * JOURNAL_REC_SIZE;
+}
+
+/** <!-- journal_read_rec {{{1 -->
+ * @brief read and check record
+ * @param[in] j journal
+ * @param[in] pos position of record
+ * @param[out] rec record
+ * @return state of record
+ * @retval Zero: valid record
+ * @retval +ve_value: empty slot
+ * @retval -ve_value: corrupt record or read error
+ */
+static int8_t journal_read_rec(const journal_t *j, uint32_t pos, uint8_t *rec)
+{
+    if (j->ops->read(j->ops->ctx, journal_addr(j, pos), rec, JOURNAL_REC_SIZE)) {
+        return -1;
+    }
+    if (journal_get(&rec[JOURNAL_REC_CRC], 2) != journal_crc16(rec, JOURNAL_REC_CRC)) {
+        return (journal_get(rec, 4) == 0xffffffff) ? 1 : -1;
+    }
+    return 0;
+}
+
+/** <!-- journal_mount {{{1 -->
+ * @brief mount journal and recover positions from storage
+ * @param[out] j journal
+ * @param[in] ops storage backend
+ * @param[in] clock clock mapping of timestamps (records hold wall clock)
+ * @return result of mount
+ * @retval Zero: Success
+ * @retval -ve_value: Error
+ */
+int8_t journal_mount(journal_t *j, const journal_ops_t *ops,
+                     const timemap_t *clock)
+{
+    uint8_t rec[JOURNAL_REC_SIZE];
+    uint8_t head[JOURNAL_HEAD_SIZE];
+    uint32_t pos, s;
+    uint32_t seq_max = 0;
+    uint32_t seq_consumed = 0;
+    int8_t found = 0;
+    int8_t marked = 0;
+    memset(j, 0, sizeof(*j));
+    if ((ops->sector_num < 2) || (ops->sector_size <= JOURNAL_HEAD_SIZE + JOURNAL_REC_SIZE)) {
+        return -1;
+    }
+    j->ops   = ops;
+    j->clock = clock;
+    j->slots = (ops->sector_size - JOURNAL_HEAD_SIZE) / JOURNAL_REC_SIZE;
+    j->total = j->slots * ops->sector_num;
+
+    // 1st pass: the newest record and the newest consumed record
+    for (s = 0; s < ops->sector_num; s++) {
+        if (ops->read(ops->ctx, s * ops->sector_size, head, sizeof(head)) ||
+            (journal_get(head, 4) != JOURNAL_MAGIC)) {
+            continue;
+        }
+        for (pos = s * j->slots; pos < (s + 1) * j->slots; pos++) {
+            if (journal_read_rec(j, pos, rec)) {
+                continue;
+            }
+            uint32_t seq = journal_get(rec, 4);
+            if (!found || ((int32_t)(seq - seq_max) > 0)) {
+                seq_max = seq;
+                j->wr = (pos + 1) % j->total;
+                found = 1;
+            }
+            // partly written mark is taken, the records were delivered
+            if ((journal_get(&rec[JOURNAL_REC_STATE], 4) != JOURNAL_UNCONSUMED) &&
+                (!marked || ((int32_t)(seq + 1 - seq_consumed) > 0))) {
+                seq_consumed = seq + 1;
+                marked = 1;
+            }
+        }
+    }
+    j->seq = found ? seq_max + 1 : 0;
+    // slots torn by reset while appending can not be written again
+    while ((j->wr % j->slots != 0) && (journal_read_rec(j, j->wr, rec) < 0)) {
+        j->wr = (j->wr + 1) % j->total;
+    }
+
+    // 2nd pass: unconsumed records, starting from the oldest sector
+    j->rd = j->wr;
+    for (pos = 0; pos < j->total; pos++) {
+        uint32_t p = (j->wr + pos) % j->total;
+        if ((journal_read_rec(j, p, rec) == 0) &&
+            (!marked || ((int32_t)(journal_get(rec, 4) - seq_consumed) >= 0)) &&
+            ((int32_t)(journal_get(rec, 4) - j->seq) < 0)) {
+            if (j->count == 0) {
+                j->rd = p;
+            }
+            j->count = (p >= j->rd) ? (p - j->rd + 1) : (j->total - j->rd + p + 1);
+        }
+    }
+    return 0;
+}
+
+/** <!-- journal_enter_sector {{{1 -->
+ * @brief erase next sector to append, dropping its unconsumed records
+ * @param[in,out] j journal
+ * @return result of erase
+ * @retval Zero: Success
+ * @retval +ve_value: Warning (unconsumed records were overwritten)
+ * @retval -ve_value: Error
+ */
+static int8_t journal_enter_sector(journal_t *j)
+{
+    int8_t ret = 0;
+    uint8_t head[JOURNAL_HEAD_SIZE];
+    uint32_t s = j->wr / j->slots;
+    uint32_t addr = s * j->ops->sector_size;
+    uint32_t erase_count = 0;
+    if ((j->count > 0) && (j->rd / j->slots == s)) {
+        uint32_t drop = j->slots - (j->rd % j->slots);
+        if (drop > j->count) {
+            drop = j->count;
+        }
+        j->count -= drop;
+        j->rd = ((s + 1) * j->slots) % j->total;
+        j->n_overwrite += drop;
+        ret = 1;
+    }
+    if ((j->ops->read(j->ops->ctx, addr, head, sizeof(head)) == 0) &&
+        (journal_get(head, 4) == JOURNAL_MAGIC)) {
+        erase_count = journal_get(&head[4], 4) + 1;
+    }
+    if (j->ops->erase(j->ops->ctx, addr, j->ops->sector_size)) {
+        return -1;
+    }
+    j->n_erase++;
+    memset(head, 0xff, sizeof(head));
+    journal_put(&head[0], JOURNAL_MAGIC, 4);
+    journal_put(&head[4], erase_count, 4);
+    if (j->ops->write(j->ops->ctx, addr, head, sizeof(head))) {
+        return -1;
+    }
+    return ret;
+}
+
+/** <!-- journal_append {{{1 -->
+ * @brief append packet to journal
+ * @param[in,out] j journal
+ * @param[in] pkt TWE-LITE packet
+ * @return result of append
+ * @retval Zero: Success
+ * @retval +ve_value: Warning (the oldest unconsumed records were overwritten)
+ * @retval -ve_value: Error
+ */
+int8_t journal_append(journal_t *j, const twelite_packet_t *pkt)
+{
+    uint8_t rec[JOURNAL_REC_SIZE];
+    int8_t ret = 0;
+    if (j->ops == NULL) {
+        return -1;
+    }
+    if (j->wr % j->slots == 0) {
+        if ((ret = journal_enter_sector(j)) < 0) {
+            return ret;
+        }
+    }
+    journal_encode(rec, pkt, j->seq, j->clock);
+    if (j->ops->write(j->ops->ctx, journal_addr(j, j->wr), rec, sizeof(rec))) {
+        return -1;
+    }
+    if (j->count == 0) {
+        j->rd = j->wr;
+    }
+    j->wr = (j->wr + 1) % j->total;
+    j->seq++;
+    j->count++;
+    j->n_append++;
+    return ret;
+}
+
+/** <!-- journal_peek {{{1 -->
+ * @brief read the oldest unconsumed packets without consuming them
+ * @param[in,out] j journal
+ * @param[out] pkt packets
+ * @param[in] num max. number of packets
+ * @param[out] span number of records to pass to journal_consume()
+ * @return number of packets read
+ * @retval -ve_value: Error
+ */
+int32_t journal_peek(journal_t *j, twelite_packet_t *pkt, uint32_t num,
+                     uint32_t *span)
+{
+    uint8_t rec[JOURNAL_REC_SIZE];
+    uint32_t n = 0;
+    uint32_t i;
+    *span = 0;
+    if (j->ops == NULL) {
+        return -1;
+    }
+    for (i = 0; (i < j->count) && (n < num); i++) {
+        if (journal_read_rec(j, (j->rd + i) % j->total, rec)) {
+            j->n_corrupt++;
+            continue; // consumed together with valid records
+        }
+        journal_decode(&pkt[n++], rec, j->clock);
+    }
+    *span = i;
+    return n;
+}
+
+/** <!-- journal_consume {{{1 -->
+ * @brief mark the oldest records consumed
+ * @param[in,out] j journal
+ * @param[in] span number of records (see journal_peek())
+ * @return result of consume
+ * @retval Zero: Success
+ * @retval -ve_value: Error
+ */
+int8_t journal_consume(journal_t *j, uint32_t span)
+{
+    uint8_t rec[JOURNAL_REC_SIZE];
+    uint8_t state[4] = {0};
+    uint32_t i;
+    if ((j->ops == NULL) || (span > j->count)) {
+        return -1;
+    }
+    // consumed mark on the last valid record covers all older records,
+    // corrupt records are never taken by mount (no mark needed for them)
+    for (i = span; i > 0; i--) {
+        uint32_t last = (j->rd + i - 1) % j->total;
+        if (journal_read_rec(j, last, rec)) {
+            continue;
+        }
+        if (j->ops->write(j->ops->ctx, journal_addr(j, last) + JOURNAL_REC_STATE,
+                          state, sizeof(state))) {
+            return -1;
+        }
+        break;
+    }
+    j->rd = (j->rd + span) % j->total;
+    j->count -= span;
+    j->n_consume += span;
+    return 0;
+}
+
+/** <!-- journal_mem_read {{{1 -->
+ * @brief read from memory image
+ */
+static int8_t journal_mem_read(void *ctx, uint32_t addr, void *dst, uint32_t len)
+{
+    memcpy(dst, (uint8_t *)ctx + addr, len);
+    return 0;
+}
+
+/** <!-- journal_mem_write {{{1 -->
+ * @brief write to memory image (clear bits only, like NOR flash)
+ */
+static int8_t journal_mem_write(void *ctx, uint32_t addr, const void *src, uint32_t len)
+{
+    uint8_t *dst = (uint8_t *)ctx + addr;
+    const uint8_t *s = src;
+    uint32_t i;
+    for (i = 0; i < len; i++) {
+        dst[i] &= s[i];
+    }
+    return 0;
+}
+
+/** <!-- journal_mem_erase {{{1 -->
+ * @brief erase memory image
+ */
+static int8_t journal_mem_erase(void *ctx, uint32_t addr, uint32_t len)
+{
+    memset((uint8_t *)ctx + addr, 0xff, len);
+    return 0;
+}
+
+/** <!-- journal_mem_ops {{{1 -->
+ * @brief storage backend on memory image (RAM or mmap'd file)
+ * @param[out] ops storage backend
+ * @param[in] image memory image (sector_size * sector_num bytes)
+ * @param[in] sector_size size of erase sector [byte]
+ * @param[in] sector_num number of sectors
+ * @return nothing
+ */
+void journal_mem_ops(journal_ops_t *ops, uint8_t *image,
+                     uint32_t sector_size, uint32_t sector_num)
+{
+    ops->read           = journal_mem_read;
+    ops->write          = journal_mem_write;
+    ops->erase          = journal_mem_erase;
+    ops->ctx            = image;
+    ops->sector_size    = sector_size;
+    ops->sector_num     = sector_num;
+}
+
+#ifdef ESP_PLATFORM
+/** <!-- journal_part_read {{{1 -->
+ * @brief read from flash partition
+ */
+static int8_t journal_part_read(void *ctx, uint32_t addr, void *dst, uint32_t len)
+{
+    return (esp_partition_read(ctx, addr, dst, len) == ESP_OK) ? 0 : -1;
+}
+
+/** <!-- journal_part_write {{{1 -->
+ * @brief write to flash partition
+ */
+static int8_t journal_part_write(void *ctx, uint32_t addr, const void *src, uint32_t len)
+{
+    return (esp_partition_write(ctx, addr, src, len) == ESP_OK) ? 0 : -1;
+}
+
+/** <!-- journal_part_erase {{{1 -->
+ * @brief erase flash partition
+ */
+static int8_t journal_part_erase(void *ctx, uint32_t addr, uint32_t len)
+{
+    return (esp_partition_erase_range(ctx, addr, len) == ESP_OK) ? 0 : -1;
+}
+
+/** <!-- journal_partition_ops {{{1 -->
+ * @brief storage backend on flash data partition
+ * @param[out] ops storage backend
+ * @param[in] label partition label
+ * @return result of partition lookup
+ * @retval Zero: Success
+ * @retval -ve_value: partition not found
+ */
+int8_t journal_partition_ops(journal_ops_t *ops, const char *label)
+{
+    const esp_partition_t *part = esp_partition_find_first(
+        ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+    if (part == NULL) {
+        return -1;
+    }
+    ops->read           = journal_part_read;
+    ops->write          = journal_part_write;
+    ops->erase          = journal_part_erase;
+    ops->ctx            = (void *)part;
+    ops->sector_size    = SPI_FLASH_SEC_SIZE;
+    ops->sector_num     = part->size / SPI_FLASH_SEC_SIZE;
+    return 0;
+}
+#endif
+
+// end of file {{{1
+// vim:ft=c:et:nowrap:fdm=marker
@@ -0,0 +1,129 @@
+/**
+ * Copyright (C) 2017 m2enu
+ *
+ * @file main/journal.h
+ * @brief append-only store-and-forward journal of TWE-LITE packets on flash
+ * @author m2enu
+ * @date 2026/10/16
+ */
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stdint.h>
+
+#include "timemap.h"
+#include "twelite.h"
+
+#define JOURNAL_MAGIC       0x4c4e524a //!< sector header magic ("JRNL")
+#define JOURNAL_HEAD_SIZE   16 //!< size of sector header [byte]
+#define JOURNAL_REC_SIZE    48 //!< size of record [byte]
+
+/** <!-- journal_ops_t {{{1 -->
+ * @brief storage backend of journal (NOR flash semantics)
+ *
+ * write can only clear bits, erase sets a whole sector to 0xff.
+ */
+typedef struct journal_ops_t_tag {
+    int8_t (*read)(void *ctx, uint32_t addr, void *dst, uint32_t len); //!< read
+    int8_t (*write)(void *ctx, uint32_t addr, const void *src, uint32_t len); //!< write
+    int8_t (*erase)(void *ctx, uint32_t addr, uint32_t len); //!< erase sectors
+    void *ctx; //!< context of backend
+    uint32_t sector_size; //!< size of erase sector [byte]
+    uint32_t sector_num; //!< number of sectors (>= 2)
+} journal_ops_t;
+
+/** <!-- journal_t {{{1 -->
+ * @brief circular log of packet records
+ *
+ * Sectors are written and erased in turn, so wear is spread over all
+ * sectors. Each record carries a sequence number and CRC, and the last
+ * valid record of a drained batch is marked consumed in place.
+ */
+typedef struct journal_t_tag {
+    const journal_ops_t *ops; //!< storage backend
+    const timemap_t *clock; //!< clock mapping of timestamps
+    uint32_t slots; //!< number of records per sector
+    uint32_t total; //!< number of records in journal
+    uint32_t wr; //!< next position to append
+    uint32_t rd; //!< position of the oldest unconsumed record
+    uint32_t count; //!< number of unconsumed records
+    uint32_t seq; //!< next sequence number
+    uint32_t n_append; //!< number of appended records
+    uint32_t n_consume; //!< number of consumed records
+    uint32_t n_overwrite; //!< number of unconsumed records overwritten
+    uint32_t n_corrupt; //!< number of records with CRC error
+    uint32_t n_erase; //!< number of sector erases
+} journal_t;
+
+/** <!-- journal_mount {{{1 -->
+ * @brief mount journal and recover positions from storage
+ * @param[out] j journal
+ * @param[in] ops storage backend
+ * @param[in] clock clock mapping of timestamps (records hold wall clock)
+ * @return result of mount
+ * @retval Zero: Success
+ * @retval -ve_value: Error
+ */
+int8_t journal_mount(journal_t *j, const journal_ops_t *ops,
+                     const timemap_t *clock);
+
+/** <!-- journal_append {{{1 -->
+ * @brief append packet to journal
+ * @param[in,out] j journal
+ * @param[in] pkt TWE-LITE packet
+ * @return result of append
+ * @retval Zero: Success
+ * @retval +ve_value: Warning (the oldest unconsumed records were overwritten)
+ * @retval -ve_value: Error
+ */
+int8_t journal_append(journal_t *j, const twelite_packet_t *pkt);
+
+/** <!-- journal_peek {{{1 -->
+ * @brief read the oldest unconsumed packets without consuming them
+ * @param[in,out] j journal
+ * @param[out] pkt packets
+ * @param[in] num max. number of packets
+ * @param[out] span number of records to pass to journal_consume()
+ * @return number of packets read
+ * @retval -ve_value: Error
+ */
+int32_t journal_peek(journal_t *j, twelite_packet_t *pkt, uint32_t num,
+                     uint32_t *span);
+
+/** <!-- journal_consume {{{1 -->
+ * @brief mark the oldest records consumed
+ * @param[in,out] j journal
+ * @param[in] span number of records (see journal_peek())
+ * @return result of consume
+ * @retval Zero: Success
+ * @retval -ve_value: Error
+ */
+int8_t journal_consume(journal_t *j, uint32_t span);
+
+/** <!-- journal_mem_ops {{{1 -->
+ * @brief storage backend on memory image (RAM or mmap'd file)
+ * @param[out] ops storage backend
+ * @param[in] image memory image (sector_size * sector_num bytes)
+ * @param[in] sector_size size of erase sector [byte]
+ * @param[in] sector_num number of sectors
+ * @return nothing
+ */
+void journal_mem_ops(journal_ops_t *ops, uint8_t *image,
+                     uint32_t sector_size, uint32_t sector_num);
+
+#ifdef ESP_PLATFORM
+/** <!-- journal_partition_ops {{{1 -->
+ * @brief storage backend on flash data partition
+ * @param[out] ops storage backend
+ * @param[in] label partition label
+ * @return result of partition lookup
+ * @retval Zero: Success
+ * @retval -ve_value: partition not found
+ */
+int8_t journal_partition_ops(journal_ops_t *ops, const char *label);
+#endif
+
+#endif // JOURNAL_H
+
+// end of file {{{1
+// vim:ft=c:et:nowrap:fdm=marker
@@ -0,0 +1,208 @@
+/**
+ * Copyright (C) 2017 m2enu
+ *
+ * @file main/json.c
+ * @brief bounds-checked streaming JSON writer without printf/float
+ * @author m2enu
+ * @date 2026/10/16
+ */
+#include <stdint.h>
+#include <string.h>
+
+#include "json.h"
+
+/** <!-- json_init {{{1 -->
+ * @brief initialise JSON writer
+ * @param[out] w JSON writer
+ * @param[in] buf output buffer
+ * @param[in] size size of output buffer
+ * @return nothing
+ */
+void json_init(json_writer_t *w, char *buf, int32_t size)
+{
+    w->buf  = buf;
+    w->size = size;
+    w->len  = 0;
+    w->err  = (size > 0) ? 0 : -1;
+}
+
+/** <!-- json_raw {{{1 -->
+ * @brief write raw characters
+ * @param[in,out] w JSON writer
+ * @param[in] str characters
+ * @param[in] len number of characters
+ * @return nothing
+ */
+void json_raw(json_writer_t *w, const char *str, int32_t len)
+{
+    if (w->err || (len >= w->size - w->len)) {
+        w->err = -1; // keep room for NUL
+        return;
+    }
+    memcpy(&w->buf[w->len], str, len);
+    w->len += len;
+}
+
+/** <!-- json_puts {{{1 -->
+ * @brief write raw string
+ * @param[in,out] w JSON writer
+ * @param[in] str string
+ * @return nothing
+ */
+void json_puts(json_writer_t *w, const char *str)
+{
+    json_raw(w, str, strlen(str));
+}
+
+/** <!-- json_key {{{1 -->
+ * @brief write object key ("key":)
+ * @param[in,out] w JSON writer
+ * @param[in] key key (no escape)
+ * @return nothing
+ */
+void json_key(json_writer_t *w, const char *key)
+{
+    json_raw(w, "\"", 1);
+    json_puts(w, key);
+    json_raw(w, "\":", 2);
+}
+
+/** <!-- json_uint {{{1 -->
+ * @brief write unsigned integer
+ * @param[in,out] w JSON writer
+ * @param[in] val value
+ * @param[in] width minimum number of digits (zero padded)
+ * @return nothing
+ */
+void json_uint(json_writer_t *w, uint32_t val, uint8_t width)
+{
+    char tmp[10];
+    int32_t pos = sizeof(tmp);
+    do {
+        tmp[--pos] = '0' + (val % 10);
+        val /= 10;
+    } while ((val > 0) && (pos > 0));
+    while ((pos > 0) && ((int32_t)sizeof(tmp) - pos < width)) {
+        tmp[--pos] = '0';
+    }
+    json_raw(w, &tmp[pos], sizeof(tmp) - pos);
+}
+
+/** <!-- json_hex {{{1 -->
+ * @brief write unsigned integer in lower case hexadecimal (no prefix)
+ * @param[in,out] w JSON writer
+ * @param[in] val value
+ * @param[in] width number of digits (1 - 8)
+ * @return nothing
+ */
+void json_hex(json_writer_t *w, uint32_t val, uint8_t width)
+{
+    static const char hex[] = "0123456789abcdef";
+    char tmp[8];
+    uint8_t i;
+    if ((width == 0) || (width > sizeof(tmp))) {
+        w->err = -1;
+        return;
+    }
+    for (i = 0; i < width; i++) {
+        tmp[width - 1 - i] = hex[(val >> (i * 4)) & 0x0f];
+    }
+    json_raw(w, tmp, width);
+}
+
+/** <!-- json_fixed {{{1 -->
+ * @brief write fixed-point number
+ * @param[in,out] w JSON writer
+ * @param[in] val value in units of 10^-frac
+ * @param[in] frac number of fractional digits
+ * @return nothing
+ */
+void json_fixed(json_writer_t *w, int32_t val, uint8_t frac)
+{
+    static const uint32_t pow10[] = {1, 10, 100, 1000, 10000, 100000};
+    uint32_t mag = (val < 0) ? -(uint32_t)val : (uint32_t)val;
+    if (frac >= sizeof(pow10) / sizeof(pow10[0])) {
+        w->err = -1;
+        return;
+    }
+    if (val < 0) {
+        json_raw(w, "-", 1);
+    }
+    json_uint(w, mag / pow10[frac], 1);
+    if (frac > 0) {
+        json_raw(w, ".", 1);
+        json_uint(w, mag % pow10[frac], frac);
+    }
+}
+
+/** <!-- json_digits {{{1 -->
+ * @brief put fixed number of decimal digits
+ * @param[out] dst destination
+ * @param[in] val value
+ * @param[in] width number of digits
+ * @return nothing
+ */
+static inline void json_digits(char *dst, uint32_t val, uint8_t width)
+{
+    while (width > 0) {
+        dst[--width] = (char)('0' + val % 10);
+        val /= 10;
+    }
+}
+
+/** <!-- json_timestamp {{{1 -->
+ * @brief write timestamp in ISO 8601
+ *
+ * Date is computed from days since epoch by integer arithmetic (civil
+ * calendar of H. Hinnant), so no gmtime()/strftime() is called.
+ * @param[in,out] w JSON writer
+ * @param[in] msec time [ms since epoch]
+ * @return nothing
+ */
+void json_timestamp(json_writer_t *w, int64_t msec)
+{
+    char buf[26] = "\"0000-00-00T00:00:00.000Z\"";
+    int64_t days = msec / 86400000;
+    int32_t ms = (int32_t)(msec % 86400000);
+    if (ms < 0) {
+        ms += 86400000;
+        days--;
+    }
+    days += 719468; // days from 0000-03-01
+    int64_t era = ((days >= 0) ? days : days - 146096) / 146097;
+    uint32_t doe = (uint32_t)(days - era * 146097); // day of era
+    uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    uint32_t mp = (5 * doy + 2) / 153; // month from March
+    uint32_t mon = (mp < 10) ? mp + 3 : mp - 9;
+    uint32_t year = (uint32_t)(yoe + era * 400) + (mon <= 2);
+    json_digits(&buf[1], year, 4);
+    json_digits(&buf[6], mon, 2);
+    json_digits(&buf[9], doy - (153 * mp + 2) / 5 + 1, 2);
+    json_digits(&buf[12], ms / 3600000, 2);
+    json_digits(&buf[15], ms / 60000 % 60, 2);
+    json_digits(&buf[18], ms / 1000 % 60, 2);
+    json_digits(&buf[21], ms % 1000, 3);
+    json_raw(w, buf, sizeof(buf));
+}
+
+/** <!-- json_finish {{{1 -->
+ * @brief terminate output with NUL
+ * @param[in,out] w JSON writer
+ * @return length of output
+ * @retval -ve_value: buffer overflow
+ */
+int32_t json_finish(json_writer_t *w)
+{
+    if (w->err) {
+        if (w->size > 0) {
+            w->buf[0] = '\0';
+        }
+        return -1;
+    }
+    w->buf[w->len] = '\0';
+    return w->len;
+}
+
+// end of file {{{1
+// vim:ft=c:et:nowrap:fdm=marker
@@ -0,0 +1,107 @@
+/**
+ * Copyright (C) 2017 m2enu
+ *
+ * @file main/json.h
+ * @brief bounds-checked streaming JSON writer without printf/float
+ * @author m2enu
+ * @date 2026/10/16
+ */
+#ifndef JSON_H
+#define JSON_H
+
+#include <stdint.h>
+
+/** <!-- json_writer_t {{{1 -->
+ * @brief JSON writer
+ *
+ * Once the buffer overflows, further output is discarded and
+ * json_finish() reports the error.
+ */
+typedef struct json_writer_t_tag {
+    char *buf; //!< output buffer
+    int32_t size; //!< size of output buffer
+    int32_t len; //!< length of output
+    int8_t err; //!< 0: OK, -1: buffer overflow
+} json_writer_t;
+
+/** <!-- json_init {{{1 -->
+ * @brief initialise JSON writer
+ * @param[out] w JSON writer
+ * @param[in] buf output buffer
+ * @param[in] size size of output buffer
+ * @return nothing
+ */
+void json_init(json_writer_t *w, char *buf, int32_t size);
+
+/** <!-- json_raw {{{1 -->
+ * @brief write raw characters
+ * @param[in,out] w JSON writer
+ * @param[in] str characters
+ * @param[in] len number of characters
+ * @return nothing
+ */
+void json_raw(json_writer_t *w, const char *str, int32_t len);
+
+/** <!-- json_puts {{{1 -->
+ * @brief write raw string
+ * @param[in,out] w JSON writer
+ * @param[in] str string
+ * @return nothing
+ */
+void json_puts(json_writer_t *w, const char *str);
+
+/** <!-- json_key {{{1 -->
+ * @brief write object key ("key":)
+ * @param[in,out] w JSON writer
+ * @param[in] key key (no escape)
+ * @return nothing
+ */
+void json_key(json_writer_t *w, const char *key);
+
+/** <!-- json_uint {{{1 -->
+ * @brief write unsigned integer
+ * @param[in,out] w JSON writer
+ * @param[in] val value
+ * @param[in] width minimum number of digits (zero padded)
+ * @return nothing
+ */
+void json_uint(json_writer_t *w, uint32_t val, uint8_t width);
+
+/** <!-- json_hex {{{1 -->
+ * @brief write unsigned integer in lower case hexadecimal (no prefix)
+ * @param[in,out] w JSON writer
+ * @param[in] val value
+ * @param[in] width number of digits (1 - 8)
+ * @return nothing
+ */
+void json_hex(json_writer_t *w, uint32_t val, uint8_t width);
+
+/** <!-- json_fixed {{{1 -->
+ * @brief write fixed-point number
+ * @param[in,out] w JSON writer
+ * @param[in] val value in units of 10^-frac
+ * @param[in] frac number of fractional digits
+ * @return nothing
+ */
+void json_fixed(json_writer_t *w, int32_t val, uint8_t frac);
+
+/** <!-- json_timestamp {{{1 -->
+ * @brief write timestamp in ISO 8601
+ * @param[in,out] w JSON writer
+ * @param[in] msec time [ms since epoch]
+ * @return nothing
+ */
+void json_timestamp(json_writer_t *w, int64_t msec);
+
+/** <!-- json_finish {{{1 -->
+ * @brief terminate output with NUL
+ * @param[in,out] w JSON writer
+ * @return length of output
+ * @retval -ve_value: buffer overflow
+ */
+int32_t json_finish(json_writer_t *w);
+
+#endif // JSON_H
+
+// end of file {{{1
+// vim:ft=c:et:nowrap:fdm=marker
@@ -6,36 +6,418 @@
  * @author m2enu
  * @date 2017/08/20
  */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <strings.h>
+
 #include "m2x.h"
 
 const char *TAG_M2X = "m2x"; //!< ESP_LOGx TAG for M2X
 
-/** <!-- m2x_request {{{1 -->
- * @brief request to AT&T M2X
+/** <!-- m2x_client_init {{{1 -->
+ * @brief initialise M2X client and pre-render request headers
+ * @param[out] c M2X client
+ * @param[in] host host name
+ * @param[in] port port number
  * @param[in] device_id primary device id
  * @param[in] api_key primary api key
- * @param[in] json content
+ * @return result of initialisation
+ * @retval Zero: Success
+ * @retval -ve_value: Error
+ */
+int8_t m2x_client_init(m2x_client_t *c, const char *host, uint16_t port,
+                       const char *device_id, const char *api_key)
+{
+    static const char *sfx[M2X_PATH_NUM] = {M2X_URL_SFX, M2X_URL_SFX_BATCH};
+    int32_t i;
+    memset(c, 0, sizeof(*c));
+    c->sock = -1;
+    c->port = port;
+    if (strlen(host) >= sizeof(c->host)) {
+        return -1;
+    }
+    strcpy(c->host, host);
+    for (i = 0; i < M2X_PATH_NUM; i++) {
+        c->head_len[i] = snprintf(c->head[i], M2X_HEAD_BUF,
+            "POST %s%s%s HTTP/1.1\r\n"
+            "Host: %s\r\n"
+            "%s%s\r\n"
+            "%s\r\n"
+            "Content-Type: %s\r\n"
+            "Connection: keep-alive\r\n"
+            "Content-Length: ",
+            M2X_URL_PFX, device_id, sfx[i], host,
+            M2X_KEY_PFX, api_key, M2X_ACCEPT, M2X_CONTENT);
+        if ((c->head_len[i] < 0) || (c->head_len[i] >= M2X_HEAD_BUF - 16)) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/** <!-- m2x_client_close {{{1 -->
+ * @brief close connection of M2X client
+ * @param[in,out] c M2X client
+ * @return nothing
+ */
+void m2x_client_close(m2x_client_t *c)
+{
+    if (c->sock >= 0) {
+        close(c->sock);
+    }
+    c->sock = -1;
+    c->rx_len = 0;
+}
+
+/** <!-- m2x_resolve {{{1 -->
+ * @brief resolve host name, or reuse cached address until TTL expires
+ * @param[in,out] c M2X client
+ * @return result of resolve
+ * @retval Zero: Success
+ * @retval -ve_value: Error
+ */
+static int8_t m2x_resolve(m2x_client_t *c)
+{
+    int64_t now = port_msec();
+    if ((c->addr_expire != 0) && (now < c->addr_expire)) {
+        return 0;
+    }
+    struct addrinfo hints;
+    struct addrinfo *res = NULL;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    c->n_dns++;
+    if ((getaddrinfo(c->host, NULL, &hints, &res) != 0) || (res == NULL)) {
+        ESP_LOGE(TAG_M2X, "DNS lookup failed: %s", c->host);
+        return -1;
+    }
+    memcpy(&c->addr, res->ai_addr, sizeof(c->addr));
+    c->addr.sin_port = htons(c->port);
+    c->addr_expire = now + M2X_DNS_TTL;
+    freeaddrinfo(res);
+    return 0;
+}
+
+/** <!-- m2x_connect {{{1 -->
+ * @brief connect to M2X unless already connected
+ * @param[in,out] c M2X client
+ * @return result of connect
+ * @retval Zero: Success
+ * @retval -ve_value: Error
+ */
+static int8_t m2x_connect(m2x_client_t *c)
+{
+    if (c->sock >= 0) {
+        return 0;
+    }
+    if (m2x_resolve(c)) {
+        return -1;
+    }
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock < 0) {
+        ESP_LOGE(TAG_M2X, "Failed to allocate socket");
+        return -1;
+    }
+    struct timeval tv = {
+        .tv_sec = M2X_TIMEOUT / 1000,
+        .tv_usec = (M2X_TIMEOUT % 1000) * 1000,
+    };
+    int one = 1;
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (connect(sock, (struct sockaddr *)&c->addr, sizeof(c->addr)) != 0) {
+        ESP_LOGE(TAG_M2X, "Failed to connect %s:%d", c->host, c->port);
+        close(sock);
+        c->addr_expire = 0; // resolve again at next connect
+        return -1;
+    }
+    c->sock = sock;
+    c->rx_len = 0;
+    c->n_connect++;
+    return 0;
+}
+
+/** <!-- m2x_send {{{1 -->
+ * @brief send all data
+ *
+ * EPIPE or ECONNRESET means the server had closed the connection, so the
+ * client is marked stale.
+ * @param[in,out] c M2X client
+ * @param[in] data data to send
+ * @param[in] len length of data
+ * @return result of send
+ * @retval Zero: Success
+ * @retval -ve_value: Error
+ */
+static int8_t m2x_send(m2x_client_t *c, const char *data, int32_t len)
+{
+    while (len > 0) {
+        int32_t n = send(c->sock, data, len, PORT_MSG_NOSIGNAL);
+        if (n <= 0) {
+            if ((n < 0) && ((errno == EPIPE) || (errno == ECONNRESET))) {
+                c->stale = 1;
+            }
+            return -1;
+        }
+        data += n;
+        len  -= n;
+    }
+    return 0;
+}
+
+/** <!-- m2x_rx_more {{{1 -->
+ * @brief receive more response data into rx buffer
+ *
+ * The connection is stale when the first receive after the requests finds
+ * it closed (0 or ECONNRESET). A timeout (EAGAIN) is not, as the server
+ * may have taken the requests.
+ * @param[in,out] c M2X client
+ * @return result of receive
+ * @retval Zero: Success
+ * @retval -ve_value: Error, closed by peer or rx buffer full
+ */
+static int8_t m2x_rx_more(m2x_client_t *c)
+{
+    if (c->rx_len >= M2X_RX_BUF) {
+        return -1;
+    }
+    int32_t n = recv(c->sock, &c->rx[c->rx_len], M2X_RX_BUF - c->rx_len, 0);
+    if (n <= 0) {
+        if (!c->rx_any && ((n == 0) || (errno == ECONNRESET))) {
+            c->stale = 1;
+        }
+        return -1;
+    }
+    c->rx_len += n;
+    c->rx_any = 1;
+    return 0;
+}
+
+/** <!-- m2x_rx_consume {{{1 -->
+ * @brief remove data from the head of rx buffer
+ * @param[in,out] c M2X client
+ * @param[in] len length to remove
+ * @return nothing
+ */
+static void m2x_rx_consume(m2x_client_t *c, int32_t len)
+{
+    c->rx_len -= len;
+    memmove(c->rx, &c->rx[len], c->rx_len);
+}
+
+/** <!-- m2x_rx_line {{{1 -->
+ * @brief wait for one CRLF terminated line at the head of rx buffer
+ * @param[in,out] c M2X client
+ * @return length of line including CRLF
+ * @retval -ve_value: Error
+ */
+static int32_t m2x_rx_line(m2x_client_t *c)
+{
+    int32_t i = 0;
+    while (1) {
+        for (; i < c->rx_len; i++) {
+            if (c->rx[i] == '\n') {
+                return i + 1;
+            }
+        }
+        if (m2x_rx_more(c)) {
+            return -1;
+        }
+    }
+}
+
+/** <!-- m2x_rx_skip {{{1 -->
+ * @brief discard response data
+ * @param[in,out] c M2X client
+ * @param[in] len length to discard
+ * @return result of discard
+ * @retval Zero: Success
+ * @retval -ve_value: Error
+ */
+static int8_t m2x_rx_skip(m2x_client_t *c, int32_t len)
+{
+    while (len > 0) {
+        if ((c->rx_len == 0) && m2x_rx_more(c)) {
+            return -1;
+        }
+        int32_t n = (len < c->rx_len) ? len : c->rx_len;
+        m2x_rx_consume(c, n);
+        len -= n;
+    }
+    return 0;
+}
+
+/** <!-- m2x_rx_response {{{1 -->
+ * @brief receive one HTTP response and discard its body
+ * @param[in,out] c M2X client
+ * @return HTTP status
+ * @retval -ve_value: Error (connection is closed)
+ */
+static int32_t m2x_rx_response(m2x_client_t *c)
+{
+    int32_t status = -1;
+    int32_t content_len = -1;
+    int8_t chunked = 0;
+    int8_t keep = 1;
+    int32_t len = m2x_rx_line(c);
+    if ((len < 12) || (strncmp(c->rx, "HTTP/1.", 7) != 0)) {
+        m2x_client_close(c);
+        return -1;
+    }
+    status = strtol(&c->rx[9], NULL, 10);
+    if (strncmp(c->rx, "HTTP/1.0", 8) == 0) {
+        keep = 0;
+    }
+    m2x_rx_consume(c, len);
+
+    // headers
+    while ((len = m2x_rx_line(c)) > 2) {
+        if (strncasecmp(c->rx, "Content-Length:", 15) == 0) {
+            content_len = strtol(&c->rx[15], NULL, 10);
+        } else if ((strncasecmp(c->rx, "Transfer-Encoding:", 18) == 0) &&
+                   (strncasecmp(&c->rx[18], " chunked", 8) == 0)) {
+            chunked = 1;
+        } else if ((strncasecmp(c->rx, "Connection:", 11) == 0) &&
+                   (strncasecmp(&c->rx[11], " close", 6) == 0)) {
+            keep = 0;
+        }
+        m2x_rx_consume(c, len);
+    }
+    if (len < 0) {
+        m2x_client_close(c);
+        return -1;
+    }
+    m2x_rx_consume(c, len);
+
+    // body
+    if (chunked) {
+        int32_t size;
+        do {
+            if ((len = m2x_rx_line(c)) < 0) {
+                break;
+            }
+            size = strtol(c->rx, NULL, 16);
+            m2x_rx_consume(c, len);
+            if (m2x_rx_skip(c, size + 2)) {
+                len = -1;
+                break;
+            }
+        } while (size > 0);
+    } else if (content_len >= 0) {
+        len = m2x_rx_skip(c, content_len);
+    } else if ((status >= 200) && (status != 204) && (status != 304)) {
+        len = -1; // body delimited by close
+    }
+    if ((len < 0) || !keep) {
+        m2x_client_close(c);
+    }
+    return status;
+}
+
+/** <!-- m2x_pipeline {{{1 -->
+ * @brief send requests and receive their responses over one connection
+ * @param[in,out] c M2X client
+ * @param[in] path M2X device API
+ * @param[in] body contents
+ * @param[in] len lengths of contents
+ * @param[out] status HTTP status of each request (-ve_value: not answered)
+ * @param[in] num number of requests
+ * @return number of answered requests
+ * @retval -ve_value: Error
+ */
+static int32_t m2x_pipeline(m2x_client_t *c, m2x_path_t path,
+                            const char **body, const int32_t *len,
+                            int32_t *status, int32_t num)
+{
+    char head[M2X_HEAD_BUF];
+    int32_t i;
+    for (i = 0; i < num; i++) {
+        status[i] = -1;
+    }
+    c->stale = 0;
+    c->rx_any = 0;
+    if (m2x_connect(c)) {
+        return -1;
+    }
+    memcpy(head, c->head[path], c->head_len[path]);
+    for (i = 0; i < num; i++) {
+        int32_t n = c->head_len[path];
+        n += snprintf(&head[n], M2X_HEAD_BUF - n, "%d\r\n\r\n", len[i]);
+        if (m2x_send(c, head, n) || m2x_send(c, body[i], len[i])) {
+            ESP_LOGE(TAG_M2X, "Failed to send request");
+            m2x_client_close(c);
+            return -1;
+        }
+        c->n_request++;
+    }
+    for (i = 0; i < num; i++) {
+        status[i] = m2x_rx_response(c);
+        if (status[i] < 0) {
+            break;
+        }
+        if ((c->sock < 0) && (i < num - 1)) {
+            i++; // closed by server, rest are not answered
+            break;
+        }
+    }
+    return i;
+}
+
+/** <!-- m2x_client_pipeline {{{1 -->
+ * @brief POST multiple requests over the same connection
+ *
+ * All requests are sent before the responses are read. The connection is
+ * re-established only when it fails. A kept-alive connection may have
+ * been closed by the server while idle. When sending fails with EPIPE or
+ * ECONNRESET, or the first receive finds the connection closed, the
+ * requests are sent once more on a new connection. They are never resent
+ * after a timeout, as the server may have taken them.
+ * @param[in,out] c M2X client
+ * @param[in] path M2X device API
+ * @param[in] body contents
+ * @param[in] len lengths of contents
+ * @param[out] status HTTP status of each request (-ve_value: not answered)
+ * @param[in] num number of requests (max. M2X_PIPELINE_MAX)
+ * @return number of answered requests
+ * @retval -ve_value: Error
+ */
+int32_t m2x_client_pipeline(m2x_client_t *c, m2x_path_t path,
+                            const char **body, const int32_t *len,
+                            int32_t *status, int32_t num)
+{
+    if ((num <= 0) || (num > M2X_PIPELINE_MAX) || (path >= M2X_PATH_NUM)) {
+        return -1;
+    }
+    int8_t reused = (c->sock >= 0);
+    int32_t ret = m2x_pipeline(c, path, body, len, status, num);
+    if (reused && c->stale) {
+        ESP_LOGW(TAG_M2X, "Stale connection, retry on new connection");
+        c->n_stale++;
+        ret = m2x_pipeline(c, path, body, len, status, num);
+    }
+    return ret;
+}
+
+/** <!-- m2x_client_post {{{1 -->
+ * @brief POST to AT&T M2X
+ * @param[in,out] c M2X client
+ * @param[in] path M2X device API
+ * @param[in] body content
+ * @param[in] len length of content
+ * @param[in] retry maximum retry number
  * @return result of HTTP request
  * @retval 202: OK
  */
-int32_t m2x_request(char *device_id, char *api_key, char *json, int32_t retry)
+int32_t m2x_client_post(m2x_client_t *c, m2x_path_t path,
+                        const char *body, int32_t len, int32_t retry)
 {
-    request_t *req;
     int32_t status = 0;
-    char m2x_url[M2X_STR_BUF];
-    char m2x_key[M2X_STR_BUF];
-    sprintf(m2x_url, "%s%s%s", M2X_URL_PFX, device_id, M2X_URL_SFX);
-    sprintf(m2x_key, "%s%s", M2X_KEY_PFX, api_key);
-
     int32_t n = 0;
     for (n = 0; n < retry; n++) {
-        req = req_new(m2x_url);
-        req_setopt(req, REQ_SET_HEADER, M2X_ACCEPT);
-        req_setopt(req, REQ_SET_HEADER, m2x_key);
-        req_setopt(req, REQ_SET_POSTFIELDS, M2X_CONTENT);
-        req_setopt(req, REQ_SET_DATAFIELDS, json);
-        status = req_perform(req);
-        req_clean(req);
+        m2x_client_pipeline(c, path, &body, &len, &status, 1);
         if (status == STATUS_OK) {
             ESP_LOGI(TAG_M2X, "Finish request, status=%d", status);
             break;
@@ -6,37 +6,118 @@
  * @author m2enu
  * @date 2017/08/20
  */
+#ifndef M2X_H
+#define M2X_H
+
 #include <stdint.h>
 #include <string.h>
 
-#include "esp_log.h"
-
-#include "lwip/err.h"
-#include "lwip/sockets.h"
-#include "lwip/sys.h"
-#include "lwip/netdb.h"
-#include "lwip/dns.h"
-#include "esp_request.h"
+#include "port.h"
 
-#define M2X_URL_PFX     "http://api-m2x.att.com/v2/devices/" //!< AT&T M2X URL prefix
+#define M2X_HOST        "api-m2x.att.com" //!< AT&T M2X host
+#define M2X_PORT        80 //!< AT&T M2X port
+#define M2X_URL_PFX     "/v2/devices/" //!< AT&T M2X URL prefix
 #define M2X_URL_SFX     "/update" //!< AT&T M2X URL suffix
+#define M2X_URL_SFX_BATCH "/updates" //!< AT&T M2X URL suffix (multiple values)
 #define M2X_KEY_PFX     "X-M2X-KEY: "  //!< AT&T M2X PRIMARY API KEY prefix
 #define M2X_ACCEPT      "Accept: */*" //!< AT&T M2X Accept
 #define M2X_CONTENT     "application/json" //!< AT&T M2X Content-type
 #define M2X_STR_BUF     256 //!< AT&T M2X URL/KEY BUFFER SIZE
+#define M2X_HEAD_BUF    512 //!< AT&T M2X request header buffer size
+#define M2X_RX_BUF      1024 //!< AT&T M2X response buffer size
+#define M2X_DNS_TTL     (300 * 1000) //!< lifetime of resolved address [ms]
+#define M2X_TIMEOUT     5000 //!< socket send/receive timeout [ms]
+#define M2X_PIPELINE_MAX 8 //!< max. number of pipelined requests
 
 #define STATUS_OK       202 //!< HTTP request complete successfully
 
-/** <!-- m2x_request {{{1 -->
- * @brief request to AT&T M2X
+/** <!-- m2x_path_t {{{1 -->
+ * @brief AT&T M2X device API
+ */
+typedef enum m2x_path_t_tag {
+    M2X_PATH_UPDATE = 0, //!< /devices/<id>/update (single values)
+    M2X_PATH_UPDATES, //!< /devices/<id>/updates (multiple values)
+    M2X_PATH_NUM,
+} m2x_path_t;
+
+/** <!-- m2x_client_t {{{1 -->
+ * @brief AT&T M2X client with persistent HTTP/1.1 connection
+ */
+typedef struct m2x_client_t_tag {
+    char host[64]; //!< host name
+    uint16_t port; //!< port number
+    char head[M2X_PATH_NUM][M2X_HEAD_BUF]; //!< pre-rendered request headers
+    int32_t head_len[M2X_PATH_NUM]; //!< length of pre-rendered headers
+    struct sockaddr_in addr; //!< resolved address
+    int64_t addr_expire; //!< expiry of resolved address [ms]
+    int sock; //!< connected socket (-1: not connected)
+    char rx[M2X_RX_BUF]; //!< response buffer
+    int32_t rx_len; //!< length of data in rx
+    uint32_t n_dns; //!< number of DNS lookups
+    uint32_t n_connect; //!< number of TCP connections
+    uint32_t n_request; //!< number of requests sent
+    uint32_t n_stale; //!< number of requests resent after stale connection
+    int8_t rx_any; //!< 1: response bytes received since requests were sent
+    int8_t stale; //!< 1: connection was found closed by server, nothing answered
+} m2x_client_t;
+
+/** <!-- m2x_client_init {{{1 -->
+ * @brief initialise M2X client and pre-render request headers
+ * @param[out] c M2X client
+ * @param[in] host host name
+ * @param[in] port port number
  * @param[in] device_id primary device id
  * @param[in] api_key primary api key
- * @param[in] json content
+ * @return result of initialisation
+ * @retval Zero: Success
+ * @retval -ve_value: Error
+ */
+int8_t m2x_client_init(m2x_client_t *c, const char *host, uint16_t port,
+                       const char *device_id, const char *api_key);
+
+/** <!-- m2x_client_pipeline {{{1 -->
+ * @brief POST multiple requests over the same connection
+ *
+ * All requests are sent before the responses are read. The connection is
+ * re-established only when it fails. A kept-alive connection may have
+ * been closed by the server while idle. When sending fails with EPIPE or
+ * ECONNRESET, or the first receive finds the connection closed, the
+ * requests are sent once more on a new connection. They are never resent
+ * after a timeout, as the server may have taken them.
+ * @param[in,out] c M2X client
+ * @param[in] path M2X device API
+ * @param[in] body contents
+ * @param[in] len lengths of contents
+ * @param[out] status HTTP status of each request (-ve_value: not answered)
+ * @param[in] num number of requests (max. M2X_PIPELINE_MAX)
+ * @return number of answered requests
+ * @retval -ve_value: Error
+ */
+int32_t m2x_client_pipeline(m2x_client_t *c, m2x_path_t path,
+                            const char **body, const int32_t *len,
+                            int32_t *status, int32_t num);
+
+/** <!-- m2x_client_post {{{1 -->
+ * @brief POST to AT&T M2X
+ * @param[in,out] c M2X client
+ * @param[in] path M2X device API
+ * @param[in] body content
+ * @param[in] len length of content
  * @param[in] retry maximum retry number
  * @return result of HTTP request
  * @retval 202: OK
  */
-int32_t m2x_request(char *device_id, char *api_key, char *json, int32_t retry);
+int32_t m2x_client_post(m2x_client_t *c, m2x_path_t path,
+                        const char *body, int32_t len, int32_t retry);
+
+/** <!-- m2x_client_close {{{1 -->
+ * @brief close connection of M2X client
+ * @param[in,out] c M2X client
+ * @return nothing
+ */
+void m2x_client_close(m2x_client_t *c);
+
+#endif // M2X_H
 
 // end of file {{{1
 // vim:ft=c:et:nowrap:fdm=marker
@@ -9,11 +9,13 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <sys/time.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/queue.h"
 #include "freertos/event_groups.h"
 #include "esp_system.h"
+#include "esp_heap_caps.h"
 #include "esp_log.h"
 #include "esp_wifi.h"
 #include "esp_event_loop.h"
@@ -21,9 +23,24 @@
 #include "soc/uart_struct.h"
 #include "driver/uart.h"
 #include "driver/gpio.h"
+#include "lwip/apps/sntp.h"
 
 #include "twelite.h"
+#include "ingest.h"
+#include "pktq.h"
+#include "dedup.h"
+#include "devtab.h"
+#include "batch.h"
+#include "aggr.h"
+#include "journal.h"
 #include "m2x.h"
+#include "retry.h"
+#include "sink.h"
+#include "influx.h"
+#include "mqtt.h"
+#include "metrics.h"
+#include "timemap.h"
+#include "rule.h"
 
 // global members {{{1
 static const char *TAG = "main"; //!< ESP_LOGx tag
@@ -33,6 +50,38 @@ static EventGroupHandle_t wifi_event_group; //!< FreeRTOS event group to signal
    but we only care about one event - are we connected
    to the AP with an IP? */
 static const int CONNECTED_BIT = BIT0;
+static ingest_t ingest; //!< TWE-LITE app_tag stream ingestion
+#ifdef CONFIG_UART_EVENT_DRIVEN
+static QueueHandle_t uart_queue; //!< UART driver event queue
+#endif
+static twelite_stats_t parse_stats; //!< statistics of TWE-LITE packet parser
+static dedup_t dedup; //!< duplicate filter of relayed packets
+static devtab_t devtab; //!< state of end devices
+static pktq_t pktq; //!< packet queue from uart_task to m2x_task
+static port_task_t task_uart; //!< uart_task (ingest stage)
+static port_task_t task_m2x; //!< m2x_task (upload stage)
+static port_task_t task_alert; //!< alert_task (upload stage of alert lane)
+static uint32_t heap_init_free; //!< free heap after initialisation [byte]
+static timemap_t timemap; //!< clock mapping of this device
+static m2x_batch_t batch; //!< batch of packets for M2X /updates
+static aggr_t aggr; //!< windowed aggregation of packets
+static aggr_summary_t aggr_summary[AGGR_DEVICE_MAX]; //!< closed windows
+static m2x_client_t m2x; //!< AT&T M2X client
+static retry_t retry; //!< retry scheduler of M2X POST
+static journal_ops_t journal_ops; //!< storage backend of journal
+static journal_t journal; //!< journal of packets failed to upload
+static m2x_batch_t replay; //!< batch of packets replayed from journal
+static influx_t influx; //!< InfluxDB UDP sink
+static mqtt_t mqtt; //!< MQTT publisher sink
+static rule_table_t rules; //!< alert rules
+static pktq_t pktq_alert; //!< packet queue from uart_task to alert_task
+static pktq_t pktq_fallback; //!< packet queue of alerts from alert_task to m2x_task
+static m2x_batch_t batch_alert; //!< batch of alert packets
+static m2x_client_t m2x_alert; //!< AT&T M2X client of alert lane
+static retry_t retry_alert; //!< retry scheduler of alert POST
+#ifdef CONFIG_METRICS_ENABLE
+static metrics_t metrics_snap; //!< snapshot of metrics to report
+#endif
 
 // defines {{{1
 #define UART_TXD_PIN    (4) //!< GPIO number of UART TXD
@@ -41,8 +90,22 @@ static const int CONNECTED_BIT = BIT0;
 #define UART_CTS_PIN    (19) //!< GPIO number of UART CTS
 #define UART_BAUDRATE   115200 //!< UART baudrate [bps]
 #define UART_NUM        UART_NUM_1 //!< port number of UART
-#define UART_TIMEOUT    20 / portTICK_RATE_MS //!< UART TIMEOUT [ms]
-#define UART_BUF_SIZE   (1024) //!< UART receive buffer size
+#define UART_TIMEOUT    20 / portTICK_RATE_MS //!< UART polling interval [ms]
+#define UART_BUF_SIZE   CONFIG_UART_BUF_SIZE //!< UART driver receive buffer size
+#ifdef CONFIG_TWELITE_BINARY
+#define UART_FORMAT     TWELITE_FORMAT_BINARY //!< TWE-LITE frame format
+#define UART_PATTERN    TWELITE_BINARY_EOT //!< end of frame (pattern detect)
+#define UART_PARSE      twelite_parse_binary //!< parser of TWE-LITE frame
+#else
+#define UART_FORMAT     TWELITE_FORMAT_ASCII //!< TWE-LITE frame format
+#define UART_PATTERN    '\n' //!< end of frame (pattern detect)
+#define UART_PARSE      twelite_parse_packet //!< parser of TWE-LITE frame
+#endif
+#ifdef CONFIG_UART_EVENT_DRIVEN
+#define UART_RX_THRESH  CONFIG_UART_RX_THRESH //!< RX FIFO interrupt threshold [byte]
+#define UART_RX_TOUT    10 //!< RX FIFO timeout [symbol]
+#define UART_QUEUE_SIZE 20 //!< UART driver event queue size
+#endif
 
 #define WIFI_SSID       CONFIG_WIFI_SSID //!< WiFi SSID
 #define WIFI_PASS       CONFIG_WIFI_PASSWORD //!< WiFi PASSWORD
@@ -50,7 +113,93 @@ static const int CONNECTED_BIT = BIT0;
 #define M2X_POST_PIN    (19) //!< GPIO number for switching M2X post
 #define M2X_ID          CONFIG_M2X_ID //!< AT&T M2X PRIMARY DEIVCE ID
 #define M2X_KEY         CONFIG_M2X_KEY //!< AT&T M2X PRIMARY API KEY
-#define M2X_RETRY       10 //!< M2X POST retry number
+#define M2X_RETRY       3 //!< max. attempts of one M2X POST
+#define M2X_BACKOFF     500 //!< backoff after the first failure [ms]
+#define M2X_BACKOFF_MAX 30000 //!< max. backoff [ms]
+#define M2X_BREAKER     5 //!< consecutive failures to stop posting
+#define M2X_COOLDOWN    60000 //!< time to stop posting [ms]
+#define M2X_WAIT        1000 //!< max. wait for queued packet [ms]
+#define M2X_BATCH_NUM   CONFIG_M2X_BATCH_NUM //!< max. number of packets in one POST
+#define M2X_BATCH_AGE   CONFIG_M2X_BATCH_AGE //!< max. age of batched packet [ms]
+#define M2X_AGGR_WINDOW CONFIG_M2X_AGGR_WINDOW //!< aggregation window [ms] (0: raw)
+#define M2X_BODY_SIZE   8192 //!< M2X POST body buffer size
+#define AGGR_POST_NUM   8 //!< max. summaries per POST (up to ~750 bytes each)
+
+#define JOURNAL_LABEL   "journal" //!< label of journal data partition
+#define JOURNAL_INTERVAL 2000 //!< min. interval of journal replay [ms]
+#define JOURNAL_PIPELINE 4 //!< batches replayed by one pipelined round trip (max. M2X_PIPELINE_MAX)
+
+#define SINK_INFLUX_HOST CONFIG_SINK_INFLUX_HOST //!< InfluxDB host ("": disable)
+#define SINK_INFLUX_PORT CONFIG_SINK_INFLUX_PORT //!< InfluxDB UDP port
+#define SINK_MQTT_HOST  CONFIG_SINK_MQTT_HOST //!< MQTT broker host ("": disable)
+#define SINK_MQTT_PORT  CONFIG_SINK_MQTT_PORT //!< MQTT broker port
+#define SINK_MQTT_TOPIC CONFIG_SINK_MQTT_TOPIC //!< MQTT topic prefix
+#define SINK_MQTT_ID    "esp32-twelite" //!< MQTT client identifier
+#if defined(CONFIG_SINK_MQTT_CBOR_DELTA)
+#define SINK_MQTT_ENCODING MQTT_CBOR_DELTA //!< MQTT payload encoding
+#elif defined(CONFIG_SINK_MQTT_CBOR)
+#define SINK_MQTT_ENCODING MQTT_CBOR //!< MQTT payload encoding
+#else
+#define SINK_MQTT_ENCODING MQTT_JSON //!< MQTT payload encoding
+#endif
+#define SINK_BATCH_AGE  CONFIG_SINK_BATCH_AGE //!< max. age of batched packet [ms]
+#define SINK_PKTQ_SIZE  64 //!< number of sink packet queue slots (power of 2)
+#define SINK_BODY_SIZE  4096 //!< sink serialize buffer size
+
+#define TASK_INGEST_CORE  CONFIG_TASK_INGEST_CORE //!< core of uart_task (-1: any)
+#define TASK_INGEST_PRIO  CONFIG_TASK_INGEST_PRIORITY //!< priority of uart_task
+#define TASK_INGEST_STACK CONFIG_TASK_INGEST_STACK //!< stack size of uart_task [byte]
+#define TASK_UPLOAD_CORE  CONFIG_TASK_UPLOAD_CORE //!< core of m2x_task and sinks (-1: any)
+#define TASK_UPLOAD_PRIO  CONFIG_TASK_UPLOAD_PRIORITY //!< priority of m2x_task and sinks
+#define TASK_UPLOAD_STACK CONFIG_TASK_UPLOAD_STACK //!< stack size of m2x_task and sinks [byte]
+#define TASK_REPORT_INTERVAL CONFIG_TASK_REPORT_INTERVAL //!< task usage report interval [ms] (0: disable)
+#define TASK_REPORT_NUM   16 //!< max. number of tasks in run time report
+
+#ifdef CONFIG_METRICS_ENABLE
+#define METRICS_INTERVAL CONFIG_METRICS_INTERVAL //!< metrics report interval [ms]
+#endif
+
+#define SNTP_SERVER     "pool.ntp.org" //!< SNTP server
+#define TIME_SYNC_INTERVAL 10000 //!< interval of clock mapping discipline [ms]
+
+#define DEDUP_WINDOW    5000 //!< duplicates are detected within this [ms]
+#define DEDUP_BEST_LQI  1 //!< 1: keep the relayed copy with the highest LQI
+
+#define DEVTAB_SIZE     CONFIG_DEVTAB_SIZE //!< number of device table entries (power of 2)
+#define DEVTAB_VDD_LOW  2400 //!< battery low threshold of end device [mV]
+#define DEVTAB_ALERT_NUM 16 //!< max. silent end devices logged at once
+#define DEVTAB_FULL_LOG 60000 //!< min. interval of device table full log [ms]
+
+#define PKTQ_SIZE       32 //!< number of packet queue slots (power of 2)
+#define PKTQ_POLICY     PKTQ_COALESCE //!< packet queue overflow policy
+#define PKTQ_PRESSURE   (PKTQ_SIZE * 3 / 4) //!< queued packets to flush batch
+
+#define ALERT_RULES     CONFIG_ALERT_RULES //!< alert rules (see rule.h)
+#define ALERT_PKTQ_SIZE 16 //!< number of alert queue slots (power of 2)
+#define ALERT_BATCH_NUM 8 //!< max. number of packets in one alert POST
+#define ALERT_BODY_SIZE 4096 //!< alert POST body buffer size
+
+static pktq_slot_t pktq_slot[PKTQ_SIZE]; //!< slots of packet queue
+static pktq_slot_t pktq_alert_slot[ALERT_PKTQ_SIZE]; //!< slots of alert queue
+static pktq_slot_t pktq_fallback_slot[ALERT_PKTQ_SIZE]; //!< slots of alert fallback queue
+static devtab_alert_t devtab_alert[DEVTAB_ALERT_NUM]; //!< end devices gone silent
+static char m2x_body[M2X_BODY_SIZE]; //!< M2X POST body
+static twelite_packet_t replay_pkt[JOURNAL_PIPELINE * M2X_BATCH_MAX]; //!< packets replayed from journal
+static char replay_body[JOURNAL_PIPELINE * M2X_BODY_SIZE / 2]; //!< M2X POST bodies of replay
+static char alert_body[ALERT_BODY_SIZE]; //!< alert POST body
+
+/** <!-- sink_id_t {{{1 -->
+ * @brief sinks beside M2X
+ */
+typedef enum sink_id_t_tag {
+    SINK_INFLUX = 0, //!< InfluxDB line protocol over UDP
+    SINK_MQTT, //!< MQTT publish
+    SINK_NUM, //!< number of sinks
+} sink_id_t;
+
+static sink_t sink[SINK_NUM]; //!< sinks beside M2X
+static pktq_slot_t sink_slot[SINK_NUM][SINK_PKTQ_SIZE]; //!< slots of sink packet queues
+static char sink_body[SINK_NUM][SINK_BODY_SIZE]; //!< sink serialize buffers
 
 /** <!-- event_handler {{{1 -->
  * @brief event handler
@@ -118,27 +267,44 @@ static void wifi_connect(void)
     ESP_LOGI(TAG_WIFI, "Connected to AP, freemem=%d", esp_get_free_heap_size());
 }
 
-/** <!-- create_json {{{1 -->
- * @brief create json message from TWE-LITE packet
- * @param[out] dst json string
- * @param[in] pkt TWE-LITE app_tag packet structure
+/** <!-- time_init {{{1 -->
+ * @brief start SNTP to map packet timestamps to wall clock
+ * @param nothing
+ * @return nothing
+ */
+static void time_init(void)
+{
+    timemap_init(&timemap);
+    sntp_setoperatingmode(SNTP_OPMODE_POLL);
+    sntp_setservername(0, SNTP_SERVER);
+    sntp_init();
+}
+
+/** <!-- time_sync {{{1 -->
+ * @brief discipline monotonic to wall clock mapping by SNTP time
+ * @param nothing
  * @return nothing
  */
-void create_json(char *dst, twelite_packet_t *pkt)
+static void time_sync(void)
 {
-    const char *fmt = (
-        "{ \"values\": {"
-            "\"temperature\": %6.2f" ", "
-            "\"pressure\": %9.2f" ", "
-            "\"humidity\": %6.2f" ", "
-            "\"vdd\": %6.3f"
-        "} }"
-    );
-    sprintf(dst, fmt,
-            pkt->pkt_bme280.temperature,
-            pkt->pkt_bme280.pressure,
-            pkt->pkt_bme280.humidity,
-            (pkt->mvolt_vdd / 1000.0));
+    static int64_t synced;
+    int64_t now = port_msec();
+    if (timemap.synced && (now - synced < TIME_SYNC_INTERVAL)) {
+        return;
+    }
+    synced = now;
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    int64_t wall = (int64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+    if (timemap_sync(&timemap, now, wall) <= 0) {
+        return;
+    }
+    if (timemap.n_step == 1) {
+        ESP_LOGI(TAG, "wall clock synced");
+    } else {
+        ESP_LOGW(TAG, "wall clock stepped by %d s",
+                 (int32_t)(timemap.error / 1000));
+    }
 }
 
 /** <!-- uart_init {{{1 -->
@@ -158,38 +324,745 @@ void uart_init(void)
     uart_param_config(UART_NUM, &uart_config);
     uart_set_pin(UART_NUM,
                  UART_TXD_PIN, UART_RXD_PIN, UART_RTS_PIN, UART_CTS_PIN);
-    uart_driver_install(UART_NUM, UART_BUF_SIZE * 2, 0, 0, NULL, 0);
+#ifdef CONFIG_UART_EVENT_DRIVEN
+    uart_intr_config_t uart_intr = {
+        .intr_enable_mask = UART_RXFIFO_FULL_INT_ENA_M |
+                            UART_RXFIFO_TOUT_INT_ENA_M,
+        .rxfifo_full_thresh = UART_RX_THRESH,
+        .rx_timeout_thresh = UART_RX_TOUT,
+    };
+    uart_driver_install(UART_NUM, UART_BUF_SIZE, 0,
+                        UART_QUEUE_SIZE, &uart_queue, 0);
+    uart_intr_config(UART_NUM, &uart_intr);
+    // end of frame, no idle time around it as frames arrive back to back
+    uart_enable_pattern_det_intr(UART_NUM, UART_PATTERN, 1, 9, 0, 0);
+    uart_pattern_queue_reset(UART_NUM, UART_QUEUE_SIZE);
+#else
+    uart_driver_install(UART_NUM, UART_BUF_SIZE, 0, 0, NULL, 0);
+#endif
+}
+
+/** <!-- uart_read {{{1 -->
+ * @brief read buffered data from UART without blocking (ingest_ops_t)
+ * @param[in] ctx not used
+ * @param[out] dst read data
+ * @param[in] len max. length to read
+ * @return length of read data
+ */
+static int32_t uart_read(void *ctx, char *dst, int32_t len)
+{
+    METRICS_BEGIN(t_uart);
+    len = uart_read_bytes(UART_NUM, (uint8_t*)dst, len, 0);
+    METRICS_END(METRICS_UART, t_uart);
+    if (len > 0) {
+        METRICS_COUNT(METRICS_RX_BYTES, len);
+    }
+    return len;
+}
+
+/** <!-- uart_flush {{{1 -->
+ * @brief discard UART data and events after overflow (ingest_ops_t)
+ * @param[in] ctx not used
+ * @return nothing
+ */
+static void uart_flush(void *ctx)
+{
+    METRICS_COUNT(METRICS_UART_OVF, 1);
+    ESP_LOGW(TAG, "UART overflow (fifo=%u, buffer=%u)",
+             ingest.n_event[INGEST_FIFO_OVF],
+             ingest.n_event[INGEST_BUFFER_FULL]);
+    uart_flush_input(UART_NUM);
+#ifdef CONFIG_UART_EVENT_DRIVEN
+    xQueueReset(uart_queue);
+#endif
+}
+
+/** <!-- device_update {{{1 -->
+ * @brief update state of end device and log its event
+ * @param[in] pkt TWE-LITE packet
+ * @return nothing
+ */
+static void device_update(const twelite_packet_t *pkt)
+{
+    static int64_t full_logged; // time of last device table full log
+    int64_t now = port_msec();
+    int8_t ev = devtab_update(&devtab, pkt, now);
+    const devtab_entry_t *e;
+    switch (ev) {
+    case DEVTAB_EV_NEW:
+        ESP_LOGI(TAG, "device %08x joined, devices=%u",
+                 pkt->sid_enddevice, devtab.num);
+        break;
+    case DEVTAB_EV_ALIVE:
+        ESP_LOGI(TAG, "device %08x alive again, silent=%u",
+                 pkt->sid_enddevice, devtab.n_silent);
+        break;
+    case DEVTAB_EV_BATTERY_LOW:
+    case DEVTAB_EV_BATTERY_OK:
+        e = devtab_find(&devtab, pkt->sid_enddevice);
+        ESP_LOGW(TAG, "device %08x battery %s: %d mV, %d mV/h",
+                 pkt->sid_enddevice,
+                 (ev == DEVTAB_EV_BATTERY_LOW) ? "low" : "recovered",
+                 e->vdd_avg / 16, e->vdd_trend);
+        break;
+    case DEVTAB_EV_FULL:
+        // reported for every packet of untracked devices, so rate limited
+        if ((devtab.n_full == 1) || (now - full_logged >= DEVTAB_FULL_LOG)) {
+            ESP_LOGW(TAG, "device table full, untracked=%u", devtab.n_full);
+            full_logged = now;
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+/** <!-- device_expire {{{1 -->
+ * @brief log end devices gone silent
+ * @param nothing
+ * @return nothing
+ */
+static void device_expire(void)
+{
+    uint32_t num = devtab_expire(&devtab, port_msec(),
+                                 devtab_alert, DEVTAB_ALERT_NUM);
+    uint32_t n;
+    for (n = 0; (n < num) && (n < DEVTAB_ALERT_NUM); n++) {
+        ESP_LOGW(TAG, "device %08x silent for %u s",
+                 devtab_alert[n].sid, devtab_alert[n].age / 1000);
+    }
+    if (num > DEVTAB_ALERT_NUM) {
+        ESP_LOGW(TAG, "%u more devices silent", num - DEVTAB_ALERT_NUM);
+    }
 }
 
+/** <!-- task_report {{{1 -->
+ * @brief log free heap, stack high water mark of pipeline tasks, and CPU
+ *        usage of every task when FreeRTOS collects run time stats
+ * @param nothing
+ * @return nothing
+ */
+static void task_report(void)
+{
+    static int64_t reported;
+    const port_task_t *tasks[SINK_NUM + 3];
+    uint32_t num = 0;
+    uint32_t n;
+    int64_t now = port_msec();
+    if ((TASK_REPORT_INTERVAL == 0) || (now - reported < TASK_REPORT_INTERVAL)) {
+        return;
+    }
+    reported = now;
+    // pipeline buffers are static, only WiFi and lwip use heap after init
+    ESP_LOGI(TAG, "heap free=%u min=%u init=%u", esp_get_free_heap_size(),
+             heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT), heap_init_free);
+    tasks[num++] = &task_uart;
+    tasks[num++] = &task_m2x;
+    tasks[num++] = &task_alert;
+    for (n = 0; n < SINK_NUM; n++) {
+        tasks[num++] = &sink[n].task;
+    }
+    for (n = 0; n < num; n++) {
+        if (tasks[n]->name != NULL) {
+            ESP_LOGI(TAG, "task %s: stack free=%u bytes", tasks[n]->name,
+                     uxTaskGetStackHighWaterMark(tasks[n]->handle));
+        }
+    }
+#if (configUSE_TRACE_FACILITY == 1) && (configGENERATE_RUN_TIME_STATS == 1)
+    // CPU usage since last report, tasks are matched by handle
+    static TaskStatus_t status[2][TASK_REPORT_NUM];
+    static uint32_t status_num[2];
+    static uint32_t total[2];
+    static uint8_t cur;
+    TaskStatus_t *now_st = status[cur];
+    TaskStatus_t *prev_st = status[cur ^ 1];
+    uint32_t i;
+    status_num[cur] = uxTaskGetSystemState(now_st, TASK_REPORT_NUM, &total[cur]);
+    uint32_t span = total[cur] - total[cur ^ 1];
+    for (n = 0; (span > 0) && (n < status_num[cur]); n++) {
+        uint32_t used = now_st[n].ulRunTimeCounter;
+        for (i = 0; i < status_num[cur ^ 1]; i++) {
+            if (prev_st[i].xHandle == now_st[n].xHandle) {
+                used -= prev_st[i].ulRunTimeCounter;
+                break;
+            }
+        }
+        ESP_LOGI(TAG, "task %s: core=%d cpu=%u.%u%%", now_st[n].pcTaskName,
+                 (int)xTaskGetAffinity(now_st[n].xHandle),
+                 (uint32_t)((uint64_t)used * 100 / span),
+                 (uint32_t)((uint64_t)used * 1000 / span % 10));
+    }
+    cur ^= 1;
+#endif
+}
+
+/** <!-- uart_dispatch {{{1 -->
+ * @brief parse one TWE-LITE packet and hand over to m2x_task and sinks (ingest_ops_t)
+ * @param[in] ctx not used
+ * @param[in] frame app_tag frame
+ * @param[in] len length of frame
+ * @return nothing
+ */
+static void uart_dispatch(void *ctx, const char *frame, int32_t len)
+{
+    twelite_packet_t pkt;
+    uint32_t n;
+    METRICS_BEGIN(t_parse);
+    int8_t err = UART_PARSE(&pkt, frame, len);
+    METRICS_END(METRICS_PARSE, t_parse);
+    METRICS_COUNT(METRICS_FRAME, 1);
+    twelite_stats_count(&parse_stats, err);
+    if (err < 0) {
+        METRICS_COUNT(METRICS_PARSE_ERR, 1);
+        ESP_LOGE(TAG, "TWE-LITE packet parse failed: %d "
+                 "(length=%u, hex=%u, checksum=%u)", err,
+                 parse_stats.n_length, parse_stats.n_hex,
+                 parse_stats.n_checksum);
+        return;
+    }
+    pkt.timestamp = ingest.stamp;
+    // drop copies of the same reading relayed by other routers
+    int8_t dup = dedup_check(&dedup, &pkt, pkt.timestamp);
+    if (dup == DEDUP_DUP) {
+        METRICS_COUNT(METRICS_DUP, 1);
+        return;
+    }
+    // a higher-LQI copy can only replace the reading in M2X batch, every
+    // other consumer has taken the reading already
+    pkt.better = (dup == DEDUP_BETTER);
+    int8_t lane = RULE_LANE_BULK;
+    if (!pkt.better) {
+        device_update(&pkt);
+        lane = rule_check(&rules, &pkt);
+        // hand over to every sink, a slow sink drops only its own oldest packets
+        for (n = 0; n < SINK_NUM; n++) {
+            if (sink[n].task.name != NULL) {
+                sink_push(&sink[n], &pkt);
+            }
+        }
+    }
+    // alerts bypass batching and aggregation, and the bulk lane if full
+    if ((lane == RULE_LANE_ALERT) && (task_alert.name != NULL)) {
+        METRICS_COUNT(METRICS_ALERT, 1);
+        if (pktq_push(&pktq_alert, &pkt) >= 0) {
+            port_task_notify(&task_alert);
+            return;
+        }
+    }
+    // hand over to m2x_task
+    if (task_m2x.name == NULL) {
+        return;
+    }
+    if (pktq_push(&pktq, &pkt) < 0) {
+        METRICS_COUNT(METRICS_DROP, 1);
+        ESP_LOGW(TAG, "packet queue full, dropped: %u",
+                 pktq.n_drop_newest);
+    }
+    port_task_notify(&task_m2x);
+}
+
+/** <!-- uart_ops {{{1 -->
+ * @brief UART device and packet consumer of ingestion
+ */
+static const ingest_ops_t uart_ops = {
+    .read = uart_read,
+    .flush = uart_flush,
+    .dispatch = uart_dispatch,
+    .ctx = NULL,
+};
+
 /** <!-- uart_task {{{1 -->
- * @brief UART receive and display task
+ * @brief UART receive and parse task (ingest stage)
  * @return nothing
  */
 static void uart_task(void *args)
+{
+    size_t len;
+    dedup_init(&dedup, DEDUP_WINDOW, DEDUP_BEST_LQI);
+#ifdef CONFIG_UART_EVENT_DRIVEN
+    uart_event_t event;
+    // read only when a frame end is signalled, unless it is overdue
+    ingest_init(&ingest, &uart_ops, TWELITE_FRAME_LENGTH_MAX);
+    twelite_framer_format(&ingest.framer, UART_FORMAT);
+    while(1) {
+        // wake up every tick of timer wheel to detect silent devices
+        time_sync();
+        device_expire();
+        task_report();
+        if (xQueueReceive(uart_queue, &event,
+                          DEVTAB_TICK / portTICK_RATE_MS) != pdTRUE) {
+            continue;
+        }
+        switch (event.type) {
+        case UART_DATA:
+            uart_get_buffered_data_len(UART_NUM, &len);
+            ingest_event(&ingest, INGEST_DATA, len);
+            break;
+        case UART_PATTERN_DET: {
+            int pos = uart_pattern_pop_pos(UART_NUM);
+            if (pos < 0) {
+                // pattern position queue overflowed, take everything
+                uart_get_buffered_data_len(UART_NUM, &len);
+                pos = (int)len - 1;
+            }
+            ingest_event(&ingest, INGEST_PATTERN, pos + 1);
+            break;
+        }
+        case UART_FIFO_OVF:
+            ingest_event(&ingest, INGEST_FIFO_OVF, 0);
+            break;
+        case UART_BUFFER_FULL:
+            ingest_event(&ingest, INGEST_BUFFER_FULL, 0);
+            break;
+        default:
+            break;
+        }
+    }
+#else
+    ingest_init(&ingest, &uart_ops, 0);
+    twelite_framer_format(&ingest.framer, UART_FORMAT);
+    while(1) {
+        time_sync();
+        device_expire();
+        task_report();
+        uart_get_buffered_data_len(UART_NUM, &len);
+        if (len == 0) {
+            vTaskDelay(UART_TIMEOUT);
+            continue;
+        }
+        ingest_event(&ingest, INGEST_DATA, len);
+    }
+#endif
+}
+
+/** <!-- m2x_connected {{{1 -->
+ * @brief check connection to access point
+ * @param nothing
+ * @return 1: connected, 0: not connected
+ */
+static int8_t m2x_connected(void)
+{
+    return (xEventGroupGetBits(wifi_event_group) & CONNECTED_BIT) ? 1 : 0;
+}
+
+/** <!-- m2x_wait {{{1 -->
+ * @brief time until next POST to M2X is allowed
+ * @param[in,out] r retry scheduler of lane
+ * @return time to wait [ms]
+ * @retval Zero: POST allowed now
+ * @retval -ve_value: offline or circuit open, store into journal
+ */
+static int64_t m2x_wait(retry_t *r)
+{
+    if (!m2x_connected()) {
+        return -1;
+    }
+    int64_t wait = retry_wait(r, port_msec());
+    return (r->state == RETRY_OPEN) ? -1 : wait;
+}
+
+/** <!-- m2x_post {{{1 -->
+ * @brief POST to M2X once, and schedule next POST by its result
+ * @param[in] path M2X device API
+ * @param[in] body content
+ * @param[in] len length of content
+ * @return what to do with the content (retry_verdict_t)
+ */
+static retry_verdict_t m2x_post(m2x_path_t path, const char *body, int32_t len)
+{
+    METRICS_BEGIN(t_post);
+    int32_t ret = m2x_client_post(&m2x, path, body, len, 1);
+    METRICS_END(METRICS_POST, t_post);
+    METRICS_COUNT((ret == STATUS_OK) ? METRICS_POST_OK : METRICS_POST_ERR, 1);
+    retry_verdict_t verdict = retry_result(&retry, port_msec(), ret);
+    if (verdict == RETRY_DROP) {
+        ESP_LOGE(TAG, "M2X refused request, status=%d", ret);
+    } else if ((verdict == RETRY_GIVEUP) && (retry.state == RETRY_OPEN)) {
+        ESP_LOGW(TAG, "M2X not responding, pause %d ms (opened=%u)",
+                 M2X_COOLDOWN, retry.n_open);
+    }
+    return verdict;
+}
+
+/** <!-- m2x_upload {{{1 -->
+ * @brief post batch to M2X
+ * @param[in] b batch
+ * @return what to do with the batch (retry_verdict_t)
+ */
+static retry_verdict_t m2x_upload(m2x_batch_t *b)
+{
+    METRICS_BEGIN(t_json);
+    int32_t len = m2x_batch_json(m2x_body, sizeof(m2x_body), b);
+    METRICS_END(METRICS_JSON, t_json);
+    if (len < 0) {
+        ESP_LOGE(TAG, "M2X body buffer overflow");
+        return RETRY_DROP;
+    }
+    return m2x_post(M2X_PATH_UPDATES, m2x_body, len);
+}
+
+/** <!-- m2x_store {{{1 -->
+ * @brief store batch into journal to upload later
+ * @param[in] b batch
+ * @return nothing
+ */
+static void m2x_store(m2x_batch_t *b)
+{
+    uint32_t n;
+    for (n = 0; n < b->num; n++) {
+        if (journal_append(&journal, &b->pkt[n]) < 0) {
+            ESP_LOGE(TAG, "journal append failed, %d packets lost",
+                     b->num - n);
+            break;
+        }
+    }
+    METRICS_COUNT(METRICS_STORE, n);
+    ESP_LOGW(TAG, "stored %d packets, journal=%d", n, journal.count);
+}
+
+/** <!-- m2x_summary {{{1 -->
+ * @brief post summaries of closed windows to M2X
+ *
+ * Summaries are posted AGGR_POST_NUM at a time, as all of them do not fit
+ * into one body. While offline, mean values of summaries not posted are
+ * stored into journal instead.
+ * @param[in] num number of summaries
+ * @return nothing
+ */
+static void m2x_summary(uint32_t num)
 {
     twelite_packet_t pkt;
-    uint8_t* data = (uint8_t*) malloc(UART_BUF_SIZE);
-    char json[256];
+    uint32_t n = 0;
+    ESP_LOGI(TAG, "flush %d summaries", num);
+    if (gpio_get_level(M2X_POST_PIN) == 0) {
+        ESP_LOGI(TAG, "M2X POST disable -> continue ...");
+        return;
+    }
+    while ((n < num) && (m2x_wait(&retry) == 0)) {
+        uint32_t cnt = (num - n < AGGR_POST_NUM) ? num - n : AGGR_POST_NUM;
+        int32_t len = aggr_json(m2x_body, sizeof(m2x_body),
+                                &aggr_summary[n], cnt, &timemap);
+        if (len < 0) {
+            ESP_LOGE(TAG, "M2X body buffer overflow");
+            break;
+        }
+        retry_verdict_t verdict = m2x_post(M2X_PATH_UPDATES, m2x_body, len);
+        if ((verdict != RETRY_DONE) && (verdict != RETRY_DROP)) {
+            break;
+        }
+        n += cnt;
+    }
+    uint32_t posted = n;
+    for (; n < num; n++) {
+        aggr_packet(&pkt, &aggr_summary[n]);
+        if (journal_append(&journal, &pkt) < 0) {
+            ESP_LOGE(TAG, "journal append failed, %d summaries lost", num - n);
+            break;
+        }
+    }
+    METRICS_COUNT(METRICS_STORE, n - posted);
+}
+
+#ifdef CONFIG_METRICS_ENABLE
+/** <!-- m2x_metrics {{{1 -->
+ * @brief log metrics and post them to M2X as their own streams
+ * @param nothing
+ * @return nothing
+ */
+static void m2x_metrics(void)
+{
+    metrics_snapshot(&metrics_snap);
+    int32_t len = metrics_json(m2x_body, sizeof(m2x_body), &metrics_snap);
+    if (len < 0) {
+        ESP_LOGE(TAG, "M2X body buffer overflow");
+        return;
+    }
+    ESP_LOGI(TAG, "metrics: %s", m2x_body);
+    if ((m2x_wait(&retry) == 0) && (gpio_get_level(M2X_POST_PIN) != 0)) {
+        m2x_post(M2X_PATH_UPDATE, m2x_body, len);
+    }
+}
+#endif
+
+/** <!-- m2x_replay {{{1 -->
+ * @brief upload batches of packets stored in journal in one round trip
+ *
+ * Up to JOURNAL_PIPELINE batches, as many as fit in replay_body, are
+ * pipelined over the kept-alive connection. Packets are consumed up to
+ * the first batch which is not answered or to be retried.
+ * @param nothing
+ * @return nothing
+ */
+static void m2x_replay(void)
+{
+    const char *body[JOURNAL_PIPELINE];
+    int32_t len[JOURNAL_PIPELINE];
+    int32_t status[JOURNAL_PIPELINE];
+    int32_t pos = 0;
+    int32_t done = 0;
+    int32_t req;
+    int32_t n;
+    uint32_t span;
+    int32_t num = journal_peek(&journal, replay_pkt,
+                               JOURNAL_PIPELINE * M2X_BATCH_MAX, &span);
+    if (num < 0) {
+        return;
+    }
+    if (num == 0) {
+        journal_consume(&journal, span); // nothing but corrupt records
+        return;
+    }
+    for (req = 0; (req < JOURNAL_PIPELINE) && (req * M2X_BATCH_MAX < num); req++) {
+        n = num - req * M2X_BATCH_MAX;
+        replay.num = (n < M2X_BATCH_MAX) ? n : M2X_BATCH_MAX;
+        memcpy(replay.pkt, &replay_pkt[req * M2X_BATCH_MAX],
+               replay.num * sizeof(twelite_packet_t));
+        len[req] = m2x_batch_json(&replay_body[pos], sizeof(replay_body) - pos,
+                                  &replay);
+        if (len[req] < 0) {
+            break; // the rest waits for next replay
+        }
+        body[req] = &replay_body[pos];
+        pos += len[req];
+    }
+    m2x_batch_clear(&replay);
+    if (req == 0) {
+        ESP_LOGE(TAG, "M2X body buffer overflow");
+        done = M2X_BATCH_MAX; // dropped, or it would block journal
+    } else {
+        METRICS_BEGIN(t_post);
+        m2x_client_pipeline(&m2x, M2X_PATH_UPDATES, body, len, status, req);
+        METRICS_END(METRICS_POST, t_post);
+    }
+    // refused packets are consumed as well, or they would block journal
+    for (n = 0; n < req; n++) {
+        METRICS_COUNT((status[n] == STATUS_OK) ? METRICS_POST_OK
+                                               : METRICS_POST_ERR, 1);
+        retry_verdict_t verdict = retry_result(&retry, port_msec(), status[n]);
+        if ((verdict != RETRY_DONE) && (verdict != RETRY_DROP)) {
+            break;
+        }
+        if (verdict == RETRY_DROP) {
+            ESP_LOGE(TAG, "M2X refused replay, status=%d", status[n]);
+        }
+        done += M2X_BATCH_MAX;
+    }
+    if (done >= num) {
+        journal_consume(&journal, span);
+        done = num;
+    } else if ((done > 0) &&
+               (journal_peek(&journal, replay_pkt, done, &span) == done)) {
+        journal_consume(&journal, span);
+    } else {
+        done = 0;
+    }
+    if (done > 0) {
+        ESP_LOGI(TAG, "replayed %d packets in %d requests, journal=%d",
+                 done, req, journal.count);
+    }
+}
+
+/** <!-- m2x_task {{{1 -->
+ * @brief M2X upload task (upload stage)
+ * @return nothing
+ */
+static void m2x_task(void *args)
+{
+    twelite_packet_t pkt;
+    int64_t replayed = 0;
+#ifdef CONFIG_METRICS_ENABLE
+    int64_t reported = port_msec();
+#endif
+    m2x_batch_init(&batch, M2X_BATCH_NUM, M2X_BATCH_AGE, PKTQ_PRESSURE,
+                   &timemap);
+    m2x_batch_init(&replay, M2X_BATCH_MAX, 0, 0, &timemap);
+    aggr_init(&aggr, M2X_AGGR_WINDOW);
+    retry_init(&retry, M2X_BACKOFF, M2X_BACKOFF_MAX, M2X_BREAKER,
+               M2X_COOLDOWN, M2X_RETRY, esp_random());
+    if (m2x_client_init(&m2x, M2X_HOST, M2X_PORT, M2X_ID, M2X_KEY)) {
+        ESP_LOGE(TAG, "M2X client initialisation failed");
+    }
+    if (journal_partition_ops(&journal_ops, JOURNAL_LABEL) ||
+        journal_mount(&journal, &journal_ops, &timemap)) {
+        ESP_LOGW(TAG, "journal partition \"%s\" not available", JOURNAL_LABEL);
+    } else {
+        ESP_LOGI(TAG, "journal mounted, %d packets to replay", journal.count);
+    }
     while(1) {
-        // Read data from UART
-        int32_t len = uart_read_bytes(UART_NUM, data,
-                                      UART_BUF_SIZE, UART_TIMEOUT);
-        if (len <= 0) continue;
-
-        // parse twe-lite packet
-        int8_t err = twelite_parse_packet(&pkt, (char*)data, len);
-        if (err < 0) {
-            ESP_LOGE(TAG, "TWE-LITE packet parse failed: %d", err);
+        // packets are timestamped by wall clock only after SNTP sync
+        if (!timemap.synced) {
+            port_task_wait(&task_m2x, M2X_WAIT);
             continue;
         }
-        // post to M2X
-        create_json(json, &pkt);
-        ESP_LOGI(TAG, "%s", json);
+        // gather queued packets into aggregation table or batch
+        uint32_t queued = pktq_count(&pktq);
+        METRICS_GAUGE(METRICS_QUEUE, queued);
+        METRICS_GAUGE(METRICS_JOURNAL, journal.count);
+        // alerts given up by alert_task are batched as they are
+        while ((batch.num < batch.max_num) &&
+               (pktq_pop(&pktq_fallback, &pkt) == 0)) {
+            m2x_batch_add(&batch, &pkt);
+        }
+        while ((batch.num < batch.max_num) && (pktq_pop(&pktq, &pkt) == 0)) {
+            if (pkt.better || (aggr_add(&aggr, &pkt) != 0)) {
+                m2x_batch_add(&batch, &pkt);
+            }
+        }
+        int64_t now = port_msec();
+        uint32_t num = aggr_flush(&aggr, now, aggr_summary, AGGR_DEVICE_MAX);
+        if (num > 0) {
+            m2x_summary(num);
+        }
+#ifdef CONFIG_METRICS_ENABLE
+        if (now - reported >= METRICS_INTERVAL) {
+            m2x_metrics();
+            reported = now;
+        }
+#endif
+        m2x_batch_reason_t reason = m2x_batch_due(&batch, now, queued);
+        if (reason == M2X_BATCH_NONE) {
+            // replay journal while live data is idle, at limited rate
+            if ((journal.count > 0) && (m2x_wait(&retry) == 0) &&
+                (now - replayed >= JOURNAL_INTERVAL)) {
+                m2x_replay();
+                replayed = now;
+                continue;
+            }
+            int64_t wait = m2x_batch_wait(&batch, now);
+            int64_t wait_aggr = aggr_wait(&aggr, now);
+            if ((wait < 0) || ((wait_aggr >= 0) && (wait_aggr < wait))) {
+                wait = wait_aggr;
+            }
+            if ((journal.count > 0) &&
+                ((wait < 0) || (wait > JOURNAL_INTERVAL))) {
+                wait = JOURNAL_INTERVAL;
+            }
+            port_task_wait(&task_m2x, (wait < 0) ? M2X_WAIT : wait);
+            continue;
+        }
+        // post to M2X, or store into journal while offline
         if (gpio_get_level(M2X_POST_PIN) == 0) {
             ESP_LOGI(TAG, "M2X POST disable -> continue ...");
+            m2x_batch_clear(&batch);
+            continue;
+        }
+        int64_t wait = m2x_wait(&retry);
+        if (wait > 0) {
+            // backing off, batch and queue keep packets meanwhile
+            port_task_wait(&task_m2x, wait);
+            continue;
+        }
+        ESP_LOGI(TAG, "flush %d packets, reason=%d", batch.num, reason);
+        retry_verdict_t verdict = (wait < 0) ? RETRY_GIVEUP : m2x_upload(&batch);
+        if (verdict == RETRY_AGAIN) {
             continue;
         }
-        m2x_request(M2X_ID, M2X_KEY, json, M2X_RETRY);
+        if (verdict == RETRY_GIVEUP) {
+            m2x_store(&batch);
+        }
+        m2x_batch_clear(&batch);
+    }
+}
+
+/** <!-- alert_upload {{{1 -->
+ * @brief post batch of alert packets to M2X by connection of alert lane
+ * @param nothing
+ * @return what to do with the batch (retry_verdict_t)
+ */
+static retry_verdict_t alert_upload(void)
+{
+    int32_t len = m2x_batch_json(alert_body, sizeof(alert_body), &batch_alert);
+    if (len < 0) {
+        ESP_LOGE(TAG, "alert body buffer overflow");
+        return RETRY_DROP;
+    }
+    int32_t ret = m2x_client_post(&m2x_alert, M2X_PATH_UPDATES,
+                                  alert_body, len, 1);
+    retry_verdict_t verdict = retry_result(&retry_alert, port_msec(), ret);
+    if (verdict == RETRY_DROP) {
+        ESP_LOGE(TAG, "M2X refused alert, status=%d", ret);
+    }
+    return verdict;
+}
+
+/** <!-- alert_task {{{1 -->
+ * @brief M2X upload task of alert lane (upload stage)
+ *
+ * Alert packets are posted as soon as they are queued, by their own
+ * connection and retry scheduler, so a backlog of the bulk lane does not
+ * delay them. Alerts which cannot be posted go to the bulk lane by their
+ * own queue (pktq has uart_task as its only producer), and m2x_task
+ * stores them into journal while offline.
+ * @return nothing
+ */
+static void alert_task(void *args)
+{
+    twelite_packet_t pkt;
+    uint32_t n;
+    m2x_batch_init(&batch_alert, ALERT_BATCH_NUM, 0, 0, &timemap);
+    retry_init(&retry_alert, M2X_BACKOFF, M2X_BACKOFF_MAX, M2X_BREAKER,
+               M2X_COOLDOWN, M2X_RETRY, esp_random());
+    if (m2x_client_init(&m2x_alert, M2X_HOST, M2X_PORT, M2X_ID, M2X_KEY)) {
+        ESP_LOGE(TAG, "M2X client of alert lane initialisation failed");
+    }
+    while(1) {
+        // packets are timestamped by wall clock only after SNTP sync
+        if (!timemap.synced) {
+            port_task_wait(&task_alert, M2X_WAIT);
+            continue;
+        }
+        while ((batch_alert.num < batch_alert.max_num) &&
+               (pktq_pop(&pktq_alert, &pkt) == 0)) {
+            m2x_batch_add(&batch_alert, &pkt);
+        }
+        if (batch_alert.num == 0) {
+            port_task_wait(&task_alert, M2X_WAIT);
+            continue;
+        }
+        if (gpio_get_level(M2X_POST_PIN) == 0) {
+            m2x_batch_clear(&batch_alert);
+            continue;
+        }
+        int64_t wait = m2x_wait(&retry_alert);
+        if (wait > 0) {
+            port_task_wait(&task_alert, wait);
+            continue;
+        }
+        ESP_LOGW(TAG, "alert %d packets", batch_alert.num);
+        retry_verdict_t verdict = (wait < 0) ? RETRY_GIVEUP : alert_upload();
+        if (verdict == RETRY_AGAIN) {
+            continue;
+        }
+        if (verdict == RETRY_GIVEUP) {
+            for (n = 0; n < batch_alert.num; n++) {
+                if (pktq_push(&pktq_fallback, &batch_alert.pkt[n]) < 0) {
+                    ESP_LOGW(TAG, "fallback queue full, alert dropped");
+                }
+            }
+            port_task_notify(&task_m2x);
+        }
+        m2x_batch_clear(&batch_alert);
+    }
+}
+
+/** <!-- sink_start {{{1 -->
+ * @brief initialise sink and create its task
+ * @param[in] id sink
+ * @param[in] name name of sink
+ * @param[in] ops wire format and transport
+ * @return nothing
+ */
+static void sink_start(sink_id_t id, const char *name, const sink_ops_t *ops)
+{
+    if (sink_init(&sink[id], name, ops, sink_slot[id], SINK_PKTQ_SIZE,
+                  sink_body[id], SINK_BODY_SIZE, SINK_BATCH_MAX,
+                  SINK_BATCH_AGE)) {
+        ESP_LOGE(TAG, "%s sink initialisation failed", name);
+        return;
+    }
+    if (sink_spawn(&sink[id], TASK_UPLOAD_STACK, TASK_UPLOAD_PRIO,
+                   TASK_UPLOAD_CORE)) {
+        ESP_LOGE(TAG, "%s sink task creation failed", name);
     }
 }
 
@@ -216,8 +1089,48 @@ void app_main(void)
     wifi_init();
     // connect to access point
     wifi_connect();
-    // create tasks
-    xTaskCreate(uart_task, "uart_echo_task", 4096, NULL, 10, NULL);
+    time_init();
+    // create tasks, every buffer of them is static but the device table
+    if (devtab_init(&devtab, DEVTAB_SIZE, port_msec(), DEVTAB_VDD_LOW)) {
+        ESP_LOGE(TAG, "device table allocation failed, %u entries",
+                 DEVTAB_SIZE);
+    }
+    if ((strlen(SINK_INFLUX_HOST) > 0) &&
+        (influx_init(&influx, SINK_INFLUX_HOST, SINK_INFLUX_PORT,
+                     &timemap) == 0)) {
+        sink_start(SINK_INFLUX, "influx", &influx.ops);
+    }
+    if ((strlen(SINK_MQTT_HOST) > 0) &&
+        (mqtt_init(&mqtt, SINK_MQTT_HOST, SINK_MQTT_PORT,
+                   SINK_MQTT_ID, SINK_MQTT_TOPIC, SINK_MQTT_ENCODING,
+                   &timemap) == 0)) {
+        sink_start(SINK_MQTT, "mqtt", &mqtt.ops);
+    }
+#ifdef CONFIG_SINK_M2X
+    pktq_init(&pktq, pktq_slot, PKTQ_SIZE, PKTQ_POLICY);
+    pktq_init(&pktq_fallback, pktq_fallback_slot, ALERT_PKTQ_SIZE,
+              PKTQ_DROP_NEWEST);
+    if (port_task_create(&task_m2x, m2x_task, "m2x_task", TASK_UPLOAD_STACK,
+                         TASK_UPLOAD_PRIO, TASK_UPLOAD_CORE, NULL)) {
+        ESP_LOGE(TAG, "m2x_task creation failed");
+    }
+    if (rule_init(&rules, ALERT_RULES)) {
+        ESP_LOGE(TAG, "alert rules \"%s\" malformed", ALERT_RULES);
+    }
+    // alert lane preempts bulk lane on the same core
+    pktq_init(&pktq_alert, pktq_alert_slot, ALERT_PKTQ_SIZE, PKTQ_DROP_NEWEST);
+    if ((rules.num > 0) &&
+        port_task_create(&task_alert, alert_task, "alert_task",
+                         TASK_UPLOAD_STACK, TASK_UPLOAD_PRIO + 1,
+                         TASK_UPLOAD_CORE, NULL)) {
+        ESP_LOGE(TAG, "alert_task creation failed");
+    }
+#endif
+    if (port_task_create(&task_uart, uart_task, "uart_task", TASK_INGEST_STACK,
+                         TASK_INGEST_PRIO, TASK_INGEST_CORE, NULL)) {
+        ESP_LOGE(TAG, "uart_task creation failed");
+    }
+    heap_init_free = esp_get_free_heap_size();
 }
 
 // end of file {{{1
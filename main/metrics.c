@@ -0,0 +1,148 @@
+/**
+ * Copyright (C) 2017 m2enu
+ *
+ * @file main/metrics.c
+ * @brief hot-path instrumentation (counters, gauges, latency histograms)
+ * @author m2enu
+ * @date 2026/10/16
+ */
+#include <stdint.h>
+#include <string.h>
+
+#include "metrics.h"
+#include "json.h"
+
+#ifdef CONFIG_METRICS_ENABLE
+
+metrics_t metrics; //!< metrics of this device
+
+/** <!-- metrics_stage_name {{{1 -->
+ * @brief M2X stream prefix of stages
+ */
+static const char *metrics_stage_name[METRICS_STAGE_NUM] = {
+    "m_uart",
+    "m_parse",
+    "m_json",
+    "m_post",
+};
+
+/** <!-- metrics_counter_name {{{1 -->
+ * @brief M2X stream of counters
+ */
+static const char *metrics_counter_name[METRICS_COUNTER_NUM] = {
+    "m_rx_bytes",
+    "m_uart_ovf",
+    "m_frame",
+    "m_parse_err",
+    "m_dup",
+    "m_drop",
+    "m_post_ok",
+    "m_post_err",
+    "m_store",
+    "m_alert",
+};
+
+/** <!-- metrics_gauge_name {{{1 -->
+ * @brief M2X stream of gauges (max. since last snapshot)
+ */
+static const char *metrics_gauge_name[METRICS_GAUGE_NUM] = {
+    "m_queue_max",
+    "m_journal_max",
+};
+
+/** <!-- metrics_snapshot {{{1 -->
+ * @brief copy metrics and restart max. of gauges
+ * @param[out] dst snapshot
+ * @return nothing
+ */
+void metrics_snapshot(metrics_t *dst)
+{
+    uint32_t i;
+    memcpy(dst, &metrics, sizeof(metrics_t));
+    for (i = 0; i < METRICS_GAUGE_NUM; i++) {
+        metrics.gauge_max[i] = metrics.gauge[i];
+    }
+}
+
+/** <!-- metrics_percentile {{{1 -->
+ * @brief approximate percentile of latency histogram
+ * @param[in] h latency histogram
+ * @param[in] pct percentile [%]
+ * @return upper bound of the bucket holding the percentile [cycles]
+ */
+uint32_t metrics_percentile(const metrics_hist_t *h, uint32_t pct)
+{
+    uint64_t rank = ((uint64_t)h->num * pct + 99) / 100;
+    uint64_t sum = 0;
+    uint32_t i;
+    for (i = 0; i < METRICS_HIST_NUM - 1; i++) {
+        sum += h->bucket[i];
+        if ((sum >= rank) && (sum > 0)) {
+            uint32_t upper = 1u << (METRICS_HIST_SHIFT + i);
+            return (upper < h->max) ? upper : h->max;
+        }
+    }
+    return h->max;
+}
+
+/** <!-- metrics_json_value {{{1 -->
+ * @brief write one M2X stream value
+ * @param[in,out] w JSON writer
+ * @param[in] name M2X stream
+ * @param[in] suffix suffix of M2X stream
+ * @param[in] val value
+ * @return nothing
+ */
+static void metrics_json_value(json_writer_t *w, const char *name,
+                               const char *suffix, uint32_t val)
+{
+    if (w->len > 11) { // not the first value after {"values":{
+        json_raw(w, ",", 1);
+    }
+    json_raw(w, "\"", 1);
+    json_puts(w, name);
+    json_puts(w, suffix);
+    json_raw(w, "\":", 2);
+    json_uint(w, val, 1);
+}
+
+/** <!-- metrics_json {{{1 -->
+ * @brief create JSON for M2X /update (single values) from snapshot
+ *
+ * Latencies are written as p50/p99/max in microseconds.
+ * @param[out] dst JSON string
+ * @param[in] size size of dst
+ * @param[in] m snapshot
+ * @return length of JSON string
+ * @retval -ve_value: buffer overflow
+ */
+int32_t metrics_json(char *dst, int32_t size, const metrics_t *m)
+{
+    json_writer_t w;
+    uint32_t i;
+    json_init(&w, dst, size);
+    json_raw(&w, "{\"values\":{", 11);
+    for (i = 0; i < METRICS_STAGE_NUM; i++) {
+        const metrics_hist_t *h = &m->hist[i];
+        metrics_json_value(&w, metrics_stage_name[i], "_n", h->num);
+        metrics_json_value(&w, metrics_stage_name[i], "_p50",
+            metrics_percentile(h, 50) / METRICS_CYCLES_PER_US);
+        metrics_json_value(&w, metrics_stage_name[i], "_p99",
+            metrics_percentile(h, 99) / METRICS_CYCLES_PER_US);
+        metrics_json_value(&w, metrics_stage_name[i], "_max",
+            h->max / METRICS_CYCLES_PER_US);
+    }
+    for (i = 0; i < METRICS_COUNTER_NUM; i++) {
+        metrics_json_value(&w, metrics_counter_name[i], "", m->counter[i]);
+    }
+    for (i = 0; i < METRICS_GAUGE_NUM; i++) {
+        metrics_json_value(&w, metrics_gauge_name[i], "", m->gauge_max[i]);
+    }
+    json_raw(&w, "}}", 2);
+    return json_finish(&w);
+}
+
+#endif // CONFIG_METRICS_ENABLE
+
+// end of file {{{1
+// vim:ft=c:et:nowrap:fdm=marker
@@ -0,0 +1,189 @@
+/**
+ * Copyright (C) 2017 m2enu
+ *
+ * @file main/metrics.h
+ * @brief hot-path instrumentation (counters, gauges, latency histograms)
+ *
+ * Everything is compiled out unless CONFIG_METRICS_ENABLE is set, so the
+ * METRICS_xxx() macros can stay in the hot path. Each metric is written
+ * by one task only; a snapshot taken by another task may be slightly
+ * inconsistent but never corrupt, as all members are 32-bit words.
+ * @author m2enu
+ * @date 2026/10/16
+ */
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+
+#include "port.h"
+
+#ifdef CONFIG_METRICS_ENABLE
+
+#ifdef ESP_PLATFORM
+#include "xtensa/hal.h"
+#define METRICS_CYCLES_PER_US CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ //!< cycle counter [1/us]
+#else
+#define METRICS_CYCLES_PER_US 1000 //!< cycle counter [1/us] (host: ns)
+#endif
+
+#define METRICS_HIST_NUM    20 //!< number of histogram buckets
+#define METRICS_HIST_SHIFT  8 //!< cycles of the first bucket = 2^SHIFT
+
+/** <!-- metrics_stage_t {{{1 -->
+ * @brief instrumented stages
+ */
+typedef enum metrics_stage_t_tag {
+    METRICS_UART = 0, //!< uart_read_bytes()
+    METRICS_PARSE, //!< twelite_parse_packet()
+    METRICS_JSON, //!< m2x_batch_json()
+    METRICS_POST, //!< m2x_client_post()
+    METRICS_STAGE_NUM,
+} metrics_stage_t;
+
+/** <!-- metrics_counter_t {{{1 -->
+ * @brief monotonic counters
+ */
+typedef enum metrics_counter_t_tag {
+    METRICS_RX_BYTES = 0, //!< bytes read from UART
+    METRICS_UART_OVF, //!< UART FIFO overflow or buffer full
+    METRICS_FRAME, //!< frames found by framer
+    METRICS_PARSE_ERR, //!< frames rejected by parser
+    METRICS_DUP, //!< dropped duplicates
+    METRICS_DROP, //!< packets dropped by packet queue
+    METRICS_POST_OK, //!< successful POSTs
+    METRICS_POST_ERR, //!< failed POSTs (after retries)
+    METRICS_STORE, //!< packets stored into journal
+    METRICS_ALERT, //!< packets classified into alert lane
+    METRICS_COUNTER_NUM,
+} metrics_counter_t;
+
+/** <!-- metrics_gauge_t {{{1 -->
+ * @brief gauges (current value and maximum since last snapshot)
+ */
+typedef enum metrics_gauge_t_tag {
+    METRICS_QUEUE = 0, //!< packets in packet queue
+    METRICS_JOURNAL, //!< packets in journal
+    METRICS_GAUGE_NUM,
+} metrics_gauge_t;
+
+/** <!-- metrics_hist_t {{{1 -->
+ * @brief latency histogram with log2 buckets
+ *
+ * bucket[0] counts latencies below 2^SHIFT cycles, bucket[i] counts
+ * [2^(SHIFT+i-1), 2^(SHIFT+i)) cycles, and the last bucket everything
+ * above.
+ */
+typedef struct metrics_hist_t_tag {
+    uint32_t bucket[METRICS_HIST_NUM]; //!< number of samples
+    uint32_t num; //!< total number of samples
+    uint32_t max; //!< max. latency [cycles]
+} metrics_hist_t;
+
+/** <!-- metrics_t {{{1 -->
+ * @brief all metrics
+ */
+typedef struct metrics_t_tag {
+    metrics_hist_t hist[METRICS_STAGE_NUM]; //!< latency of stages
+    uint32_t counter[METRICS_COUNTER_NUM]; //!< counters
+    uint32_t gauge[METRICS_GAUGE_NUM]; //!< current value of gauges
+    uint32_t gauge_max[METRICS_GAUGE_NUM]; //!< max. value of gauges
+} metrics_t;
+
+extern metrics_t metrics; //!< metrics of this device
+
+/** <!-- metrics_cycles {{{1 -->
+ * @brief read cycle counter
+ * @param nothing
+ * @return cycle counter (wraps around)
+ */
+static inline uint32_t metrics_cycles(void)
+{
+#ifdef ESP_PLATFORM
+    return xthal_get_ccount();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)ts.tv_sec * 1000000000u + (uint32_t)ts.tv_nsec;
+#endif
+}
+
+/** <!-- metrics_hist_add {{{1 -->
+ * @brief add one sample to latency histogram
+ * @param[in,out] h latency histogram
+ * @param[in] cycles latency [cycles]
+ * @return nothing
+ */
+static inline void metrics_hist_add(metrics_hist_t *h, uint32_t cycles)
+{
+    uint32_t v = cycles >> METRICS_HIST_SHIFT;
+    uint32_t i = (v == 0) ? 0 : 32 - __builtin_clz(v);
+    if (i >= METRICS_HIST_NUM) {
+        i = METRICS_HIST_NUM - 1;
+    }
+    h->bucket[i]++;
+    h->num++;
+    if (cycles > h->max) {
+        h->max = cycles;
+    }
+}
+
+/** <!-- metrics_gauge_set {{{1 -->
+ * @brief set value of gauge
+ * @param[in] id gauge
+ * @param[in] val value
+ * @return nothing
+ */
+static inline void metrics_gauge_set(metrics_gauge_t id, uint32_t val)
+{
+    metrics.gauge[id] = val;
+    if (val > metrics.gauge_max[id]) {
+        metrics.gauge_max[id] = val;
+    }
+}
+
+#define METRICS_BEGIN(t)        uint32_t t = metrics_cycles()
+#define METRICS_END(stage, t)   metrics_hist_add(&metrics.hist[stage], metrics_cycles() - (t))
+#define METRICS_COUNT(id, n)    (metrics.counter[id] += (n))
+#define METRICS_GAUGE(id, val)  metrics_gauge_set(id, val)
+
+/** <!-- metrics_snapshot {{{1 -->
+ * @brief copy metrics and restart max. of gauges
+ * @param[out] dst snapshot
+ * @return nothing
+ */
+void metrics_snapshot(metrics_t *dst);
+
+/** <!-- metrics_percentile {{{1 -->
+ * @brief approximate percentile of latency histogram
+ * @param[in] h latency histogram
+ * @param[in] pct percentile [%]
+ * @return upper bound of the bucket holding the percentile [cycles]
+ */
+uint32_t metrics_percentile(const metrics_hist_t *h, uint32_t pct);
+
+/** <!-- metrics_json {{{1 -->
+ * @brief create JSON for M2X /update (single values) from snapshot
+ *
+ * Latencies are written as p50/p99/max in microseconds.
+ * @param[out] dst JSON string
+ * @param[in] size size of dst
+ * @param[in] m snapshot
+ * @return length of JSON string
+ * @retval -ve_value: buffer overflow
+ */
+int32_t metrics_json(char *dst, int32_t size, const metrics_t *m);
+
+#else
+
+#define METRICS_BEGIN(t)        do { } while (0)
+#define METRICS_END(stage, t)   do { } while (0)
+#define METRICS_COUNT(id, n)    do { } while (0)
+#define METRICS_GAUGE(id, val)  do { } while (0)
+
+#endif // CONFIG_METRICS_ENABLE
+
+#endif // METRICS_H
+
+// end of file {{{1
+// vim:ft=c:et:nowrap:fdm=marker
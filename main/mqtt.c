@@ -0,0 +1,271 @@
+/**
+ * Copyright (C) 2017 m2enu
+ *
+ * @file main/mqtt.c
+ * @brief minimal MQTT 3.1.1 publisher sink (QoS 0)
+ * @author m2enu
+ * @date 2026/10/16
+ */
+#include <stdint.h>
+#include <string.h>
+
+#include "mqtt.h"
+#include "json.h"
+#include "cbor.h"
+
+static const char *TAG_MQTT = "mqtt"; //!< ESP_LOGx tag
+
+#define MQTT_CONNECT    0x10 //!< CONNECT packet type
+#define MQTT_CONNACK    0x20 //!< CONNACK packet type
+#define MQTT_PUBLISH    0x30 //!< PUBLISH packet type (QoS 0)
+#define MQTT_HEAD_MAX   5 //!< max. length of fixed header
+
+/** <!-- mqtt_remaining {{{1 -->
+ * @brief encode fixed header (type and remaining length)
+ * @param[out] dst fixed header (MQTT_HEAD_MAX bytes)
+ * @param[in] type packet type
+ * @param[in] len remaining length
+ * @return length of fixed header
+ */
+static int32_t mqtt_remaining(uint8_t *dst, uint8_t type, uint32_t len)
+{
+    int32_t n = 0;
+    dst[n++] = type;
+    do {
+        uint8_t byte = len & 0x7f;
+        len >>= 7;
+        dst[n++] = byte | ((len > 0) ? 0x80 : 0);
+    } while ((len > 0) && (n < MQTT_HEAD_MAX));
+    return n;
+}
+
+/** <!-- mqtt_publish_begin {{{1 -->
+ * @brief write topic of PUBLISH packet after space for fixed header
+ * @param[in,out] w writer
+ * @param[in] c MQTT publisher sink
+ * @param[in] pkt packet to publish to <topic>/<sid> (NULL: <topic>)
+ * @return start of PUBLISH packet
+ */
+static int32_t mqtt_publish_begin(json_writer_t *w, const mqtt_t *c,
+                                  const twelite_packet_t *pkt)
+{
+    int32_t start = w->len;
+    uint32_t topic_len = strlen(c->topic) + ((pkt != NULL) ? 9 : 0);
+    char len[2] = {(char)(topic_len >> 8), (char)topic_len};
+    json_raw(w, "\0\0\0\0\0", MQTT_HEAD_MAX);
+    json_raw(w, len, 2);
+    json_puts(w, c->topic);
+    if (pkt != NULL) {
+        json_raw(w, "/", 1);
+        json_hex(w, pkt->sid_enddevice, 8);
+    }
+    return start;
+}
+
+/** <!-- mqtt_publish_end {{{1 -->
+ * @brief write fixed header and move body next to it
+ * @param[in,out] w writer
+ * @param[in] start start of PUBLISH packet
+ * @return nothing
+ */
+static void mqtt_publish_end(json_writer_t *w, int32_t start)
+{
+    uint8_t head[MQTT_HEAD_MAX];
+    int32_t body = start + MQTT_HEAD_MAX;
+    if (w->err) {
+        return;
+    }
+    int32_t hlen = mqtt_remaining(head, MQTT_PUBLISH, w->len - body);
+    memmove(&w->buf[start + hlen], &w->buf[body], w->len - body);
+    memcpy(&w->buf[start], head, hlen);
+    w->len -= MQTT_HEAD_MAX - hlen;
+}
+
+/** <!-- mqtt_json {{{1 -->
+ * @brief write JSON payload of one packet
+ * @param[in,out] w writer
+ * @param[in] pkt TWE-LITE packet
+ * @param[in] clock clock mapping of timestamps
+ * @return nothing
+ */
+static void mqtt_json(json_writer_t *w, const twelite_packet_t *pkt,
+                      const timemap_t *clock)
+{
+    uint32_t i;
+    int32_t val;
+    json_raw(w, "{\"timestamp\":", 13);
+    json_timestamp(w, timemap_wall(clock, pkt->timestamp));
+    json_raw(w, ",\"lqi\":", 7);
+    json_uint(w, pkt->lqi, 1);
+    for (i = 0; i < TWELITE_STREAM_NUM; i++) {
+        if (twelite_stream_value(pkt, i, &val) < 0) {
+            continue;
+        }
+        json_raw(w, ",", 1);
+        json_key(w, twelite_streams[i].name);
+        json_fixed(w, val, twelite_streams[i].frac);
+    }
+    json_raw(w, "}", 1);
+}
+
+/** <!-- mqtt_format {{{1 -->
+ * @brief serialize packets into PUBLISH packets
+ * @param[in] ctx MQTT publisher sink
+ * @param[out] dst PUBLISH packets
+ * @param[in] size size of dst
+ * @param[in] pkt TWE-LITE packets
+ * @param[in] num number of packets
+ * @return length of PUBLISH packets
+ * @retval -ve_value: dst is too small
+ */
+int32_t mqtt_format(void *ctx, char *dst, int32_t size,
+                    const twelite_packet_t *pkt, uint32_t num)
+{
+    mqtt_t *c = (mqtt_t *)ctx;
+    json_writer_t w;
+    uint32_t n;
+    json_init(&w, dst, size);
+    if (c->encoding == MQTT_CBOR_DELTA) {
+        int32_t start = mqtt_publish_begin(&w, c, NULL);
+        cbor_delta(&w, pkt, num, c->ops.clock);
+        mqtt_publish_end(&w, start);
+        return json_finish(&w);
+    }
+    for (n = 0; (n < num) && !w.err; n++) {
+        int32_t start = mqtt_publish_begin(&w, c, &pkt[n]);
+        if (c->encoding == MQTT_CBOR) {
+            cbor_packet(&w, &pkt[n], c->ops.clock);
+        } else {
+            mqtt_json(&w, &pkt[n], c->ops.clock);
+        }
+        mqtt_publish_end(&w, start);
+    }
+    return json_finish(&w);
+}
+
+/** <!-- mqtt_connect {{{1 -->
+ * @brief connect to broker and start session
+ * @param[in,out] c MQTT publisher sink
+ * @return result of connect
+ * @retval Zero: Success
+ * @retval -ve_value: Error
+ */
+static int8_t mqtt_connect(mqtt_t *c)
+{
+    uint8_t pkt[64 + sizeof(c->client_id)];
+    uint32_t id_len = strlen(c->client_id);
+    uint8_t *p = &pkt[MQTT_HEAD_MAX];
+    int32_t n;
+    c->sock = sink_connect(c->host, c->port, SOCK_STREAM);
+    if (c->sock < 0) {
+        return -1;
+    }
+    // variable header: protocol name, level 4, clean session, keep alive
+    memcpy(p, "\0\4MQTT\4\2", 8);
+    p[8] = (uint8_t)(MQTT_KEEPALIVE >> 8);
+    p[9] = (uint8_t)MQTT_KEEPALIVE;
+    p[10] = (uint8_t)(id_len >> 8);
+    p[11] = (uint8_t)id_len;
+    memcpy(&p[12], c->client_id, id_len);
+    uint8_t head[MQTT_HEAD_MAX];
+    int32_t hlen = mqtt_remaining(head, MQTT_CONNECT, 12 + id_len);
+    memcpy(p - hlen, head, hlen);
+    if (sink_send_all(c->sock, (const char *)(p - hlen), hlen + 12 + id_len)) {
+        return -1;
+    }
+    // CONNACK: type, length 2, flags, return code
+    for (n = 0; n < 4; ) {
+        int32_t r = recv(c->sock, &pkt[n], 4 - n, 0);
+        if (r <= 0) {
+            ESP_LOGE(TAG_MQTT, "no CONNACK from %s:%d", c->host, c->port);
+            return -1;
+        }
+        n += r;
+    }
+    if ((pkt[0] != MQTT_CONNACK) || (pkt[1] != 2) || (pkt[3] != 0)) {
+        ESP_LOGE(TAG_MQTT, "connection refused: %d", pkt[3]);
+        return -1;
+    }
+    c->n_connect++;
+    return 0;
+}
+
+/** <!-- mqtt_close {{{1 -->
+ * @brief close connection to broker
+ * @param[in,out] ctx MQTT publisher sink
+ * @return nothing
+ */
+static void mqtt_close(void *ctx)
+{
+    mqtt_t *c = (mqtt_t *)ctx;
+    if (c->sock >= 0) {
+        close(c->sock);
+    }
+    c->sock = -1;
+}
+
+/** <!-- mqtt_send {{{1 -->
+ * @brief send PUBLISH packets, connect on demand
+ * @param[in,out] ctx MQTT publisher sink
+ * @param[in] data PUBLISH packets
+ * @param[in] len length of data
+ * @return result of send
+ * @retval Zero: Success
+ * @retval -ve_value: Error
+ */
+static int8_t mqtt_send(void *ctx, const char *data, int32_t len)
+{
+    mqtt_t *c = (mqtt_t *)ctx;
+    int64_t now = port_msec();
+    if ((c->sock >= 0) && (now - c->last_tx >= MQTT_KEEPALIVE * 1000)) {
+        mqtt_close(c);
+    }
+    if ((c->sock < 0) && mqtt_connect(c)) {
+        return -1;
+    }
+    if (sink_send_all(c->sock, data, len)) {
+        return -1;
+    }
+    c->last_tx = now;
+    return 0;
+}
+
+/** <!-- mqtt_init {{{1 -->
+ * @brief initialise MQTT publisher sink
+ * @param[out] c MQTT publisher sink
+ * @param[in] host host name
+ * @param[in] port port number
+ * @param[in] client_id client identifier
+ * @param[in] topic topic prefix
+ * @param[in] encoding payload encoding
+ * @param[in] clock clock mapping of timestamps
+ * @return result of initialisation
+ * @retval Zero: Success
+ * @retval -ve_value: Error
+ */
+int8_t mqtt_init(mqtt_t *c, const char *host, uint16_t port,
+                 const char *client_id, const char *topic,
+                 mqtt_encoding_t encoding, const timemap_t *clock)
+{
+    memset(c, 0, sizeof(mqtt_t));
+    c->sock = -1;
+    c->port = port;
+    c->encoding = encoding;
+    if ((strlen(host) >= sizeof(c->host)) ||
+        (strlen(client_id) >= sizeof(c->client_id)) ||
+        (strlen(topic) >= sizeof(c->topic))) {
+        return -1;
+    }
+    strcpy(c->host, host);
+    strcpy(c->client_id, client_id);
+    strcpy(c->topic, topic);
+    c->ops.format   = mqtt_format;
+    c->ops.send     = mqtt_send;
+    c->ops.close    = mqtt_close;
+    c->ops.ctx      = c;
+    c->ops.clock    = clock;
+    return 0;
+}
+
+// end of file {{{1
+// vim:ft=c:et:nowrap:fdm=marker
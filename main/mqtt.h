@@ -0,0 +1,80 @@
+/**
+ * Copyright (C) 2017 m2enu
+ *
+ * @file main/mqtt.h
+ * @brief minimal MQTT 3.1.1 publisher sink (QoS 0)
+ * @author m2enu
+ * @date 2026/10/16
+ */
+#ifndef MQTT_H
+#define MQTT_H
+
+#include <stdint.h>
+
+#include "sink.h"
+
+#define MQTT_KEEPALIVE  60 //!< keep alive of session [s]
+
+/** <!-- mqtt_encoding_t {{{1 -->
+ * @brief payload encoding of MQTT publisher sink
+ */
+typedef enum mqtt_encoding_t_tag {
+    MQTT_JSON = 0, //!< JSON, one message per packet to <topic>/<sid>
+    MQTT_CBOR, //!< CBOR map, one message per packet to <topic>/<sid>
+    MQTT_CBOR_DELTA, //!< CBOR delta batch, one message per batch to <topic>
+} mqtt_encoding_t;
+
+/** <!-- mqtt_t {{{1 -->
+ * @brief MQTT publisher sink
+ *
+ * Each packet is published to <topic>/<sid_enddevice>, or each batch to
+ * <topic> with MQTT_CBOR_DELTA. The
+ * connection is re-established when it was idle for the keep alive, as
+ * the broker may have dropped it silently.
+ */
+typedef struct mqtt_t_tag {
+    char host[64]; //!< host name
+    uint16_t port; //!< port number
+    char client_id[24]; //!< client identifier
+    char topic[48]; //!< topic prefix
+    uint8_t encoding; //!< payload encoding (mqtt_encoding_t)
+    int sock; //!< connected socket (-1: not connected)
+    int64_t last_tx; //!< time of last transmission [ms]
+    uint32_t n_connect; //!< number of sessions
+    sink_ops_t ops; //!< sink operations
+} mqtt_t;
+
+/** <!-- mqtt_init {{{1 -->
+ * @brief initialise MQTT publisher sink
+ * @param[out] c MQTT publisher sink
+ * @param[in] host host name
+ * @param[in] port port number
+ * @param[in] client_id client identifier
+ * @param[in] topic topic prefix
+ * @param[in] encoding payload encoding
+ * @param[in] clock clock mapping of timestamps
+ * @return result of initialisation
+ * @retval Zero: Success
+ * @retval -ve_value: Error
+ */
+int8_t mqtt_init(mqtt_t *c, const char *host, uint16_t port,
+                 const char *client_id, const char *topic,
+                 mqtt_encoding_t encoding, const timemap_t *clock);
+
+/** <!-- mqtt_format {{{1 -->
+ * @brief serialize packets into PUBLISH packets
+ * @param[in] ctx MQTT publisher sink
+ * @param[out] dst PUBLISH packets
+ * @param[in] size size of dst
+ * @param[in] pkt TWE-LITE packets
+ * @param[in] num number of packets
+ * @return length of PUBLISH packets
+ * @retval -ve_value: dst is too small
+ */
+int32_t mqtt_format(void *ctx, char *dst, int32_t size,
+                    const twelite_packet_t *pkt, uint32_t num);
+
+#endif // MQTT_H
+
+// end of file {{{1
+// vim:ft=c:et:nowrap:fdm=marker
@@ -0,0 +1,196 @@
+/**
+ * Copyright (C) 2017 m2enu
+ *
+ * @file main/pktq.c
+ * @brief bounded lock-free SPSC queue of TWE-LITE packets
+ * @author m2enu
+ * @date 2026/10/16
+ */
+#include <stdint.h>
+#include <string.h>
+
+#include "pktq.h"
+
+#define PKTQ_SPIN_MAX   16 //!< max. retry of claiming the oldest slot
+
+#define PKTQ_LOAD(p)        __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define PKTQ_STORE(p, v)    __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define PKTQ_CAS(p, e, d)   __atomic_compare_exchange_n((p), &(e), (d), 0, \
+                                __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+
+/* Sequence number of slot at position pos:
+ *   pos         : free, producer may write
+ *   pos + 1     : published, consumer may read
+ *   pos (again) : claimed by consumer or producer while it is read/written
+ *   pos + num   : released, free for next lap
+ */
+
+/** <!-- pktq_init {{{1 -->
+ * @brief initialise packet queue
+ * @param[out] q packet queue
+ * @param[in] slot slots of queue
+ * @param[in] num number of slots (power of 2)
+ * @param[in] policy overflow policy
+ * @return result of initialisation
+ * @retval Zero: Success
+ * @retval -ve_value: Error
+ */
+int8_t pktq_init(pktq_t *q, pktq_slot_t *slot, uint32_t num,
+                 pktq_policy_t policy)
+{
+    if ((num < 2) || (num & (num - 1))) {
+        return -1;
+    }
+    uint32_t i;
+    for (i = 0; i < num; i++) {
+        slot[i].seq = i;
+    }
+    q->slot             = slot;
+    q->mask             = num - 1;
+    q->policy           = policy;
+    q->head             = 0;
+    q->tail             = 0;
+    q->n_push           = 0;
+    q->n_pop            = 0;
+    q->n_drop_newest    = 0;
+    q->n_drop_oldest    = 0;
+    q->n_coalesce       = 0;
+    return 0;
+}
+
+/** <!-- pktq_drop_oldest {{{1 -->
+ * @brief drop the oldest queued packet (producer)
+ * @param[in,out] q packet queue
+ * @return result of drop
+ * @retval Zero: Success
+ * @retval -ve_value: the oldest slot is being read by consumer
+ */
+static int8_t pktq_drop_oldest(pktq_t *q)
+{
+    uint32_t h = PKTQ_LOAD(&q->head);
+    pktq_slot_t *s = &q->slot[h & q->mask];
+    uint32_t seq = h + 1;
+    if (!PKTQ_CAS(&s->seq, seq, h)) {
+        return -1;
+    }
+    PKTQ_STORE(&q->head, h + 1);
+    PKTQ_STORE(&s->seq, h + q->mask + 1);
+    q->n_drop_oldest++;
+    return 0;
+}
+
+/** <!-- pktq_coalesce {{{1 -->
+ * @brief overwrite the latest queued packet of the same end device (producer)
+ * @param[in,out] q packet queue
+ * @param[in] pkt packet to push
+ * @return result of coalesce
+ * @retval Zero: Success
+ * @retval -ve_value: no queued packet of the same end device
+ */
+static int8_t pktq_coalesce(pktq_t *q, const twelite_packet_t *pkt)
+{
+    uint32_t pos;
+    uint32_t h = PKTQ_LOAD(&q->head);
+    for (pos = q->tail - 1; (int32_t)(pos - h) >= 0; pos--) {
+        pktq_slot_t *s = &q->slot[pos & q->mask];
+        uint32_t seq = pos + 1;
+        if (!PKTQ_CAS(&s->seq, seq, pos)) {
+            continue; // being read by consumer, or already popped
+        }
+        int8_t hit = (s->pkt.sid_enddevice == pkt->sid_enddevice);
+        if (hit) {
+            s->pkt = *pkt;
+        }
+        PKTQ_STORE(&s->seq, pos + 1);
+        if (hit) {
+            q->n_coalesce++;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/** <!-- pktq_push {{{1 -->
+ * @brief push packet to queue (producer)
+ * @param[in,out] q packet queue
+ * @param[in] pkt packet to push
+ * @return result of push
+ * @retval Zero: Success
+ * @retval +ve_value: pushed, but queued packet was dropped or overwritten
+ * @retval -ve_value: queue full, pushed packet was dropped
+ */
+int8_t pktq_push(pktq_t *q, const twelite_packet_t *pkt)
+{
+    int8_t ret = 0;
+    int32_t spin;
+    uint32_t t = q->tail;
+    pktq_slot_t *s = &q->slot[t & q->mask];
+    for (spin = 0; PKTQ_LOAD(&s->seq) != t; spin++) {
+        // queue full
+        if (spin >= PKTQ_SPIN_MAX) {
+            q->n_drop_newest++;
+            return -1;
+        }
+        switch (q->policy) {
+        case PKTQ_DROP_OLDEST:
+            if (pktq_drop_oldest(q) == 0) {
+                ret = 1;
+            }
+            break;
+        case PKTQ_COALESCE:
+            if (pktq_coalesce(q, pkt) == 0) {
+                return 1;
+            }
+            // fall through
+        default:
+            q->n_drop_newest++;
+            return -1;
+        }
+    }
+    s->pkt = *pkt;
+    PKTQ_STORE(&s->seq, t + 1);
+    PKTQ_STORE(&q->tail, t + 1);
+    q->n_push++;
+    return ret;
+}
+
+/** <!-- pktq_pop {{{1 -->
+ * @brief pop packet from queue (consumer)
+ * @param[in,out] q packet queue
+ * @param[out] pkt popped packet
+ * @return result of pop
+ * @retval Zero: Success
+ * @retval +ve_value: queue empty
+ */
+int8_t pktq_pop(pktq_t *q, twelite_packet_t *pkt)
+{
+    while (1) {
+        uint32_t h = PKTQ_LOAD(&q->head);
+        pktq_slot_t *s = &q->slot[h & q->mask];
+        uint32_t seq = h + 1;
+        if (PKTQ_CAS(&s->seq, seq, h)) {
+            *pkt = s->pkt;
+            PKTQ_STORE(&q->head, h + 1);
+            PKTQ_STORE(&s->seq, h + q->mask + 1);
+            q->n_pop++;
+            return 0;
+        }
+        if ((int32_t)(seq - (h + 1)) <= 0) {
+            return 1; // empty, or claimed by producer to coalesce
+        }
+        // dropped by producer, head is being advanced
+    }
+}
+
+/** <!-- pktq_count {{{1 -->
+ * @brief number of queued packets
+ * @param[in] q packet queue
+ * @return number of queued packets
+ */
+uint32_t pktq_count(pktq_t *q)
+{
+    return PKTQ_LOAD(&q->tail) - PKTQ_LOAD(&q->head);
+}
+
+// end of file {{{1
+// vim:ft=c:et:nowrap:fdm=marker
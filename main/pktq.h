@@ -0,0 +1,97 @@
+/**
+ * Copyright (C) 2017 m2enu
+ *
+ * @file main/pktq.h
+ * @brief bounded lock-free SPSC queue of TWE-LITE packets
+ * @author m2enu
+ * @date 2026/10/16
+ */
+#ifndef PKTQ_H
+#define PKTQ_H
+
+#include <stdint.h>
+
+#include "twelite.h"
+
+/** <!-- pktq_policy_t {{{1 -->
+ * @brief overflow policy of packet queue
+ */
+typedef enum pktq_policy_t_tag {
+    PKTQ_DROP_NEWEST = 0, //!< drop pushed packet
+    PKTQ_DROP_OLDEST, //!< drop the oldest queued packet
+    PKTQ_COALESCE, //!< overwrite queued packet of the same end device
+} pktq_policy_t;
+
+/** <!-- pktq_slot_t {{{1 -->
+ * @brief slot of packet queue
+ */
+typedef struct pktq_slot_t_tag {
+    uint32_t seq; //!< sequence number of slot
+    twelite_packet_t pkt; //!< queued packet
+} pktq_slot_t;
+
+/** <!-- pktq_t {{{1 -->
+ * @brief bounded single-producer/single-consumer packet queue
+ *
+ * The producer may also take the oldest slot (PKTQ_DROP_OLDEST) or any
+ * queued slot (PKTQ_COALESCE) when the queue is full, so every slot is
+ * claimed by compare-and-swap of its sequence number before it is read.
+ */
+typedef struct pktq_t_tag {
+    pktq_slot_t *slot; //!< slots (number of slots is power of 2)
+    uint32_t mask; //!< number of slots - 1
+    pktq_policy_t policy; //!< overflow policy
+    uint32_t head; //!< next position to pop
+    uint32_t tail; //!< next position to push (producer only)
+    uint32_t n_push; //!< number of pushed packets
+    uint32_t n_pop; //!< number of popped packets
+    uint32_t n_drop_newest; //!< number of dropped pushed packets
+    uint32_t n_drop_oldest; //!< number of dropped queued packets
+    uint32_t n_coalesce; //!< number of overwritten queued packets
+} pktq_t;
+
+/** <!-- pktq_init {{{1 -->
+ * @brief initialise packet queue
+ * @param[out] q packet queue
+ * @param[in] slot slots of queue
+ * @param[in] num number of slots (power of 2)
+ * @param[in] policy overflow policy
+ * @return result of initialisation
+ * @retval Zero: Success
+ * @retval -ve_value: Error
+ */
+int8_t pktq_init(pktq_t *q, pktq_slot_t *slot, uint32_t num,
+                 pktq_policy_t policy);
+
+/** <!-- pktq_push {{{1 -->
+ * @brief push packet to queue (producer)
+ * @param[in,out] q packet queue
+ * @param[in] pkt packet to push
+ * @return result of push
+ * @retval Zero: Success
+ * @retval +ve_value: pushed, but queued packet was dropped or overwritten
+ * @retval -ve_value: queue full, pushed packet was dropped
+ */
+int8_t pktq_push(pktq_t *q, const twelite_packet_t *pkt);
+
+/** <!-- pktq_pop {{{1 -->
+ * @brief pop packet from queue (consumer)
+ * @param[in,out] q packet queue
+ * @param[out] pkt popped packet
+ * @return result of pop
+ * @retval Zero: Success
+ * @retval +ve_value: queue empty
+ */
+int8_t pktq_pop(pktq_t *q, twelite_packet_t *pkt);
+
+/** <!-- pktq_count {{{1 -->
+ * @brief number of queued packets
+ * @param[in] q packet queue
+ * @return number of queued packets
+ */
+uint32_t pktq_count(pktq_t *q);
+
+#endif // PKTQ_H
+
+// end of file {{{1
+// vim:ft=c:et:nowrap:fdm=marker
@@ -0,0 +1,224 @@
+/**
+ * Copyright (C) 2017 m2enu
+ *
+ * @file main/port.c
+ * @brief platform abstraction for ESP-IDF and host (Linux) builds
+ * @author m2enu
+ * @date 2026/10/16
+ */
+#if !defined(ESP_PLATFORM) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE // pthread_setaffinity_np()
+#endif
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "port.h"
+
+#ifndef ESP_PLATFORM
+/** <!-- port_task_entry {{{1 -->
+ * @brief thread entry of task
+ * @param[in] arg task
+ * @return nothing
+ */
+static void *port_task_entry(void *arg)
+{
+    port_task_t *t = (port_task_t *)arg;
+    t->fn(t->arg);
+    return NULL;
+}
+#endif
+
+/** <!-- port_task_create {{{1 -->
+ * @brief create task
+ * @param[out] t task
+ * @param[in] fn task function
+ * @param[in] name name of task
+ * @param[in] stack stack size [byte] (ignored on host)
+ * @param[in] prio priority (ignored on host)
+ * @param[in] core core to pin task to (PORT_CORE_ANY: not pinned)
+ * @param[in] arg argument of task function
+ * @return result of creation
+ * @retval Zero: Success
+ * @retval -ve_value: Error
+ */
+int8_t port_task_create(port_task_t *t, void (*fn)(void *), const char *name,
+                        uint32_t stack, uint32_t prio, int32_t core, void *arg)
+{
+    memset(t, 0, sizeof(port_task_t));
+#ifdef ESP_PLATFORM
+    if (xTaskCreatePinnedToCore(fn, name, stack, arg, prio, &t->handle,
+                                (core < 0) ? tskNO_AFFINITY : core) != pdPASS) {
+        return -1;
+    }
+#else
+    (void)stack;
+    (void)prio;
+    pthread_mutex_init(&t->lock, NULL);
+    pthread_cond_init(&t->cond, NULL);
+    t->fn   = fn;
+    t->arg  = arg;
+    if (pthread_create(&t->thread, NULL, port_task_entry, t) != 0) {
+        return -1;
+    }
+#ifdef __linux__
+    if (core >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(core, &set);
+        pthread_setaffinity_np(t->thread, sizeof(set), &set);
+    }
+#endif
+#endif
+    t->name = name;
+    return 0;
+}
+
+/** <!-- port_task_notify {{{1 -->
+ * @brief wake up task waiting in port_task_wait()
+ * @param[in,out] t task
+ * @return nothing
+ */
+void port_task_notify(port_task_t *t)
+{
+#ifdef ESP_PLATFORM
+    if (t->handle != NULL) {
+        xTaskNotifyGive(t->handle);
+    }
+#else
+    pthread_mutex_lock(&t->lock);
+    t->notify++;
+    pthread_cond_signal(&t->cond);
+    pthread_mutex_unlock(&t->lock);
+#endif
+}
+
+/** <!-- port_task_wait {{{1 -->
+ * @brief wait for notification of calling task
+ *
+ * Timeout is rounded up to ticks, so that a task waiting for a deadline
+ * never wakes up before it (and polls again at once).
+ * @param[in,out] t calling task
+ * @param[in] msec timeout [ms] (PORT_WAIT_FOREVER: no timeout)
+ * @return nothing
+ */
+void port_task_wait(port_task_t *t, int64_t msec)
+{
+#ifdef ESP_PLATFORM
+    ulTaskNotifyTake(pdTRUE, (msec < 0) ? portMAX_DELAY
+                     : (msec + portTICK_RATE_MS - 1) / portTICK_RATE_MS);
+#else
+    pthread_mutex_lock(&t->lock);
+    if (t->notify == 0) {
+        if (msec < 0) {
+            pthread_cond_wait(&t->cond, &t->lock);
+        } else {
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            ts.tv_sec  += msec / 1000;
+            ts.tv_nsec += (msec % 1000) * 1000000;
+            if (ts.tv_nsec >= 1000000000) {
+                ts.tv_sec++;
+                ts.tv_nsec -= 1000000000;
+            }
+            pthread_cond_timedwait(&t->cond, &t->lock, &ts);
+        }
+    }
+    t->notify = 0;
+    pthread_mutex_unlock(&t->lock);
+#endif
+}
+
+#if !defined(ESP_PLATFORM) && defined(PORT_HEAP_GUARD)
+// glibc allocator, wrapped below
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t num, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static volatile int port_heap_armed; //!< 1: initialisation is done
+static volatile uint32_t port_heap_n; //!< allocations since armed
+static volatile uint64_t port_heap_b; //!< bytes requested since armed
+
+/** <!-- port_heap_check {{{1 -->
+ * @brief count allocation, and abort in strict mode
+ * @param[in] size requested size [byte]
+ * @return nothing
+ */
+static void port_heap_check(size_t size)
+{
+    static const char msg[] = "heap allocation after init\n";
+    if (!port_heap_armed) {
+        return;
+    }
+    __atomic_add_fetch(&port_heap_n, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&port_heap_b, size, __ATOMIC_RELAXED);
+    if (PORT_HEAP_GUARD == 2) {
+        // stdio may allocate, so write directly
+        (void)!write(2, msg, sizeof(msg) - 1);
+        abort();
+    }
+}
+
+void *malloc(size_t size)
+{
+    port_heap_check(size);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t num, size_t size)
+{
+    port_heap_check(num * size);
+    return __libc_calloc(num, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    port_heap_check(size);
+    return __libc_realloc(ptr, size);
+}
+#endif
+
+/** <!-- port_heap_arm {{{1 -->
+ * @brief mark end of initialisation, heap is not used from now on
+ * @param nothing
+ * @return nothing
+ */
+void port_heap_arm(void)
+{
+#if !defined(ESP_PLATFORM) && defined(PORT_HEAP_GUARD)
+    port_heap_n     = 0;
+    port_heap_b     = 0;
+    port_heap_armed = 1;
+#endif
+}
+
+/** <!-- port_heap_count {{{1 -->
+ * @brief number of heap allocations since port_heap_arm()
+ * @param nothing
+ * @return number of allocations
+ */
+uint32_t port_heap_count(void)
+{
+#if !defined(ESP_PLATFORM) && defined(PORT_HEAP_GUARD)
+    return port_heap_n;
+#else
+    return 0;
+#endif
+}
+
+/** <!-- port_heap_bytes {{{1 -->
+ * @brief bytes requested by heap allocations since port_heap_arm()
+ * @param nothing
+ * @return requested bytes
+ */
+uint64_t port_heap_bytes(void)
+{
+#if !defined(ESP_PLATFORM) && defined(PORT_HEAP_GUARD)
+    return port_heap_b;
+#else
+    return 0;
+#endif
+}
+
+// end of file {{{1
+// vim:ft=c:et:nowrap:fdm=marker
@@ -0,0 +1,150 @@
+/**
+ * Copyright (C) 2017 m2enu
+ *
+ * @file main/port.h
+ * @brief platform abstraction for ESP-IDF and host (Linux) builds
+ *
+ * Every module except main.c takes sockets, logging, clock and tasks from
+ * this header only, so it also builds on Linux without ESP-IDF, e.g.
+ *   cc -Imain -c main/twelite.c main/framer.c main/m2x.c
+ * host/Makefile builds them with unit tests and fuzz targets.
+ * @author m2enu
+ * @date 2026/10/16
+ */
+#ifndef PORT_H
+#define PORT_H
+
+#include <stdint.h>
+
+#ifdef ESP_PLATFORM
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "lwip/err.h"
+#include "lwip/sockets.h"
+#include "lwip/sys.h"
+#include "lwip/netdb.h"
+#include "lwip/dns.h"
+#else
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+
+#define ESP_LOGE(tag, fmt, ...) fprintf(stderr, "E (%s) " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) fprintf(stderr, "W (%s) " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...) fprintf(stderr, "I (%s) " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGD(tag, fmt, ...) do { } while (0)
+#endif
+
+#ifdef MSG_NOSIGNAL
+#define PORT_MSG_NOSIGNAL MSG_NOSIGNAL //!< send() to closed socket fails without SIGPIPE
+#else
+#define PORT_MSG_NOSIGNAL 0 //!< send() to closed socket fails without SIGPIPE
+#endif
+#define PORT_CORE_ANY   (-1) //!< task is not pinned to a core
+#define PORT_WAIT_FOREVER (-1) //!< port_task_wait() without timeout
+
+/** <!-- port_task_t {{{1 -->
+ * @brief task which can be notified (FreeRTOS task or pthread)
+ */
+typedef struct port_task_t_tag {
+    const char *name; //!< name of task (NULL: not created)
+#ifdef ESP_PLATFORM
+    TaskHandle_t handle; //!< FreeRTOS task
+#else
+    pthread_t thread; //!< thread
+    pthread_mutex_t lock; //!< lock of notify
+    pthread_cond_t cond; //!< signalled by port_task_notify()
+    uint32_t notify; //!< number of pending notifications
+    void (*fn)(void *); //!< task function
+    void *arg; //!< argument of task function
+#endif
+} port_task_t;
+
+/** <!-- port_task_create {{{1 -->
+ * @brief create task
+ * @param[out] t task
+ * @param[in] fn task function
+ * @param[in] name name of task
+ * @param[in] stack stack size [byte] (ignored on host)
+ * @param[in] prio priority (ignored on host)
+ * @param[in] core core to pin task to (PORT_CORE_ANY: not pinned)
+ * @param[in] arg argument of task function
+ * @return result of creation
+ * @retval Zero: Success
+ * @retval -ve_value: Error
+ */
+int8_t port_task_create(port_task_t *t, void (*fn)(void *), const char *name,
+                        uint32_t stack, uint32_t prio, int32_t core, void *arg);
+
+/** <!-- port_task_notify {{{1 -->
+ * @brief wake up task waiting in port_task_wait()
+ * @param[in,out] t task
+ * @return nothing
+ */
+void port_task_notify(port_task_t *t);
+
+/** <!-- port_task_wait {{{1 -->
+ * @brief wait for notification of calling task
+ * @param[in,out] t calling task
+ * @param[in] msec timeout [ms] (PORT_WAIT_FOREVER: no timeout)
+ * @return nothing
+ */
+void port_task_wait(port_task_t *t, int64_t msec);
+
+/** <!-- port_heap_arm {{{1 -->
+ * @brief mark end of initialisation, heap is not used from now on
+ *
+ * Host builds with PORT_HEAP_GUARD defined count every malloc(), calloc()
+ * and realloc() after this, and abort at the first one when
+ * PORT_HEAP_GUARD is 2. Without it (and on ESP-IDF) nothing is counted.
+ * @param nothing
+ * @return nothing
+ */
+void port_heap_arm(void);
+
+/** <!-- port_heap_count {{{1 -->
+ * @brief number of heap allocations since port_heap_arm()
+ * @param nothing
+ * @return number of allocations
+ */
+uint32_t port_heap_count(void);
+
+/** <!-- port_heap_bytes {{{1 -->
+ * @brief bytes requested by heap allocations since port_heap_arm()
+ * @param nothing
+ * @return requested bytes
+ */
+uint64_t port_heap_bytes(void);
+
+/** <!-- port_msec {{{1 -->
+ * @brief monotonic time
+ *
+ * Taken from the 64-bit microsecond timer on ESP-IDF, as the 32-bit tick
+ * count wraps (49.7 days at 1 kHz) and has only tick resolution.
+ * @param nothing
+ * @return monotonic time since boot [ms]
+ */
+static inline int64_t port_msec(void)
+{
+#ifdef ESP_PLATFORM
+    return esp_timer_get_time() / 1000;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+#endif
+}
+
+#endif // PORT_H
+
+// end of file {{{1
+// vim:ft=c:et:nowrap:fdm=marker
@@ -0,0 +1,148 @@
+/**
+ * Copyright (C) 2017 m2enu
+ *
+ * @file main/retry.c
+ * @brief upload retry scheduler with exponential backoff and circuit breaker
+ * @author m2enu
+ * @date 2026/10/16
+ */
+#include <stdint.h>
+#include <string.h>
+
+#include "retry.h"
+
+/** <!-- retry_init {{{1 -->
+ * @brief initialise retry scheduler
+ * @param[out] r retry scheduler
+ * @param[in] base backoff after the first failure [ms]
+ * @param[in] cap max. backoff [ms]
+ * @param[in] threshold consecutive failures to open breaker
+ * @param[in] cooldown time to stay open before probing [ms]
+ * @param[in] max_attempt max. attempts of one request
+ * @param[in] seed seed of jitter (non-zero)
+ * @return nothing
+ */
+void retry_init(retry_t *r, int64_t base, int64_t cap, uint32_t threshold,
+                int64_t cooldown, uint32_t max_attempt, uint32_t seed)
+{
+    memset(r, 0, sizeof(retry_t));
+    r->base         = (base > 0) ? base : 1;
+    r->cap          = (cap > r->base) ? cap : r->base;
+    r->cooldown     = cooldown;
+    r->threshold    = (threshold > 0) ? threshold : 1;
+    r->max_attempt  = (max_attempt > 0) ? max_attempt : 1;
+    r->seed         = (seed != 0) ? seed : 1;
+    r->state        = RETRY_CLOSED;
+}
+
+/** <!-- retry_classify {{{1 -->
+ * @brief classify HTTP status of request
+ * @param[in] status HTTP status (-ve_value: no response)
+ * @return RETRY_DONE, RETRY_AGAIN or RETRY_DROP
+ */
+retry_verdict_t retry_classify(int32_t status)
+{
+    if ((status >= 200) && (status < 300)) {
+        return RETRY_DONE;
+    }
+    if ((status == 408) || (status == 429)) {
+        return RETRY_AGAIN; // request timeout, too many requests
+    }
+    if ((status >= 300) && (status < 500)) {
+        return RETRY_DROP; // same request will be refused again
+    }
+    return RETRY_AGAIN; // 5xx, timeout, connection failure
+}
+
+/** <!-- retry_backoff {{{1 -->
+ * @brief backoff after consecutive failures with jitter
+ *
+ * Half of the exponential backoff is fixed and the other half random, so
+ * that gateways restarted by the same outage do not retry in lockstep.
+ * @param[in,out] r retry scheduler
+ * @return backoff [ms]
+ */
+static int64_t retry_backoff(retry_t *r)
+{
+    uint32_t shift = r->fails - 1;
+    int64_t delay;
+    if (shift > RETRY_SHIFT_MAX) {
+        shift = RETRY_SHIFT_MAX;
+    }
+    delay = r->base << shift;
+    if (delay > r->cap) {
+        delay = r->cap;
+    }
+    // xorshift32
+    r->seed ^= r->seed << 13;
+    r->seed ^= r->seed >> 17;
+    r->seed ^= r->seed << 5;
+    return delay / 2 + (int64_t)(r->seed % (uint32_t)(delay / 2 + 1));
+}
+
+/** <!-- retry_wait {{{1 -->
+ * @brief time until next request is allowed
+ *
+ * An open breaker turns half-open here once its cool down has elapsed.
+ * @param[in,out] r retry scheduler
+ * @param[in] now monotonic time [ms]
+ * @return time to wait [ms]
+ * @retval Zero: request allowed now
+ */
+int64_t retry_wait(retry_t *r, int64_t now)
+{
+    if (now >= r->next) {
+        if (r->state == RETRY_OPEN) {
+            r->state = RETRY_HALF_OPEN;
+        }
+        return 0;
+    }
+    return r->next - now;
+}
+
+/** <!-- retry_result {{{1 -->
+ * @brief account result of request and schedule next one
+ * @param[in,out] r retry scheduler
+ * @param[in] now monotonic time [ms]
+ * @param[in] status HTTP status (-ve_value: no response)
+ * @return what to do with the request
+ */
+retry_verdict_t retry_result(retry_t *r, int64_t now, int32_t status)
+{
+    retry_verdict_t verdict = retry_classify(status);
+    if (verdict != RETRY_AGAIN) {
+        // server answered, it is healthy even if the request was refused
+        r->state    = RETRY_CLOSED;
+        r->fails    = 0;
+        r->attempt  = 0;
+        r->next     = now;
+        if (verdict == RETRY_DONE) {
+            r->n_done++;
+        } else {
+            r->n_drop++;
+        }
+        return verdict;
+    }
+    r->fails++;
+    r->attempt++;
+    if ((r->state == RETRY_HALF_OPEN) || (r->fails >= r->threshold)) {
+        // failed probe or too many failures, stop requests for a while
+        r->state    = RETRY_OPEN;
+        r->attempt  = 0;
+        r->next     = now + r->cooldown;
+        r->n_open++;
+        r->n_giveup++;
+        return RETRY_GIVEUP;
+    }
+    r->next = now + retry_backoff(r);
+    if (r->attempt >= r->max_attempt) {
+        r->attempt = 0;
+        r->n_giveup++;
+        return RETRY_GIVEUP;
+    }
+    r->n_again++;
+    return RETRY_AGAIN;
+}
+
+// end of file {{{1
+// vim:ft=c:et:nowrap:fdm=marker
@@ -0,0 +1,104 @@
+/**
+ * Copyright (C) 2017 m2enu
+ *
+ * @file main/retry.h
+ * @brief upload retry scheduler with exponential backoff and circuit breaker
+ *
+ * The scheduler never sleeps nor reads a clock by itself; the caller passes
+ * the current time to every function, so it runs against a virtual clock
+ * on the host as well.
+ * @author m2enu
+ * @date 2026/10/16
+ */
+#ifndef RETRY_H
+#define RETRY_H
+
+#include <stdint.h>
+
+#define RETRY_SHIFT_MAX     16 //!< max. exponent of backoff
+
+/** <!-- retry_state_t {{{1 -->
+ * @brief state of circuit breaker
+ */
+typedef enum retry_state_t_tag {
+    RETRY_CLOSED = 0, //!< server healthy, requests allowed after backoff
+    RETRY_OPEN, //!< server down, no request until cool down elapsed
+    RETRY_HALF_OPEN, //!< cool down elapsed, one probe request allowed
+} retry_state_t;
+
+/** <!-- retry_verdict_t {{{1 -->
+ * @brief what to do with the request after retry_result()
+ */
+typedef enum retry_verdict_t_tag {
+    RETRY_DONE = 0, //!< succeeded, discard request
+    RETRY_AGAIN, //!< transient failure, keep request and retry after wait
+    RETRY_DROP, //!< permanent failure (4xx), discard request
+    RETRY_GIVEUP, //!< attempts exhausted or breaker opened, store request
+} retry_verdict_t;
+
+/** <!-- retry_t {{{1 -->
+ * @brief retry scheduler
+ */
+typedef struct retry_t_tag {
+    int64_t base; //!< backoff after the first failure [ms]
+    int64_t cap; //!< max. backoff [ms]
+    int64_t cooldown; //!< time to stay open before probing [ms]
+    uint32_t threshold; //!< consecutive failures to open breaker
+    uint32_t max_attempt; //!< max. attempts of one request
+    uint8_t state; //!< state of circuit breaker (retry_state_t)
+    uint32_t fails; //!< number of consecutive failures
+    uint32_t attempt; //!< number of failed attempts of current request
+    int64_t next; //!< earliest time of next request [ms]
+    uint32_t seed; //!< state of jitter generator
+    uint32_t n_done; //!< number of succeeded requests
+    uint32_t n_again; //!< number of retried requests
+    uint32_t n_drop; //!< number of dropped requests
+    uint32_t n_giveup; //!< number of given up requests
+    uint32_t n_open; //!< number of breaker openings
+} retry_t;
+
+/** <!-- retry_init {{{1 -->
+ * @brief initialise retry scheduler
+ * @param[out] r retry scheduler
+ * @param[in] base backoff after the first failure [ms]
+ * @param[in] cap max. backoff [ms]
+ * @param[in] threshold consecutive failures to open breaker
+ * @param[in] cooldown time to stay open before probing [ms]
+ * @param[in] max_attempt max. attempts of one request
+ * @param[in] seed seed of jitter (non-zero)
+ * @return nothing
+ */
+void retry_init(retry_t *r, int64_t base, int64_t cap, uint32_t threshold,
+                int64_t cooldown, uint32_t max_attempt, uint32_t seed);
+
+/** <!-- retry_classify {{{1 -->
+ * @brief classify HTTP status of request
+ * @param[in] status HTTP status (-ve_value: no response)
+ * @return RETRY_DONE, RETRY_AGAIN or RETRY_DROP
+ */
+retry_verdict_t retry_classify(int32_t status);
+
+/** <!-- retry_wait {{{1 -->
+ * @brief time until next request is allowed
+ *
+ * An open breaker turns half-open here once its cool down has elapsed.
+ * @param[in,out] r retry scheduler
+ * @param[in] now monotonic time [ms]
+ * @return time to wait [ms]
+ * @retval Zero: request allowed now
+ */
+int64_t retry_wait(retry_t *r, int64_t now);
+
+/** <!-- retry_result {{{1 -->
+ * @brief account result of request and schedule next one
+ * @param[in,out] r retry scheduler
+ * @param[in] now monotonic time [ms]
+ * @param[in] status HTTP status (-ve_value: no response)
+ * @return what to do with the request
+ */
+retry_verdict_t retry_result(retry_t *r, int64_t now, int32_t status);
+
+#endif // RETRY_H
+
+// end of file {{{1
+// vim:ft=c:et:nowrap:fdm=marker
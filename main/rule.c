@@ -0,0 +1,216 @@
+/**
+ * Copyright (C) 2017 m2enu
+ *
+ * @file main/rule.c
+ * @brief alert rules classifying packets into priority lanes
+ * @author m2enu
+ * @date 2026/10/17
+ */
+#include <stdint.h>
+#include <string.h>
+
+#include "rule.h"
+
+#define RULE_RATE_SPAN  (60 * 1000) //!< span of rate limit [ms]
+#define RULE_RATE_DT    (60 * 60 * 1000) //!< max. interval of rate check [ms]
+
+/** <!-- rule_hash {{{1 -->
+ * @brief hash of end device SID
+ * @param[in] sid SID of end device
+ * @return hash value
+ */
+static inline uint32_t rule_hash(uint32_t sid)
+{
+    return (sid * 2654435761u) >> 16;
+}
+
+/** <!-- rule_value {{{1 -->
+ * @brief parse decimal value in units of 10^-frac
+ * @param[in,out] spec rules, advanced to the end of value
+ * @param[in] frac number of fractional digits
+ * @param[out] val value
+ * @return result of parse
+ * @retval Zero: Success
+ * @retval -ve_value: no digit, or value out of range
+ */
+static int8_t rule_value(const char **spec, uint8_t frac, int32_t *val)
+{
+    const char *s = *spec;
+    int64_t v = 0;
+    int8_t neg = 0;
+    int8_t digits = 0;
+    int8_t point = -1;
+    if (*s == '-') {
+        neg = 1;
+        s++;
+    }
+    for (; ((*s >= '0') && (*s <= '9')) || ((*s == '.') && (point < 0)); s++) {
+        if (*s == '.') {
+            point = 0;
+            continue;
+        }
+        digits = 1;
+        if ((point < 0) || (point < frac)) {
+            v = v * 10 + (*s - '0');
+            point += (point >= 0);
+        }
+        if (v > INT32_MAX) {
+            return -1;
+        }
+    }
+    // scale to frac, extra fractional digits are truncated
+    for (point = (point < 0) ? 0 : point; point < frac; point++) {
+        v *= 10;
+    }
+    if ((digits == 0) || (v > INT32_MAX)) {
+        return -1;
+    }
+    *val  = neg ? (int32_t)-v : (int32_t)v;
+    *spec = s;
+    return 0;
+}
+
+/** <!-- rule_stream {{{1 -->
+ * @brief find compiled rules of stream, or add them
+ * @param[in,out] t alert rules
+ * @param[in] stream output stream
+ * @return compiled rules of stream
+ */
+static rule_entry_t *rule_stream(rule_table_t *t, uint8_t stream)
+{
+    uint8_t n;
+    for (n = 0; n < t->num; n++) {
+        if (t->entry[n].stream == stream) {
+            return &t->entry[n];
+        }
+    }
+    rule_entry_t *e = &t->entry[t->num++];
+    e->stream = stream;
+    e->slot   = -1;
+    e->lo     = INT32_MIN;
+    e->hi     = INT32_MAX;
+    e->rate   = 0;
+    return e;
+}
+
+/** <!-- rule_init {{{1 -->
+ * @brief compile alert rules
+ * @param[out] t alert rules
+ * @param[in] spec rules (see rule.h, NULL or "": no rule)
+ * @return result of compile
+ * @retval Zero: Success
+ * @retval -ve_value: spec is malformed, no rule is compiled
+ */
+int8_t rule_init(rule_table_t *t, const char *spec)
+{
+    int8_t ret = 0;
+    memset(t, 0, sizeof(*t));
+    while ((spec != NULL) && (*spec != '\0') && (ret == 0)) {
+        uint8_t s;
+        int32_t val;
+        for (s = 0; s < TWELITE_STREAM_NUM; s++) {
+            size_t len = strlen(twelite_streams[s].name);
+            if ((strncmp(spec, twelite_streams[s].name, len) == 0) &&
+                (strchr("<>~", spec[len]) != NULL) && (spec[len] != '\0')) {
+                spec += len;
+                break;
+            }
+        }
+        char op = *spec++;
+        if ((s == TWELITE_STREAM_NUM) ||
+            (rule_value(&spec, twelite_streams[s].frac, &val) < 0) ||
+            ((*spec != ',') && (*spec != '\0'))) {
+            ret = -1;
+            break;
+        }
+        spec += (*spec == ',');
+        rule_entry_t *e = rule_stream(t, s);
+        if (op == '>') {
+            e->hi = val;
+        } else if (op == '<') {
+            e->lo = val;
+        } else if ((val >= 0) && ((e->slot >= 0) || (t->num_rate < RULE_RATE_MAX))) {
+            e->slot = (e->slot >= 0) ? e->slot : (int8_t)t->num_rate++;
+            e->rate = val;
+        } else {
+            ret = -1;
+        }
+    }
+    if (ret < 0) {
+        memset(t, 0, sizeof(*t));
+    }
+    return ret;
+}
+
+/** <!-- rule_lookup {{{1 -->
+ * @brief find previous values of end device, or entry to (re)use for it
+ * @param[in,out] t alert rules
+ * @param[in] sid SID of end device
+ * @return previous values (sid is 0 when newly assigned)
+ */
+static rule_prev_t *rule_lookup(rule_table_t *t, uint32_t sid)
+{
+    rule_prev_t *oldest = NULL;
+    uint32_t h = rule_hash(sid);
+    uint32_t i;
+    for (i = 0; i < RULE_PROBE; i++) {
+        rule_prev_t *p = &t->prev[(h + i) & (RULE_DEVICE_SIZE - 1)];
+        if ((p->sid == sid) || (p->sid == 0)) {
+            return p;
+        }
+        if ((oldest == NULL) || (p->seen < oldest->seen)) {
+            oldest = p;
+        }
+    }
+    // probe sequence is full, evict the least recently seen device
+    t->n_evict++;
+    oldest->sid = 0;
+    return oldest;
+}
+
+/** <!-- rule_check {{{1 -->
+ * @brief classify packet into lane, and keep values for rate rules
+ * @param[in,out] t alert rules
+ * @param[in] pkt TWE-LITE packet (timestamp must be set)
+ * @return lane of packet (rule_lane_t)
+ */
+int8_t rule_check(rule_table_t *t, const twelite_packet_t *pkt)
+{
+    rule_prev_t *p = NULL;
+    int64_t dt = 0;
+    int32_t hit = 0;
+    uint8_t n;
+    if (t->num_rate > 0) {
+        // SID 0 marks unused entry
+        uint32_t sid = pkt->sid_enddevice ? pkt->sid_enddevice : 0xffffffff;
+        p = rule_lookup(t, sid);
+        if (p->sid != sid) {
+            p->sid   = sid;
+            p->valid = 0;
+        }
+        dt = pkt->timestamp - p->seen;
+        dt = (dt < 1) ? 1 : (dt > RULE_RATE_DT) ? RULE_RATE_DT : dt;
+        p->seen = pkt->timestamp;
+    }
+    for (n = 0; n < t->num; n++) {
+        const rule_entry_t *e = &t->entry[n];
+        int32_t v;
+        if (twelite_stream_value(pkt, e->stream, &v) < 0) {
+            continue;
+        }
+        hit |= (v < e->lo) | (v > e->hi);
+        if (e->slot >= 0) {
+            int64_t dv = (int64_t)v - p->val[e->slot];
+            dv = (dv < 0) ? -dv : dv;
+            hit |= ((p->valid >> e->slot) & 1) &
+                   (dv * RULE_RATE_SPAN > e->rate * dt);
+            p->val[e->slot] = v;
+            p->valid |= 1 << e->slot;
+        }
+    }
+    t->n_alert += hit;
+    return hit ? RULE_LANE_ALERT : RULE_LANE_BULK;
+}
+
+// end of file {{{1
+// vim:ft=c:et:nowrap:fdm=marker
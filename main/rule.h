@@ -0,0 +1,92 @@
+/**
+ * Copyright (C) 2017 m2enu
+ *
+ * @file main/rule.h
+ * @brief alert rules classifying packets into priority lanes
+ *
+ * Rules are given as a comma separated list of <stream><op><value>, where
+ * stream is a name of twelite_streams, value is in units of the M2X
+ * stream (e.g. degC, V), and op is one of
+ *   '>': value above limit
+ *   '<': value below limit
+ *   '~': change of value faster than limit per minute
+ * e.g. "vdd<2.4,temperature>40,temperature~5".
+ * Rules are compiled into one entry per stream, so the check of a packet
+ * is a few compares per ruled stream.
+ * @author m2enu
+ * @date 2026/10/17
+ */
+#ifndef RULE_H
+#define RULE_H
+
+#include <stdint.h>
+
+#include "twelite.h"
+
+#define RULE_RATE_MAX       4 //!< max. number of streams with rate rule
+#define RULE_DEVICE_SIZE    64 //!< entries of previous value table (power of 2)
+#define RULE_PROBE          8 //!< max. probe length of previous value table
+
+/** <!-- rule_lane_t {{{1 -->
+ * @brief lane of packet
+ */
+typedef enum rule_lane_t_tag {
+    RULE_LANE_BULK = 0, //!< batched and aggregated
+    RULE_LANE_ALERT = 1, //!< uploaded at once
+} rule_lane_t;
+
+/** <!-- rule_entry_t {{{1 -->
+ * @brief compiled rules of one stream
+ */
+typedef struct rule_entry_t_tag {
+    uint8_t stream; //!< output stream (twelite_stream_t)
+    int8_t slot; //!< slot of previous value (-1: no rate rule)
+    int32_t lo; //!< alert below this (INT32_MIN: none)
+    int32_t hi; //!< alert above this (INT32_MAX: none)
+    int64_t rate; //!< alert if change per minute is above this
+} rule_entry_t;
+
+/** <!-- rule_prev_t {{{1 -->
+ * @brief previous values of one end device for rate rules
+ */
+typedef struct rule_prev_t_tag {
+    uint32_t sid; //!< SID of end device (0: unused)
+    int64_t seen; //!< receive time of previous values [ms]
+    int32_t val[RULE_RATE_MAX]; //!< previous values (by slot)
+    uint8_t valid; //!< bit n: val[n] is set
+} rule_prev_t;
+
+/** <!-- rule_table_t {{{1 -->
+ * @brief compiled alert rules
+ */
+typedef struct rule_table_t_tag {
+    rule_entry_t entry[TWELITE_STREAM_NUM]; //!< rules of ruled streams
+    uint8_t num; //!< number of ruled streams
+    uint8_t num_rate; //!< number of streams with rate rule
+    rule_prev_t prev[RULE_DEVICE_SIZE]; //!< previous values (open addressing)
+    uint32_t n_alert; //!< number of packets classified into alert lane
+    uint32_t n_evict; //!< number of evicted previous values
+} rule_table_t;
+
+/** <!-- rule_init {{{1 -->
+ * @brief compile alert rules
+ * @param[out] t alert rules
+ * @param[in] spec rules (see rule.h, NULL or "": no rule)
+ * @return result of compile
+ * @retval Zero: Success
+ * @retval -ve_value: spec is malformed, no rule is compiled
+ */
+int8_t rule_init(rule_table_t *t, const char *spec);
+
+/** <!-- rule_check {{{1 -->
+ * @brief classify packet into lane, and keep values for rate rules
+ * @param[in,out] t alert rules
+ * @param[in] pkt TWE-LITE packet (timestamp must be set)
+ * @return lane of packet (rule_lane_t)
+ */
+int8_t rule_check(rule_table_t *t, const twelite_packet_t *pkt);
+
+#endif // RULE_H
+
+// end of file {{{1
+// vim:ft=c:et:nowrap:fdm=marker
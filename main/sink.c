@@ -0,0 +1,208 @@
+/**
+ * Copyright (C) 2017 m2enu
+ *
+ * @file main/sink.c
+ * @brief output sink with its own packet queue and batching
+ * @author m2enu
+ * @date 2026/10/16
+ */
+#include <stdint.h>
+#include <string.h>
+
+#include "sink.h"
+
+static const char *TAG_SINK = "sink"; //!< ESP_LOGx tag
+
+/** <!-- sink_init {{{1 -->
+ * @brief initialise sink
+ * @param[out] s sink
+ * @param[in] name name of sink (for log)
+ * @param[in] ops wire format and transport
+ * @param[in] slot slots of packet queue
+ * @param[in] slot_num number of slots (power of 2)
+ * @param[in] buf serialize buffer
+ * @param[in] size size of serialize buffer
+ * @param[in] max_num send when number of batched packets reaches this
+ * @param[in] max_age send when the oldest packet is batched this long [ms]
+ * @return result of initialisation
+ * @retval Zero: Success
+ * @retval -ve_value: Error
+ */
+int8_t sink_init(sink_t *s, const char *name, const sink_ops_t *ops,
+                 pktq_slot_t *slot, uint32_t slot_num,
+                 char *buf, int32_t size, uint32_t max_num, int64_t max_age)
+{
+    memset(s, 0, sizeof(sink_t));
+    if ((max_num == 0) || (max_num > SINK_BATCH_MAX)) {
+        max_num = SINK_BATCH_MAX;
+    }
+    s->name     = name;
+    s->ops      = ops;
+    s->buf      = buf;
+    s->size     = size;
+    s->max_num  = max_num;
+    s->max_age  = max_age;
+    return pktq_init(&s->q, slot, slot_num, PKTQ_DROP_OLDEST);
+}
+
+/** <!-- sink_push {{{1 -->
+ * @brief queue packet to sink and wake up its task (called by ingest)
+ * @param[in,out] s sink
+ * @param[in] pkt TWE-LITE packet
+ * @return result of pktq_push()
+ */
+int8_t sink_push(sink_t *s, const twelite_packet_t *pkt)
+{
+    int8_t ret = pktq_push(&s->q, pkt);
+    port_task_notify(&s->task);
+    return ret;
+}
+
+/** <!-- sink_poll {{{1 -->
+ * @brief batch queued packets, and send them when due (called by sink task)
+ * @param[in,out] s sink
+ * @param[in] now monotonic time [ms]
+ * @return time to wait until next poll [ms]
+ * @retval Zero: poll again immediately
+ * @retval -ve_value: nothing to do until next packet is queued
+ */
+int64_t sink_poll(sink_t *s, int64_t now)
+{
+    while ((s->num < s->max_num) && (pktq_pop(&s->q, &s->pkt[s->num]) == 0)) {
+        if (s->num++ == 0) {
+            s->since = now;
+        }
+    }
+    if (s->num == 0) {
+        return -1;
+    }
+    if (now < s->retry) {
+        return s->retry - now;
+    }
+    if ((s->num < s->max_num) && (now - s->since < s->max_age)) {
+        return s->since + s->max_age - now;
+    }
+    // timestamps are mapped to wall clock only after the first sync
+    if (!s->ops->clock->synced) {
+        return SINK_RETRY_WAIT;
+    }
+    int32_t len = s->ops->format(s->ops->ctx, s->buf, s->size, s->pkt, s->num);
+    if (len < 0) {
+        ESP_LOGE(TAG_SINK, "%s: buffer overflow, %d packets lost",
+                 s->name, s->num);
+        s->n_overflow++;
+    } else if (s->ops->send(s->ops->ctx, s->buf, len) < 0) {
+        // keep batch, packets arriving meanwhile wait in queue
+        s->ops->close(s->ops->ctx);
+        s->n_fail++;
+        s->retry = now + SINK_RETRY_WAIT;
+        ESP_LOGW(TAG_SINK, "%s: send failed (%u), queued=%u dropped=%u",
+                 s->name, s->n_fail, pktq_count(&s->q), s->q.n_drop_oldest);
+        return SINK_RETRY_WAIT;
+    } else {
+        s->n_send++;
+        s->n_packet += s->num;
+    }
+    s->num = 0;
+    return 0;
+}
+
+/** <!-- sink_task {{{1 -->
+ * @brief batch and send queued packets (upload stage)
+ * @param[in,out] args sink
+ * @return nothing
+ */
+static void sink_task(void *args)
+{
+    sink_t *s = (sink_t *)args;
+    while (1) {
+        int64_t wait = sink_poll(s, port_msec());
+        if (wait != 0) {
+            port_task_wait(&s->task, wait);
+        }
+    }
+}
+
+/** <!-- sink_spawn {{{1 -->
+ * @brief create task which batches and sends queued packets
+ * @param[in,out] s sink
+ * @param[in] stack stack size [byte]
+ * @param[in] prio priority
+ * @param[in] core core to pin task to (PORT_CORE_ANY: not pinned)
+ * @return result of port_task_create()
+ */
+int8_t sink_spawn(sink_t *s, uint32_t stack, uint32_t prio, int32_t core)
+{
+    return port_task_create(&s->task, sink_task, s->name, stack, prio, core, s);
+}
+
+/** <!-- sink_connect {{{1 -->
+ * @brief resolve host name and connect socket
+ * @param[in] host host name
+ * @param[in] port port number
+ * @param[in] type SOCK_STREAM or SOCK_DGRAM
+ * @return connected socket
+ * @retval -ve_value: Error
+ */
+int sink_connect(const char *host, uint16_t port, int type)
+{
+    struct addrinfo hints;
+    struct addrinfo *res = NULL;
+    struct sockaddr_in addr;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = type;
+    if ((getaddrinfo(host, NULL, &hints, &res) != 0) || (res == NULL)) {
+        ESP_LOGE(TAG_SINK, "DNS lookup failed: %s", host);
+        return -1;
+    }
+    memcpy(&addr, res->ai_addr, sizeof(addr));
+    addr.sin_port = htons(port);
+    freeaddrinfo(res);
+    int sock = socket(AF_INET, type, 0);
+    if (sock < 0) {
+        ESP_LOGE(TAG_SINK, "Failed to allocate socket");
+        return -1;
+    }
+    struct timeval tv = {
+        .tv_sec = SINK_TIMEOUT / 1000,
+        .tv_usec = (SINK_TIMEOUT % 1000) * 1000,
+    };
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    if (type == SOCK_STREAM) {
+        int one = 1;
+        setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        ESP_LOGE(TAG_SINK, "Failed to connect %s:%d", host, port);
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+/** <!-- sink_send_all {{{1 -->
+ * @brief send all data to socket
+ * @param[in] sock socket
+ * @param[in] data data to send
+ * @param[in] len length of data
+ * @return result of send
+ * @retval Zero: Success
+ * @retval -ve_value: Error
+ */
+int8_t sink_send_all(int sock, const char *data, int32_t len)
+{
+    while (len > 0) {
+        int32_t n = send(sock, data, len, PORT_MSG_NOSIGNAL);
+        if (n <= 0) {
+            return -1;
+        }
+        data += n;
+        len  -= n;
+    }
+    return 0;
+}
+
+// end of file {{{1
+// vim:ft=c:et:nowrap:fdm=marker
@@ -0,0 +1,132 @@
+/**
+ * Copyright (C) 2017 m2enu
+ *
+ * @file main/sink.h
+ * @brief output sink with its own packet queue and batching
+ *
+ * Every sink consumes its own bounded packet queue in its own task, so a
+ * slow or unreachable sink only drops its own oldest packets and never
+ * stalls ingestion or the other sinks.
+ * @author m2enu
+ * @date 2026/10/16
+ */
+#ifndef SINK_H
+#define SINK_H
+
+#include <stdint.h>
+
+#include "port.h"
+#include "pktq.h"
+#include "timemap.h"
+#include "twelite.h"
+
+#define SINK_BATCH_MAX      16 //!< max. number of packets in one send
+#define SINK_RETRY_WAIT     1000 //!< min. interval of retry after failure [ms]
+#define SINK_TIMEOUT        5000 //!< socket send/receive timeout [ms]
+
+/** <!-- sink_ops_t {{{1 -->
+ * @brief wire format and transport of sink
+ */
+typedef struct sink_ops_t_tag {
+    int32_t (*format)(void *ctx, char *dst, int32_t size,
+                      const twelite_packet_t *pkt, uint32_t num); //!< serialize packets (-ve_value: overflow)
+    int8_t (*send)(void *ctx, const char *data, int32_t len); //!< send serialized packets, connect on demand
+    void (*close)(void *ctx); //!< close connection after failure
+    void *ctx; //!< context of sink
+    const timemap_t *clock; //!< clock mapping of timestamps
+} sink_ops_t;
+
+/** <!-- sink_t {{{1 -->
+ * @brief output sink
+ */
+typedef struct sink_t_tag {
+    const char *name; //!< name of sink (for log)
+    const sink_ops_t *ops; //!< wire format and transport
+    pktq_t q; //!< packet queue (drop oldest when full)
+    twelite_packet_t pkt[SINK_BATCH_MAX]; //!< batched packets
+    uint32_t num; //!< number of batched packets
+    uint32_t max_num; //!< send when num reaches this
+    int64_t max_age; //!< send when the oldest packet is batched this long [ms]
+    int64_t since; //!< time when the oldest packet is batched [ms]
+    int64_t retry; //!< time of next retry after failure [ms]
+    char *buf; //!< serialize buffer
+    int32_t size; //!< size of serialize buffer
+    uint32_t n_packet; //!< number of sent packets
+    uint32_t n_send; //!< number of sends
+    uint32_t n_fail; //!< number of failed sends
+    uint32_t n_overflow; //!< number of batches dropped by buffer overflow
+    port_task_t task; //!< task running sink (see sink_spawn())
+} sink_t;
+
+/** <!-- sink_init {{{1 -->
+ * @brief initialise sink
+ * @param[out] s sink
+ * @param[in] name name of sink (for log)
+ * @param[in] ops wire format and transport
+ * @param[in] slot slots of packet queue
+ * @param[in] slot_num number of slots (power of 2)
+ * @param[in] buf serialize buffer
+ * @param[in] size size of serialize buffer
+ * @param[in] max_num send when number of batched packets reaches this
+ * @param[in] max_age send when the oldest packet is batched this long [ms]
+ * @return result of initialisation
+ * @retval Zero: Success
+ * @retval -ve_value: Error
+ */
+int8_t sink_init(sink_t *s, const char *name, const sink_ops_t *ops,
+                 pktq_slot_t *slot, uint32_t slot_num,
+                 char *buf, int32_t size, uint32_t max_num, int64_t max_age);
+
+/** <!-- sink_spawn {{{1 -->
+ * @brief create task which batches and sends queued packets
+ * @param[in,out] s sink
+ * @param[in] stack stack size [byte]
+ * @param[in] prio priority
+ * @param[in] core core to pin task to (PORT_CORE_ANY: not pinned)
+ * @return result of port_task_create()
+ */
+int8_t sink_spawn(sink_t *s, uint32_t stack, uint32_t prio, int32_t core);
+
+/** <!-- sink_push {{{1 -->
+ * @brief queue packet to sink and wake up its task (called by ingest)
+ * @param[in,out] s sink
+ * @param[in] pkt TWE-LITE packet
+ * @return result of pktq_push()
+ */
+int8_t sink_push(sink_t *s, const twelite_packet_t *pkt);
+
+/** <!-- sink_poll {{{1 -->
+ * @brief batch queued packets, and send them when due (called by sink task)
+ * @param[in,out] s sink
+ * @param[in] now monotonic time [ms]
+ * @return time to wait until next poll [ms]
+ * @retval Zero: poll again immediately
+ * @retval -ve_value: nothing to do until next packet is queued
+ */
+int64_t sink_poll(sink_t *s, int64_t now);
+
+/** <!-- sink_connect {{{1 -->
+ * @brief resolve host name and connect socket
+ * @param[in] host host name
+ * @param[in] port port number
+ * @param[in] type SOCK_STREAM or SOCK_DGRAM
+ * @return connected socket
+ * @retval -ve_value: Error
+ */
+int sink_connect(const char *host, uint16_t port, int type);
+
+/** <!-- sink_send_all {{{1 -->
+ * @brief send all data to socket
+ * @param[in] sock socket
+ * @param[in] data data to send
+ * @param[in] len length of data
+ * @return result of send
+ * @retval Zero: Success
+ * @retval -ve_value: Error
+ */
+int8_t sink_send_all(int sock, const char *data, int32_t len);
+
+#endif // SINK_H
+
+// end of file {{{1
+// vim:ft=c:et:nowrap:fdm=marker
@@ -0,0 +1,103 @@
+/**
+ * Copyright (C) 2017 m2enu
+ *
+ * @file main/timemap.c
+ * @brief mapping from monotonic clock to SNTP-disciplined wall clock
+ * @author m2enu
+ * @date 2026/10/17
+ */
+#include <stdint.h>
+#include <string.h>
+
+#include "timemap.h"
+
+/** <!-- timemap_offset {{{1 -->
+ * @brief read offset consistently
+ * @param[in] m clock mapping
+ * @return wall clock - monotonic clock [ms]
+ */
+static int64_t timemap_offset(const timemap_t *m)
+{
+    uint32_t seq;
+    int64_t offset;
+    do {
+        seq = __atomic_load_n(&m->seq, __ATOMIC_ACQUIRE);
+        offset = m->offset;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while ((seq & 1) || (seq != __atomic_load_n(&m->seq, __ATOMIC_RELAXED)));
+    return offset;
+}
+
+/** <!-- timemap_init {{{1 -->
+ * @brief initialise clock mapping (not synced)
+ * @param[out] m clock mapping
+ * @return nothing
+ */
+void timemap_init(timemap_t *m)
+{
+    memset(m, 0, sizeof(timemap_t));
+}
+
+/** <!-- timemap_sync {{{1 -->
+ * @brief discipline clock mapping by a pair of clock readings
+ *
+ * The first sync and errors beyond TIMEMAP_STEP set the offset at once.
+ * Smaller errors, like jitter of SNTP or the read of both clocks, are
+ * corrected gradually so that consecutive packets keep their order.
+ * @param[in,out] m clock mapping
+ * @param[in] mono monotonic time [ms]
+ * @param[in] wall wall clock at mono [ms since epoch]
+ * @return result of sync
+ * @retval Zero: small error slewed
+ * @retval +ve_value: offset stepped (first sync or large error)
+ * @retval -ve_value: wall clock is not set yet, ignored
+ */
+int8_t timemap_sync(timemap_t *m, int64_t mono, int64_t wall)
+{
+    int64_t offset = m->offset;
+    int8_t ret = 0;
+    if (wall < TIMEMAP_VALID) {
+        return -1;
+    }
+    m->error = (wall - mono) - offset;
+    if (!m->synced || (m->error > TIMEMAP_STEP) || (m->error < -TIMEMAP_STEP)) {
+        offset = wall - mono;
+        m->n_step++;
+        ret = 1;
+    } else {
+        offset += m->error / TIMEMAP_SLEW;
+        m->n_slew++;
+    }
+    __atomic_add_fetch(&m->seq, 1, __ATOMIC_ACQ_REL);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    m->offset = offset;
+    __atomic_add_fetch(&m->seq, 1, __ATOMIC_RELEASE);
+    m->synced = 1;
+    m->last = mono;
+    return ret;
+}
+
+/** <!-- timemap_wall {{{1 -->
+ * @brief map monotonic time to wall clock
+ * @param[in] m clock mapping
+ * @param[in] mono monotonic time [ms]
+ * @return wall clock [ms since epoch]
+ */
+int64_t timemap_wall(const timemap_t *m, int64_t mono)
+{
+    return mono + timemap_offset(m);
+}
+
+/** <!-- timemap_mono {{{1 -->
+ * @brief map wall clock to monotonic time (may be before boot)
+ * @param[in] m clock mapping
+ * @param[in] wall wall clock [ms since epoch]
+ * @return monotonic time [ms]
+ */
+int64_t timemap_mono(const timemap_t *m, int64_t wall)
+{
+    return wall - timemap_offset(m);
+}
+
+// end of file {{{1
+// vim:ft=c:et:nowrap:fdm=marker
@@ -0,0 +1,79 @@
+/**
+ * Copyright (C) 2017 m2enu
+ *
+ * @file main/timemap.h
+ * @brief mapping from monotonic clock to SNTP-disciplined wall clock
+ *
+ * Packets are stamped by the monotonic clock at receive, and mapped to
+ * wall clock only when they are serialized. Steps of the wall clock by
+ * SNTP do not reorder packets queued meanwhile, and packets received
+ * before the first sync still get a correct time.
+ * @author m2enu
+ * @date 2026/10/17
+ */
+#ifndef TIMEMAP_H
+#define TIMEMAP_H
+
+#include <stdint.h>
+
+#define TIMEMAP_VALID   1483228800000LL //!< wall clock before this is not synced (2017-01-01) [ms]
+#define TIMEMAP_STEP    1000 //!< larger errors are stepped, smaller ones slewed [ms]
+#define TIMEMAP_SLEW    4 //!< 1/TIMEMAP_SLEW of small error is corrected per sync
+
+/** <!-- timemap_t {{{1 -->
+ * @brief mapping from monotonic clock to wall clock
+ *
+ * Written by one task by timemap_sync(), and read by any task. Readers
+ * retry while seq is odd or has changed, as offset is not written
+ * atomically on 32-bit cores.
+ */
+typedef struct timemap_t_tag {
+    volatile uint32_t seq; //!< odd while offset is being written
+    volatile int64_t offset; //!< wall clock - monotonic clock [ms]
+    volatile int8_t synced; //!< 1: offset is valid
+    int64_t last; //!< monotonic time of last sync [ms]
+    int64_t error; //!< error of offset found by last sync [ms]
+    uint32_t n_step; //!< number of steps
+    uint32_t n_slew; //!< number of slews
+} timemap_t;
+
+
+/** <!-- timemap_init {{{1 -->
+ * @brief initialise clock mapping (not synced)
+ * @param[out] m clock mapping
+ * @return nothing
+ */
+void timemap_init(timemap_t *m);
+
+/** <!-- timemap_sync {{{1 -->
+ * @brief discipline clock mapping by a pair of clock readings
+ * @param[in,out] m clock mapping
+ * @param[in] mono monotonic time [ms]
+ * @param[in] wall wall clock at mono [ms since epoch]
+ * @return result of sync
+ * @retval Zero: small error slewed
+ * @retval +ve_value: offset stepped (first sync or large error)
+ * @retval -ve_value: wall clock is not set yet, ignored
+ */
+int8_t timemap_sync(timemap_t *m, int64_t mono, int64_t wall);
+
+/** <!-- timemap_wall {{{1 -->
+ * @brief map monotonic time to wall clock
+ * @param[in] m clock mapping
+ * @param[in] mono monotonic time [ms]
+ * @return wall clock [ms since epoch]
+ */
+int64_t timemap_wall(const timemap_t *m, int64_t mono);
+
+/** <!-- timemap_mono {{{1 -->
+ * @brief map wall clock to monotonic time (may be before boot)
+ * @param[in] m clock mapping
+ * @param[in] wall wall clock [ms since epoch]
+ * @return monotonic time [ms]
+ */
+int64_t timemap_mono(const timemap_t *m, int64_t wall);
+
+#endif // TIMEMAP_H
+
+// end of file {{{1
+// vim:ft=c:et:nowrap:fdm=marker
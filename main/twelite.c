@@ -7,105 +7,567 @@
  * @date 2017/08/20
  */
 #include <stdio.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <string.h>
 #include <stdlib.h>
 
 #include "twelite.h"
+#include "framer.h"
 
-/** <!-- substring {{{1 -->
- * @brief substring function
- * @param[out] dst destination string
- * @param[in] src source string
- * @param[in] pos position of source string
- * @param[in] len length of substring
- * @return result of substring
+/** <!-- twelite_field_t {{{1 -->
+ * @brief descriptor of one hexadecimal field in TWE-LITE app_tag packet
+ */
+typedef struct twelite_field_t_tag {
+    uint8_t pos; //!< position of field in received packet (ascii)
+    uint8_t len; //!< length of field (number of hex characters)
+    uint8_t size; //!< size of destination member [byte]
+    uint8_t offset; //!< offset of destination member in twelite_packet_t
+} twelite_field_t;
+
+/** <!-- TWELITE_FIELD {{{1 -->
+ * @brief macro of twelite_field_t initializer
+ * @param member destination member of twelite_packet_t
+ * @param pos position of field in received packet (ascii)
+ * @param len length of field (number of hex characters)
+ */
+#define TWELITE_FIELD(member, pos, len) { \
+    (pos), (len), \
+    sizeof(((twelite_packet_t *)0)->member), \
+    offsetof(twelite_packet_t, member) \
+}
+
+/** <!-- twelite_fields {{{1 -->
+ * @brief field layout of TWE-LITE app_tag packet header (all sensors)
+ */
+static const twelite_field_t twelite_fields[] = {
+    TWELITE_FIELD(sid_router,                1, 8),
+    TWELITE_FIELD(lqi,                       9, 2),
+    TWELITE_FIELD(next_number,              11, 4),
+    TWELITE_FIELD(sid_enddevice,            15, 8),
+    TWELITE_FIELD(id_enddevice,             23, 2),
+    TWELITE_FIELD(id_sensor,                25, 2),
+    TWELITE_FIELD(mvolt_vdd,                27, 2),
+    TWELITE_FIELD(mvolt_adc1,               29, 4),
+    TWELITE_FIELD(mvolt_adc2,               33, 4),
+};
+
+#define TWELITE_FIELDS_NUM  (sizeof(twelite_fields) / sizeof(twelite_fields[0]))
+
+/** <!-- twelite_fields_xxx {{{1 -->
+ * @brief field layout of sensor payloads
+ */
+static const twelite_field_t twelite_fields_bme280[] = {
+    TWELITE_FIELD(pkt_bme280.id_sensor,     37, 4),
+    TWELITE_FIELD(pkt_bme280.i_temperature, 41, 4),
+    TWELITE_FIELD(pkt_bme280.i_humidity,    45, 4),
+    TWELITE_FIELD(pkt_bme280.i_pressure,    49, 8),
+};
+
+static const twelite_field_t twelite_fields_sht21[] = {
+    TWELITE_FIELD(pkt_sht21.i_temperature,  37, 4),
+    TWELITE_FIELD(pkt_sht21.i_humidity,     41, 4),
+};
+
+static const twelite_field_t twelite_fields_adxl34x[] = {
+    TWELITE_FIELD(pkt_adxl34x.accel_x,      37, 4),
+    TWELITE_FIELD(pkt_adxl34x.accel_y,      41, 4),
+    TWELITE_FIELD(pkt_adxl34x.accel_z,      45, 4),
+};
+
+/** <!-- twelite_value_type_t {{{1 -->
+ * @brief type of packet member holding stream value
+ */
+typedef enum twelite_value_type_t_tag {
+    TWELITE_NONE = 0, //!< stream not provided
+    TWELITE_U16, //!< uint16_t
+    TWELITE_S16, //!< int16_t
+    TWELITE_U32, //!< uint32_t
+} twelite_value_type_t;
+
+/** <!-- twelite_value_t {{{1 -->
+ * @brief packet member holding stream value
+ */
+typedef struct twelite_value_t_tag {
+    uint8_t type; //!< type of member (twelite_value_type_t)
+    uint8_t offset; //!< offset of member in twelite_packet_t
+} twelite_value_t;
+
+#define TWELITE_VALUE(member, type) \
+    { (type), offsetof(twelite_packet_t, member) }
+
+/** <!-- twelite_decoder_t {{{1 -->
+ * @brief decoder of sensor payload
+ */
+typedef struct twelite_decoder_t_tag {
+    const twelite_field_t *field; //!< payload layout
+    uint8_t field_num; //!< number of payload fields
+    twelite_value_t stream[TWELITE_STREAM_NUM]; //!< output streams
+    int8_t (*post)(twelite_packet_t *pkt); //!< derive values (optional)
+} twelite_decoder_t;
+
+#define TWELITE_DECODER_FIELDS(tbl) \
+    .field = (tbl), .field_num = sizeof(tbl) / sizeof((tbl)[0])
+
+/** <!-- twelite_post_lm61 {{{1 -->
+ * @brief derive LM61 temperature from ADC1 (10 mV/degC, 600 mV at 0 degC)
+ * @param[in,out] pkt TWE-LITE packet
+ * @return result of derivation
  * @retval Zero: Success
- * @retval +ve_value: Warning
- * @retval -ve_value: Error
  */
-int8_t substring(char *dst, const char *src, int32_t pos, int32_t len)
+static int8_t twelite_post_lm61(twelite_packet_t *pkt)
 {
-    if ((pos < 0) || (len < 0) || (len > strlen(src))) {
-        return -1;
+    pkt->pkt_lm61.i_temperature = (int16_t)((pkt->mvolt_adc1 - 600) * 10);
+    return 0;
+}
+
+/** <!-- twelite_decoders {{{1 -->
+ * @brief decoders indexed by twelite_sensor_t
+ */
+static const twelite_decoder_t twelite_decoders[TWELITE_SENSOR_NUM] = {
+    [TWELITE_SENSOR_BME280] = {
+        TWELITE_DECODER_FIELDS(twelite_fields_bme280),
+        .stream = {
+            [TWELITE_STREAM_TEMPERATURE] = TWELITE_VALUE(pkt_bme280.i_temperature, TWELITE_S16),
+            [TWELITE_STREAM_PRESSURE]    = TWELITE_VALUE(pkt_bme280.i_pressure, TWELITE_U32),
+            [TWELITE_STREAM_HUMIDITY]    = TWELITE_VALUE(pkt_bme280.i_humidity, TWELITE_U16),
+            [TWELITE_STREAM_VDD]         = TWELITE_VALUE(mvolt_vdd, TWELITE_U16),
+        },
+        .post = twelite_parse_packet_bme280,
+    },
+    [TWELITE_SENSOR_ANALOG] = {
+        .stream = {
+            [TWELITE_STREAM_VDD]         = TWELITE_VALUE(mvolt_vdd, TWELITE_U16),
+            [TWELITE_STREAM_ADC1]        = TWELITE_VALUE(mvolt_adc1, TWELITE_U16),
+            [TWELITE_STREAM_ADC2]        = TWELITE_VALUE(mvolt_adc2, TWELITE_U16),
+        },
+    },
+    [TWELITE_SENSOR_LM61] = {
+        .stream = {
+            [TWELITE_STREAM_TEMPERATURE] = TWELITE_VALUE(pkt_lm61.i_temperature, TWELITE_S16),
+            [TWELITE_STREAM_VDD]         = TWELITE_VALUE(mvolt_vdd, TWELITE_U16),
+        },
+        .post = twelite_post_lm61,
+    },
+    [TWELITE_SENSOR_SHT21] = {
+        TWELITE_DECODER_FIELDS(twelite_fields_sht21),
+        .stream = {
+            [TWELITE_STREAM_TEMPERATURE] = TWELITE_VALUE(pkt_sht21.i_temperature, TWELITE_S16),
+            [TWELITE_STREAM_HUMIDITY]    = TWELITE_VALUE(pkt_sht21.i_humidity, TWELITE_U16),
+            [TWELITE_STREAM_VDD]         = TWELITE_VALUE(mvolt_vdd, TWELITE_U16),
+        },
+    },
+    [TWELITE_SENSOR_ADXL34X] = {
+        TWELITE_DECODER_FIELDS(twelite_fields_adxl34x),
+        .stream = {
+            [TWELITE_STREAM_VDD]         = TWELITE_VALUE(mvolt_vdd, TWELITE_U16),
+            [TWELITE_STREAM_ACCEL_X]     = TWELITE_VALUE(pkt_adxl34x.accel_x, TWELITE_S16),
+            [TWELITE_STREAM_ACCEL_Y]     = TWELITE_VALUE(pkt_adxl34x.accel_y, TWELITE_S16),
+            [TWELITE_STREAM_ACCEL_Z]     = TWELITE_VALUE(pkt_adxl34x.accel_z, TWELITE_S16),
+        },
+    },
+};
+
+/** <!-- twelite_registry {{{1 -->
+ * @brief id_sensor -> twelite_sensor_t (not registered: BME280)
+ */
+static const uint8_t twelite_registry[256] = {
+    [TWELITE_ID_ANALOG]     = TWELITE_SENSOR_ANALOG,
+    [TWELITE_ID_LM61]       = TWELITE_SENSOR_LM61,
+    [TWELITE_ID_SHT21]      = TWELITE_SENSOR_SHT21,
+    [TWELITE_ID_ADXL34X]    = TWELITE_SENSOR_ADXL34X,
+    [TWELITE_ID_BME280]     = TWELITE_SENSOR_BME280,
+};
+
+/** <!-- twelite_streams {{{1 -->
+ * @brief output streams
+ */
+const twelite_stream_info_t twelite_streams[TWELITE_STREAM_NUM] = {
+    [TWELITE_STREAM_TEMPERATURE]    = {"temperature", 2},
+    [TWELITE_STREAM_PRESSURE]       = {"pressure", 0},
+    [TWELITE_STREAM_HUMIDITY]       = {"humidity", 2},
+    [TWELITE_STREAM_VDD]            = {"vdd", 3},
+    [TWELITE_STREAM_ADC1]           = {"adc1", 3},
+    [TWELITE_STREAM_ADC2]           = {"adc2", 3},
+    [TWELITE_STREAM_ACCEL_X]        = {"accel_x", 3},
+    [TWELITE_STREAM_ACCEL_Y]        = {"accel_y", 3},
+    [TWELITE_STREAM_ACCEL_Z]        = {"accel_z", 3},
+};
+
+/** <!-- twelite_hex_table {{{1 -->
+ * @brief ascii -> nibble lookup table (0xff: not hexadecimal)
+ */
+static const uint8_t twelite_hex_table[256] = {
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, // 0x00
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, // 0x10
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, // 0x20
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, // 0x30
+    0xff, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, // 0x40
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, // 0x50
+    0xff, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, // 0x60
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, // 0x70
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, // 0x80
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, // 0x90
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, // 0xa0
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, // 0xb0
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, // 0xc0
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, // 0xd0
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, // 0xe0
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, // 0xf0
+};
+
+/** <!-- twelite_decode_byte {{{1 -->
+ * @brief decode one byte (two hexadecimal characters)
+ * @param[in] data received TWE-LITE app_tag string (ascii)
+ * @param[in] pos position of byte
+ * @param[in,out] bad OR-ed nibbles (> 0x0f: non-hexadecimal character found)
+ * @return decoded byte
+ */
+static inline uint8_t twelite_decode_byte(const char *data, int32_t pos,
+                                          uint8_t *bad)
+{
+    uint8_t hi = twelite_hex_table[(uint8_t)data[pos]];
+    uint8_t lo = twelite_hex_table[(uint8_t)data[pos + 1]];
+    *bad |= hi | lo;
+    return (uint8_t)((hi << 4) | lo);
+}
+
+/** <!-- twelite_store_field {{{1 -->
+ * @brief store decoded value into member of packet
+ * @param[out] pkt TWE-LITE packet
+ * @param[in] fld field descriptor
+ * @param[in] val decoded value
+ * @return nothing
+ */
+static inline void twelite_store_field(twelite_packet_t *pkt,
+                                       const twelite_field_t *fld,
+                                       uint32_t val)
+{
+    uint8_t *dst = (uint8_t *)pkt + fld->offset;
+    switch (fld->size) {
+    case 1: *(uint8_t  *)dst = (uint8_t)val;  break;
+    case 2: *(uint16_t *)dst = (uint16_t)val; break;
+    default: *(uint32_t *)dst = val;          break;
     }
-    for (src += pos; (*src != '\0') && (len > 0); len--) {
-        *dst++ = *src++;
+}
+
+/** <!-- twelite_decode_field {{{1 -->
+ * @brief decode one hexadecimal field in-place from received packet
+ * @param[out] pkt TWE-LITE packet
+ * @param[in] fld field descriptor
+ * @param[in] data received TWE-LITE app_tag string (ascii)
+ * @param[in] end end of payload (position of checksum)
+ * @param[in,out] sum sum of decoded bytes
+ * @param[in,out] bad OR-ed nibbles (> 0x0f: non-hexadecimal character found)
+ * @return end position of decoded field
+ */
+static inline int32_t twelite_decode_field(twelite_packet_t *pkt,
+                                           const twelite_field_t *fld,
+                                           const char *data, int32_t end,
+                                           uint8_t *sum, uint8_t *bad)
+{
+    uint32_t val = 0;
+    int32_t i;
+    if (end > fld->pos + fld->len) {
+        end = fld->pos + fld->len;
     }
-    *dst = '\0';
-    return 0;
+    for (i = fld->pos; i < end; i += 2) {
+        uint8_t byte = twelite_decode_byte(data, i, bad);
+        *sum += byte;
+        val = (val << 8) | byte;
+    }
+    twelite_store_field(pkt, fld, val);
+    return i;
 }
 
-/** <!-- hex2dec {{{1 -->
- * @brief convert hexadecimal-string to unsigned-decimal-integer function
- * @param[in] src source hexadecimal-string
- * @param[in] base base number (allow only 10 or 16)
- * @return converted value
+/** <!-- twelite_unpack_field {{{1 -->
+ * @brief decode one field from binary payload
+ * @param[out] pkt TWE-LITE packet
+ * @param[in] fld field descriptor
+ * @param[in] data binary payload
+ * @param[in] end length of payload
+ * @return nothing
  */
-uint32_t hex2dec(char *src, int32_t base)
+static inline void twelite_unpack_field(twelite_packet_t *pkt,
+                                        const twelite_field_t *fld,
+                                        const uint8_t *data, int32_t end)
 {
-    if ((base != 10) && (base != 16)) {
-        return 0;
+    uint32_t val = 0;
+    int32_t i = (fld->pos - 1) / 2;
+    if (end > i + fld->len / 2) {
+        end = i + fld->len / 2;
     }
-    uint64_t tmp = strtoul(src, NULL, base);
-    return (uint32_t)tmp;
+    for (; i < end; i++) {
+        val = (val << 8) | data[i];
+    }
+    twelite_store_field(pkt, fld, val);
 }
 
-/** <!-- parse {{{1 -->
- * @brief macro of substring -> hex2dec
- * @param[in] src received packet of TWE-LITE
- * @param[in] base base number (allow only 10 or 16)
- * @param[in] pos positin of source string
- * @param[in] len length of substring
- * @return parsed parameter
+/** <!-- twelite_parse_finish {{{1 -->
+ * @brief convert raw values of verified packet
+ * @param[in,out] pkt TWE-LITE packet
+ * @param[in] dec decoder of sensor
+ * @return nothing
  */
-uint32_t parse(const char *src, int32_t base, int32_t pos, int32_t len)
+static void twelite_parse_finish(twelite_packet_t *pkt,
+                                 const twelite_decoder_t *dec)
 {
-    char tmp[TWELITE_PACKET_LENGTH_MAX] = {0};
-    if (substring(tmp, src, pos, len)) {
-        return 0;
+    pkt->mvolt_vdd = twelite_calc_supply((uint8_t)(pkt->mvolt_vdd & 0xff));
+    if (dec->post != NULL) {
+        dec->post(pkt);
     }
-    return hex2dec(tmp, base);
+    pkt->ok = 1;
 }
 
 /** <!-- twelite_parse_packet {{{1 -->
  * @brief packet parser for TWE-LITE app_tag
+ *
+ * Fields are decoded and the checksum (two's complement of the sum of
+ * decoded bytes) is verified in one pass.
  * @param[out] pkt TWE-LITE packet
- * @param[in] data received TWE-LITE app_tag string (ascii)
+ * @param[in] data received TWE-LITE app_tag string (ascii, without CR/LF)
  * @param[in] len length of data
  * @return result of parse
  * @retval Zero: Success
  * @retval +ve_value: Warning
- * @retval -ve_value: Error
+ * @retval -ve_value: Error (twelite_err_t)
+ */
+int8_t twelite_parse_packet(twelite_packet_t *pkt, const char *data, int32_t len)
+{
+    uint32_t i;
+    uint8_t sum = 0;
+    uint8_t bad = 0;
+    int32_t pos = 1;
+    int32_t end = len - 2; // position of checksum
+    pkt->ok = 0;
+    if ((len < TWELITE_PACKET_LENGTH_MIN) ||
+        (len > TWELITE_PACKET_LENGTH_MAX) || ((len & 1) == 0)) {
+        return TWELITE_ERR_LENGTH;
+    }
+    for (i = 0; i < TWELITE_FIELDS_NUM; i++) {
+        int32_t n = twelite_decode_field(pkt, &twelite_fields[i], data, end,
+                                         &sum, &bad);
+        if (n > pos) {
+            pos = n;
+        }
+    }
+    pkt->type = twelite_registry[pkt->id_sensor];
+    const twelite_decoder_t *dec = &twelite_decoders[pkt->type];
+    for (i = 0; i < dec->field_num; i++) {
+        int32_t n = twelite_decode_field(pkt, &dec->field[i], data, end,
+                                         &sum, &bad);
+        if (n > pos) {
+            pos = n;
+        }
+    }
+    for (; pos < end; pos += 2) {
+        sum += twelite_decode_byte(data, pos, &bad); // trailing bytes
+    }
+    pkt->checksum       = twelite_decode_byte(data, end, &bad);
+    pkt->checksum_calc  = (uint8_t)(0 - sum);
+    if (bad > 0x0f) {
+        return TWELITE_ERR_HEX;
+    }
+    if (pkt->checksum != pkt->checksum_calc) {
+        return TWELITE_ERR_CHECKSUM;
+    }
+    twelite_parse_finish(pkt, dec);
+
+    return TWELITE_OK;
+}
+
+/** <!-- twelite_parse_binary {{{1 -->
+ * @brief packet parser for TWE-LITE binary transfer mode
+ *
+ * The payload is the same byte sequence as the app_tag string without
+ * its checksum, so fields are laid out by the same descriptor tables.
+ * @param[out] pkt TWE-LITE packet
+ * @param[in] data received binary frame (header to trailer)
+ * @param[in] len length of data
+ * @return result of parse
+ * @retval Zero: Success
+ * @retval -ve_value: Error (twelite_err_t)
+ */
+int8_t twelite_parse_binary(twelite_packet_t *pkt, const char *data, int32_t len)
+{
+    const uint8_t *p = (const uint8_t *)data + 4;
+    int32_t n = len - TWELITE_BINARY_OVERHEAD; // length of payload
+    uint8_t sum = 0;
+    uint32_t i;
+    pkt->ok = 0;
+    if ((n < TWELITE_BINARY_LENGTH_MIN) || (n > TWELITE_BINARY_LENGTH_MAX) ||
+        ((uint8_t)data[0] != TWELITE_BINARY_HEAD0) ||
+        ((uint8_t)data[1] != TWELITE_BINARY_HEAD1) ||
+        ((uint8_t)data[2] != (0x80 | (n >> 8))) ||
+        ((uint8_t)data[3] != (uint8_t)n)) {
+        return TWELITE_ERR_LENGTH;
+    }
+    for (i = 0; i < (uint32_t)n; i++) {
+        sum ^= p[i];
+    }
+    pkt->checksum       = p[n];
+    pkt->checksum_calc  = sum;
+    if (pkt->checksum != pkt->checksum_calc) {
+        return TWELITE_ERR_CHECKSUM;
+    }
+    for (i = 0; i < TWELITE_FIELDS_NUM; i++) {
+        twelite_unpack_field(pkt, &twelite_fields[i], p, n);
+    }
+    pkt->type = twelite_registry[pkt->id_sensor];
+    const twelite_decoder_t *dec = &twelite_decoders[pkt->type];
+    for (i = 0; i < dec->field_num; i++) {
+        twelite_unpack_field(pkt, &dec->field[i], p, n);
+    }
+    twelite_parse_finish(pkt, dec);
+
+    return TWELITE_OK;
+}
+
+/** <!-- twelite_encode_field {{{1 -->
+ * @brief encode one hexadecimal field from packet
+ * @param[out] dst TWE-LITE app_tag string (ascii)
+ * @param[in] pkt TWE-LITE packet
+ * @param[in] fld field descriptor
+ * @param[in,out] sum sum of encoded bytes
+ * @return end position of encoded field
+ */
+static int32_t twelite_encode_field(char *dst, const twelite_packet_t *pkt,
+                                    const twelite_field_t *fld, uint8_t *sum)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    const uint8_t *src = (const uint8_t *)pkt + fld->offset;
+    uint32_t val;
+    int32_t n;
+    switch (fld->size) {
+    case 1: val = *(const uint8_t  *)src; break;
+    case 2: val = *(const uint16_t *)src; break;
+    default: val = *(const uint32_t *)src; break;
+    }
+    if (fld->offset == offsetof(twelite_packet_t, mvolt_vdd)) {
+        val = (val <= 2800) ? (val - 1950) / 5 : 170 + (val - 2800) / 10;
+    }
+    for (n = fld->len - 2; n >= 0; n -= 2) {
+        uint8_t byte = (uint8_t)(val >> (n * 4));
+        *sum += byte;
+        dst[fld->pos + fld->len - 2 - n]     = hex[byte >> 4];
+        dst[fld->pos + fld->len - 2 - n + 1] = hex[byte & 0x0f];
+    }
+    return fld->pos + fld->len;
+}
+
+/** <!-- twelite_build_packet {{{1 -->
+ * @brief build TWE-LITE app_tag string from packet (inverse of parser)
+ *
+ * Fields are laid out by the same descriptor tables as the parser, and
+ * the checksum is appended. Used to generate synthetic or replayed
+ * traffic.
+ * @param[out] dst TWE-LITE app_tag string (ascii, with CR/LF and NUL)
+ * @param[in] size size of dst
+ * @param[in] pkt TWE-LITE packet
+ * @return length of string (without NUL)
+ * @retval -ve_value: dst is too small
  */
-int8_t twelite_parse_packet(twelite_packet_t *pkt, char *data, int32_t len)
+int32_t twelite_build_packet(char *dst, int32_t size,
+                             const twelite_packet_t *pkt)
 {
-    if (len < TWELITE_PACKET_LENGTH_MIN) {
+    static const char hex[] = "0123456789ABCDEF";
+    const twelite_decoder_t *dec =
+        &twelite_decoders[twelite_registry[pkt->id_sensor]];
+    int32_t end = TWELITE_PACKET_LENGTH_MIN; // position of checksum
+    uint8_t sum = 0;
+    uint32_t i;
+    if (dec->field_num > 0) {
+        const twelite_field_t *last = &dec->field[dec->field_num - 1];
+        end = last->pos + last->len;
+    }
+    if (size < end + 5) {
         return -1;
     }
-    // TODO: compare checksum
-    pkt->ok                         = 1;
-    pkt->sid_router                 = parse(data, 16,  1, 8);
-    pkt->lqi                        = parse(data, 16,  9, 2);
-    pkt->next_number                = parse(data, 16, 11, 4);
-    pkt->sid_enddevice              = parse(data, 16, 15, 8);
-    pkt->id_enddevice               = parse(data, 16, 23, 2);
-    pkt->id_sensor                  = parse(data, 16, 25, 2);
-    pkt->mvolt_vdd                  = parse(data, 16, 27, 2);
-    pkt->mvolt_adc1                 = parse(data, 16, 29, 4);
-    pkt->mvolt_adc2                 = parse(data, 16, 33, 4);
-    pkt->pkt_bme280.id_sensor       = parse(data, 16, 37, 4);
-    pkt->pkt_bme280.i_temperature   = parse(data, 16, 41, 4);
-    pkt->pkt_bme280.i_humidity      = parse(data, 16, 45, 4);
-    pkt->pkt_bme280.i_pressure      = parse(data, 16, 49, 8);
-    pkt->checksum                   = parse(data, 16, 57, 2);
-
-    pkt->mvolt_vdd      = twelite_calc_supply((uint8_t)(pkt->mvolt_vdd & 0xff));
-    pkt->checksum_calc  = twelite_calc_checksum(data, 0, len);
-
-    twelite_parse_packet_bme280(pkt);
+    dst[0] = ':';
+    for (i = 0; i < TWELITE_FIELDS_NUM; i++) {
+        twelite_encode_field(dst, pkt, &twelite_fields[i], &sum);
+    }
+    for (i = 0; i < dec->field_num; i++) {
+        twelite_encode_field(dst, pkt, &dec->field[i], &sum);
+    }
+    sum = (uint8_t)(0 - sum);
+    dst[end]     = hex[sum >> 4];
+    dst[end + 1] = hex[sum & 0x0f];
+    dst[end + 2] = '\r';
+    dst[end + 3] = '\n';
+    dst[end + 4] = '\0';
+    return end + 4;
+}
 
-    return 0;
+/** <!-- twelite_build_binary {{{1 -->
+ * @brief build TWE-LITE binary frame from packet (inverse of parser)
+ * @param[out] dst TWE-LITE binary frame
+ * @param[in] size size of dst
+ * @param[in] pkt TWE-LITE packet
+ * @return length of frame
+ * @retval -ve_value: dst is too small
+ */
+int32_t twelite_build_binary(char *dst, int32_t size,
+                             const twelite_packet_t *pkt)
+{
+    char str[TWELITE_PACKET_LENGTH_MAX + 5];
+    int32_t len = twelite_build_packet(str, sizeof(str), pkt);
+    int32_t n = (len - 5) / 2; // without ':', checksum and CR/LF
+    uint8_t bad = 0;
+    uint8_t sum = 0;
+    int32_t i;
+    if ((len < 0) || (size < n + TWELITE_BINARY_OVERHEAD)) {
+        return -1;
+    }
+    dst[0] = (char)TWELITE_BINARY_HEAD0;
+    dst[1] = (char)TWELITE_BINARY_HEAD1;
+    dst[2] = (char)(0x80 | (n >> 8));
+    dst[3] = (char)n;
+    for (i = 0; i < n; i++) {
+        uint8_t byte = twelite_decode_byte(str, 1 + i * 2, &bad);
+        sum ^= byte;
+        dst[4 + i] = (char)byte;
+    }
+    dst[4 + n] = (char)sum;
+    dst[5 + n] = (char)TWELITE_BINARY_EOT;
+    return n + TWELITE_BINARY_OVERHEAD;
+}
+
+/** <!-- twelite_sensor_resolve {{{1 -->
+ * @brief set payload type from id_sensor and derive payload values
+ *
+ * Used for packets restored from storage, the parser does this itself.
+ * @param[in,out] pkt TWE-LITE packet (id_sensor and payload set)
+ * @return nothing
+ */
+void twelite_sensor_resolve(twelite_packet_t *pkt)
+{
+    pkt->type = twelite_registry[pkt->id_sensor];
+    if (twelite_decoders[pkt->type].post != NULL) {
+        twelite_decoders[pkt->type].post(pkt);
+    }
+}
+
+/** <!-- twelite_stream_value {{{1 -->
+ * @brief get value of output stream from packet
+ * @param[in] pkt TWE-LITE packet
+ * @param[in] stream output stream
+ * @param[out] val value in units of 10^-frac (see twelite_streams)
+ * @return result of get
+ * @retval Zero: Success
+ * @retval -ve_value: stream is not provided by payload type of packet
+ */
+int8_t twelite_stream_value(const twelite_packet_t *pkt,
+                            twelite_stream_t stream, int32_t *val)
+{
+    const twelite_value_t *v = &twelite_decoders[pkt->type].stream[stream];
+    const uint8_t *src = (const uint8_t *)pkt + v->offset;
+    switch (v->type) {
+    case TWELITE_U16: *val = *(const uint16_t *)src;          return 0;
+    case TWELITE_S16: *val = *(const int16_t *)src;           return 0;
+    case TWELITE_U32: *val = (int32_t)*(const uint32_t *)src; return 0;
+    default:                                                  return -1;
+    }
 }
 
 /** <!-- twelite_parse_packet_bme280 {{{1 -->
@@ -118,7 +580,7 @@ int8_t twelite_parse_packet(twelite_packet_t *pkt, char *data, int32_t len)
  */
 int8_t twelite_parse_packet_bme280(twelite_packet_t *pkt)
 {
-    pkt->pkt_bme280.temperature = pkt->pkt_bme280.i_temperature / 100.0;
+    pkt->pkt_bme280.temperature = (int16_t)pkt->pkt_bme280.i_temperature / 100.0;
     pkt->pkt_bme280.humidity    = pkt->pkt_bme280.i_humidity    / 100.0;
     pkt->pkt_bme280.pressure    = pkt->pkt_bme280.i_pressure    /   1.0;
     return 0;
@@ -140,19 +602,35 @@ int16_t twelite_calc_supply(uint8_t src)
 /** <!-- twelite_calc_checksum {{{1 -->
  * @brief calculate TWE-LITE app_tag packet checksum
  * @param[in] data received TWE-LITE app_tag string (ascii)
- * @param[in] pos start position of data
- * @param[in] len length of data
- * @return calculated checksum
+ * @param[in] pos start position of data (first hexadecimal character)
+ * @param[in] len end position of data (position of checksum)
+ * @return calculated checksum (two's complement of the sum of decoded bytes)
  */
-uint8_t twelite_calc_checksum(char *data, int32_t pos, int32_t len)
+uint8_t twelite_calc_checksum(const char *data, int32_t pos, int32_t len)
 {
-    // TODO: calculation of checksum is unknown
-    int32_t i;
-    uint8_t ret = 0;
-    for (i = pos; i < len; i++) {
-        ret = ret ^ data[i];
+    uint8_t sum = 0;
+    uint8_t bad = 0;
+    for (; pos + 1 < len; pos += 2) {
+        sum += twelite_decode_byte(data, pos, &bad);
+    }
+    return (uint8_t)(0 - sum);
+}
+
+/** <!-- twelite_stats_count {{{1 -->
+ * @brief count result of twelite_parse_packet()
+ * @param[in,out] st statistics
+ * @param[in] err result of twelite_parse_packet()
+ * @return nothing
+ */
+void twelite_stats_count(twelite_stats_t *st, int8_t err)
+{
+    switch (err) {
+    case TWELITE_OK:            st->n_ok++;         break;
+    case TWELITE_ERR_LENGTH:    st->n_length++;     break;
+    case TWELITE_ERR_HEX:       st->n_hex++;        break;
+    case TWELITE_ERR_CHECKSUM:  st->n_checksum++;   break;
+    default:                                        break;
     }
-    return ret;
 }
 
 /** <!-- debug_twelite_print_packet {{{1 -->
@@ -160,7 +638,7 @@ uint8_t twelite_calc_checksum(char *data, int32_t pos, int32_t len)
  * @param nothing
  * @return nothing
  */
-void debug_twelite_print_packet(twelite_packet_t *pkt)
+void debug_twelite_print_packet(const twelite_packet_t *pkt)
 {
     printf("\n");
     printf("parse           : %8d  \n", pkt->ok                         );
@@ -170,16 +648,19 @@ void debug_twelite_print_packet(twelite_packet_t *pkt)
     printf("sid_enddevice   : %08x \n", pkt->sid_enddevice              );
     printf("id_enddevice    : %08x \n", pkt->id_enddevice               );
     printf("id_sensor       : %08x \n", pkt->id_sensor                  );
+    printf("type            : %8d  \n", pkt->type                       );
     printf("mvolt_vdd       : %8d  \n", pkt->mvolt_vdd                  );
     printf("mvolt_adc1      : %8d  \n", pkt->mvolt_adc1                 );
     printf("mvolt_adc2      : %8d  \n", pkt->mvolt_adc2                 );
-    printf("BME280 id       : %08x \n", pkt->pkt_bme280.id_sensor       );
-    printf("BME280 temp(int): %8d  \n", pkt->pkt_bme280.i_temperature   );
-    printf("BME280 humi(int): %8d  \n", pkt->pkt_bme280.i_humidity      );
-    printf("BME280 pres(int): %8d  \n", pkt->pkt_bme280.i_pressure      );
-    printf("BME280 temp(flt): %8.2f\n", pkt->pkt_bme280.temperature     );
-    printf("BME280 humi(flt): %8.2f\n", pkt->pkt_bme280.humidity        );
-    printf("BME280 pres(flt): %8.2f\n", pkt->pkt_bme280.pressure        );
+    if (pkt->type == TWELITE_SENSOR_BME280) {
+        printf("BME280 id       : %08x \n", pkt->pkt_bme280.id_sensor       );
+        printf("BME280 temp(int): %8d  \n", pkt->pkt_bme280.i_temperature   );
+        printf("BME280 humi(int): %8d  \n", pkt->pkt_bme280.i_humidity      );
+        printf("BME280 pres(int): %8d  \n", pkt->pkt_bme280.i_pressure      );
+        printf("BME280 temp(flt): %8.2f\n", pkt->pkt_bme280.temperature     );
+        printf("BME280 humi(flt): %8.2f\n", pkt->pkt_bme280.humidity        );
+        printf("BME280 pres(flt): %8.2f\n", pkt->pkt_bme280.pressure        );
+    }
     printf("checksum        : %08x \n", pkt->checksum                   );
     printf("checksum_calc   : %08x \n", pkt->checksum_calc              );
 }
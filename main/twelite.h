@@ -6,12 +6,83 @@
  * @author m2enu
  * @date 2017/08/20
  */
+#ifndef TWELITE_H
+#define TWELITE_H
+
 #include <stdint.h>
 #include <string.h>
 #include <stdlib.h>
 
 #define TWELITE_PACKET_LENGTH_MIN   37 //!< TWE-LITE app_tag packet length min.
 #define TWELITE_PACKET_LENGTH_MAX   61 //!< TWE-LITE app_tag packet length max.
+#define TWELITE_BINARY_LENGTH_MIN   ((TWELITE_PACKET_LENGTH_MIN - 3) / 2) //!< TWE-LITE binary payload length min.
+#define TWELITE_BINARY_LENGTH_MAX   ((TWELITE_PACKET_LENGTH_MAX - 3) / 2) //!< TWE-LITE binary payload length max.
+
+/** <!-- twelite_err_t {{{1 -->
+ * @brief result of twelite_parse_packet()
+ */
+typedef enum twelite_err_t_tag {
+    TWELITE_OK = 0, //!< success
+    TWELITE_ERR_LENGTH = -1, //!< invalid packet length
+    TWELITE_ERR_HEX = -2, //!< non-hexadecimal character
+    TWELITE_ERR_CHECKSUM = -3, //!< checksum mismatch
+} twelite_err_t;
+
+/** <!-- twelite_stats_t {{{1 -->
+ * @brief statistics of twelite_parse_packet() by result
+ */
+typedef struct twelite_stats_t_tag {
+    uint32_t n_ok; //!< number of accepted packets
+    uint32_t n_length; //!< number of packets rejected by length
+    uint32_t n_hex; //!< number of packets rejected by non-hexadecimal character
+    uint32_t n_checksum; //!< number of packets rejected by checksum
+} twelite_stats_t;
+
+/** <!-- twelite_sensor_t {{{1 -->
+ * @brief payload type of TWE-LITE app_tag packet (tag of twelite_packet_t)
+ *
+ * id_sensor not registered is decoded as BME280, as before the registry.
+ */
+typedef enum twelite_sensor_t_tag {
+    TWELITE_SENSOR_BME280 = 0, //!< BME280 temperature/humidity/pressure
+    TWELITE_SENSOR_ANALOG, //!< analog inputs only (ADC1/ADC2)
+    TWELITE_SENSOR_LM61, //!< LM61 temperature sensor on ADC1
+    TWELITE_SENSOR_SHT21, //!< SHT21 temperature/humidity
+    TWELITE_SENSOR_ADXL34X, //!< ADXL34x accelerometer
+    TWELITE_SENSOR_NUM,
+} twelite_sensor_t;
+
+#define TWELITE_ID_ANALOG   0x10 //!< id_sensor of analog inputs
+#define TWELITE_ID_LM61     0x11 //!< id_sensor of LM61
+#define TWELITE_ID_SHT21    0x31 //!< id_sensor of SHT21
+#define TWELITE_ID_ADXL34X  0x35 //!< id_sensor of ADXL34x
+#define TWELITE_ID_BME280   0x39 //!< id_sensor of BME280
+
+/** <!-- twelite_stream_t {{{1 -->
+ * @brief output streams of sensor payloads
+ */
+typedef enum twelite_stream_t_tag {
+    TWELITE_STREAM_TEMPERATURE = 0, //!< temperature [x100 degC]
+    TWELITE_STREAM_PRESSURE, //!< pressure [Pa]
+    TWELITE_STREAM_HUMIDITY, //!< humidity [x100 %]
+    TWELITE_STREAM_VDD, //!< power supply voltage [mV]
+    TWELITE_STREAM_ADC1, //!< ADC1 voltage [mV]
+    TWELITE_STREAM_ADC2, //!< ADC2 voltage [mV]
+    TWELITE_STREAM_ACCEL_X, //!< acceleration X [mg]
+    TWELITE_STREAM_ACCEL_Y, //!< acceleration Y [mg]
+    TWELITE_STREAM_ACCEL_Z, //!< acceleration Z [mg]
+    TWELITE_STREAM_NUM,
+} twelite_stream_t;
+
+/** <!-- twelite_stream_info_t {{{1 -->
+ * @brief name and scale of output stream
+ */
+typedef struct twelite_stream_info_t_tag {
+    const char *name; //!< M2X stream
+    uint8_t frac; //!< number of fractional digits of integer value
+} twelite_stream_info_t;
+
+extern const twelite_stream_info_t twelite_streams[TWELITE_STREAM_NUM]; //!< output streams
 
 /** <!-- twelite_packet_bme280_t {{{1 -->
  * @brief TWE-LITE app_tag packet structure for BME280 sensor data
@@ -26,11 +97,47 @@ typedef struct twelite_packet_bme280_t_tag {
     float pressure; //!< pressure [Pa]
 } twelite_packet_bme280_t;
 
+/** <!-- twelite_packet_lm61_t {{{1 -->
+ * @brief TWE-LITE app_tag packet structure for LM61 sensor data
+ */
+typedef struct twelite_packet_lm61_t_tag {
+    int16_t i_temperature; //!< temperature in integer [x100 degC]
+} twelite_packet_lm61_t;
+
+/** <!-- twelite_packet_sht21_t {{{1 -->
+ * @brief TWE-LITE app_tag packet structure for SHT21 sensor data
+ */
+typedef struct twelite_packet_sht21_t_tag {
+    int16_t i_temperature; //!< temperature in integer [x100 degC]
+    uint16_t i_humidity; //!< humidity in integer [x100 %]
+} twelite_packet_sht21_t;
+
+/** <!-- twelite_packet_adxl34x_t {{{1 -->
+ * @brief TWE-LITE app_tag packet structure for ADXL34x sensor data
+ */
+typedef struct twelite_packet_adxl34x_t_tag {
+    int16_t accel_x; //!< acceleration X [mg]
+    int16_t accel_y; //!< acceleration Y [mg]
+    int16_t accel_z; //!< acceleration Z [mg]
+} twelite_packet_adxl34x_t;
+
+/** <!-- twelite_packet_raw_t {{{1 -->
+ * @brief storage view of sensor payloads
+ *
+ * Every payload structure fits in this layout (same offsets as BME280),
+ * so a payload can be stored and restored without knowing its type.
+ */
+typedef struct twelite_packet_raw_t_tag {
+    uint16_t w16[3]; //!< 16-bit words at offset 0, 2, 4
+    uint32_t w32; //!< 32-bit word at offset 8
+} twelite_packet_raw_t;
+
 /** <!-- twelite_packet_t {{{1 -->
- * @brief TWE-LITE app_tag packet structure
+ * @brief TWE-LITE app_tag packet structure (tagged by type)
  */
 typedef struct twelite_packet_t_tag {
     int8_t ok; //!< 0:parse failed, 1:parse successed
+    uint8_t type; //!< payload type (twelite_sensor_t)
     uint32_t sid_router; //!< SID of router
     uint8_t lqi; //!< LQI
     uint16_t next_number; //!< Next number
@@ -42,52 +149,89 @@ typedef struct twelite_packet_t_tag {
     uint16_t mvolt_adc2; //!< ADC2 voltage [mV]
     uint8_t checksum; //!< received checksum
     uint8_t checksum_calc; //!< calculated checksum
+    int64_t timestamp; //!< receive time [ms, monotonic] (set by receiver, see timemap.h)
+    uint8_t better; //!< 1: higher-LQI copy of a forwarded reading (set by receiver, see dedup.h)
 
-    twelite_packet_bme280_t pkt_bme280; //!< packet for BME280 sensor data
+    union {
+        twelite_packet_bme280_t pkt_bme280; //!< TWELITE_SENSOR_BME280
+        twelite_packet_lm61_t pkt_lm61; //!< TWELITE_SENSOR_LM61
+        twelite_packet_sht21_t pkt_sht21; //!< TWELITE_SENSOR_SHT21
+        twelite_packet_adxl34x_t pkt_adxl34x; //!< TWELITE_SENSOR_ADXL34X
+        twelite_packet_raw_t pkt_raw; //!< storage view of any payload
+    };
 } twelite_packet_t;
 
-/** <!-- substring {{{1 -->
- * @brief substring function
- * @param[out] dst destination string
- * @param[in] src source string
- * @param[in] pos position of source string
- * @param[in] len length of substring
- * @return result of substring
+/** <!-- twelite_parse_packet {{{1 -->
+ * @brief packet parser for TWE-LITE app_tag
+ *
+ * Fields are decoded and the checksum (two's complement of the sum of
+ * decoded bytes) is verified in one pass.
+ * @param[out] pkt TWE-LITE packet
+ * @param[in] data received TWE-LITE app_tag string (ascii, without CR/LF)
+ * @param[in] len length of data
+ * @return result of parse
  * @retval Zero: Success
  * @retval +ve_value: Warning
- * @retval -ve_value: Error
+ * @retval -ve_value: Error (twelite_err_t)
  */
-int8_t substring(char *dst, const char *src, int32_t pos, int32_t len);
+int8_t twelite_parse_packet(twelite_packet_t *pkt, const char *data, int32_t len);
 
-/** <!-- hex2dec {{{1 -->
- * @brief convert hexadecimal-string to unsigned-decimal-integer function
- * @param[in] src source hexadecimal-string
- * @param[in] base base number (allow only 10 or 16)
- * @return converted value
+/** <!-- twelite_parse_binary {{{1 -->
+ * @brief packet parser for TWE-LITE binary transfer mode
+ *
+ * The payload is the same byte sequence as the app_tag string without
+ * its checksum, so fields are laid out by the same descriptor tables.
+ * @param[out] pkt TWE-LITE packet
+ * @param[in] data received binary frame (header to trailer)
+ * @param[in] len length of data
+ * @return result of parse
+ * @retval Zero: Success
+ * @retval -ve_value: Error (twelite_err_t)
  */
-uint32_t hex2dec(char *src, int32_t base);
+int8_t twelite_parse_binary(twelite_packet_t *pkt, const char *data, int32_t len);
 
-/** <!-- parse {{{1 -->
- * @brief macro of substring -> hex2dec
- * @param[in] src received packet of TWE-LITE
- * @param[in] base base number (allow only 10 or 16)
- * @param[in] pos positin of source string
- * @param[in] len length of substring
- * @return parsed parameter
+/** <!-- twelite_build_packet {{{1 -->
+ * @brief build TWE-LITE app_tag string from packet (inverse of parser)
+ * @param[out] dst TWE-LITE app_tag string (ascii, with CR/LF and NUL)
+ * @param[in] size size of dst
+ * @param[in] pkt TWE-LITE packet
+ * @return length of string (without NUL)
+ * @retval -ve_value: dst is too small
  */
-uint32_t parse(const char *src, int32_t base, int32_t pos, int32_t len);
+int32_t twelite_build_packet(char *dst, int32_t size,
+                             const twelite_packet_t *pkt);
 
-/** <!-- twelite_parse_packet {{{1 -->
- * @brief packet parser for TWE-LITE app_tag
- * @param[out] pkt TWE-LITE packet
- * @param[in] data received TWE-LITE app_tag string (ascii)
- * @param[in] len length of data
- * @return result of parse
+/** <!-- twelite_build_binary {{{1 -->
+ * @brief build TWE-LITE binary frame from packet (inverse of parser)
+ * @param[out] dst TWE-LITE binary frame
+ * @param[in] size size of dst
+ * @param[in] pkt TWE-LITE packet
+ * @return length of frame
+ * @retval -ve_value: dst is too small
+ */
+int32_t twelite_build_binary(char *dst, int32_t size,
+                             const twelite_packet_t *pkt);
+
+/** <!-- twelite_sensor_resolve {{{1 -->
+ * @brief set payload type from id_sensor and derive payload values
+ *
+ * Used for packets restored from storage, the parser does this itself.
+ * @param[in,out] pkt TWE-LITE packet (id_sensor and payload set)
+ * @return nothing
+ */
+void twelite_sensor_resolve(twelite_packet_t *pkt);
+
+/** <!-- twelite_stream_value {{{1 -->
+ * @brief get value of output stream from packet
+ * @param[in] pkt TWE-LITE packet
+ * @param[in] stream output stream
+ * @param[out] val value in units of 10^-frac (see twelite_streams)
+ * @return result of get
  * @retval Zero: Success
- * @retval +ve_value: Warning
- * @retval -ve_value: Error
+ * @retval -ve_value: stream is not provided by payload type of packet
  */
-int8_t twelite_parse_packet(twelite_packet_t *pkt, char *data, int32_t len);
+int8_t twelite_stream_value(const twelite_packet_t *pkt,
+                            twelite_stream_t stream, int32_t *val);
 
 /** <!-- twelite_parse_packet_bme280 {{{1 -->
  * @brief packet parser for TWE-LITE app_tag BME280 sensor data
@@ -109,18 +253,28 @@ int16_t twelite_calc_supply(uint8_t src);
 /** <!-- twelite_calc_checksum {{{1 -->
  * @brief calculate TWE-LITE app_tag packet checksum
  * @param[in] data received TWE-LITE app_tag string (ascii)
- * @param[in] pos start position of data
- * @param[in] len length of data
- * @return calculated checksum
+ * @param[in] pos start position of data (first hexadecimal character)
+ * @param[in] len end position of data (position of checksum)
+ * @return calculated checksum (two's complement of the sum of decoded bytes)
+ */
+uint8_t twelite_calc_checksum(const char *data, int32_t pos, int32_t len);
+
+/** <!-- twelite_stats_count {{{1 -->
+ * @brief count result of twelite_parse_packet()
+ * @param[in,out] st statistics
+ * @param[in] err result of twelite_parse_packet()
+ * @return nothing
  */
-uint8_t twelite_calc_checksum(char *data, int32_t pos, int32_t len);
+void twelite_stats_count(twelite_stats_t *st, int8_t err);
 
 /** <!-- debug_twelite_print_packet {{{1 -->
  * @brief debug function of printing packet parameters
  * @param nothing
  * @return nothing
  */
-void debug_twelite_print_packet(twelite_packet_t *pkt);
+void debug_twelite_print_packet(const twelite_packet_t *pkt);
+
+#endif // TWELITE_H
 
 // end of file {{{1
 // vim:ft=c:et:nowrap:fdm=marker
@@ -0,0 +1,518 @@
+/**
+ * Copyright (C) 2017 m2enu
+ *
+ * @file tools/gateway.c
+ * @brief host build of the gateway pipeline for load tests (Linux)
+ *
+ * Reads app_tag frames from a file, pipe or pseudo terminal through the
+ * same ingest, parse, dedup, devtab, rule, pktq, batch and M2X client
+ * modules as the ESP32 build, posts them to an M2X server (usually
+ * tools/mock_m2x.py) by bulk and alert lanes, and reports throughput and
+ * latency percentiles of each lane at the end of input.
+ *   cc -O2 -Imain -o gateway tools/gateway.c main/ingest.c main/framer.c \
+ *      main/twelite.c main/dedup.c main/devtab.c main/pktq.c main/batch.c \
+ *      main/json.c main/m2x.c main/retry.c main/port.c main/timemap.c \
+ *      main/rule.c -lpthread
+ *   ./twesim -x 0 -n 200 -t 3600 | ./gateway -m 127.0.0.1:8080 \
+ *      -r "temperature>30"
+ * @author m2enu
+ * @date 2026/10/17
+ */
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+
+#include "port.h"
+#include "twelite.h"
+#include "ingest.h"
+#include "dedup.h"
+#include "devtab.h"
+#include "pktq.h"
+#include "batch.h"
+#include "m2x.h"
+#include "retry.h"
+#include "timemap.h"
+#include "rule.h"
+
+#define GW_PKTQ_MAX     1024 //!< max. number of packet queue slots
+#define GW_HIST_MAX     60000 //!< latency histogram range [ms]
+#define GW_WAIT         1000 //!< max. wait of input and upload [ms]
+#define GW_DEVICE_ID    "mock" //!< M2X device id sent to server
+#define GW_API_KEY      "mock" //!< M2X api key sent to server
+#define GW_ALERT_NUM    16 //!< max. silent end devices reported at once
+#define GW_DEVTAB_SIZE  4096 //!< number of device table entries
+#define GW_LANE_NUM     2 //!< number of lanes (rule_lane_t)
+
+/** <!-- gw_hist_t {{{1 -->
+ * @brief latency histogram with 1 ms buckets
+ */
+typedef struct gw_hist_t_tag {
+    uint32_t bucket[GW_HIST_MAX + 1]; //!< number of samples, last: overflow
+    uint32_t num; //!< number of samples
+    uint32_t max; //!< max. latency [ms]
+} gw_hist_t;
+
+/** <!-- gw_lane_t {{{1 -->
+ * @brief upload lane with its own queue, batch, connection and task
+ */
+typedef struct gw_lane_t_tag {
+    const char *name; //!< name of lane
+    pktq_t pktq; //!< packet queue from ingest to upload
+    pktq_slot_t slot[GW_PKTQ_MAX]; //!< slots of packet queue
+    m2x_batch_t batch; //!< batch of packets
+    m2x_client_t m2x; //!< M2X client
+    retry_t retry; //!< retry scheduler
+    char body[8192]; //!< POST body
+    port_task_t task; //!< upload task
+    volatile int done; //!< 1: queue drained after end of input
+    uint32_t n_sent; //!< number of uploaded packets
+    uint32_t n_lost; //!< number of packets dropped or given up
+    gw_hist_t post; //!< latency of POST
+    gw_hist_t e2e; //!< latency from receive to uploaded
+} gw_lane_t;
+
+/** <!-- gw_t {{{1 -->
+ * @brief gateway options and state
+ */
+typedef struct gw_t_tag {
+    const char *path; //!< input (NULL: stdin)
+    char host[64]; //!< M2X host
+    uint16_t port; //!< M2X port
+    uint32_t batch_num; //!< max. number of packets in one POST
+    int64_t batch_age; //!< max. age of batched packet [ms]
+    uint32_t pktq_size; //!< number of packet queue slots
+    uint8_t binary; //!< 1: binary transfer mode
+    const char *rules; //!< alert rules (see rule.h)
+    int fd; //!< input
+    uint8_t regular; //!< 1: input is regular file
+    ingest_t ingest; //!< app_tag stream ingestion
+    twelite_stats_t parse_stats; //!< statistics of parser
+    dedup_t dedup; //!< duplicate filter
+    devtab_t devtab; //!< state of end devices
+    devtab_alert_t alert[GW_ALERT_NUM]; //!< end devices gone silent
+    rule_table_t rule; //!< alert rules
+    timemap_t clock; //!< clock mapping of timestamps
+    gw_lane_t lane[GW_LANE_NUM]; //!< upload lanes (by rule_lane_t)
+    volatile int done; //!< 1: end of input
+    uint32_t n_dup; //!< number of dropped duplicates
+    uint32_t n_silent; //!< number of silent events
+} gw_t;
+
+static gw_t gw; //!< gateway
+
+/** <!-- gw_time {{{1 -->
+ * @brief current time
+ * @param nothing
+ * @return current time [ms since epoch]
+ */
+static int64_t gw_time(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/** <!-- gw_hist_add {{{1 -->
+ * @brief add one sample to latency histogram
+ * @param[in,out] h latency histogram
+ * @param[in] msec latency [ms]
+ * @return nothing
+ */
+static void gw_hist_add(gw_hist_t *h, int64_t msec)
+{
+    uint32_t ms = (msec < 0) ? 0 : (uint32_t)msec;
+    h->bucket[(ms < GW_HIST_MAX) ? ms : GW_HIST_MAX]++;
+    h->num++;
+    if (ms > h->max) {
+        h->max = ms;
+    }
+}
+
+/** <!-- gw_hist_pct {{{1 -->
+ * @brief percentile of latency histogram
+ * @param[in] h latency histogram
+ * @param[in] pct percentile [1/1000]
+ * @return latency [ms]
+ */
+static uint32_t gw_hist_pct(const gw_hist_t *h, uint32_t pct)
+{
+    uint64_t rank = ((uint64_t)h->num * pct + 999) / 1000;
+    uint64_t sum = 0;
+    uint32_t i;
+    for (i = 0; i < GW_HIST_MAX; i++) {
+        sum += h->bucket[i];
+        if ((sum >= rank) && (sum > 0)) {
+            return i;
+        }
+    }
+    return h->max;
+}
+
+/** <!-- gw_read {{{1 -->
+ * @brief read buffered input without blocking (ingest_ops_t)
+ * @param[in] ctx not used
+ * @param[out] dst destination
+ * @param[in] len max. length to read
+ * @return length read
+ */
+static int32_t gw_read(void *ctx, char *dst, int32_t len)
+{
+    (void)ctx;
+    ssize_t n = read(gw.fd, dst, len);
+    return (n < 0) ? 0 : (int32_t)n;
+}
+
+/** <!-- gw_flush {{{1 -->
+ * @brief discard buffered input (ingest_ops_t)
+ * @param[in] ctx not used
+ * @return nothing
+ */
+static void gw_flush(void *ctx)
+{
+    char buf[256];
+    (void)ctx;
+    while (read(gw.fd, buf, sizeof(buf)) > 0) {
+    }
+}
+
+/** <!-- gw_dispatch {{{1 -->
+ * @brief parse one frame and hand over to upload task (ingest_ops_t)
+ * @param[in] ctx not used
+ * @param[in] frame app_tag frame
+ * @param[in] len length of frame
+ * @return nothing
+ */
+static void gw_dispatch(void *ctx, const char *frame, int32_t len)
+{
+    twelite_packet_t pkt;
+    (void)ctx;
+    int8_t err = gw.binary ? twelite_parse_binary(&pkt, frame, len)
+                           : twelite_parse_packet(&pkt, frame, len);
+    twelite_stats_count(&gw.parse_stats, err);
+    if (err) {
+        return;
+    }
+    pkt.timestamp = gw.ingest.stamp;
+    int8_t dup = dedup_check(&gw.dedup, &pkt, pkt.timestamp);
+    if (dup == DEDUP_DUP) {
+        gw.n_dup++;
+        return;
+    }
+    // a higher-LQI copy only replaces the reading in bulk batch
+    pkt.better = (dup == DEDUP_BETTER);
+    gw_lane_t *l = &gw.lane[RULE_LANE_BULK];
+    if (!pkt.better) {
+        devtab_update(&gw.devtab, &pkt, port_msec());
+        l = &gw.lane[rule_check(&gw.rule, &pkt)];
+    }
+    // alerts go to bulk lane if alert queue is full
+    if ((pktq_push(&l->pktq, &pkt) < 0) && (l != &gw.lane[RULE_LANE_BULK])) {
+        l = &gw.lane[RULE_LANE_BULK];
+        pktq_push(&l->pktq, &pkt);
+    }
+    port_task_notify(&l->task);
+}
+
+/** <!-- gw_ops {{{1 -->
+ * @brief input and packet consumer of ingestion
+ */
+static const ingest_ops_t gw_ops = {
+    .read       = gw_read,
+    .flush      = gw_flush,
+    .dispatch   = gw_dispatch,
+    .ctx        = NULL,
+};
+
+/** <!-- gw_upload {{{1 -->
+ * @brief post batch and account its latency
+ * @param[in,out] l lane
+ * @return what to do with the batch
+ */
+static retry_verdict_t gw_upload(gw_lane_t *l)
+{
+    uint32_t i;
+    int32_t len = m2x_batch_json(l->body, sizeof(l->body), &l->batch);
+    if (len < 0) {
+        return RETRY_DROP;
+    }
+    int64_t start = port_msec();
+    int32_t status = m2x_client_post(&l->m2x, M2X_PATH_UPDATES, l->body, len, 1);
+    int64_t end = port_msec();
+    gw_hist_add(&l->post, end - start);
+    retry_verdict_t verdict = retry_result(&l->retry, end, status);
+    if (verdict == RETRY_DONE) {
+        int64_t now = port_msec();
+        for (i = 0; i < l->batch.num; i++) {
+            gw_hist_add(&l->e2e, now - l->batch.pkt[i].timestamp);
+        }
+    }
+    return verdict;
+}
+
+/** <!-- gw_task {{{1 -->
+ * @brief batch and post queued packets until end of input (upload stage)
+ * @param[in,out] args lane
+ * @return nothing
+ */
+static void gw_task(void *args)
+{
+    gw_lane_t *l = args;
+    twelite_packet_t pkt;
+    while (1) {
+        while ((l->batch.num < l->batch.max_num) &&
+               (pktq_pop(&l->pktq, &pkt) == 0)) {
+            m2x_batch_add(&l->batch, &pkt);
+        }
+        uint32_t queued = pktq_count(&l->pktq);
+        int64_t now = port_msec();
+        m2x_batch_reason_t reason = m2x_batch_due(&l->batch, now, queued);
+        if ((reason == M2X_BATCH_NONE) && gw.done && (queued == 0)) {
+            if (l->batch.num == 0) {
+                break;
+            }
+            reason = M2X_BATCH_SIZE; // post the rest at end of input
+        }
+        if (reason == M2X_BATCH_NONE) {
+            int64_t wait = m2x_batch_wait(&l->batch, now);
+            port_task_wait(&l->task, (wait < 0) ? GW_WAIT : wait);
+            continue;
+        }
+        int64_t wait = retry_wait(&l->retry, port_msec());
+        if (wait > 0) {
+            port_task_wait(&l->task, wait);
+            continue;
+        }
+        retry_verdict_t verdict = gw_upload(l);
+        if (verdict == RETRY_AGAIN) {
+            continue;
+        }
+        if (verdict == RETRY_DONE) {
+            l->n_sent += l->batch.num;
+        } else {
+            l->n_lost += l->batch.num;
+        }
+        m2x_batch_clear(&l->batch);
+    }
+    l->done = 1;
+}
+
+/** <!-- gw_lane_init {{{1 -->
+ * @brief initialise lane and create its upload task
+ * @param[out] l lane
+ * @param[in] name name of lane
+ * @param[in] batch_num max. number of packets in one POST
+ * @param[in] batch_age max. age of batched packet [ms]
+ * @param[in] policy overflow policy of packet queue
+ * @return result of initialisation
+ * @retval Zero: Success
+ * @retval -ve_value: Error
+ */
+static int8_t gw_lane_init(gw_lane_t *l, const char *name, uint32_t batch_num,
+                           int64_t batch_age, pktq_policy_t policy)
+{
+    l->name = name;
+    if (pktq_init(&l->pktq, l->slot, gw.pktq_size, policy) ||
+        m2x_client_init(&l->m2x, gw.host, gw.port, GW_DEVICE_ID, GW_API_KEY)) {
+        return -1;
+    }
+    m2x_batch_init(&l->batch, batch_num, batch_age, gw.pktq_size * 3 / 4,
+                   &gw.clock);
+    retry_init(&l->retry, 500, 30000, 5, 60000, 3, 1);
+    return port_task_create(&l->task, gw_task, name, 0, 0, PORT_CORE_ANY, l);
+}
+
+/** <!-- gw_open {{{1 -->
+ * @brief open input without blocking, raw if it is a terminal
+ * @param nothing
+ * @return result of open
+ * @retval Zero: Success
+ * @retval -ve_value: Error
+ */
+static int8_t gw_open(void)
+{
+    struct termios tio;
+    struct stat st;
+    gw.fd = (gw.path == NULL) ? STDIN_FILENO
+                              : open(gw.path, O_RDONLY | O_NOCTTY);
+    if (gw.fd < 0) {
+        perror(gw.path);
+        return -1;
+    }
+    if (tcgetattr(gw.fd, &tio) == 0) {
+        cfmakeraw(&tio);
+        tcsetattr(gw.fd, TCSANOW, &tio);
+    }
+    gw.regular = (fstat(gw.fd, &st) == 0) && S_ISREG(st.st_mode);
+    fcntl(gw.fd, F_SETFL, fcntl(gw.fd, F_GETFL) | O_NONBLOCK);
+    return 0;
+}
+
+/** <!-- gw_report {{{1 -->
+ * @brief print counters and latency percentiles
+ * @param[in] elapsed time from first input to end [ms]
+ * @return nothing
+ */
+static void gw_report(int64_t elapsed)
+{
+    const twelite_stats_t *st = &gw.parse_stats;
+    double sec = (elapsed > 0) ? elapsed / 1000.0 : 1.0;
+    uint32_t n;
+    printf("input    : %u bytes, %u frames, parse errors %u "
+           "(length=%u, hex=%u, checksum=%u)\n",
+           gw.ingest.n_byte, gw.ingest.n_dispatch,
+           st->n_length + st->n_hex + st->n_checksum,
+           st->n_length, st->n_hex, st->n_checksum);
+    printf("pipeline : %u duplicates, %u devices, %u silent\n",
+           gw.n_dup, gw.devtab.num, gw.n_silent);
+    printf("rules    : %u streams, %u alerts\n", gw.rule.num, gw.rule.n_alert);
+    for (n = 0; n < GW_LANE_NUM; n++) {
+        const gw_lane_t *l = &gw.lane[n];
+        if (l->name == NULL) {
+            continue;
+        }
+        printf("%-5s    : %u packets in %u requests, %u lost, "
+               "retried %u, breaker opened %u, queue dropped %u/%u/%u\n",
+               l->name, l->n_sent, l->m2x.n_request, l->n_lost,
+               l->retry.n_again, l->retry.n_open, l->pktq.n_drop_newest,
+               l->pktq.n_drop_oldest, l->pktq.n_coalesce);
+        printf("  rate   : %.1f packets/s over %.1f s\n", l->n_sent / sec, sec);
+        printf("  POST   : p50=%u p90=%u p99=%u max=%u ms\n",
+               gw_hist_pct(&l->post, 500), gw_hist_pct(&l->post, 900),
+               gw_hist_pct(&l->post, 990), l->post.max);
+        printf("  e2e    : p50=%u p90=%u p99=%u p999=%u max=%u ms\n",
+               gw_hist_pct(&l->e2e, 500), gw_hist_pct(&l->e2e, 900),
+               gw_hist_pct(&l->e2e, 990), gw_hist_pct(&l->e2e, 999),
+               l->e2e.max);
+    }
+}
+
+/** <!-- gw_usage {{{1 -->
+ * @brief print usage
+ * @param nothing
+ * @return nothing
+ */
+static void gw_usage(void)
+{
+    fprintf(stderr,
+        "usage: gateway [options]\n"
+        "  -f path  input file, pipe or terminal (stdin)\n"
+        "  -b       binary transfer mode\n"
+        "  -m host:port  M2X server (%s:%u)\n"
+        "  -n num   max. packets per POST (%u)\n"
+        "  -a ms    max. batch age (%ld)\n"
+        "  -q num   packet queue slots per lane, power of 2 (%u)\n"
+        "  -r rules alert rules, e.g. \"vdd<2.4,temperature~5\" (none)\n"
+        "queue dropped counts are newest/oldest/coalesced\n",
+        gw.host, gw.port, gw.batch_num, (long)gw.batch_age, gw.pktq_size);
+}
+
+/** <!-- main {{{1 -->
+ * @brief main function
+ * @param[in] argc number of arguments
+ * @param[in] argv arguments
+ * @return exit status
+ */
+int main(int argc, char **argv)
+{
+    struct pollfd pfd;
+    int64_t start = 0;
+    char *colon;
+    int opt;
+    strcpy(gw.host, "127.0.0.1");
+    gw.port         = 8080;
+    gw.batch_num    = 16;
+    gw.batch_age    = 10000;
+    gw.pktq_size    = 32;
+    while ((opt = getopt(argc, argv, "f:bm:n:a:q:r:h")) != -1) {
+        switch (opt) {
+        case 'f': gw.path       = optarg; break;
+        case 'b': gw.binary     = 1; break;
+        case 'n': gw.batch_num  = strtoul(optarg, NULL, 0); break;
+        case 'a': gw.batch_age  = strtoll(optarg, NULL, 0); break;
+        case 'q': gw.pktq_size  = strtoul(optarg, NULL, 0); break;
+        case 'r': gw.rules      = optarg; break;
+        case 'm':
+            colon = strrchr(optarg, ':');
+            if ((colon == NULL) || (colon - optarg >= (int)sizeof(gw.host))) {
+                gw_usage();
+                return 2;
+            }
+            memcpy(gw.host, optarg, colon - optarg);
+            gw.host[colon - optarg] = '\0';
+            gw.port = (uint16_t)strtoul(colon + 1, NULL, 0);
+            break;
+        default:
+            gw_usage();
+            return 2;
+        }
+    }
+    if ((gw.batch_num < 1) || (gw.batch_num > M2X_BATCH_MAX) ||
+        (gw.pktq_size > GW_PKTQ_MAX) || rule_init(&gw.rule, gw.rules)) {
+        gw_usage();
+        return 2;
+    }
+    if (gw_open()) {
+        return 1;
+    }
+    timemap_init(&gw.clock);
+    timemap_sync(&gw.clock, port_msec(), gw_time());
+    ingest_init(&gw.ingest, &gw_ops, 0);
+    twelite_framer_format(&gw.ingest.framer,
+                          gw.binary ? TWELITE_FORMAT_BINARY : TWELITE_FORMAT_ASCII);
+    dedup_init(&gw.dedup, 5000, 1);
+    if (devtab_init(&gw.devtab, GW_DEVTAB_SIZE, port_msec(), 2400)) {
+        return 1;
+    }
+    if (gw_lane_init(&gw.lane[RULE_LANE_BULK], "bulk", gw.batch_num,
+                     gw.batch_age, PKTQ_COALESCE) ||
+        gw_lane_init(&gw.lane[RULE_LANE_ALERT], "alert", 8, 0,
+                     PKTQ_DROP_NEWEST)) {
+        return 1;
+    }
+    pfd.fd      = gw.fd;
+    pfd.events  = POLLIN;
+    while (1) {
+        int avail = 0;
+        if (poll(&pfd, 1, GW_WAIT) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        timemap_sync(&gw.clock, port_msec(), gw_time());
+        gw.n_silent += devtab_expire(&gw.devtab, port_msec(),
+                                     gw.alert, GW_ALERT_NUM);
+        if (pfd.revents == 0) {
+            continue;
+        }
+        if ((ioctl(gw.fd, FIONREAD, &avail) != 0) || (avail <= 0)) {
+            if (gw.regular || (pfd.revents & (POLLHUP | POLLERR))) {
+                break; // end of file, or writer closed
+            }
+            continue;
+        }
+        if (start == 0) {
+            start = port_msec();
+        }
+        ingest_event(&gw.ingest, INGEST_DATA, avail);
+    }
+    gw.done = 1;
+    while (!gw.lane[RULE_LANE_BULK].done || !gw.lane[RULE_LANE_ALERT].done) {
+        port_task_notify(&gw.lane[RULE_LANE_BULK].task);
+        port_task_notify(&gw.lane[RULE_LANE_ALERT].task);
+        usleep(10 * 1000);
+    }
+    gw_report((start == 0) ? 0 : port_msec() - start);
+    return 0;
+}
+
+// end of file {{{1
+// vim:ft=c:et:nowrap:fdm=marker
@@ -0,0 +1,204 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+Copyright (C) 2017 m2enu
+
+@file tools/mock_m2x.py
+@brief local mock of AT&T M2X device update API for load tests
+
+Serves POST /v2/devices/<id>/update and /v2/devices/<id>/updates over
+keep-alive HTTP/1.1 with configurable latency, error rate and outages,
+and prints request, status and value counters.
+  ./tools/mock_m2x.py --port 8080 --latency 80 --jitter 40 \\
+      --error-rate 0.02 --outage 120:60 --idle-timeout 5
+@author m2enu
+@date 2026/10/17
+"""
+import argparse
+import json
+import random
+import re
+import socket
+import socketserver
+import sys
+import threading
+import time
+from collections import Counter
+from http.server import BaseHTTPRequestHandler, HTTPServer
+
+PATH = re.compile(r"^/v2/devices/([^/]+)/(update|updates)$")
+
+
+class Stats:
+    """ counters shared by handler threads """
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.status = Counter()
+        self.values = 0
+        self.requests = 0
+        self.connections = 0
+
+    def count(self, status, values=0):
+        with self.lock:
+            self.requests += 1
+            self.status[status] += 1
+            self.values += values
+
+    def line(self):
+        with self.lock:
+            codes = " ".join("%d=%d" % kv for kv in sorted(self.status.items()))
+            return "requests=%d values=%d connections=%d %s" % (
+                self.requests, self.values, self.connections, codes)
+
+
+def count_values(kind, body):
+    """ number of stream values in request body (-1: malformed) """
+    try:
+        doc = json.loads(body)
+        if kind == "update":
+            return len(doc["values"])
+        return sum(len(v) for v in doc["values"].values())
+    except (ValueError, KeyError, TypeError, AttributeError):
+        return -1
+
+
+class Mock:
+    """ failure model, deterministic for a given seed and request order """
+    def __init__(self, args):
+        self.args = args
+        self.rand = random.Random(args.seed)
+        self.lock = threading.Lock()
+        self.start = time.monotonic()
+        self.outages = []
+        for spec in args.outage:
+            begin, length = spec.split(":")
+            self.outages.append((float(begin), float(begin) + float(length)))
+
+    def in_outage(self):
+        now = time.monotonic() - self.start
+        return any(begin <= now < end for begin, end in self.outages)
+
+    def draw(self):
+        """ latency [s] and forced error status (None: no error) """
+        with self.lock:
+            latency = max(0.0, self.rand.gauss(self.args.latency,
+                                               self.args.jitter)) / 1000.0
+            error = self.rand.random() < self.args.error_rate
+        return latency, (self.args.error_status if error else None)
+
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+    disable_nagle_algorithm = True
+
+    def setup(self):
+        # idle keep-alive connections are closed, as load balancers do
+        self.timeout = self.server.args.idle_timeout or None
+        super().setup()
+        with self.server.stats.lock:
+            self.server.stats.connections += 1
+
+    def reply(self, status, body):
+        data = json.dumps(body).encode()
+        self.send_response(status)
+        self.send_header("Content-Type", "application/json")
+        self.send_header("Content-Length", str(len(data)))
+        self.end_headers()
+        self.wfile.write(data)
+
+    def do_POST(self):
+        mock, stats, args = self.server.mock, self.server.stats, self.server.args
+        length = int(self.headers.get("Content-Length", 0))
+        body = self.rfile.read(length)
+        if mock.in_outage():
+            if args.outage_mode == "close":
+                stats.count(0)
+                self.close_connection = True
+                self.connection.shutdown(socket.SHUT_RDWR)
+                return
+            if args.outage_mode == "hang":
+                time.sleep(args.hang)
+                stats.count(0)
+                self.close_connection = True
+                return
+            stats.count(503)
+            return self.reply(503, {"message": "Service Unavailable"})
+        latency, error = mock.draw()
+        time.sleep(latency)
+        match = PATH.match(self.path)
+        if match is None:
+            stats.count(404)
+            return self.reply(404, {"message": "Not Found"})
+        if args.key and self.headers.get("X-M2X-KEY") != args.key:
+            stats.count(401)
+            return self.reply(401, {"message": "Unauthorized"})
+        if error is not None:
+            stats.count(error)
+            return self.reply(error, {"message": "Injected error"})
+        values = count_values(match.group(2), body)
+        if values < 0:
+            stats.count(422)
+            return self.reply(422, {"message": "Validation Failed"})
+        stats.count(202, values)
+        self.reply(202, {"status": "accepted"})
+
+    def log_message(self, fmt, *args):
+        if self.server.args.verbose:
+            sys.stderr.write("%s %s\n" % (self.address_string(), fmt % args))
+
+
+class Server(socketserver.ThreadingMixIn, HTTPServer):
+    daemon_threads = True
+    allow_reuse_address = True
+
+
+def main():
+    parser = argparse.ArgumentParser(description="mock of AT&T M2X device update API")
+    parser.add_argument("--host", default="127.0.0.1")
+    parser.add_argument("--port", type=int, default=8080)
+    parser.add_argument("--latency", type=float, default=0.0,
+                        help="mean response latency [ms]")
+    parser.add_argument("--jitter", type=float, default=0.0,
+                        help="standard deviation of latency [ms]")
+    parser.add_argument("--error-rate", type=float, default=0.0,
+                        help="fraction of requests answered with an error")
+    parser.add_argument("--error-status", type=int, default=500,
+                        help="status of injected errors")
+    parser.add_argument("--outage", action="append", default=[],
+                        metavar="START:LENGTH",
+                        help="outage window [s] from start, repeatable")
+    parser.add_argument("--outage-mode", choices=("503", "close", "hang"),
+                        default="503",
+                        help="answer 503, close the connection, or hang")
+    parser.add_argument("--hang", type=float, default=10.0,
+                        help="time to hang before closing [s]")
+    parser.add_argument("--idle-timeout", type=float, default=0.0,
+                        help="close idle keep-alive connections [s] (0: never)")
+    parser.add_argument("--key", default="",
+                        help="required X-M2X-KEY (blank: any)")
+    parser.add_argument("--seed", type=int, default=1)
+    parser.add_argument("--stats", type=float, default=10.0,
+                        help="stats interval [s] (0: only at exit)")
+    parser.add_argument("--verbose", action="store_true")
+    args = parser.parse_args()
+
+    server = Server((args.host, args.port), Handler)
+    server.args = args
+    server.mock = Mock(args)
+    server.stats = Stats()
+    print("mock_m2x: listening on %s:%d" % (args.host, args.port), flush=True)
+    if args.stats > 0:
+        def report():
+            while True:
+                time.sleep(args.stats)
+                print("mock_m2x: " + server.stats.line(), flush=True)
+        threading.Thread(target=report, daemon=True).start()
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+    print("mock_m2x: " + server.stats.line(), flush=True)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,396 @@
+/**
+ * Copyright (C) 2017 m2enu
+ *
+ * @file tools/twesim.c
+ * @brief deterministic TWE-LITE traffic simulator (Linux)
+ *
+ * Generates app_tag frames of N virtual BME280 end devices heard by R
+ * routers, and writes them to stdout or a pseudo terminal, paced in
+ * real time or faster. The same options and seed give the same frames.
+ *   cc -O2 -Imain -o twesim tools/twesim.c main/twelite.c main/framer.c
+ *   ./twesim -n 50 -r 3 -i 10000 -t 600 -p
+ * @author m2enu
+ * @date 2026/10/17
+ */
+#define _GNU_SOURCE // posix_openpt(), cfmakeraw()
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <termios.h>
+
+#include "twelite.h"
+#include "framer.h"
+
+#define SIM_DEVICE_MAX  4096 //!< max. number of end devices
+#define SIM_ROUTER_MAX  8 //!< max. number of routers
+#define SIM_SID_DEVICE  0x81000000u //!< SID of the first end device
+#define SIM_SID_ROUTER  0x82000000u //!< SID of the first router
+#define SIM_JITTER      20 //!< jitter of send interval [1/1000]
+#define SIM_LQI_NOISE   12 //!< max. deviation of LQI per packet
+#define SIM_LQI_HEARD   30 //!< routers hear devices above this LQI
+
+/** <!-- sim_device_t {{{1 -->
+ * @brief state of one virtual end device
+ */
+typedef struct sim_device_t_tag {
+    uint32_t sid; //!< SID of end device
+    uint16_t next_number; //!< sequence number of next packet
+    int64_t next_time; //!< time of next packet [ms]
+    int32_t temperature; //!< temperature [x100 degC]
+    int32_t humidity; //!< humidity [x100 %]
+    int32_t pressure; //!< pressure [Pa]
+    int32_t mvolt; //!< power supply voltage [mV x100]
+    uint8_t lqi[SIM_ROUTER_MAX]; //!< mean LQI at each router
+} sim_device_t;
+
+/** <!-- sim_t {{{1 -->
+ * @brief simulator options and state
+ */
+typedef struct sim_t_tag {
+    uint32_t device_num; //!< number of end devices
+    uint32_t router_num; //!< number of routers
+    uint32_t interval; //!< mean send interval of end device [ms]
+    int64_t duration; //!< simulated time [ms]
+    uint32_t loss; //!< packets lost before any router [1/1000]
+    uint32_t speed; //!< speed factor (0: as fast as possible)
+    uint32_t seed; //!< random seed
+    uint8_t binary; //!< 1: binary transfer mode
+    uint8_t pty; //!< 1: write to pseudo terminal
+    sim_device_t dev[SIM_DEVICE_MAX]; //!< end devices
+    uint32_t n_packet; //!< number of packets sent by end devices
+    uint32_t n_lost; //!< number of packets no router heard
+    uint32_t n_frame; //!< number of frames written
+    uint64_t n_byte; //!< number of bytes written
+} sim_t;
+
+static sim_t sim; //!< simulator
+
+/** <!-- sim_random {{{1 -->
+ * @brief xorshift32 pseudo random number
+ * @param[in,out] s simulator
+ * @return random number
+ */
+static uint32_t sim_random(sim_t *s)
+{
+    uint32_t x = s->seed;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    s->seed = x;
+    return x;
+}
+
+/** <!-- sim_range {{{1 -->
+ * @brief uniform random number in [lo, hi]
+ * @param[in,out] s simulator
+ * @param[in] lo lower bound
+ * @param[in] hi upper bound
+ * @return random number
+ */
+static int32_t sim_range(sim_t *s, int32_t lo, int32_t hi)
+{
+    return lo + (int32_t)(sim_random(s) % (uint32_t)(hi - lo + 1));
+}
+
+/** <!-- sim_clamp {{{1 -->
+ * @brief clamp value into [lo, hi]
+ * @param[in] val value
+ * @param[in] lo lower bound
+ * @param[in] hi upper bound
+ * @return clamped value
+ */
+static int32_t sim_clamp(int32_t val, int32_t lo, int32_t hi)
+{
+    return (val < lo) ? lo : (val > hi) ? hi : val;
+}
+
+/** <!-- sim_init {{{1 -->
+ * @brief place end devices and set their initial readings
+ *
+ * Every device is near one router and farther from the others, and
+ * starts at a random phase of its interval.
+ * @param[in,out] s simulator
+ * @return nothing
+ */
+static void sim_init(sim_t *s)
+{
+    uint32_t i, r;
+    for (i = 0; i < s->device_num; i++) {
+        sim_device_t *d = &s->dev[i];
+        uint32_t home = i % s->router_num;
+        d->sid          = SIM_SID_DEVICE + i;
+        d->next_number  = (uint16_t)sim_random(s);
+        d->next_time    = sim_range(s, 0, s->interval - 1);
+        d->temperature  = sim_range(s, 1500, 3000);
+        d->humidity     = sim_range(s, 3000, 7000);
+        d->pressure     = sim_range(s, 99000, 103000);
+        d->mvolt        = sim_range(s, 2700, 3300) * 100;
+        for (r = 0; r < s->router_num; r++) {
+            int32_t lqi = (r == home) ? sim_range(s, 120, 220)
+                                      : sim_range(s, 0, 100);
+            d->lqi[r] = (uint8_t)lqi;
+        }
+    }
+}
+
+/** <!-- sim_next {{{1 -->
+ * @brief end device sending the next packet
+ * @param[in] s simulator
+ * @return index of end device
+ */
+static uint32_t sim_next(const sim_t *s)
+{
+    uint32_t best = 0;
+    uint32_t i;
+    for (i = 1; i < s->device_num; i++) {
+        if (s->dev[i].next_time < s->dev[best].next_time) {
+            best = i;
+        }
+    }
+    return best;
+}
+
+/** <!-- sim_pace {{{1 -->
+ * @brief wait until simulated time is due in real time
+ * @param[in] s simulator
+ * @param[in] start wall clock at simulated time 0
+ * @param[in] now simulated time [ms]
+ * @return nothing
+ */
+static void sim_pace(const sim_t *s, const struct timespec *start, int64_t now)
+{
+    struct timespec due;
+    if (s->speed == 0) {
+        return;
+    }
+    int64_t ns = now * 1000000 / s->speed;
+    due.tv_sec  = start->tv_sec + ns / 1000000000;
+    due.tv_nsec = start->tv_nsec + ns % 1000000000;
+    if (due.tv_nsec >= 1000000000) {
+        due.tv_sec++;
+        due.tv_nsec -= 1000000000;
+    }
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL) == EINTR) {
+    }
+}
+
+/** <!-- sim_write {{{1 -->
+ * @brief write all data
+ * @param[in] fd file descriptor
+ * @param[in] data data to write
+ * @param[in] len length of data
+ * @return result of write
+ * @retval Zero: Success
+ * @retval -ve_value: Error
+ */
+static int8_t sim_write(int fd, const char *data, int32_t len)
+{
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        data += n;
+        len  -= n;
+    }
+    return 0;
+}
+
+/** <!-- sim_send {{{1 -->
+ * @brief send one packet of end device via every router hearing it
+ *
+ * Readings drift by a random walk; copies relayed by routers carry the
+ * same next_number and their own LQI, in random order.
+ * @param[in,out] s simulator
+ * @param[in,out] d end device
+ * @param[in] fd output
+ * @return result of write
+ * @retval Zero: Success
+ * @retval -ve_value: Error
+ */
+static int8_t sim_send(sim_t *s, sim_device_t *d, int fd)
+{
+    char frame[TWELITE_FRAME_LENGTH_MAX];
+    uint32_t order[SIM_ROUTER_MAX];
+    twelite_packet_t pkt;
+    uint32_t heard = 0;
+    uint32_t i, r;
+    d->temperature  = sim_clamp(d->temperature + sim_range(s, -10, 10), -1000, 5000);
+    d->humidity     = sim_clamp(d->humidity + sim_range(s, -20, 20), 0, 10000);
+    d->pressure     = sim_clamp(d->pressure + sim_range(s, -5, 5), 90000, 110000);
+    d->mvolt        = sim_clamp(d->mvolt - sim_range(s, 0, 2), 195000, 365000);
+    memset(&pkt, 0, sizeof(pkt));
+    pkt.next_number     = d->next_number++;
+    pkt.sid_enddevice   = d->sid;
+    pkt.id_enddevice    = (uint8_t)(d->sid - SIM_SID_DEVICE);
+    pkt.id_sensor       = TWELITE_ID_BME280;
+    pkt.mvolt_vdd       = (uint16_t)(d->mvolt / 100);
+    pkt.pkt_bme280.id_sensor     = TWELITE_ID_BME280;
+    pkt.pkt_bme280.i_temperature = (uint16_t)d->temperature;
+    pkt.pkt_bme280.i_humidity    = (uint16_t)d->humidity;
+    pkt.pkt_bme280.i_pressure    = (uint32_t)d->pressure;
+    s->n_packet++;
+    if (sim_random(s) % 1000 < s->loss) {
+        s->n_lost++;
+        return 0;
+    }
+    for (r = 0; r < s->router_num; r++) {
+        if (d->lqi[r] > SIM_LQI_HEARD) {
+            order[heard++] = r;
+        }
+    }
+    for (i = heard; i > 1; i--) {
+        uint32_t j = sim_random(s) % i;
+        uint32_t tmp = order[i - 1];
+        order[i - 1] = order[j];
+        order[j] = tmp;
+    }
+    for (i = 0; i < heard; i++) {
+        r = order[i];
+        pkt.sid_router  = SIM_SID_ROUTER + r;
+        pkt.lqi         = (uint8_t)sim_clamp(d->lqi[r] + sim_range(s,
+                          -SIM_LQI_NOISE, SIM_LQI_NOISE), 0, 255);
+        int32_t len = s->binary ? twelite_build_binary(frame, sizeof(frame), &pkt)
+                                : twelite_build_packet(frame, sizeof(frame), &pkt);
+        if ((len < 0) || sim_write(fd, frame, len)) {
+            return -1;
+        }
+        s->n_frame++;
+        s->n_byte += len;
+    }
+    return 0;
+}
+
+/** <!-- sim_open_pty {{{1 -->
+ * @brief open raw pseudo terminal, print path of its slave and wait for
+ *        the reader to open it
+ * @param nothing
+ * @return file descriptor of master
+ * @retval -ve_value: Error
+ */
+static int sim_open_pty(void)
+{
+    struct termios tio;
+    int fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if ((fd < 0) || grantpt(fd) || unlockpt(fd)) {
+        perror("posix_openpt");
+        return -1;
+    }
+    if (tcgetattr(fd, &tio) == 0) {
+        cfmakeraw(&tio);
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+    fprintf(stderr, "twesim: %s\n", ptsname(fd));
+    // master hangs up until the reader opens the slave
+    while (1) {
+        struct pollfd pfd = {.fd = fd, .events = POLLOUT};
+        if ((poll(&pfd, 1, 100) > 0) && !(pfd.revents & POLLHUP)) {
+            break;
+        }
+        usleep(100 * 1000);
+    }
+    usleep(100 * 1000); // let the reader set raw mode
+    return fd;
+}
+
+/** <!-- sim_usage {{{1 -->
+ * @brief print usage
+ * @param nothing
+ * @return nothing
+ */
+static void sim_usage(void)
+{
+    fprintf(stderr,
+        "usage: twesim [options]\n"
+        "  -n num   end devices (%u)\n"
+        "  -r num   routers (%u)\n"
+        "  -i ms    mean send interval of end device (%u)\n"
+        "  -t sec   simulated time (%ld)\n"
+        "  -l num   packets lost before any router [1/1000] (%u)\n"
+        "  -x num   speed factor, 0: as fast as possible (%u)\n"
+        "  -s num   random seed (%u)\n"
+        "  -b       binary transfer mode\n"
+        "  -p       write to pseudo terminal, its path goes to stderr\n",
+        sim.device_num, sim.router_num, sim.interval,
+        (long)(sim.duration / 1000), sim.loss, sim.speed, sim.seed);
+}
+
+/** <!-- main {{{1 -->
+ * @brief main function
+ * @param[in] argc number of arguments
+ * @param[in] argv arguments
+ * @return exit status
+ */
+int main(int argc, char **argv)
+{
+    struct timespec start;
+    int fd = STDOUT_FILENO;
+    int opt;
+    sim.device_num  = 16;
+    sim.router_num  = 2;
+    sim.interval    = 10000;
+    sim.duration    = 60 * 1000;
+    sim.speed       = 1;
+    sim.seed        = 1;
+    while ((opt = getopt(argc, argv, "n:r:i:t:l:x:s:bph")) != -1) {
+        switch (opt) {
+        case 'n': sim.device_num = strtoul(optarg, NULL, 0); break;
+        case 'r': sim.router_num = strtoul(optarg, NULL, 0); break;
+        case 'i': sim.interval   = strtoul(optarg, NULL, 0); break;
+        case 't': sim.duration   = strtoll(optarg, NULL, 0) * 1000; break;
+        case 'l': sim.loss       = strtoul(optarg, NULL, 0); break;
+        case 'x': sim.speed      = strtoul(optarg, NULL, 0); break;
+        case 's': sim.seed       = strtoul(optarg, NULL, 0); break;
+        case 'b': sim.binary     = 1; break;
+        case 'p': sim.pty        = 1; break;
+        default:
+            sim_usage();
+            return 2;
+        }
+    }
+    if ((sim.device_num < 1) || (sim.device_num > SIM_DEVICE_MAX) ||
+        (sim.router_num < 1) || (sim.router_num > SIM_ROUTER_MAX) ||
+        (sim.interval < 1) || (sim.seed == 0)) {
+        sim_usage();
+        return 2;
+    }
+    if (sim.pty && ((fd = sim_open_pty()) < 0)) {
+        return 1;
+    }
+    sim_init(&sim);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (1) {
+        sim_device_t *d = &sim.dev[sim_next(&sim)];
+        if (d->next_time >= sim.duration) {
+            break;
+        }
+        sim_pace(&sim, &start, d->next_time);
+        if (sim_send(&sim, d, fd)) {
+            perror("write");
+            return 1;
+        }
+        int32_t jitter = (int32_t)(sim.interval * SIM_JITTER / 1000);
+        d->next_time += sim.interval + sim_range(&sim, -jitter, jitter);
+    }
+    fprintf(stderr, "twesim: packets=%u lost=%u frames=%u bytes=%llu\n",
+            sim.n_packet, sim.n_lost, sim.n_frame,
+            (unsigned long long)sim.n_byte);
+    if (sim.pty) {
+        // unread data is discarded at hang up, give the reader time
+        tcdrain(fd);
+        sleep(1);
+    }
+    return 0;
+}
+
+// end of file {{{1
+// vim:ft=c:et:nowrap:fdm=marker